@@ -36,7 +36,7 @@ void ExgMcChannel::StartupChannel(std::string logPath) {
       }
       if (!res.HasResult()) {
          this->PkLog_.reset();
-         fon9_LOG_FATAL(this->ChannelMgr_->Name_, ".StartupChannel|channelId=", this->ChannelId_, "|fn=", logPath, '|', res);
+         fon9_LOGM_FATAL(LogModule_Mc, this->ChannelMgr_->Name_, ".StartupChannel|channelId=", this->ChannelId_, "|fn=", logPath, '|', res);
       }
    }
    if (this->IsSnapshot()) // 快照更新, 尚未收到 A:Refresh Begin 之前, 不記錄 PkLog.
@@ -69,7 +69,7 @@ void ExgMcChannel::SetupReload() {
    fon9::File::SizeType fpos = 0;
    fon9::File::Result   res = fon9::FileReadAll(*this->PkLog_, fpos, reloader);
    if (res.IsError())
-      fon9_LOG_FATAL(this->ChannelMgr_->Name_, ".SetupReload|channelId=", this->ChannelId_, "|pos=", fpos, '|', res);
+      fon9_LOGM_FATAL(LogModule_Mc, this->ChannelMgr_->Name_, ".SetupReload|channelId=", this->ChannelId_, "|pos=", fpos, '|', res);
 }
 void ExgMcChannel::ReloadDispatch(SeqT fromSeq) {
    if (!this->PkLog_)
@@ -101,7 +101,7 @@ void ExgMcChannel::ReloadDispatch(SeqT fromSeq) {
    fon9::File::SizeType fpos = this->Pk1stPos_;
    fon9::File::Result   res = fon9::FileReadAll(*this->PkLog_, fpos, reloader);
    if (res.IsError())
-      fon9_LOG_FATAL(this->ChannelMgr_->Name_, ".ReloadDispatch|channelId=", this->ChannelId_, "|pos=", fpos, '|', res);
+      fon9_LOGM_FATAL(LogModule_Mc, this->ChannelMgr_->Name_, ".ReloadDispatch|channelId=", this->ChannelId_, "|pos=", fpos, '|', res);
    if (this->State_ < ExgMcChannelState::Cycled)
       this->State_ = ExgMcChannelState::Running;
 }
@@ -205,11 +205,11 @@ void ExgMcChannel::PkContOnTimer(PkPendings::Locker&& pks) {
                break;
             svr = *rs->begin();
          }
-         fon9_LOG_WARN(this->ChannelMgr_->Name_,
+         fon9_LOGM_WARN(LogModule_Mc, this->ChannelMgr_->Name_,
                        "|recoverSessionId=", svr->SessionId_,
                        "|requestCount=", svr->GetRequestCount());
       }
-      fon9_LOG_WARN(this->ChannelMgr_->Name_, ".PkLost|err=NoRecover");
+      fon9_LOGM_WARN(LogModule_Mc, this->ChannelMgr_->Name_, ".PkLost|err=NoRecover");
    }
    base::PkContOnTimer(std::move(pks));
 }
@@ -503,14 +503,14 @@ ExgMcChannelMgr::ExgMcChannelMgr(ExgMdSymbsSP symbs, fon9::StrView sysName, fon9
 ExgMcChannelMgr::~ExgMcChannelMgr() {
 }
 void ExgMcChannelMgr::StartupChannelMgr(std::string logPath) {
-   fon9_LOG_INFO(this->Name_, ".StartupChannelMgr|path=", logPath);
+   fon9_LOGM_INFO(LogModule_Mc, this->Name_, ".StartupChannelMgr|path=", logPath);
    for (ExgMcChannel& channel : this->Channels_)
       channel.StartupChannel(logPath);
    for (ExgMcChannel& channel : this->Channels_)
       channel.SetupReload();
 }
 void ExgMcChannelMgr::ChannelCycled(ExgMcChannel& src) {
-   fon9_LOG_INFO(this->Name_, ".ChannelCycled|ChannelId=", src.GetChannelId());
+   fon9_LOGM_INFO(LogModule_Mc, this->Name_, ".ChannelCycled|ChannelId=", src.GetChannelId());
    auto iMkt = (src.GetChannelId() % 2);
    if (src.IsBasicInfo()) {
       for (ExgMcChannel& c : this->Channels_) {
@@ -524,7 +524,7 @@ void ExgMcChannelMgr::ChannelCycled(ExgMcChannel& src) {
 }
 void ExgMcChannelMgr::OnSnapshotDone(ExgMcChannel& src, uint64_t lastRtSeq) {
    assert(src.IsSnapshot());
-   fon9_LOG_INFO(this->Name_, ".SnapshotDone|ChannelId=", src.GetChannelId());
+   fon9_LOGM_INFO(LogModule_Mc, this->Name_, ".SnapshotDone|ChannelId=", src.GetChannelId());
    auto iMkt = (src.GetChannelId() % 2);
    for (ExgMcChannel& c : this->Channels_) {
       if (c.GetChannelId() % 2 == iMkt)
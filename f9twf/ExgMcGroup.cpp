@@ -38,7 +38,7 @@ unsigned ExgMcSystem::CheckTDayYYYYMMDD(fon9::TimeStamp tm) const {
 bool ExgMcSystem::Startup(const unsigned tdayYYYYMMDD) {
    if (tdayYYYYMMDD == this->TDayYYYYMMDD_)
       return false;
-   fon9_LOG_IMP("ExgMcSystem.Startup|name=", this->Name_, "|tday=", tdayYYYYMMDD);
+   fon9_LOGM_IMP(LogModule_Mc, "ExgMcSystem.Startup|name=", this->Name_, "|tday=", tdayYYYYMMDD);
    this->TDayYYYYMMDD_ = tdayYYYYMMDD;
    fon9::TimedFileName logfn(fon9::seed::SysEnv_GetLogFileFmtPath(*this->Root_), fon9::TimedFileName::TimeScale::Day);
    // 檔名與 TDay 相關, 與 TimeZone 無關, 所以要扣除 logfn.GetTimeChecker().GetTimeZoneOffset();
@@ -58,7 +58,7 @@ void ExgMcSystem::StartupMcSystem() {
    this->Startup(this->CheckTDayYYYYMMDD(fon9::LocalNow()));
    fon9::TimeStamp tm = fon9::YYYYMMDDHHMMSS_ToTimeStamp(this->TDayYYYYMMDD_, this->ClearHHMMSS_)
                       + fon9::TimeInterval_Day(1);
-   fon9_LOG_IMP("ExgMcSystem.NextClear|name=", this->Name_, "|time=", tm);
+   fon9_LOGM_IMP(LogModule_Mc, "ExgMcSystem.NextClear|name=", this->Name_, "|time=", tm);
    this->ClearTimer_.RunAt(tm - fon9::GetLocalTimeZoneOffset());
 }
 //--------------------------------------------------------------------------//
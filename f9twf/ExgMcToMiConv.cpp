@@ -147,7 +147,7 @@ void ExgMcToMiConv::OnStartupMcGroup(ExgMcGroup&, const std::string& logPath) {
    this->PkLog_ = fon9::AsyncFileAppender::Make();
    auto res = this->PkLog_->OpenImmediately(logfn, fon9::FileMode::CreatePath | fon9::FileMode::Read | fon9::FileMode::Append);
    if (res.IsError()) {
-      fon9_LOG_FATAL("ExgMcToMiConv.OnStartupMcGroup|fn=", logfn, '|', res);
+      fon9_LOGM_FATAL(LogModule_Mc, "ExgMcToMiConv.OnStartupMcGroup|fn=", logfn, '|', res);
       this->PkLog_.reset();
       return;
    }
@@ -174,7 +174,7 @@ void ExgMcToMiConv::OnStartupMcGroup(ExgMcGroup&, const std::string& logPath) {
    fon9::File::SizeType fpos = 0;
    res = fon9::FileReadAll(*this->PkLog_, fpos, reloader);
    if (res.IsError())
-      fon9_LOG_FATAL("ExgMcToMiConv.OnStartupMcGroup.Read|fn=", logfn, "|pos=", fpos, '|', res);
+      fon9_LOGM_FATAL(LogModule_Mc, "ExgMcToMiConv.OnStartupMcGroup.Read|fn=", logfn, "|pos=", fpos, '|', res);
 }
 void ExgMcToMiConv::OnExgMcMessage(const ExgMcMessage& e) {
    MsgHandler& msgh = this->GetMsgHandler(e.Pk_);
@@ -4,6 +4,8 @@
 
 namespace f9twf {
 
+f9twf_API fon9::LogModule  LogModule_Mc{"f9twf.Mc"};
+
 ExgMiPkReceiver::~ExgMiPkReceiver() {
 }
 unsigned ExgMiPkReceiver::GetPkSize(const void* pkptr) {
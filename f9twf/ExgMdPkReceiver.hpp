@@ -4,9 +4,13 @@
 #define __f9twf_ExgMdPkReceiver_hpp__
 #include "f9twf/ExgMdFmt.hpp"
 #include "fon9/PkReceiver.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace f9twf {
 
+/// 期交所行情(ExgMc*, ExgMr*)使用的 log 類別: "f9twf.Mc";
+extern f9twf_API fon9::LogModule  LogModule_Mc;
+
 /// 解析台灣期交所「間隔行情」格式框架.
 class f9twf_API ExgMiPkReceiver : public fon9::PkReceiver {
    fon9_NON_COPY_NON_MOVE(ExgMiPkReceiver);
@@ -79,7 +79,7 @@ io::RecvBufferSize ExgMrRecoverSession::OnDevice_Recv(io::Device& dev, DcQueueLi
             auto channelId = TmpGetValueU(pkrec->ChannelId_);
             auto beginSeqNo = TmpGetValueU(pkrec->BeginSeqNo_);
             auto recoverNum = TmpGetValueU(pkrec->RecoverNum_);
-            fon9_LOG_WARN("ExgMrRecoverSession.RecoverErr"
+            fon9_LOGM_WARN(LogModule_Mc, "ExgMrRecoverSession.RecoverErr"
                           "|channelId=", channelId, "|st=", pkrec->StatusCode_,
                           "|beginSeqNo=", beginSeqNo, "|recoverNum=", recoverNum);
             if (auto* channel = this->ChannelMgr_->GetChannel(channelId))
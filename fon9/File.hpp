@@ -192,6 +192,10 @@ public:
    Fdr::fdr_t ReleaseFD() {
       return this->Fdr_.ReleaseFD();
    }
+   /// 僅供需要直接使用 fd 的地方(例: FileMap), fd 的擁有權仍屬於 this.
+   Fdr::fdr_t GetFD() const {
+      return this->Fdr_.GetFD();
+   }
 };
 fon9_WARN_POP;
 
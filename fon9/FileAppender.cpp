@@ -1,7 +1,7 @@
 ﻿/// \file fon9/FileAppender.cpp
 /// \author fonwinz@gmail.com
 #include "fon9/FileAppender.hpp"
-#include "fon9/DefaultThreadPool.hpp"
+#include "fon9/WorkStealingPool.hpp"
 
 namespace fon9 {
 
@@ -178,7 +178,7 @@ bool AsyncFileAppender::MakeCallNow(WorkContentLocker&& lk) {
    // 所以在此先釋放上面的 if (intrusive_ptr_add_ref(this) == 0)...
    // 並使用 intrusive_ptr<> pthis 傳遞, 這樣才能確保當要求的 task 沒有執行時, this 仍會正常死亡!
 
-   GetDefaultThreadPool().EmplaceMessage([pthis]() {
+   GetDefaultWorkPool().AddTask([pthis]() {
       WorkContentLocker lk2{pthis->Worker_.Lock()};
       lk2->SetAsyncTaken();
       pthis->Worker_.TakeCallLocked(std::move(lk2));
@@ -130,7 +130,7 @@ public:
 };
 
 /// \ingroup Misc
-/// - 當收到 Append() 要求時, 丟到 DefaultThreadPool 寫檔.
+/// - 當收到 Append() 要求時, 丟到 GetDefaultWorkPool() 寫檔.
 class fon9_API AsyncFileAppender : public intrusive_ref_counter<AsyncFileAppender>, public FileAppender {
    fon9_NON_COPY_NON_MOVE(AsyncFileAppender);
    using base = FileAppender;
@@ -145,7 +145,7 @@ protected:
    virtual void DisposeAsync();
 
    /// 返回前 lk 可能已經 unlock().
-   /// \retval true  則把需求丟到 DefaultThreadPool 去處理.
+   /// \retval true  則把需求丟到 GetDefaultWorkPool() 去處理.
    /// \retval false 現在狀態無法進行非同步要求(下班了? 正在結構?).
    virtual bool MakeCallNow(WorkContentLocker&& lk) override;
    /// - 如果 IsHighWaterLevel() => WaitConsumed() 等候水位降低.
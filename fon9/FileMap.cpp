@@ -0,0 +1,75 @@
+﻿// \file fon9/FileMap.cpp
+// \author fonwinz@gmail.com
+#include "fon9/FileMap.hpp"
+#ifndef fon9_WINDOWS
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace fon9 {
+
+/// 映射的開始位置, 必須是此值的整數倍.
+static size_t GetFileMapGranularity() {
+#ifdef fon9_WINDOWS
+   SYSTEM_INFO si;
+   GetSystemInfo(&si);
+   return si.dwAllocationGranularity;
+#else
+   return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+File::Result FileMap::Map(const File& fd, File::PosType offset, size_t size, bool isWritable) {
+   this->Unmap();
+   if (size == 0)
+      return File::Result{0};
+   if (!fd.IsOpened())
+      return File::Result{std::errc::bad_file_descriptor};
+   static const size_t  kGranularity = GetFileMapGranularity();
+   const size_t         delta = static_cast<size_t>(offset % kGranularity);
+   const File::PosType  mapOffset = offset - delta;
+   const size_t         mapSize = size + delta;
+#ifdef fon9_WINDOWS
+   const uint64_t mapEnd = offset + size;
+   HANDLE hmap = CreateFileMapping(fd.GetFD(), nullptr, isWritable ? PAGE_READWRITE : PAGE_READONLY,
+                                   static_cast<DWORD>(mapEnd >> 32), static_cast<DWORD>(mapEnd), nullptr);
+   if (hmap == nullptr)
+      return File::Result{GetSysErrC()};
+   void* addr = MapViewOfFile(hmap, isWritable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ,
+                              static_cast<DWORD>(mapOffset >> 32), static_cast<DWORD>(mapOffset), mapSize);
+   ErrC  eno = (addr ? ErrC{} : GetSysErrC());
+   // view 會保留 mapping object 的參考, 所以可以直接關閉 hmap.
+   CloseHandle(hmap);
+   if (addr == nullptr)
+      return File::Result{eno};
+#else
+   void* addr = mmap(nullptr, mapSize, isWritable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                     fd.GetFD(), static_cast<off_t>(mapOffset));
+   if (addr == MAP_FAILED)
+      return File::Result{GetSysErrC()};
+#endif
+   this->MapAddr_ = addr;
+   this->MapSize_ = mapSize;
+   this->Delta_ = delta;
+   return File::Result{size};
+}
+void FileMap::Unmap() {
+   if (this->MapAddr_ == nullptr)
+      return;
+#ifdef fon9_WINDOWS
+   UnmapViewOfFile(this->MapAddr_);
+#else
+   munmap(this->MapAddr_, this->MapSize_);
+#endif
+   this->MapAddr_ = nullptr;
+   this->MapSize_ = 0;
+   this->Delta_ = 0;
+}
+void FileMap::AdviseSequential() const {
+#ifndef fon9_WINDOWS
+   if (this->MapAddr_)
+      madvise(this->MapAddr_, this->MapSize_, MADV_SEQUENTIAL);
+#endif
+}
+
+} // namespaces
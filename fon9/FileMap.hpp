@@ -0,0 +1,73 @@
+﻿/// \file fon9/FileMap.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_FileMap_hpp__
+#define __fon9_FileMap_hpp__
+#include "fon9/File.hpp"
+
+namespace fon9 {
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Misc
+/// 將已開啟的檔案映射到記憶體(Linux: mmap(MAP_SHARED); Windows: MapViewOfFile()).
+/// - 映射範圍不可超過檔案大小, 若需要寫入更大的範圍, 請先用 File::SetFileSize() 調整.
+/// - 可從檔案的任意位置開始映射, 內部會自動調整到系統要求的對齊位置.
+/// - 可寫入的映射: 寫入的內容會直接反映到檔案(即使 process 異常結束, 只要 OS 正常, 資料就不會遺失).
+/// - 映射建立後, File 可以關閉, 映射仍然有效.
+/// - 不負責 thread safe, 若映射範圍會改變(重新映射), 使用端必須自行保護.
+class fon9_API FileMap {
+   fon9_NON_COPYABLE(FileMap);
+   /// 實際的映射位置及大小(已調整到對齊位置).
+   void*    MapAddr_{nullptr};
+   size_t   MapSize_{0};
+   /// 要求的 offset 與 對齊後的位置, 之間的差距.
+   size_t   Delta_{0};
+public:
+   FileMap() = default;
+   ~FileMap() {
+      this->Unmap();
+   }
+   FileMap(FileMap&& rhs) : MapAddr_{rhs.MapAddr_}, MapSize_{rhs.MapSize_}, Delta_{rhs.Delta_} {
+      rhs.MapAddr_ = nullptr;
+      rhs.MapSize_ = rhs.Delta_ = 0;
+   }
+   FileMap& operator=(FileMap&& rhs) {
+      FileMap tmp{std::move(rhs)};
+      std::swap(this->MapAddr_, tmp.MapAddr_);
+      std::swap(this->MapSize_, tmp.MapSize_);
+      std::swap(this->Delta_, tmp.Delta_);
+      return *this;
+   }
+
+   /// 先 Unmap(), 然後將 fd 的 [offset..offset+size) 映射到記憶體, 映射後 this->begin() 就是 offset 的位置.
+   /// \retval Result{size} 成功, 若 size==0 則不會建立映射, this->IsMapped()==false;
+   /// \retval Result{ErrC} 失敗.
+   File::Result Map(const File& fd, File::PosType offset, size_t size, bool isWritable);
+   File::Result Map(const File& fd, size_t size, bool isWritable) {
+      return this->Map(fd, 0, size, isWritable);
+   }
+   void Unmap();
+
+   /// 告知系統: 將會依序讀取映射的內容, 讓系統可以提前載入, 並儘快釋放已讀過的部分.
+   /// Windows: 不支援, 直接返回.
+   void AdviseSequential() const;
+
+   bool IsMapped() const {
+      return this->MapAddr_ != nullptr;
+   }
+   void* data() const {
+      return static_cast<byte*>(this->MapAddr_) + this->Delta_;
+   }
+   size_t size() const {
+      return this->MapSize_ - this->Delta_;
+   }
+   const char* begin() const {
+      return static_cast<const char*>(this->data());
+   }
+   const char* end() const {
+      return static_cast<const char*>(this->MapAddr_) + this->MapSize_;
+   }
+};
+fon9_WARN_POP;
+
+} // namespaces
+#endif//__fon9_FileMap_hpp__
@@ -2,7 +2,7 @@
 // \author fonwinz@gmail.com
 #include "fon9/InnApf.hpp"
 #include "fon9/BitvArchive.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 #include "fon9/DefaultThreadPool.hpp"
 
 namespace fon9 {
@@ -86,7 +86,7 @@ InnApfSP InnApf::Make(OpenArgs& args, const InnStream::OpenArgs& streamOpenArgs,
          retval->OnNewInnFile();
       else {
          if (const char* errmsg = retval->ReadExHeader()) {
-            fon9_LOG_ERROR("InnApf.ReadExHeader|fileName=", args.FileName_, "|err=", errmsg);
+            fon9_LOGM_ERROR(LogModule_Inn, "InnApf.ReadExHeader|fileName=", args.FileName_, "|err=", errmsg);
             res = std::errc::bad_message;
             return nullptr;
          }
@@ -96,7 +96,7 @@ InnApfSP InnApf::Make(OpenArgs& args, const InnStream::OpenArgs& streamOpenArgs,
       return retval;
    }
    catch (std::exception& e) {
-      fon9_LOG_ERROR("InnApf.Open|fileName=", args.FileName_, "|err=", e.what());
+      fon9_LOGM_ERROR(LogModule_Inn, "InnApf.Open|fileName=", args.FileName_, "|err=", e.what());
       res = std::errc::bad_message;
       return nullptr;
    }
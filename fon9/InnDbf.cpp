@@ -2,8 +2,8 @@
 /// \author fonwinz@gmail.com
 #include "fon9/InnDbf.hpp"
 #include "fon9/BitvArchive.hpp"
-#include "fon9/Log.hpp"
-#include "fon9/DefaultThreadPool.hpp"
+#include "fon9/LogModule.hpp"
+#include "fon9/WorkStealingPool.hpp"
 #include "fon9/buffer/DcQueueList.hpp"
 
 namespace fon9 {
@@ -26,7 +26,7 @@ InnDbf::OpenResult InnDbf::Open(OpenArgs& oargs) {
    }
    catch (std::exception& e) {
       this->Close();
-      fon9_LOG_ERROR("InnDbf.Open|dbf=", this->GetDbfName(), "|err=", e.what());
+      fon9_LOGM_ERROR(LogModule_Inn, "InnDbf.Open|dbf=", this->GetDbfName(), "|err=", e.what());
       return OpenResult{std::errc::bad_message};
    }
 }
@@ -82,7 +82,7 @@ InnDbf::OpenResult InnDbf::OpenImpl(OpenArgs& oargs) {
       if (fon9_UNLIKELY(tableId <= 0)) {
          errmsg = "Bad TableId";
       __RETURN_ERROR:
-         fon9_LOG_ERROR("InnDbf.Open|table=", tableName, "|tableId=", tableId, "|err=", errmsg);
+         fon9_LOGM_ERROR(LogModule_Inn, "InnDbf.Open|table=", tableName, "|tableId=", tableId, "|err=", errmsg);
          return OpenResult{std::errc::bad_message};
       }
       InnDbfTableLinkSP table{new InnDbfTableLink(tableId, tableName, this)};
@@ -191,7 +191,7 @@ void InnDbf::LoadAll() {
       if (fon9_UNLIKELY(tableId <= 0 || tableMap->TableList_.size() < tableId)) {
          errmsg = StrView{"Bad tableId"};
       __LOG_ERROR:
-         fon9_LOG_ERROR("InnDbf.LoadAll|dbf=", this->GetDbfName(),
+         fon9_LOGM_ERROR(LogModule_Inn, "InnDbf.LoadAll|dbf=", this->GetDbfName(),
                         "|inn=", this->InnFile_.GetOpenName(),
                         "|pos=", roomKey.GetRoomPos(),
                         "|tableId=", tableId,
@@ -278,7 +278,10 @@ void InnDbf::WaitFlush() {
       std::this_thread::sleep_for(std::chrono::milliseconds{1});
 }
 void InnDbf::StartAsyncUpdateRequests() {
-   GetDefaultThreadPool().EmplaceMessage(std::bind(&InnDbf::DoUpdateRequests, InnDbfSP{this}));
+   InnDbfSP pthis{this};
+   GetDefaultWorkPool().AddTask([pthis]() {
+      pthis->DoUpdateRequests();
+   });
 }
 void InnDbf::WriteExHeaderAddTable(InnDbfTableLink& table) {
    RevBufferList rbuf{64};
@@ -370,7 +373,7 @@ __INTO_CHECK_EMPTY:
          this->InnFile_.Rewrite(req.Room_->RoomKey_, dcbuf);
       }
       catch (std::exception& e) {
-         fon9_LOG_FATAL("InnDbf.DoUpdateRequests|dbf=", this->GetDbfName(),
+         fon9_LOGM_FATAL(LogModule_Inn, "InnDbf.DoUpdateRequests|dbf=", this->GetDbfName(),
                         "|table=", req.Table_->TableName_,
                         "|room=", req.Room_->RoomKey_.GetRoomPos(),
                         "|err=", e.what());
@@ -474,7 +477,7 @@ void InnDbf::OnInnSyncReceived(InnSyncer& syncer, DcQueue&& buf) {
       TableMap::Locker  tables{this->TableMap_};
       auto ifind = tables->find(ToStrView(tableName));
       if (ifind == tables->end()) {
-         fon9_LOG_WARN("InnDbf.OnInnSync|dbf=", this->GetDbfName(),
+         fon9_LOGM_WARN(LogModule_Inn, "InnDbf.OnInnSync|dbf=", this->GetDbfName(),
                        "|tableName=", tableName,
                        "|err=table not found");
          return;
@@ -485,7 +488,7 @@ void InnDbf::OnInnSyncReceived(InnSyncer& syncer, DcQueue&& buf) {
    if (handler)
       handler->OnInnDbfTable_Sync(evArgs);
    else
-      fon9_LOG_WARN("InnDbf.OnInnSync|dbf=", this->GetDbfName(),
+      fon9_LOGM_WARN(LogModule_Inn, "InnDbf.OnInnSync|dbf=", this->GetDbfName(),
                     "|tableName=", tableName,
                     "|err=table handler not found");
 }
@@ -3,7 +3,7 @@
 #include "fon9/InnSyncer.hpp"
 #include "fon9/BitvEncode.hpp"
 #include "fon9/BitvDecode.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 {
 
@@ -63,7 +63,7 @@ void InnSyncer::OnInnSyncRecvImpl(StrView handlerName, DcQueue&& buf) {
       auto ifind = handlers->find(handlerName);
       if (ifind == handlers->end()) {
          // 找不到要同步的 handler: 此 handler 沒註冊? 或已不須此資料?
-         fon9_LOG_WARN("InnSyncer.OnInnSyncRecv|handlerName=", handlerName, "|err=handler not found.");
+         fon9_LOGM_WARN(LogModule_Inn, "InnSyncer.OnInnSyncRecv|handlerName=", handlerName, "|err=handler not found.");
          return;
       }
       handler = ifind->second;
@@ -3,7 +3,7 @@
 #include "fon9/InnSyncerFile.hpp"
 #include "fon9/File.hpp"
 #include "fon9/FilePath.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 #include "fon9/Timer.hpp"
 #include "fon9/Endian.hpp"
 #include "fon9/buffer/DcQueueList.hpp"
@@ -37,7 +37,7 @@ class InnSyncerFile::Impl {
       Result res = fd.Open(fname.ToString(), fmode);
       if (res)
          return true;
-      fon9_LOG_ERROR("InnSyncerFile.ctor|fname=", fname, "|err=", res);
+      fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.ctor|fname=", fname, "|err=", res);
       return false;
    }
 
@@ -84,7 +84,7 @@ public:
       DcQueueList outbuf{rbuf.MoveOut()};
       auto        res = this->SynOut_.Append(outbuf);
       if (!res || res.GetResult() != pksz + kExHeaderSize) {
-         fon9_LOG_ERROR("InnSyncerFile.Write|fname=", this->SynOut_.GetOpenName(),
+         fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Write|fname=", this->SynOut_.GetOpenName(),
                         "|err=", res, "|expect=", pksz + kExHeaderSize);
       }
    }
@@ -103,7 +103,7 @@ void InnSyncerFile::Impl::SynInTimer::EmitOnTimer(TimeStamp now) {
          // header error.
          if (impl.SearchingExHeaderFrom_ == 0) {
             impl.SearchingExHeaderFrom_ = curpos + 1;
-            fon9_LOG_ERROR("InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
+            fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
                            "|pos=", curpos, "|err=unknown header");
          }
          if (void* pofs = memchr(exHeader, kExHeaderMessage[0], sizeof(exHeader))) {
@@ -118,7 +118,7 @@ void InnSyncerFile::Impl::SynInTimer::EmitOnTimer(TimeStamp now) {
       }
       ExHeaderSizeT  pksz = GetBigEndian<ExHeaderSizeT>(exHeader + sizeof(kExHeaderMessage));
       if (impl.SearchingExHeaderFrom_) {
-         fon9_LOG_ERROR("InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
+         fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
                         "|dropFrom=", impl.SearchingExHeaderFrom_ - 1,
                         "|dropTo=", curpos,
                         "|nextPksz=", pksz);
@@ -129,7 +129,7 @@ void InnSyncerFile::Impl::SynInTimer::EmitOnTimer(TimeStamp now) {
       buf.push_back(bufNode = FwdBufferNode::Alloc(pksz));
       res = impl.SynIn_.Read(curpos + sizeof(exHeader), bufNode->GetDataEnd(), pksz);
       if (!res) {
-         fon9_LOG_ERROR("InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
+         fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
                         "|pos=", curpos + sizeof(exHeader),
                         "|read=", pksz,
                         "|err=", res);
@@ -143,13 +143,13 @@ void InnSyncerFile::Impl::SynInTimer::EmitOnTimer(TimeStamp now) {
       try {
          DcQueueList dcbuf{std::move(buf)};
          if (impl.Owner_.OnInnSyncRecv(dcbuf) <= 0) {
-            fon9_LOG_ERROR("InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
+            fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
                            "|pos=", curpos,
                            "|err=unknown sync data.");
          }
       }
       catch (std::exception& e) {
-         fon9_LOG_ERROR("InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
+         fon9_LOGM_ERROR(LogModule_Inn, "InnSyncerFile.Read|fname=", impl.SynIn_.GetOpenName(),
                         "|pos=", curpos,
                         "|syncErr=", e.what());
       }
@@ -1,6 +1,6 @@
 ﻿// \file fon9/Log.cpp
 // \author fonwinz@gmail.com
-#include "fon9/Log.hpp"
+#include "fon9/LogLazy.hpp"
 #include "fon9/ThreadId.hpp"
 #include "fon9/buffer/DcQueueList.hpp"
 #include "fon9/buffer/BufferNodeWaiter.hpp"
@@ -57,10 +57,13 @@ fon9_API void LogWrite(const LogArgs& logArgs, BufferList&& buf) {
    FnLogWriter_(logArgs, std::move(buf));
 }
 
-fon9_API void AddLogHeader(RevBufferList& rbuf, TimeStamp utctm, LogLevel level) {
-   RevPrint(rbuf, ThisThread_.GetThreadIdStr(), GetLevelStr(level));
+fon9_API void AddLogHeader(RevBufferList& rbuf, TimeStamp utctm, LogLevel level, StrView thrid) {
+   RevPrint(rbuf, thrid, GetLevelStr(level));
    RevPut_Date_Time_us(rbuf, utctm + LogTimeZoneAdjust_);
 }
+fon9_API void AddLogHeader(RevBufferList& rbuf, TimeStamp utctm, LogLevel level) {
+   AddLogHeader(rbuf, utctm, level, ThisThread_.GetThreadIdStr());
+}
 fon9_API void LogWrite(LogLevel level, RevBufferList&& rbuf) {
    LogArgs logArgs{level};
    AddLogHeader(rbuf, logArgs.UtcTime_, level);
@@ -68,6 +71,7 @@ fon9_API void LogWrite(LogLevel level, RevBufferList&& rbuf) {
 }
 
 fon9_API void WaitLogFlush() {
+   LogLazyFlush();
    LogArgs        la{LogLevel::Info};
    CountDownLatch waiter{1};
    BufferList     buf;
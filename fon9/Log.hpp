@@ -85,7 +85,7 @@ fon9_API void LogWrite(const LogArgs& logArgs, BufferList&& buf);
 fon9_API void LogWrite(LogLevel level, RevBufferList&& rbuf);
 
 /// \ingroup Misc
-/// 等候在 WaitLogFlush(); 之前的 log 輸出完畢.
+/// 等候在 WaitLogFlush(); 之前的 log 輸出完畢(包含 fon9/LogLazy.hpp 尚未格式化的 log).
 fon9_API void WaitLogFlush();
 
 enum {
@@ -100,15 +100,53 @@ enum {
 ///   - 範例:
 ///      - fon9_LOG_ERROR("TimedFile.OpenNewFile|FileName=", newFile.GetOpenName(), "|OpenMode=", newFile.GetOpenMode(), "|err=", res);
 ///      - fon9_LOG_INFO("DllMgr.LoadConfig|seedName=", this->Name_, "|cfgFileName=", cfgFileName);
-#define fon9_LOG(level, ...) do {                           \
-   if (fon9_UNLIKELY(level >= fon9::LogLevel_)) {           \
-      fon9::RevBufferList rbuf_{fon9::kLogBlockNodeSize};   \
-      fon9::RevPutChar(rbuf_, '\n');                        \
-      fon9::RevPrint(rbuf_, __VA_ARGS__);                   \
-      fon9::LogWrite(level, std::move(rbuf_));              \
-   }                                                        \
+///
+/// 若在 compile 時定義了 fon9_LOG_USE_LAZY, 則 fon9_LOG() 改用 fon9_LOG_LAZY(), 參考 fon9/LogLazy.hpp
+#define fon9_LOG(level, ...)  fon9_LOG_IF(level >= fon9::LogLevel_, level, __VA_ARGS__)
+
+/// \ingroup Misc
+/// compile time 的最低 log 等級(LogLevel 的數值), 低於此等級的 log 在 compile 時就會被移除.
+/// - 例: 在 include "fon9/Log.hpp" 之前 `#define fon9_LOG_MIN_LEVEL 2`, 則:
+///   fon9_LOG_TRACE()、fon9_LOG_DEBUG() 及 fon9_LOGM_TRACE()、fon9_LOGM_DEBUG() 全部變成空的敘述.
+/// - 因為 include guard 的關係, 必須在該 cpp 第一次(直接或間接) include "fon9/Log.hpp" 之前定義;
+///   或在 compile 參數設定, 例: `-Dfon9_LOG_MIN_LEVEL=2`
+#ifndef fon9_LOG_MIN_LEVEL
+#define fon9_LOG_MIN_LEVEL    0
+#endif
+#if fon9_LOG_MIN_LEVEL > 0 && !defined(fon9_NOLOG_TRACE)
+#define fon9_NOLOG_TRACE
+#endif
+#if fon9_LOG_MIN_LEVEL > 1 && !defined(fon9_NOLOG_DEBUG)
+#define fon9_NOLOG_DEBUG
+#endif
+#if fon9_LOG_MIN_LEVEL > 2 && !defined(fon9_NOLOG_INFO)
+#define fon9_NOLOG_INFO
+#endif
+/// level 不是常數時, 仍需在執行階段判斷 fon9_LOG_MIN_LEVEL.
+#if fon9_LOG_MIN_LEVEL > 0
+#define fon9_LOG_IsMinLevel(level)  (static_cast<int>(level) >= fon9_LOG_MIN_LEVEL)
+#else
+#define fon9_LOG_IsMinLevel(level)  true
+#endif
+
+/// \ingroup Misc
+/// 若 cond 成立(且 level >= fon9_LOG_MIN_LEVEL), 則立即格式化後寫入 log.
+/// 一般用法請使用 fon9_LOG(); 或 fon9/LogModule.hpp 的 fon9_LOGM();
+#define fon9_LOG_NOW_IF(cond, level, ...) do {                 \
+   if (fon9_UNLIKELY(fon9_LOG_IsMinLevel(level) && (cond))) {  \
+      fon9::RevBufferList rbuf_{fon9::kLogBlockNodeSize};      \
+      fon9::RevPutChar(rbuf_, '\n');                           \
+      fon9::RevPrint(rbuf_, __VA_ARGS__);                      \
+      fon9::LogWrite(level, std::move(rbuf_));                 \
+   }                                                           \
 } while(0)
 
+#ifdef fon9_LOG_USE_LAZY
+#define fon9_LOG_IF(cond, level, ...)  fon9_LOG_LAZY_IF(cond, level, __VA_ARGS__)
+#else
+#define fon9_LOG_IF(cond, level, ...)  fon9_LOG_NOW_IF(cond, level, __VA_ARGS__)
+#endif
+
 #ifdef fon9_NOLOG_TRACE
 #define fon9_LOG_TRACE(...)  do{}while(0)
 #else
@@ -134,13 +172,19 @@ enum {
 
 #define fon9_LOG_ThrRun(...) fon9_LOG_IMP(__VA_ARGS__)
 
-// fon9 內部使用: GetDefaultTimerThread(); GetDefaultThreadPool(); 的 ThrRun() 等候 Log system 備妥.
+// fon9 內部使用: GetDefaultTimerThread(); GetDefaultThreadPool(); GetDefaultWorkPool(); 的 ThrRun() 等候 Log system 備妥.
 extern void (*gWaitLogSystemReady)();
 
 /// 在 rbuf 前端增加:
 /// RevPut_Date_Time_us(rbuf, utctm + tzadj) + ThisThread_.GetThreadIdStr() + GetLevelStr(level)
 /// - tzadj 在 SetLogWriter() 設定.
 fon9_API void AddLogHeader(RevBufferList& rbuf, TimeStamp utctm, LogLevel level);
+/// 同上, 但使用指定的 thread id 字串, 例: LogLazy thread 輸出其他 thread 的 log.
+fon9_API void AddLogHeader(RevBufferList& rbuf, TimeStamp utctm, LogLevel level, StrView thrid);
 
 }// namespace
+
+#ifdef fon9_LOG_USE_LAZY
+#include "fon9/LogLazy.hpp"
+#endif
 #endif//__fon9_Log_hpp__
@@ -0,0 +1,395 @@
+﻿// \file fon9/LogBin.cpp
+// \author fonwinz@gmail.com
+#include "fon9/LogBin.hpp"
+#include "fon9/LogFile.hpp"
+#include <mutex>
+#include <unordered_map>
+
+namespace fon9 {
+
+constexpr uint32_t LogBinSession::kVersion;
+const char LogBinSession::kMagic[sizeof(Magic_)] = {'f','9','L','o','g','B','i','n'};
+
+LogBinEncoder::~LogBinEncoder() {
+}
+void LogBinEncoder::PutStr(const BufferList& buf) {
+   size_t sz = CalcDataSize(buf.cfront());
+   this->PutTag(LogBinTag::Str);
+   const size_t lenpos = this->Buffer_.size();
+   this->PutU32(static_cast<uint32_t>(sz));
+   for (const BufferNode* node = buf.cfront(); node; node = node->GetNext())
+      this->PutMem(node->GetDataBegin(), node->GetDataSize());
+   if (sz > 0 && this->Buffer_.back() == '\n') {
+      this->Buffer_.pop_back();
+      --sz;
+      const uint32_t len = static_cast<uint32_t>(sz);
+      memcpy(&this->Buffer_[lenpos], &len, sizeof(len));
+   }
+}
+
+//--------------------------------------------------------------------------//
+
+class LogBinFileImpl : public LogFileAppender, public LogBinEncoder {
+   fon9_NON_COPY_NON_MOVE(LogBinFileImpl);
+   using base = LogFileAppender;
+
+   // 由 LogLazy thread 使用: 字串常數內容的 hash => id; 比對內容時使用 Literals_[id];
+   std::unordered_multimap<size_t, uint32_t> LiteralIds_;
+   // 已定義的字串常數: 換檔時, 寫到新檔的開頭; 因換檔在 Appender 的 thread, 所以需要 mutex 保護.
+   std::mutex                 LiteralsMutex_;
+   std::vector<std::string>   Literals_;
+   TimeZoneOffset             TimeZoneOffset_;
+   std::string                LiteralRec_;
+
+   static void PutRecHead(std::string& out, LogBinRecType type, size_t sz) {
+      const uint32_t len = static_cast<uint32_t>(sz);
+      out.push_back(static_cast<char>(type));
+      out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+   }
+   static void PutLiteralRec(std::string& out, uint32_t id, StrView lit) {
+      PutRecHead(out, LogBinRecType::Literal, sizeof(id) + lit.size());
+      out.append(reinterpret_cast<const char*>(&id), sizeof(id));
+      out.append(lit.begin(), lit.size());
+   }
+
+   /// 超過此長度的字串, 不使用 Literal id.
+   static constexpr size_t    kMaxLiteralSize = 256;
+
+   static size_t LiteralHash(StrView lit) {
+      // FNV-1a
+      size_t h = static_cast<size_t>(14695981039346656037ull);
+      for (char ch : lit)
+         h = (h ^ static_cast<byte>(ch)) * static_cast<size_t>(1099511628211ull);
+      return h;
+   }
+   uint32_t GetLiteralId(StrView lit) override {
+      if (lit.size() > kMaxLiteralSize)
+         return kNoLiteralId;
+      const size_t hash = LiteralHash(lit);
+      // Literals_ 只有 LogLazy thread 會增加, 所以在此讀取不用鎖定.
+      auto range = this->LiteralIds_.equal_range(hash);
+      for (auto ifind = range.first; ifind != range.second; ++ifind) {
+         if (ToStrView(this->Literals_[ifind->second]) == lit)
+            return ifind->second;
+      }
+      if (this->Literals_.size() >= kMaxLiteralCount)
+         return kNoLiteralId;
+      uint32_t id;
+      {
+         std::lock_guard<std::mutex> lk{this->LiteralsMutex_};
+         id = static_cast<uint32_t>(this->Literals_.size());
+         this->Literals_.emplace_back(lit.begin(), lit.size());
+      }
+      this->LiteralIds_.emplace(hash, id);
+      // 必須在使用此 id 的 LogBinRecType::Log 之前寫入.
+      this->LiteralRec_.clear();
+      PutLiteralRec(this->LiteralRec_, id, lit);
+      this->Append(this->LiteralRec_.data(), this->LiteralRec_.size());
+      return id;
+   }
+
+   /// 由 LogLazy thread 呼叫.
+   static void LogLazyToFile(const impl::LogLazyRecord& rec, const ThreadId& thrid) {
+      LogBinFileImpl& rthis = *LogBinFileImpl::gLogBinFile;
+      rthis.CheckRotateTime(rec.UtcTime_);
+      std::string& out = rthis.Buffer_;
+      out.resize(kLogBinRecHeadSize);
+      out[0] = static_cast<char>(LogBinRecType::Log);
+      rthis.PutMem(&rec.UtcTime_, sizeof(rec.UtcTime_));
+      out.push_back(static_cast<char>(rec.Level_));
+      const StrView thrstr = thrid.GetThreadIdStr();
+      out.push_back(static_cast<char>(thrstr.size()));
+      rthis.PutMem(thrstr.begin(), thrstr.size());
+      rec.Fns_->FnEncode_(rec.Payload(), rthis);
+      const uint32_t len = static_cast<uint32_t>(out.size() - kLogBinRecHeadSize);
+      memcpy(&out[1], &len, sizeof(len));
+      rthis.Append(out.data(), out.size());
+   }
+   /// 透過 fon9_LOG() 寫入的訊息(已格式化), 或 WaitLogFlush();
+   static void LogWriteToFile(const LogArgs& logArgs, BufferList&& buf) {
+      LogBinFileImpl& rthis = *LogBinFileImpl::gLogBinFile;
+      rthis.CheckRotateTime(logArgs.UtcTime_);
+      const size_t sz = CalcDataSize(buf.cfront());
+      if (sz > 0) {
+         RevBufferList  rbuf{kLogBinRecHeadSize, std::move(buf)};
+         const uint32_t len = static_cast<uint32_t>(sz);
+         RevPutMem(rbuf, &len, sizeof(len));
+         RevPutChar(rbuf, static_cast<char>(LogBinRecType::Text));
+         buf = rbuf.MoveOut();
+      }
+      rthis.Append(std::move(buf));
+   }
+
+   File* OnFileRotate(File& fd, Result openResult) override {
+      if (!fd.IsOpened()) {
+         fon9_LOG_ERROR("LogBinFile|open=", fd.GetOpenName(), "|mode=", FileModeToStr(fd.GetOpenMode()), "|err=", openResult.GetError());
+         return nullptr;
+      }
+      File* curfd = base::OnFileRotate(fd, openResult);
+      if (curfd) {
+         // 每次開檔都寫入 LogBinSession, 及已定義的字串常數, 讓每個檔案都可以獨立解碼.
+         std::string    out;
+         LogBinSession  ses;
+         memcpy(ses.Magic_, LogBinSession::kMagic, sizeof(ses.Magic_));
+         ses.Version_ = LogBinSession::kVersion;
+         ses.TimeZoneOffset_ = this->TimeZoneOffset_;
+         PutRecHead(out, LogBinRecType::Session, sizeof(ses));
+         out.append(reinterpret_cast<const char*>(&ses), sizeof(ses));
+         {
+            std::lock_guard<std::mutex> lk{this->LiteralsMutex_};
+            uint32_t id = 0;
+            for (const std::string& lit : this->Literals_)
+               PutLiteralRec(out, id++, ToStrView(lit));
+         }
+         curfd->Append(out.data(), out.size());
+      }
+      return curfd;
+   }
+
+   LogBinFileImpl() {
+      LogBinFileImpl::gLogBinFile = this;
+   }
+public:
+   static LogBinFileImpl* gLogBinFile;
+   ~LogBinFileImpl() {
+      this->Unset();
+      this->DisposeAsync();
+      this->Worker_.TakeCall();
+      gLogBinFile = nullptr;
+   }
+   void Unset() {
+      UnsetLogLazySink(&LogBinFileImpl::LogLazyToFile);
+      UnsetLogWriter(&LogBinFileImpl::LogWriteToFile);
+   }
+   static File::Result Init(FileRotateSP frConfig, size_t highWaterLevelNodeCount) {
+      static intrusive_ptr<LogBinFileImpl> LogBinFile_{new LogBinFileImpl{}};
+      frConfig->CheckTime(UtcNow());
+      gLogBinFile->TimeZoneOffset_ = frConfig->GetFileNameMaker().GetTimeChecker().GetTimeZoneOffset();
+      auto resfut = gLogBinFile->OpenAsync(std::move(frConfig), FileMode::CreatePath);
+      gLogBinFile->SetHighWaterLevelNodeCount(highWaterLevelNodeCount);
+      gLogBinFile->Worker_.TakeCall();//強制處理開檔要求.
+      File::Result res = resfut.get();
+      if (gLogBinFile->IsOpened()) {
+         SetLogWriter(&LogBinFileImpl::LogWriteToFile, gLogBinFile->TimeZoneOffset_);
+         SetLogLazySink(&LogBinFileImpl::LogLazyToFile);
+         LogLazyStart();
+      }
+      return res;
+   }
+};
+LogBinFileImpl* LogBinFileImpl::gLogBinFile;
+
+fon9_API File::Result InitLogBinWriteToFile(std::string fmtFileName,
+                                            FileRotate::TimeScale tmScale,
+                                            File::SizeType maxFileSize,
+                                            size_t highWaterLevelNodeCount) {
+   return LogBinFileImpl::Init(FileRotateSP{new FileRotate(std::move(fmtFileName), tmScale, maxFileSize)}, highWaterLevelNodeCount);
+}
+fon9_API void CloseLogBinFile() {
+   if (LogBinFileImpl* impl = LogBinFileImpl::gLogBinFile) {
+      LogLazyFlush();
+      impl->Unset();
+      impl->Close();
+   }
+}
+
+//--------------------------------------------------------------------------//
+
+namespace {
+fon9_WARN_DISABLE_PADDING;
+struct LogBinArg {
+   LogBinTag   Tag_;
+   const byte* Ptr_;
+   uint32_t    Size_;
+};
+fon9_WARN_POP;
+
+template <class T>
+inline T LogBinGet(const byte* ptr) {
+   typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+   memcpy(&buf, ptr, sizeof(T));
+   return *reinterpret_cast<const T*>(&buf);
+}
+
+template <class T>
+inline auto LogBinPrintValue(RevBufferList& rbuf, const T& v, int) -> decltype(RevPrint(rbuf, v)) {
+   RevPrint(rbuf, v);
+}
+template <class T>
+inline void LogBinPrintValue(RevBufferList&, const T&, ...) {
+   // FmtDef, FmtTS: 無法單獨輸出.
+}
+
+template <class FmtT, class T>
+inline auto LogBinPrintFmt(RevBufferList& rbuf, const T& v, const FmtT& fmt, int)
+-> enable_if_t<std::is_same<AutoFmt<T>, FmtT>::value, decltype(RevPrint(rbuf, v, fmt))> {
+   RevPrint(rbuf, v, fmt);
+}
+template <class FmtT, class T>
+inline void LogBinPrintFmt(RevBufferList& rbuf, const T& v, const FmtT&, ...) {
+   LogBinPrintValue(rbuf, v, 0);
+}
+
+/// 輸出 arg, 若 fmt != nullptr, 則使用 fmt 格式化.
+template <class FmtT>
+void LogBinPrint(RevBufferList& rbuf, const LogBinArg& arg, const FmtT* fmt) {
+   switch (arg.Tag_) {
+   case LogBinTag::Str:
+   case LogBinTag::Literal:
+   {
+      const StrView str{reinterpret_cast<const char*>(arg.Ptr_), arg.Size_};
+      if (fmt)
+         LogBinPrintFmt(rbuf, str, *fmt, 0);
+      else
+         RevPrint(rbuf, str);
+      break;
+   }
+#define fon9_LogBin_CasePrint(tag, type)                          \
+   case LogBinTag::tag:                                           \
+      if (fmt)                                                    \
+         LogBinPrintFmt(rbuf, LogBinGet<type>(arg.Ptr_), *fmt, 0);\
+      else                                                        \
+         LogBinPrintValue(rbuf, LogBinGet<type>(arg.Ptr_), 0);    \
+      break;
+   fon9_LogBin_PodTypes(fon9_LogBin_CasePrint)
+#undef fon9_LogBin_CasePrint
+   }
+}
+
+size_t LogBinPodSize(LogBinTag tag) {
+   switch (tag) {
+#define fon9_LogBin_CaseSize(tag, type)   case LogBinTag::tag:  return sizeof(type);
+   fon9_LogBin_PodTypes(fon9_LogBin_CaseSize)
+#undef fon9_LogBin_CaseSize
+   case LogBinTag::Str:
+   case LogBinTag::Literal:
+      break;
+   }
+   return 0;
+}
+} // namespace
+
+bool LogBinDecoder::DecodeLog(const byte* pbeg, const byte* pend, RevBufferList& rbuf) {
+   const size_t kHeadSize = sizeof(TimeStamp) + sizeof(LogLevel) + 1;
+   if (pend - pbeg < static_cast<ptrdiff_t>(kHeadSize))
+      return false;
+   const TimeStamp utctm = LogBinGet<TimeStamp>(pbeg);
+   const LogLevel  level = static_cast<LogLevel>(pbeg[sizeof(TimeStamp)]);
+   const size_t    thrlen = pbeg[sizeof(TimeStamp) + sizeof(LogLevel)];
+   const StrView   thrid{reinterpret_cast<const char*>(pbeg + kHeadSize), thrlen};
+   pbeg += kHeadSize + thrlen;
+   if (pbeg > pend)
+      return false;
+   std::vector<LogBinArg> args;
+   while (pbeg < pend) {
+      LogBinArg arg;
+      arg.Tag_ = static_cast<LogBinTag>(*pbeg++);
+      switch (arg.Tag_) {
+      case LogBinTag::Str:
+         if (pend - pbeg < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+            return false;
+         arg.Size_ = LogBinGet<uint32_t>(pbeg);
+         arg.Ptr_ = pbeg + sizeof(uint32_t);
+         break;
+      case LogBinTag::Literal:
+      {
+         if (pend - pbeg < static_cast<ptrdiff_t>(sizeof(uint32_t)))
+            return false;
+         const uint32_t id = LogBinGet<uint32_t>(pbeg);
+         pbeg += sizeof(uint32_t);
+         if (id >= this->Literals_.size())
+            return false;
+         const std::string& lit = this->Literals_[id];
+         arg.Ptr_ = reinterpret_cast<const byte*>(lit.c_str());
+         arg.Size_ = static_cast<uint32_t>(lit.size());
+         args.push_back(arg);
+         continue;
+      }
+      default:
+         arg.Size_ = static_cast<uint32_t>(LogBinPodSize(arg.Tag_));
+         if (arg.Size_ == 0)
+            return false;
+         arg.Ptr_ = pbeg;
+         break;
+      }
+      pbeg = arg.Ptr_ + arg.Size_;
+      if (pbeg > pend)
+         return false;
+      args.push_back(arg);
+   }
+   // 與 RevPrint() 相同: 從最後一個參數開始輸出; 若參數為 FmtDef 或 FmtTS, 則用來格式化前一個參數.
+   RevPutChar(rbuf, '\n');
+   for (size_t L = args.size(); L > 0;) {
+      const LogBinArg& arg = args[--L];
+      if (arg.Tag_ == LogBinTag::FmtDef || arg.Tag_ == LogBinTag::FmtTS) {
+         if (L == 0)
+            break;
+         if (arg.Tag_ == LogBinTag::FmtDef) {
+            const FmtDef fmt = LogBinGet<FmtDef>(arg.Ptr_);
+            LogBinPrint(rbuf, args[--L], &fmt);
+         }
+         else {
+            const FmtTS fmt = LogBinGet<FmtTS>(arg.Ptr_);
+            LogBinPrint(rbuf, args[--L], &fmt);
+         }
+      }
+      else {
+         LogBinPrint(rbuf, arg, static_cast<const FmtDef*>(nullptr));
+      }
+   }
+   RevPrint(rbuf, thrid, GetLevelStr(level));
+   RevPut_Date_Time_us(rbuf, utctm + this->TimeZoneOffset_);
+   return true;
+}
+
+LogBinDecoder::Result LogBinDecoder::Decode(DcQueue& rxbuf, RevBufferList& rbuf) {
+   byte         headbuf[kLogBinRecHeadSize];
+   const byte*  phead = static_cast<const byte*>(rxbuf.Peek(headbuf, sizeof(headbuf)));
+   if (phead == nullptr)
+      return Result::NeedMore;
+   const LogBinRecType  type = static_cast<LogBinRecType>(phead[0]);
+   const uint32_t       recsz = LogBinGet<uint32_t>(phead + 1);
+   if (rxbuf.CalcSize() < kLogBinRecHeadSize + recsz)
+      return Result::NeedMore;
+   rxbuf.PopConsumed(kLogBinRecHeadSize);
+   this->RecBuffer_.resize(recsz);
+   if (recsz > 0)
+      rxbuf.Read(&*this->RecBuffer_.begin(), recsz);
+   const byte* const pbeg = reinterpret_cast<const byte*>(this->RecBuffer_.data());
+   const byte* const pend = pbeg + recsz;
+   switch (type) {
+   case LogBinRecType::Session:
+   {
+      if (recsz < sizeof(LogBinSession))
+         return Result::BadFormat;
+      const LogBinSession ses = LogBinGet<LogBinSession>(pbeg);
+      if (memcmp(ses.Magic_, LogBinSession::kMagic, sizeof(ses.Magic_)) != 0
+          || ses.Version_ != LogBinSession::kVersion)
+         return Result::BadFormat;
+      this->TimeZoneOffset_ = ses.TimeZoneOffset_;
+      this->Literals_.clear();
+      return Result::Decoded;
+   }
+   case LogBinRecType::Literal:
+   {
+      if (recsz < sizeof(uint32_t))
+         return Result::BadFormat;
+      const uint32_t id = LogBinGet<uint32_t>(pbeg);
+      // id 來自檔案內容: 超過寫入端的上限, 必定是錯誤的資料.
+      if (id >= LogBinEncoder::kMaxLiteralCount)
+         return Result::BadFormat;
+      if (id >= this->Literals_.size())
+         this->Literals_.resize(id + 1);
+      this->Literals_[id].assign(reinterpret_cast<const char*>(pbeg + sizeof(id)), recsz - sizeof(id));
+      return Result::Decoded;
+   }
+   case LogBinRecType::Log:
+      return this->DecodeLog(pbeg, pend, rbuf) ? Result::Decoded : Result::BadFormat;
+   case LogBinRecType::Text:
+      RevPutMem(rbuf, pbeg, pend);
+      return Result::Decoded;
+   }
+   return Result::BadFormat;
+}
+
+} // namespace fon9
@@ -0,0 +1,60 @@
+﻿/// \file fon9/LogBin.hpp
+///
+/// 二進位格式的 log 檔, 格式定義請參考 fon9/LogBinFmt.hpp
+/// - fon9_LOG_LAZY() 的參數直接以二進位格式寫入, 不用轉成文字(不用 ToStr、RevPut_Date_Time_us...),
+///   可降低 CPU 及磁碟的負擔, 適合在下單流程之類的地方, 持續開啟 Trace.
+/// - fon9_LOG() 的訊息, 仍會以文字格式(LogBinRecType::Text)寫入.
+/// - 使用 logdecode 工具(fon9/LogDecode_main.cpp), 轉成與 fon9/LogFile.hpp 相同的文字格式.
+///
+/// \author fonwinz@gmail.com
+#ifndef __fon9_LogBin_hpp__
+#define __fon9_LogBin_hpp__
+#include "fon9/LogLazy.hpp"
+#include "fon9/FileAppender.hpp"
+#include "fon9/buffer/DcQueue.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <vector>
+fon9_AFTER_INCLUDE_STD;
+
+namespace fon9 {
+
+/// \ingroup Misc
+/// 將 log 以二進位格式寫入檔案, 參數用法與 InitLogWriteToFile() 相同.
+/// - 若 LogLazy 尚未啟動, 則會使用預設參數 LogLazyStart();
+/// - fmtFileName 的時區設定, 會記錄在檔案裡面(LogBinSession), 解碼時用來調整 log 的時間.
+fon9_API File::Result InitLogBinWriteToFile(std::string fmtFileName,
+                                            FileRotate::TimeScale tmScale,
+                                            File::SizeType maxFileSize,
+                                            size_t highWaterLevelNodeCount);
+/// \ingroup Misc
+/// 將剩餘的 log 寫入檔案後關檔, 之後的 log 還原成: 格式化成文字後, 寫到 stdout.
+fon9_API void CloseLogBinFile();
+
+/// \ingroup Misc
+/// 解析二進位 log 檔, 轉成與 fon9/LogFile.hpp 相同的文字格式.
+class fon9_API LogBinDecoder {
+   fon9_NON_COPY_NON_MOVE(LogBinDecoder);
+   std::vector<std::string>   Literals_;
+   TimeZoneOffset             TimeZoneOffset_;
+   std::string                RecBuffer_;
+
+   bool DecodeLog(const byte* pbeg, const byte* pend, RevBufferList& rbuf);
+
+public:
+   LogBinDecoder() = default;
+
+   enum class Result {
+      /// 資料不足一筆記錄.
+      NeedMore,
+      /// 已取出一筆記錄, 若為 log 訊息, 則已放入 rbuf.
+      Decoded,
+      /// 格式錯誤, 無法繼續解析.
+      BadFormat,
+   };
+   /// 從 rxbuf 取出一筆記錄, 若為 log 訊息, 則轉成文字後放在 rbuf 的前端.
+   Result Decode(DcQueue& rxbuf, RevBufferList& rbuf);
+};
+
+} // namespace fon9
+#endif//__fon9_LogBin_hpp__
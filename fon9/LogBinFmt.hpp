@@ -0,0 +1,145 @@
+﻿/// \file fon9/LogBinFmt.hpp
+///
+/// 二進位 log 的格式定義, 使用方式請參考 fon9/LogBin.hpp
+/// - 檔案由一連串的記錄組成, 每筆記錄: `LogBinRecType(1 byte) + 內容大小(uint32_t) + 內容`
+/// - LogBinRecType::Session: 每次開檔時寫入(新檔、或續寫舊檔), 內容為 LogBinSession;
+///   之後的 Literal id 重新計算.
+/// - LogBinRecType::Literal: `uint32_t id + 字串內容`;
+///   字串常數(例: "|tag=") 只在第一次使用時寫入, 之後的 log 只記錄 id.
+/// - LogBinRecType::Log: `TimeStamp(UTC) + LogLevel + uint8_t thridLen + thrid + 參數...`;
+///   每個參數為: `LogBinTag + 內容`.
+/// - LogBinRecType::Text: 已格式化的完整 log 訊息(包含 header 及 '\n'), 例: 透過 fon9_LOG() 寫入的訊息.
+/// - 數值使用本機的 byte order 及記憶體格式, 所以必須在相同的平台解碼.
+///
+/// \author fonwinz@gmail.com
+#ifndef __fon9_LogBinFmt_hpp__
+#define __fon9_LogBinFmt_hpp__
+#include "fon9/TimeStamp.hpp"
+#include "fon9/buffer/BufferList.hpp"
+#include <string>
+
+namespace fon9 {
+
+enum class LogBinRecType : uint8_t {
+   Session = 'S',
+   Literal = 'L',
+   Log = 'G',
+   Text = 'T',
+};
+enum : size_t {
+   /// LogBinRecType(1 byte) + 內容大小(uint32_t).
+   kLogBinRecHeadSize = 1 + sizeof(uint32_t),
+};
+
+fon9_WARN_DISABLE_PADDING;
+struct LogBinSession {
+   char           Magic_[8];
+   uint32_t       Version_;
+   /// 產生 log 時的 TimeZoneOffset, 解碼時用來輸出 log 的時間.
+   TimeZoneOffset TimeZoneOffset_;
+
+   static constexpr uint32_t kVersion = 1;
+   static const char kMagic[sizeof(Magic_)];
+};
+fon9_WARN_POP;
+
+/// 可以直接複製記憶體的參數型別: fon9_LogBin_PodTypes(X): X(tag, type)
+#define fon9_LogBin_PodTypes(X) \
+   X(Char,         char)                 \
+   X(SChar,        signed char)          \
+   X(UChar,        unsigned char)        \
+   X(Short,        short)                \
+   X(UShort,       unsigned short)       \
+   X(Int,          int)                  \
+   X(UInt,         unsigned)             \
+   X(Long,         long)                 \
+   X(ULong,        unsigned long)        \
+   X(LongLong,     long long)            \
+   X(ULongLong,    unsigned long long)   \
+   X(TimeStamp,    TimeStamp)            \
+   X(TimeInterval, TimeInterval)         \
+   X(BaseHex,      ToHex)                \
+   X(BaseHEX,      ToHEX)                \
+   X(BaseOct,      ToOct)                \
+   X(BaseBin,      ToBin)                \
+   X(FmtDef,       FmtDef)               \
+   X(FmtTS,        FmtTS)                \
+//----- fon9_LogBin_PodTypes
+
+/// 參數的型別.
+enum class LogBinTag : uint8_t {
+   /// uint32_t len + 字串內容.
+   Str = 1,
+   /// uint32_t id; 透過 LogBinRecType::Literal 定義的字串常數.
+   Literal,
+#define fon9_LogBin_DefTag(tag, type)  tag,
+   fon9_LogBin_PodTypes(fon9_LogBin_DefTag)
+#undef fon9_LogBin_DefTag
+};
+
+/// 若 T 為 fon9_LogBin_PodTypes() 的型別, 則 LogBinPodTag<T>::kIsPod == true;
+template <class T>
+struct LogBinPodTag {
+   enum : bool { kIsPod = false };
+};
+#define fon9_LogBin_DefPodTag(tag, type)         \
+template <> struct LogBinPodTag<type> {          \
+   enum : bool { kIsPod = true };                \
+   static constexpr LogBinTag kTag = LogBinTag::tag; \
+};
+fon9_LogBin_PodTypes(fon9_LogBin_DefPodTag)
+#undef fon9_LogBin_DefPodTag
+
+/// \ingroup Misc
+/// 將 lazy log 的參數, 依照 LogBinTag 格式放入 Buffer_;
+/// 由 LogLazy thread 呼叫, 所以不用考慮 thread safe.
+class fon9_API LogBinEncoder {
+   fon9_NON_COPY_NON_MOVE(LogBinEncoder);
+protected:
+   std::string Buffer_;
+
+   /// 依照 lit 的內容(不是位址)取得 id, 因為 lit 不一定是字串常數(例: stack 上的 const char[N]).
+   /// 若 lit 尚未定義, 則必須在 LogBinRecType::Log 之前, 寫入 LogBinRecType::Literal.
+   /// \retval kNoLiteralId 不使用 id(例: 太長, 或已定義太多), 此時改用 PutStr(lit);
+   virtual uint32_t GetLiteralId(StrView lit) = 0;
+
+public:
+   enum : uint32_t { kNoLiteralId = ~static_cast<uint32_t>(0) };
+   /// 最多定義的 Literal 數量, 避免內容會變動的 const char[N](例: stack 上的陣列)造成 Literals 無限成長;
+   /// LogBinDecoder 也用此檢查 LogBinRecType::Literal 的 id.
+   enum : uint32_t { kMaxLiteralCount = 1024 * 8 };
+   LogBinEncoder() = default;
+   virtual ~LogBinEncoder();
+
+   void PutMem(const void* mem, size_t sz) {
+      this->Buffer_.append(reinterpret_cast<const char*>(mem), sz);
+   }
+   void PutTag(LogBinTag tag) {
+      this->Buffer_.push_back(static_cast<char>(tag));
+   }
+   void PutU32(uint32_t v) {
+      this->PutMem(&v, sizeof(v));
+   }
+   template <class T>
+   void PutPod(const T& v) {
+      this->PutTag(LogBinPodTag<T>::kTag);
+      this->PutMem(&v, sizeof(v));
+   }
+   void PutStr(StrView str) {
+      this->PutTag(LogBinTag::Str);
+      this->PutU32(static_cast<uint32_t>(str.size()));
+      this->PutMem(str.begin(), str.size());
+   }
+   /// 將 buf 的內容當成字串參數, 若尾端有 '\n' 則移除.
+   void PutStr(const BufferList& buf);
+   void PutLiteral(StrView lit) {
+      const uint32_t id = this->GetLiteralId(lit);
+      if (fon9_UNLIKELY(id == kNoLiteralId))
+         return this->PutStr(lit);
+      this->PutTag(LogBinTag::Literal);
+      this->PutU32(id);
+   }
+};
+
+} // namespace fon9
+#endif//__fon9_LogBinFmt_hpp__
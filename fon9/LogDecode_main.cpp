@@ -0,0 +1,65 @@
+﻿// \file fon9/LogDecode_main.cpp
+// logdecode: 將 fon9/LogBin.hpp 產生的二進位 log 檔, 轉成與 fon9/LogFile.hpp 相同的文字格式, 輸出到 stdout.
+// 用法: logdecode binlog1 [binlog2...]
+// \author fonwinz@gmail.com
+#include "fon9/LogBin.hpp"
+#include "fon9/FileReadAll.hpp"
+#include <stdio.h>
+
+static bool WriteToStdout(fon9::BufferList&& buf) {
+   for (const fon9::BufferNode* node = buf.cfront(); node; node = node->GetNext()) {
+      if (fwrite(node->GetDataBegin(), 1, node->GetDataSize(), stdout) != node->GetDataSize())
+         return false;
+   }
+   return true;
+}
+
+static int DecodeFile(const char* fname) {
+   fon9::File  fd;
+   auto        res = fd.Open(fname, fon9::FileMode::Read);
+   if (!res) {
+      fprintf(stderr, "logdecode|open=%s|err=%s\n", fname, fon9::RevPrintTo<std::string>(res.GetError()).c_str());
+      return 1;
+   }
+   fon9::LogBinDecoder  decoder;
+   fon9::File::PosType  fpos = 0;
+   bool                 isBadFormat = false;
+   res = fon9::FileReadAll(fd, fpos, [&](fon9::DcQueueList& rdbuf, fon9::File::Result&) {
+      for (;;) {
+         fon9::RevBufferList rbuf{fon9::kLogBlockNodeSize};
+         switch (decoder.Decode(rdbuf, rbuf)) {
+         case fon9::LogBinDecoder::Result::NeedMore:
+            return true;
+         case fon9::LogBinDecoder::Result::Decoded:
+            if (!WriteToStdout(rbuf.MoveOut()))
+               return false;
+            break;
+         case fon9::LogBinDecoder::Result::BadFormat:
+            isBadFormat = true;
+            return false;
+         }
+      }
+   });
+   if (!res) {
+      fprintf(stderr, "logdecode|read=%s|err=%s\n", fname, fon9::RevPrintTo<std::string>(res.GetError()).c_str());
+      return 1;
+   }
+   if (isBadFormat) {
+      fprintf(stderr, "logdecode|file=%s|pos=%s|err=bad format\n", fname, fon9::RevPrintTo<std::string>(fpos).c_str());
+      return 1;
+   }
+   return 0;
+}
+
+int main(int argc, char** argv) {
+   if (argc < 2) {
+      fprintf(stderr, "Usage: %s binlog1 [binlog2...]\n", argv[0]);
+      return 2;
+   }
+   // 避免 logdecode 自己的 log(例: TimerThread.ThrRun), 混入解碼後的輸出.
+   fon9::LogLevel_ = fon9::LogLevel::Error;
+   int retval = 0;
+   for (int L = 1; L < argc; ++L)
+      retval |= DecodeFile(argv[L]);
+   return retval;
+}
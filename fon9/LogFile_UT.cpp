@@ -3,7 +3,10 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "fon9/TestTools.hpp"
 #include "fon9/LogFile.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogBin.hpp"
+#include "fon9/LogModule.hpp"
+#include "fon9/seed/LogModuleTree.hpp"
+#include "fon9/FileReadAll.hpp"
 #include "fon9/RevFormat.hpp"
 #include "fon9/ThreadId.hpp"
 #include "fon9/ThreadTools.hpp"
@@ -181,6 +184,217 @@ void run_benchmark(Function && fn, unsigned threadCount, char const * const logg
    fon9::JoinThreads(threads);
 }
 
+// fon9_LOG_LAZY() 的輸出, 必須與 fon9_LOG() 相同, 且同一個 thread 的順序不變.
+static std::mutex                gLazyMutex;
+static std::vector<std::string>  gLazyLines;
+static void LazyLogWriter(const fon9::LogArgs&, fon9::BufferList&& buf) {
+   std::string line = fon9::BufferTo<std::string>(std::move(buf));
+   std::lock_guard<std::mutex> lk{gLazyMutex};
+   gLazyLines.push_back(line.substr(line.find(']') + 1));
+}
+void TestLogLazy() {
+   static const unsigned kThreadCount = 4;
+   static const unsigned kTimesPerThread = 10000;
+   fon9::SetLogWriter(&LazyLogWriter, fon9::TimeZoneOffset{});
+   fon9::LogLazyStart(1024 * 4); // 使用較小的 ring, 測試 ring 滿了的情況.
+   std::vector<std::thread> thrs;
+   for (unsigned t = 0; t < kThreadCount; ++t) {
+      thrs.emplace_back([t]() {
+         char              cbuf[16] = "cbuf";
+         std::string       str{"std::string"};
+         const char* const cstr = "cstr";
+         const fon9::TimeStamp ts = fon9::TimeStamp{} + fon9::TimeInterval_Second(123);
+         for (unsigned L = 0; L < kTimesPerThread; ++L) {
+            fon9_LOG_LAZY(fon9::LogLevel::Info, "thr=", t, "|L=", L, '|', cbuf, '|', str, '|', cstr,
+                          "|dbl=", 1.5, "|ts=", ts, "|hex=", fon9::ToHex{L}, "|w=", L, fon9::FmtDef{8});
+            if (L % 100 == 0) // Decimal 不支援 lazy, 會在呼叫端格式化.
+               fon9_LOG_LAZY(fon9::LogLevel::Info, "thr=", t, "|L=", L, "|dec=", fon9::Decimal<int64_t, 6>(-42.42));
+         }
+      });
+   }
+   fon9::JoinThreads(thrs);
+   fon9::LogLazyFlush(); // LazyLogWriter 不處理 BufferNodeWaiter, 所以不能用 WaitLogFlush().
+   fon9::LogLazyStop();
+   fon9::UnsetLogWriter(&LazyLogWriter);
+
+   unsigned lastL[kThreadCount];
+   unsigned lastDec[kThreadCount];
+   std::fill(std::begin(lastL), std::end(lastL), ~0u);
+   std::fill(std::begin(lastDec), std::end(lastDec), ~0u);
+   const fon9::TimeStamp ts = fon9::TimeStamp{} + fon9::TimeInterval_Second(123);
+   size_t count = 0;
+   for (const std::string& line : gLazyLines) {
+      if (line.compare(0, 4, "thr=") != 0)
+         continue;
+      ++count;
+      const unsigned t = static_cast<unsigned>(atoi(line.c_str() + 4));
+      const unsigned L = static_cast<unsigned>(atoi(strstr(line.c_str(), "|L=") + 3));
+      std::string expected;
+      if (line.find("|dec=") != std::string::npos) {
+         expected = fon9::RevPrintTo<std::string>("thr=", t, "|L=", L, "|dec=", fon9::Decimal<int64_t, 6>(-42.42), '\n');
+         if (lastDec[t] != ~0u && lastDec[t] + 100 != L)
+            expected = "order error";
+         lastDec[t] = L;
+      }
+      else {
+         char cbuf[16] = "cbuf";
+         expected = fon9::RevPrintTo<std::string>("thr=", t, "|L=", L, '|', cbuf, '|', std::string{"std::string"}, '|', "cstr",
+                                                  "|dbl=", 1.5, "|ts=", ts, "|hex=", fon9::ToHex{L}, "|w=", L, fon9::FmtDef{8}, '\n');
+         if (lastL[t] + 1 != L)
+            expected = "order error";
+         lastL[t] = L;
+      }
+      if (line != expected) {
+         std::cout << "[ERROR] LogLazy|line=" << line << "|expected=" << expected << std::endl;
+         abort();
+      }
+   }
+   const size_t kExpectedCount = kThreadCount * (kTimesPerThread + kTimesPerThread / 100);
+   std::cout << "[" << (count == kExpectedCount ? "OK   " : "ERROR") << "] LogLazy|count=" << count << std::endl;
+   if (count != kExpectedCount)
+      abort();
+   gLazyLines.clear();
+}
+
+// 透過 LogBin 寫入的二進位檔, 經過 LogBinDecoder 解碼後, 必須與 fon9_LOG() 的文字相同.
+void TestLogBin() {
+   const char* binlog = "./logs/fon9-logbin.bin";
+   remove(binlog);
+   auto res = fon9::InitLogBinWriteToFile(binlog, fon9::TimeChecker::TimeScale::No, 0, 0);
+   if (!res) {
+      std::cout << "[ERROR] LogBin|open=" << binlog << std::endl;
+      abort();
+   }
+   static const unsigned kTimes = 1000;
+   const fon9::TimeStamp ts = fon9::TimeStamp{} + fon9::TimeInterval_Second(123);
+   std::vector<std::string> expected;
+   for (unsigned L = 0; L < kTimes; ++L) {
+      char        cbuf[16] = "cbuf";
+      std::string str{"std::string"};
+      fon9_LOG_LAZY(fon9::LogLevel::Info, "L=", L, '|', cbuf, '|', str, "|ts=", ts, fon9::FmtTS{"f-T.3"},
+                    "|hex=", fon9::ToHex{L}, "|w=", L, fon9::FmtDef{8}, "|neg=", -static_cast<int>(L), "|s=", str, fon9::FmtDef{16});
+      expected.push_back(fon9::RevPrintTo<std::string>("L=", L, '|', cbuf, '|', str, "|ts=", ts, fon9::FmtTS{"f-T.3"},
+                    "|hex=", fon9::ToHex{L}, "|w=", L, fon9::FmtDef{8}, "|neg=", -static_cast<int>(L), "|s=", str, fon9::FmtDef{16}, '\n'));
+      // const char[N] 不一定是字串常數: 相同位址, 每次內容不同, 必須複製內容, 且 Literal 必須依照內容區分.
+      struct Named {
+         const char Name_[6];
+      } named{{'n', 'a', 'm', 'e', static_cast<char>('0' + L % 10), '\0'}};
+      fon9_LOG_LAZY(fon9::LogLevel::Info, "L=", L, "|name=", named.Name_);
+      expected.push_back(fon9::RevPrintTo<std::string>("L=", L, "|name=name", L % 10, '\n'));
+      if (L % 100 == 0) {
+         // enum: 在 LogLazy thread 格式化後, 當成字串寫入.
+         fon9_LOG_LAZY(fon9::LogLevel::Warn, "L=", L, "|enum=", fon9::LogLevel::Warn);
+         expected.push_back(fon9::RevPrintTo<std::string>("L=", L, "|enum=", fon9::LogLevel::Warn, '\n'));
+         // Decimal: 在呼叫端格式化.
+         fon9_LOG_LAZY(fon9::LogLevel::Info, "L=", L, "|dec=", fon9::Decimal<int64_t, 6>(-42.42));
+         expected.push_back(fon9::RevPrintTo<std::string>("L=", L, "|dec=", fon9::Decimal<int64_t, 6>(-42.42), '\n'));
+         // 一般的 fon9_LOG(): 使用 LogBinRecType::Text 寫入.
+         fon9::WaitLogFlush();
+         fon9_LOG_ERROR("L=", L, "|text");
+         expected.push_back(fon9::RevPrintTo<std::string>("L=", L, "|text", '\n'));
+      }
+   }
+   fon9::WaitLogFlush();
+   fon9::CloseLogBinFile();
+   fon9::LogLazyStop();
+
+   fon9::File fd;
+   fd.Open(binlog, fon9::FileMode::Read);
+   fon9::LogBinDecoder     decoder;
+   fon9::File::PosType     fpos = 0;
+   std::vector<std::string> lines;
+   fon9::FileReadAll(fd, fpos, [&](fon9::DcQueueList& rdbuf, fon9::File::Result&) {
+      for (;;) {
+         fon9::RevBufferList rbuf{fon9::kLogBlockNodeSize};
+         switch (decoder.Decode(rdbuf, rbuf)) {
+         case fon9::LogBinDecoder::Result::NeedMore:
+            return true;
+         case fon9::LogBinDecoder::Result::BadFormat:
+            std::cout << "[ERROR] LogBin|err=bad format|pos=" << fpos << std::endl;
+            abort();
+         case fon9::LogBinDecoder::Result::Decoded:
+            std::string line = fon9::BufferTo<std::string>(rbuf.MoveOut());
+            if (!line.empty() && line.find("]L=") != std::string::npos)
+               lines.push_back(line.substr(line.find(']') + 1));
+            break;
+         }
+      }
+   });
+   if (lines != expected) {
+      for (size_t L = 0; L < lines.size() && L < expected.size(); ++L) {
+         if (lines[L] != expected[L]) {
+            std::cout << "[ERROR] LogBin|line=" << lines[L] << "|expected=" << expected[L] << std::endl;
+            break;
+         }
+      }
+      std::cout << "[ERROR] LogBin|count=" << lines.size() << "|expected=" << expected.size() << std::endl;
+      abort();
+   }
+   std::cout << "[OK   ] LogBin|count=" << lines.size() << "|fileSize=" << fpos << std::endl;
+
+   // 損毀的檔案: Literal id 超過上限(例: 0xFFFFFFFF), 必須視為 BadFormat, 不可用來配置 Literals.
+   for (uint32_t badId : {static_cast<uint32_t>(fon9::LogBinEncoder::kMaxLiteralCount), ~static_cast<uint32_t>(0)}) {
+      std::string rec;
+      const uint32_t recsz = sizeof(badId) + 3;
+      rec.push_back(static_cast<char>(fon9::LogBinRecType::Literal));
+      rec.append(reinterpret_cast<const char*>(&recsz), sizeof(recsz));
+      rec.append(reinterpret_cast<const char*>(&badId), sizeof(badId));
+      rec.append("abc");
+      fon9::DcQueueFixedMem   rdbuf{rec.data(), rec.size()};
+      fon9::RevBufferList     rbuf{fon9::kLogBlockNodeSize};
+      if (decoder.Decode(rdbuf, rbuf) != fon9::LogBinDecoder::Result::BadFormat) {
+         std::cout << "[ERROR] LogBin|err=bad literal id accepted|id=" << badId << std::endl;
+         abort();
+      }
+   }
+   std::cout << "[OK   ] LogBin|bad literal id" << std::endl;
+}
+
+// LogModule 的等級: 預設使用 LogLevel_, 可透過 LogModuleTree 個別調整.
+void TestLogModule() {
+   fon9::LogModule   mod{"ut.LogModule"};
+   {
+      auto modules = fon9::GetLogModules().Lock();
+      if (modules->find(fon9::StrView{"ut.LogModule"}) == modules->end()
+          || modules->find(fon9::StrView{"io"}) == modules->end()) {
+         std::cout << "[ERROR] LogModule|err=not registered" << std::endl;
+         abort();
+      }
+   }
+   fon9::SetLogWriter(&LazyLogWriter, fon9::TimeZoneOffset{});
+   const fon9::LogLevel oldLevel = fon9::LogLevel_;
+   fon9::LogLevel_ = fon9::LogLevel::Warn;
+   unsigned count = 0;
+   fon9_LOGM_INFO(mod, "LogModule|count=", ++count); // 使用 LogLevel_: 不會記錄, 也不會執行 ++count;
+   fon9_LOGM_WARN(mod, "LogModule|count=", ++count);
+
+   // 透過 LogModuleTree 設定 mod.Level_ = Trace(0);
+   fon9::seed::TreeSP   tree{new fon9::seed::LogModuleTree};
+   fon9::seed::Tab*     tab = tree->LayoutSP_->GetTab(0);
+   const fon9::seed::Field* fldLevel = tab->Fields_.Get("Level");
+   tree->OnTreeOp([&](const fon9::seed::TreeOpResult&, fon9::seed::TreeOp* op) {
+      op->Get("ut.LogModule", [&](const fon9::seed::PodOpResult&, fon9::seed::PodOp* pod) {
+         if (pod)
+            pod->BeginWrite(*tab, [&](const fon9::seed::SeedOpResult&, const fon9::seed::RawWr* wr) {
+               fldLevel->StrToCell(*wr, "0");
+            });
+      });
+   });
+   fon9_LOGM_DEBUG(mod, "LogModule|count=", ++count);
+   fon9_LOG_DEBUG("LogModule|global=", ++count); // 全域等級不受影響.
+   mod.Level_ = fon9::LogLevel::Count;           // 還原成使用 LogLevel_;
+   fon9_LOGM_INFO(mod, "LogModule|count=", ++count);
+   fon9::LogLevel_ = oldLevel;
+   fon9::UnsetLogWriter(&LazyLogWriter);
+
+   const std::vector<std::string> expected{"LogModule|count=1\n", "LogModule|count=2\n"};
+   const bool isOK = (count == 2 && gLazyLines == expected);
+   std::cout << "[" << (isOK ? "OK   " : "ERROR") << "] LogModule|count=" << count << "|lines=" << gLazyLines.size() << std::endl;
+   if (!isOK)
+      abort();
+   gLazyLines.clear();
+}
+
 void TestThreadsWriteLatency() {
    // 使用的測試方法: https://github.com/Iyengar111/NanoLog#latency-benchmark-of-guaranteed-logger
    fon9::InitLogWriteToFile("./logs/fon9-latency.log", fon9::TimeChecker::TimeScale::No, 0, 0);
@@ -189,6 +403,14 @@ void TestThreadsWriteLatency() {
    };
    for (auto threadCount : {1u, 2u, 4u, 8u})
       run_benchmark(fon9BenchmarkFn, threadCount, "fon9_LOG");
+
+   fon9::LogLazyStart();
+   auto lazyBenchmarkFn = [](unsigned i, char const * const cstr) {
+      fon9_LOG_LAZY(fon9::LogLevel::Info, "Logging ", cstr, i, 0, 'K', -42.42);
+   };
+   for (auto threadCount : {1u, 2u, 4u, 8u})
+      run_benchmark(lazyBenchmarkFn, threadCount, "fon9_LOG_LAZY");
+   fon9::LogLazyStop();
 }
 
 //--------------------------------------------------------------------------//
@@ -232,6 +454,11 @@ int main(int argc, char** argv) {
    }
    std::cout << std::endl;
 
+   utinfo.PrintSplitter();
+   TestLogLazy();
+   TestLogBin();
+   TestLogModule();
+
    // 使用 moduo 的 logging_test 測試方法:
    // https://github.com/chenshuo/muduo/blob/master/muduo/base/tests/Logging_test.cc
    utinfo.PrintSplitter();
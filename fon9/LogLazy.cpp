@@ -0,0 +1,292 @@
+﻿// \file fon9/LogLazy.cpp
+// \author fonwinz@gmail.com
+#include "fon9/LogLazy.hpp"
+#include "fon9/WaitPolicy.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace fon9 {
+namespace impl {
+
+LogLazyRing::LogLazyRing(size_t capacity)
+   : Buffer_{static_cast<byte*>(malloc(capacity))}
+   , Mask_{capacity - 1}
+   , ThreadId_(GetThisThreadId()) {
+}
+LogLazyRing::~LogLazyRing() {
+   free(this->Buffer_);
+}
+
+/// LogLazy thread 沒有資料時的休息時間.
+/// 因為 log 訊息不需要立即寫入檔案, 所以不用每次 log 都喚醒 LogLazy thread, 可避免 log 呼叫端的 syscall.
+static const std::chrono::milliseconds kLogLazyIdleInterval{1};
+
+struct LogLazyCenter {
+   fon9_NON_COPY_NON_MOVE(LogLazyCenter);
+   LogLazyCenter() = default;
+
+   using Waiter = WaitPolicy_CV;
+   Waiter::Mutex              Mutex_;
+   Waiter                     Waiter_;
+   /// 全部已註冊的 ring, 由 Mutex_ 保護.
+   std::vector<LogLazyRing*>  Rings_;
+   /// Rings_ 有異動時 ++RingsVer_; 讓 LogLazy thread 知道需要重新取得 Rings_;
+   std::atomic<size_t>        RingsVer_{0};
+   std::atomic<bool>          IsRunning_{false};
+   /// LogLazy thread 是否仍在執行(LogLazyStop() 在 join() 之後才設為 false), 由 Mutex_ 保護.
+   /// 在此之前, LogLazy thread 可能仍在使用 Rings_ 的複本, 所以不可刪除 ring.
+   bool                       IsThrAlive_{false};
+   size_t                     RingSize_{0};
+   uint64_t                   FlushReq_{0};
+   uint64_t                   FlushDone_{0};
+   std::thread                Thread_;
+
+   ~LogLazyCenter() {
+      LogLazyStop();
+   }
+   void ThrRun();
+};
+static LogLazyCenter LogLazyCenter_;
+static std::atomic<FnLogLazySink> FnLogLazySink_{nullptr};
+static thread_local bool IsInLogLazyThread_{false};
+
+/// thread 結束時, 將 ring 設為 IsClosed_, 若 LogLazy thread 已結束(已 join), 則直接刪除.
+struct LogLazyRingHolder {
+   fon9_NON_COPY_NON_MOVE(LogLazyRingHolder);
+   LogLazyRingHolder() = default;
+   LogLazyRing* Ring_{nullptr};
+   ~LogLazyRingHolder() {
+      if (this->Ring_ == nullptr)
+         return;
+      LogLazyCenter::Waiter::Locker lk{LogLazyCenter_.Mutex_};
+      if (LogLazyCenter_.IsThrAlive_) // 由 LogLazy thread 或 LogLazyStop() 刪除.
+         this->Ring_->IsClosed_.store(true, std::memory_order_release);
+      else {
+         auto& rings = LogLazyCenter_.Rings_;
+         rings.erase(std::find(rings.begin(), rings.end(), this->Ring_));
+         LogLazyCenter_.RingsVer_.fetch_add(1, std::memory_order_release);
+         delete this->Ring_;
+      }
+   }
+};
+static thread_local LogLazyRingHolder LogLazyRingHolder_;
+
+fon9_API LogLazyRing* LogLazyGetRing() {
+   if (!LogLazyCenter_.IsRunning_.load(std::memory_order_relaxed))
+      return nullptr;
+   LogLazyRingHolder& holder = LogLazyRingHolder_;
+   if (fon9_LIKELY(holder.Ring_))
+      return holder.Ring_;
+   if (IsInLogLazyThread_) // LogLazy thread 自己的 log(例: 在 FnLogWriter 裡面的 log), 不可放入 ring.
+      return nullptr;
+   LogLazyCenter::Waiter::Locker lk{LogLazyCenter_.Mutex_};
+   if (!LogLazyCenter_.IsRunning_.load(std::memory_order_relaxed))
+      return nullptr;
+   holder.Ring_ = new LogLazyRing{LogLazyCenter_.RingSize_};
+   LogLazyCenter_.Rings_.push_back(holder.Ring_);
+   LogLazyCenter_.RingsVer_.fetch_add(1, std::memory_order_release);
+   return holder.Ring_;
+}
+fon9_API LogLazyRecord* LogLazyWaitAlloc(LogLazyRing& ring, uint32_t sz) {
+   while (LogLazyCenter_.IsRunning_.load(std::memory_order_relaxed)) {
+      std::this_thread::yield();
+      if (LogLazyRecord* rec = ring.Alloc(sz))
+         return rec;
+   }
+   return nullptr;
+}
+
+static void LogLazyPrintFormatted(const byte* payload, RevBufferList& rbuf) {
+   const StrView str = LogLazyStrArg::Get(payload);
+   RevPutMem(rbuf, str.begin(), str.end());
+}
+static void LogLazyEncodeFormatted(const byte* payload, LogBinEncoder& enc) {
+   StrView str = LogLazyStrArg::Get(payload);
+   if (!str.empty() && str.end()[-1] == '\n')
+      str.SetEnd(str.end() - 1);
+   enc.PutStr(str);
+}
+static const LogLazyFns LogLazyFormattedFns{&LogLazyPrintFormatted, &LogLazyEncodeFormatted};
+fon9_API void LogLazyWriteFormatted(LogLevel level, RevBufferList&& rbuf) {
+   if (LogLazyRing* ring = LogLazyGetRing()) {
+      BufferList     buf{rbuf.MoveOut()};
+      const size_t   bufsz = CalcDataSize(buf.cfront());
+      const size_t   sz = sizeof(LogLazyRecord) + sizeof(uint32_t) + bufsz;
+      if (sz <= ring->Capacity() / 2) {
+         const uint32_t asz = LogLazyRecord::AlignSize(sz);
+         LogLazyRecord* rec = ring->Alloc(asz);
+         if (rec || (rec = LogLazyWaitAlloc(*ring, asz)) != nullptr) {
+            rec->Size_ = asz;
+            rec->IsRecord_ = true;
+            rec->Level_ = level;
+            rec->UtcTime_ = UtcNow();
+            rec->Fns_ = &LogLazyFormattedFns;
+            const uint32_t len = static_cast<uint32_t>(bufsz);
+            byte*          pout = rec->Payload();
+            memcpy(pout, &len, sizeof(len));
+            pout += sizeof(len);
+            for (const BufferNode* node = buf.cfront(); node; node = node->GetNext()) {
+               memcpy(pout, node->GetDataBegin(), node->GetDataSize());
+               pout += node->GetDataSize();
+            }
+            ring->Commit(asz);
+            return;
+         }
+      }
+      // 訊息太大, 無法放入 ring: 等 ring 清空後(保持同一 thread 的順序), 直接寫入.
+      while (!ring->IsEmpty() && LogLazyCenter_.IsRunning_.load(std::memory_order_relaxed))
+         std::this_thread::yield();
+      LogWrite(level, RevBufferList{kLogBlockNodeSize, std::move(buf)});
+      return;
+   }
+   LogWrite(level, std::move(rbuf));
+}
+
+//--------------------------------------------------------------------------//
+
+/// 從各 ring 依照時間順序取出記錄, 交給 FnLogLazySink, 或格式化後交給 FnLogWriter.
+/// \retval 處理的記錄數量.
+static size_t LogLazyDrain(const std::vector<LogLazyRing*>& rings) {
+   size_t count = 0;
+   for (;;) {
+      LogLazyRing*         minRing = nullptr;
+      const LogLazyRecord* minRec = nullptr;
+      for (LogLazyRing* ring : rings) {
+         if (const LogLazyRecord* rec = ring->Peek()) {
+            if (minRec == nullptr || rec->UtcTime_ < minRec->UtcTime_) {
+               minRec = rec;
+               minRing = ring;
+            }
+         }
+      }
+      if (minRec == nullptr)
+         return count;
+      ++count;
+      if (FnLogLazySink fnSink = FnLogLazySink_.load(std::memory_order_acquire)) {
+         fnSink(*minRec, minRing->ThreadId_);
+         minRing->Pop(minRec);
+         continue;
+      }
+      RevBufferList rbuf{kLogBlockNodeSize};
+      minRec->Fns_->FnPrint_(minRec->Payload(), rbuf);
+      AddLogHeader(rbuf, minRec->UtcTime_, minRec->Level_, minRing->ThreadId_.GetThreadIdStr());
+      const LogArgs logArgs{minRec->Level_, minRec->UtcTime_};
+      minRing->Pop(minRec);
+      LogWrite(logArgs, rbuf.MoveOut());
+   }
+}
+
+void LogLazyCenter::ThrRun() {
+   IsInLogLazyThread_ = true;
+   fon9_LOG_ThrRun("LogLazy.ThrRun|ringSize=", this->RingSize_);
+   std::vector<LogLazyRing*> rings;
+   size_t                    ringsVer = 0;
+   unsigned                  idleAfterStop = 0;
+   for (;;) {
+      const bool isRunning = this->IsRunning_.load(std::memory_order_acquire);
+      Waiter::Locker lk{this->Mutex_};
+      const uint64_t flushReq = this->FlushReq_;
+      if (ringsVer != this->RingsVer_.load(std::memory_order_acquire)) {
+         // 移除: 已結束, 且已無資料的 ring.
+         auto ipos = std::remove_if(this->Rings_.begin(), this->Rings_.end(), [](LogLazyRing* ring) {
+            if (!ring->IsClosed_.load(std::memory_order_acquire) || !ring->IsEmpty())
+               return false;
+            delete ring;
+            return true;
+         });
+         if (ipos != this->Rings_.end()) {
+            this->Rings_.erase(ipos, this->Rings_.end());
+            this->RingsVer_.fetch_add(1, std::memory_order_relaxed);
+         }
+         rings = this->Rings_;
+         ringsVer = this->RingsVer_.load(std::memory_order_relaxed);
+      }
+      lk.unlock();
+
+      size_t count = LogLazyDrain(rings);
+      for (LogLazyRing* ring : rings) {
+         if (ring->IsClosed_.load(std::memory_order_relaxed) && ring->IsEmpty()) {
+            // 下次迴圈移除.
+            this->RingsVer_.fetch_add(1, std::memory_order_relaxed);
+            break;
+         }
+      }
+      lk.lock();
+      if (this->FlushDone_ != flushReq) {
+         this->FlushDone_ = flushReq;
+         this->Waiter_.NotifyAll(lk);
+      }
+      if (count == 0) {
+         // LogLazyStop() 之後: 可能有 thread 已通過 IsRunning_ 的檢查, 正在寫入 ring,
+         // 所以休息一次後再檢查, 才結束.
+         if (!isRunning && ++idleAfterStop > 1)
+            break;
+         if (this->FlushReq_ == flushReq)
+            this->Waiter_.WaitFor(lk, kLogLazyIdleInterval);
+      }
+   }
+   fon9_LOG_ThrRun("LogLazy.ThrRun.End");
+}
+
+} // namespace impl
+using namespace impl;
+
+fon9_API bool LogLazyStart(size_t ringSize) {
+   LogLazyCenter::Waiter::Locker lk{LogLazyCenter_.Mutex_};
+   if (LogLazyCenter_.IsThrAlive_) // 包含: LogLazyStop() 正在等候 join().
+      return false;
+   size_t cap = 1024 * 4;
+   while (cap < ringSize)
+      cap <<= 1;
+   if (LogLazyCenter_.RingSize_ != cap) {
+      // 舊的 ring(LogLazyStop() 之後, thread 仍存在) 繼續使用, 新的 thread 使用新的大小.
+      LogLazyCenter_.RingSize_ = cap;
+   }
+   LogLazyCenter_.IsRunning_.store(true, std::memory_order_release);
+   LogLazyCenter_.IsThrAlive_ = true;
+   LogLazyCenter_.Thread_ = std::thread(&LogLazyCenter::ThrRun, &LogLazyCenter_);
+   return true;
+}
+fon9_API void LogLazyStop() {
+   LogLazyCenter::Waiter::Locker lk{LogLazyCenter_.Mutex_};
+   if (!LogLazyCenter_.Thread_.joinable() || IsInLogLazyThread_)
+      return;
+   LogLazyCenter_.IsRunning_.store(false, std::memory_order_release);
+   ++LogLazyCenter_.FlushReq_;
+   LogLazyCenter_.Waiter_.NotifyAll(lk);
+   std::thread thr = std::move(LogLazyCenter_.Thread_);
+   lk.unlock();
+   thr.join();
+   // 已結束的 thread 留下的 ring, 在此刪除.
+   lk.lock();
+   LogLazyCenter_.IsThrAlive_ = false;
+   auto& rings = LogLazyCenter_.Rings_;
+   auto  ipos = std::remove_if(rings.begin(), rings.end(), [](LogLazyRing* ring) {
+      if (!ring->IsClosed_.load(std::memory_order_acquire))
+         return false;
+      delete ring;
+      return true;
+   });
+   if (ipos != rings.end()) {
+      rings.erase(ipos, rings.end());
+      LogLazyCenter_.RingsVer_.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+fon9_API void SetLogLazySink(FnLogLazySink fnSink) {
+   FnLogLazySink_.store(fnSink, std::memory_order_release);
+}
+fon9_API void UnsetLogLazySink(FnLogLazySink fnSink) {
+   FnLogLazySink_.compare_exchange_strong(fnSink, nullptr, std::memory_order_acq_rel);
+}
+fon9_API void LogLazyFlush() {
+   LogLazyCenter::Waiter::Locker lk{LogLazyCenter_.Mutex_};
+   if (!LogLazyCenter_.Thread_.joinable() || IsInLogLazyThread_)
+      return;
+   const uint64_t req = ++LogLazyCenter_.FlushReq_;
+   LogLazyCenter_.Waiter_.NotifyAll(lk);
+   while (LogLazyCenter_.FlushDone_ < req && LogLazyCenter_.Thread_.joinable())
+      LogLazyCenter_.Waiter_.Wait(lk);
+}
+
+} // namespace fon9
@@ -0,0 +1,396 @@
+﻿/// \file fon9/LogLazy.hpp
+///
+/// Lazy format 的 log 機制:
+/// - 呼叫 log 的 thread 只把參數(二進位)複製到自己的 ring buffer(SPSC), 然後就返回.
+/// - 由一個獨立的 LogLazy thread 取出參數, 使用 RevPrint() 格式化之後, 再交給 FnLogWriter(例: LogFile).
+/// - 使用 LogLazyStart() 啟動, 若沒有啟動, 則 fon9_LOG_LAZY() 與 fon9_LOG() 相同.
+///
+/// \author fonwinz@gmail.com
+#ifndef __fon9_LogLazy_hpp__
+#define __fon9_LogLazy_hpp__
+#include "fon9/Log.hpp"
+#include "fon9/LogBinFmt.hpp"
+#include "fon9/ThreadId.hpp"
+#include <atomic>
+
+namespace fon9 {
+
+/// \ingroup Misc
+/// 啟動 LogLazy thread.
+/// - ringSize: 每個 thread 的 ring buffer 大小, 會調整成 2 的 n 次方, 最少 4K.
+/// - 若已啟動, 則傳回 false.
+fon9_API bool LogLazyStart(size_t ringSize = 1024 * 64);
+/// \ingroup Misc
+/// 將全部 ring buffer 的內容輸出後, 結束 LogLazy thread.
+/// 之後的 fon9_LOG_LAZY() 會回到立即格式化的方式.
+fon9_API void LogLazyStop();
+/// \ingroup Misc
+/// 等候在 LogLazyFlush() 之前的 lazy log, 已交給 FnLogWriter.
+/// WaitLogFlush() 會先呼叫此處.
+fon9_API void LogLazyFlush();
+
+namespace impl {
+struct LogLazyRecord;
+} // namespace impl
+/// \ingroup Misc
+/// LogLazy thread 取出記錄後, 若有設定 FnLogLazySink, 則交給它處理(例: fon9/LogBin.hpp 直接寫入二進位格式);
+/// 否則格式化成文字, 交給 FnLogWriter.
+using FnLogLazySink = void (*)(const impl::LogLazyRecord& rec, const ThreadId& thrid);
+/// \ingroup Misc
+/// 可在 LogLazy thread 執行中設定, 但設定前已取出的記錄, 可能仍交給之前的 sink.
+fon9_API void SetLogLazySink(FnLogLazySink fnSink);
+/// \ingroup Misc
+/// 如果現在的 LogLazySink == fnSink, 則還原成預設值: 格式化成文字, 交給 FnLogWriter.
+fon9_API void UnsetLogLazySink(FnLogLazySink fnSink);
+
+namespace impl {
+
+fon9_WARN_DISABLE_PADDING;
+/// 每一種 lazy log 參數組合的處理函式.
+struct LogLazyFns {
+   /// 格式化成文字(包含尾端的 '\n'), 不含 log header.
+   void (*FnPrint_)(const byte* payload, RevBufferList& rbuf);
+   /// 轉成 fon9/LogBinFmt.hpp 的參數格式.
+   void (*FnEncode_)(const byte* payload, LogBinEncoder& enc);
+};
+
+/// 每筆 lazy log 在 ring buffer 裡面的開頭.
+struct LogLazyRecord {
+   /// 包含 LogLazyRecord 的大小, 必定為 kAlign 的倍數.
+   uint32_t    Size_;
+   /// false 表示: ring buffer 尾端剩餘空間不足, 此為填充用, 下一筆從 ring buffer 的開頭開始.
+   bool        IsRecord_;
+   LogLevel    Level_;
+   TimeStamp         UtcTime_;
+   const LogLazyFns* Fns_;
+
+   enum : uint32_t { kAlign = 8 };
+   static constexpr uint32_t AlignSize(size_t sz) {
+      return static_cast<uint32_t>((sz + kAlign - 1) & ~static_cast<size_t>(kAlign - 1));
+   }
+   byte* Payload() {
+      return reinterpret_cast<byte*>(this + 1);
+   }
+   const byte* Payload() const {
+      return reinterpret_cast<const byte*>(this + 1);
+   }
+};
+
+/// 每個使用 fon9_LOG_LAZY() 的 thread 擁有一個 LogLazyRing.
+/// - 由 thread 自己寫入, LogLazy thread 讀出; 所以只需要 WritePos_, ReadPos_ 兩個 atomic.
+/// - WritePos_, ReadPos_ 只增不減, 使用時再 & Mask_;
+class fon9_API LogLazyRing {
+   fon9_NON_COPY_NON_MOVE(LogLazyRing);
+   byte* const          Buffer_;
+   const size_t         Mask_;
+   // WritePos_, ReadPos_ 分別由不同的 thread 更新, 所以放在不同的 cache line.
+   char                 Padding0_[64 - sizeof(byte*) - sizeof(size_t)];
+   std::atomic<size_t>  WritePos_{0};
+   char                 Padding1_[64 - sizeof(std::atomic<size_t>)];
+   std::atomic<size_t>  ReadPos_{0};
+   char                 Padding2_[64 - sizeof(std::atomic<size_t>)];
+
+   size_t FreeSize(size_t wpos) const {
+      return this->Mask_ + 1 - (wpos - this->ReadPos_.load(std::memory_order_acquire));
+   }
+public:
+   /// 產生此 ring 的 thread.
+   const ThreadId       ThreadId_;
+   /// thread 結束後設為 true, 由 LogLazy thread 輸出剩餘的內容後刪除.
+   std::atomic<bool>    IsClosed_{false};
+
+   LogLazyRing(size_t capacity);
+   ~LogLazyRing();
+
+   size_t Capacity() const {
+      return this->Mask_ + 1;
+   }
+
+   /// 取得可寫入 sz bytes 的空間, 若空間不足則傳回 nullptr;
+   /// sz 必須是 LogLazyRecord::kAlign 的倍數, 且不可超過 Capacity()/2.
+   /// 寫入完畢後必須呼叫 Commit(sz);
+   LogLazyRecord* Alloc(uint32_t sz) {
+      size_t       wpos = this->WritePos_.load(std::memory_order_relaxed);
+      const size_t tail = this->Capacity() - (wpos & this->Mask_);
+      if (fon9_UNLIKELY(tail < sz)) {
+         // 尾端不足, 填入一個 IsRecord_ = false 的填充, 從開頭開始.
+         if (this->FreeSize(wpos) < tail + sz)
+            return nullptr;
+         LogLazyRecord* pad = reinterpret_cast<LogLazyRecord*>(this->Buffer_ + (wpos & this->Mask_));
+         pad->Size_ = static_cast<uint32_t>(tail);
+         pad->IsRecord_ = false;
+         this->WritePos_.store(wpos += tail, std::memory_order_release);
+      }
+      else if (this->FreeSize(wpos) < sz)
+         return nullptr;
+      return reinterpret_cast<LogLazyRecord*>(this->Buffer_ + (wpos & this->Mask_));
+   }
+   void Commit(uint32_t sz) {
+      this->WritePos_.store(this->WritePos_.load(std::memory_order_relaxed) + sz, std::memory_order_release);
+   }
+
+   /// 由 LogLazy thread 呼叫: 取得第一筆尚未處理的記錄, 若沒有則傳回 nullptr.
+   const LogLazyRecord* Peek() {
+      for (;;) {
+         const size_t rpos = this->ReadPos_.load(std::memory_order_relaxed);
+         if (rpos == this->WritePos_.load(std::memory_order_acquire))
+            return nullptr;
+         const LogLazyRecord* rec = reinterpret_cast<const LogLazyRecord*>(this->Buffer_ + (rpos & this->Mask_));
+         if (fon9_LIKELY(rec->IsRecord_))
+            return rec;
+         this->ReadPos_.store(rpos + rec->Size_, std::memory_order_release);
+      }
+   }
+   /// 由 LogLazy thread 呼叫: 移除 Peek() 取得的記錄.
+   void Pop(const LogLazyRecord* rec) {
+      this->ReadPos_.store(this->ReadPos_.load(std::memory_order_relaxed) + rec->Size_, std::memory_order_release);
+   }
+   bool IsEmpty() const {
+      return this->ReadPos_.load(std::memory_order_acquire) == this->WritePos_.load(std::memory_order_acquire);
+   }
+};
+fon9_WARN_POP;
+
+/// 取得 this thread 的 LogLazyRing, 若 LogLazy 沒有啟動, 或在 LogLazy thread 裡面, 則傳回 nullptr.
+fon9_API LogLazyRing* LogLazyGetRing();
+/// ring 的空間不足時呼叫: 等候 LogLazy thread 消化, 若 LogLazy 已結束則傳回 nullptr.
+fon9_API LogLazyRecord* LogLazyWaitAlloc(LogLazyRing& ring, uint32_t sz);
+/// 無法使用 lazy 的參數, 在呼叫端格式化後(rbuf 尾端必須已有 '\n'), 放入 ring(保持同一個 thread 的順序), 或直接寫入 log.
+fon9_API void LogLazyWriteFormatted(LogLevel level, RevBufferList&& rbuf);
+
+//--------------------------------------------------------------------------//
+
+/// 參數的型別(保留 const char[N], 移除其他的 cv, reference).
+/// T 為 forwarding reference 推導出的型別, 所以 "abc" 為 const char[4]; char buf[N] 為 char[N].
+template <class T, class RT = typename std::remove_reference<T>::type>
+using LogLazyKey = typename std::conditional<std::is_array<RT>::value, RT, typename std::remove_cv<RT>::type>::type;
+
+/// 參數可以直接複製的型別: 數字、enum、格式化定義、時間...
+/// 其他型別可自行特化: `template <> struct LogLazyIsValue<MyType> : public std::true_type {};`
+/// 但必須確定: 複製後, 原本的物件消失, 仍可使用 RevPrint() 輸出, 例: 不可包含 StrView, 指標...
+template <class T>
+struct LogLazyIsValue : public std::integral_constant<bool,
+   std::is_arithmetic<T>::value || std::is_enum<T>::value
+   || std::is_base_of<BaseFmt, T>::value || std::is_base_of<FmtDef, T>::value> {
+};
+template <> struct LogLazyIsValue<TimeStamp> : public std::true_type {};
+template <> struct LogLazyIsValue<TimeInterval> : public std::true_type {};
+
+/// 預設: 不支援 lazy, 在呼叫端格式化.
+template <class T, class Enabled = void>
+struct LogLazyArg {
+   enum : bool { kIsSupported = false };
+   enum : bool { kIsBinNative = false };
+};
+/// Encode(): 轉成 fon9/LogBinFmt.hpp 的參數格式;
+/// 只有在 kIsBinNative == true 時才會使用; 否則在 LogLazy thread 格式化後, 當成字串參數.
+
+template <class T>
+struct LogLazyArg<T, enable_if_t<LogLazyIsValue<T>::value>> {
+   enum : bool { kIsSupported = true };
+   enum : bool { kIsBinNative = LogBinPodTag<T>::kIsPod };
+   static size_t Size(const T&) {
+      return sizeof(T);
+   }
+   static byte* Put(byte* p, const T& v) {
+      memcpy(p, &v, sizeof(T));
+      return p + sizeof(T);
+   }
+   static T Get(const byte*& p) {
+      // payload 不保證對齊, 所以先複製到對齊的位置.
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+      memcpy(&buf, p, sizeof(T));
+      p += sizeof(T);
+      return *reinterpret_cast<const T*>(&buf);
+   }
+   static void Encode(LogBinEncoder& enc, const byte*& p) {
+      enc.PutPod(Get(p));
+   }
+};
+
+/// 字串: 複製字串內容.
+struct LogLazyStrArg {
+   enum : bool { kIsSupported = true };
+   enum : bool { kIsBinNative = true };
+   static size_t Size(StrView str) {
+      return sizeof(uint32_t) + str.size();
+   }
+   static byte* Put(byte* p, StrView str) {
+      const uint32_t len = static_cast<uint32_t>(str.size());
+      memcpy(p, &len, sizeof(len));
+      memcpy(p += sizeof(len), str.begin(), len);
+      return p + len;
+   }
+   static StrView Get(const byte*& p) {
+      uint32_t len;
+      memcpy(&len, p, sizeof(len));
+      StrView retval{reinterpret_cast<const char*>(p + sizeof(len)), len};
+      p += sizeof(len) + len;
+      return retval;
+   }
+   static void Encode(LogBinEncoder& enc, const byte*& p) {
+      enc.PutStr(Get(p));
+   }
+};
+template <> struct LogLazyArg<StrView> : public LogLazyStrArg {};
+template <> struct LogLazyArg<std::string> : public LogLazyStrArg {
+   static size_t Size(const std::string& str) {
+      return LogLazyStrArg::Size(ToStrView(str));
+   }
+   static byte* Put(byte* p, const std::string& str) {
+      return LogLazyStrArg::Put(p, ToStrView(str));
+   }
+};
+template <> struct LogLazyArg<const char*> : public LogLazyStrArg {
+   static size_t Size(const char* str) {
+      return LogLazyStrArg::Size(StrView_cstr(str));
+   }
+   static byte* Put(byte* p, const char* str) {
+      return LogLazyStrArg::Put(p, StrView_cstr(str));
+   }
+};
+template <> struct LogLazyArg<char*> : public LogLazyArg<const char*> {};
+template <size_t arysz> struct LogLazyArg<char[arysz]> : public LogLazyStrArg {
+   static size_t Size(const char (&str)[arysz]) {
+      return LogLazyStrArg::Size(StrView_eos_or_all(str));
+   }
+   static byte* Put(byte* p, const char (&str)[arysz]) {
+      return LogLazyStrArg::Put(p, StrView_eos_or_all(str));
+   }
+};
+/// const char[N] 通常為字串常數(例: "|tag="), 但也可能是 stack 上的陣列, 或結構的成員,
+/// 所以仍需複製內容; 轉成二進位格式時, 使用 LogBinEncoder::PutLiteral(), 相同內容只記錄一次.
+template <size_t arysz> struct LogLazyArg<const char[arysz]> : public LogLazyStrArg {
+   static StrView ToStr(const char (&str)[arysz]) {
+      return StrView{str, arysz - (str[arysz - 1] == 0)};
+   }
+   static size_t Size(const char (&str)[arysz]) {
+      return LogLazyStrArg::Size(ToStr(str));
+   }
+   static byte* Put(byte* p, const char (&str)[arysz]) {
+      return LogLazyStrArg::Put(p, ToStr(str));
+   }
+   static void Encode(LogBinEncoder& enc, const byte*& p) {
+      enc.PutLiteral(Get(p));
+   }
+};
+
+template <class... KeysT>
+struct LogLazyArgs {
+   enum : bool { kIsSupported = true };
+   enum : bool { kIsBinNative = true };
+   static size_t Size() {
+      return 0;
+   }
+   static byte* Put(byte* p) {
+      return p;
+   }
+   template <class... ValuesT>
+   static void Print(RevBufferList& rbuf, const byte*, ValuesT&&... values) {
+      RevPrint(rbuf, std::forward<ValuesT>(values)...);
+   }
+   static void Encode(LogBinEncoder&, const byte*) {
+   }
+};
+template <class K1, class... KeysT>
+struct LogLazyArgs<K1, KeysT...> {
+   using Arg1 = LogLazyArg<K1>;
+   using Rest = LogLazyArgs<KeysT...>;
+   enum : bool { kIsSupported = Arg1::kIsSupported && Rest::kIsSupported };
+   enum : bool { kIsBinNative = Arg1::kIsBinNative && Rest::kIsBinNative };
+
+   template <class T1, class... ArgsT>
+   static size_t Size(const T1& v1, const ArgsT&... args) {
+      return Arg1::Size(v1) + Rest::Size(args...);
+   }
+   template <class T1, class... ArgsT>
+   static byte* Put(byte* p, const T1& v1, const ArgsT&... args) {
+      return Rest::Put(Arg1::Put(p, v1), args...);
+   }
+   /// 依序從 payload 取出參數, 全部取出後再呼叫 RevPrint(rbuf, values...);
+   template <class... ValuesT>
+   static void Print(RevBufferList& rbuf, const byte* p, ValuesT&&... values) {
+      const auto v1 = Arg1::Get(p);
+      Rest::Print(rbuf, p, std::forward<ValuesT>(values)..., v1);
+   }
+   static void Encode(LogBinEncoder& enc, const byte* p) {
+      Arg1::Encode(enc, p);
+      Rest::Encode(enc, p);
+   }
+   static void EncodeImpl(std::true_type /*isBinNative*/, const byte* payload, LogBinEncoder& enc) {
+      Encode(enc, payload);
+   }
+   /// 有不支援二進位格式的參數(例: enum, 自訂型別), 則格式化後, 當成一個字串參數.
+   static void EncodeImpl(std::false_type /*isBinNative*/, const byte* payload, LogBinEncoder& enc) {
+      RevBufferList rbuf{kLogBlockNodeSize};
+      Print(rbuf, payload);
+      enc.PutStr(rbuf.MoveOut());
+   }
+
+   static void PrintPayload(const byte* payload, RevBufferList& rbuf) {
+      RevPutChar(rbuf, '\n');
+      Print(rbuf, payload);
+   }
+   static void EncodePayload(const byte* payload, LogBinEncoder& enc) {
+      EncodeImpl(std::integral_constant<bool, kIsBinNative>{}, payload, enc);
+   }
+   static const LogLazyFns kFns;
+};
+template <class K1, class... KeysT>
+const LogLazyFns LogLazyArgs<K1, KeysT...>::kFns{&LogLazyArgs::PrintPayload, &LogLazyArgs::EncodePayload};
+
+template <class Args, class... ArgsT>
+inline void LogLazyWriteImpl(std::false_type /*isSupported*/, LogLevel level, ArgsT&&... args) {
+   RevBufferList rbuf{kLogBlockNodeSize};
+   RevPrint(rbuf, std::forward<ArgsT>(args)..., '\n');
+   LogLazyWriteFormatted(level, std::move(rbuf));
+}
+
+template <class Args, class... ArgsT>
+inline void LogLazyWriteImpl(std::true_type /*isSupported*/, LogLevel level, ArgsT&&... args) {
+   LogLazyRing* ring = LogLazyGetRing();
+   if (fon9_LIKELY(ring != nullptr)) {
+      const size_t sz = sizeof(LogLazyRecord) + Args::Size(args...);
+      if (fon9_LIKELY(sz <= ring->Capacity() / 2)) {
+         const uint32_t asz = LogLazyRecord::AlignSize(sz);
+         LogLazyRecord* rec = ring->Alloc(asz);
+         if (fon9_LIKELY(rec || (rec = LogLazyWaitAlloc(*ring, asz)) != nullptr)) {
+            rec->Size_ = asz;
+            rec->IsRecord_ = true;
+            rec->Level_ = level;
+            rec->UtcTime_ = UtcNow();
+            rec->Fns_ = &Args::kFns;
+            Args::Put(rec->Payload(), args...);
+            ring->Commit(asz);
+            return;
+         }
+      }
+   }
+   LogLazyWriteImpl<Args>(std::false_type{}, level, std::forward<ArgsT>(args)...);
+}
+
+} // namespace impl
+
+/// \ingroup Misc
+/// 若參數全部為支援 lazy 的型別(數字、enum、字串、TimeStamp...), 則只複製參數到 this thread 的 ring buffer;
+/// 否則在呼叫端格式化後, 放到 ring buffer.
+template <class... ArgsT>
+inline void LogLazyWrite(LogLevel level, ArgsT&&... args) {
+   using Args = impl::LogLazyArgs<impl::LogLazyKey<ArgsT>...>;
+   impl::LogLazyWriteImpl<Args>(std::integral_constant<bool, Args::kIsSupported>{}, level, std::forward<ArgsT>(args)...);
+}
+
+} // namespace fon9
+
+/// \ingroup Misc
+/// 與 fon9_LOG() 相同, 但使用 lazy format, 參考 fon9/LogLazy.hpp 的說明.
+#define fon9_LOG_LAZY(level, ...)  fon9_LOG_LAZY_IF(level >= fon9::LogLevel_, level, __VA_ARGS__)
+
+/// \ingroup Misc
+/// 若 cond 成立(且 level >= fon9_LOG_MIN_LEVEL), 則使用 lazy format 寫入 log.
+#define fon9_LOG_LAZY_IF(cond, level, ...) do {                \
+   if (fon9_UNLIKELY(fon9_LOG_IsMinLevel(level) && (cond)))    \
+      fon9::LogLazyWrite(level, __VA_ARGS__);                  \
+} while(0)
+
+#endif//__fon9_LogLazy_hpp__
@@ -0,0 +1,28 @@
+﻿// \file fon9/LogModule.cpp
+// \author fonwinz@gmail.com
+#include "fon9/LogModule.hpp"
+
+namespace fon9 {
+
+fon9_API LogModules& GetLogModules() {
+   // LogModule 通常為 global 物件, 所以必須使用 function static, 避免初始化順序的問題.
+   static LogModules LogModules_;
+   return LogModules_;
+}
+
+LogModule::LogModule(StrView name, LogLevel lv) : Name_{name}, Level_{lv} {
+   GetLogModules().Lock()->emplace(name, this);
+}
+LogModule::~LogModule() {
+   auto  modules = GetLogModules().Lock();
+   auto  ifind = modules->find(this->Name_);
+   if (ifind != modules->end() && ifind->second == this)
+      modules->erase(ifind);
+}
+
+fon9_API LogModule  LogModule_Io{"io"};
+fon9_API LogModule  LogModule_Fix{"fix"};
+fon9_API LogModule  LogModule_Fmkt{"fmkt"};
+fon9_API LogModule  LogModule_Inn{"inn"};
+
+} // namespace fon9
@@ -0,0 +1,84 @@
+﻿/// \file fon9/LogModule.hpp
+///
+/// 具名的 log 類別(LogModule), 例: "io", "fix", "fmkt", "inn", "f9twf.Mc"...
+/// - 每個 LogModule 有自己的執行階段 log 等級, 可透過管理介面(fon9/seed/LogModuleTree.hpp)調整.
+/// - 使用 fon9_LOGM_TRACE(module, ...)、fon9_LOGM_INFO(module, ...)... 記錄 log.
+/// - compile time 的等級過濾(fon9_LOG_MIN_LEVEL、fon9_NOLOG_TRACE...) 與 fon9_LOG_TRACE()... 相同.
+///
+/// \author fonwinz@gmail.com
+#ifndef __fon9_LogModule_hpp__
+#define __fon9_LogModule_hpp__
+#include "fon9/Log.hpp"
+#include "fon9/MustLock.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <map>
+fon9_AFTER_INCLUDE_STD;
+
+namespace fon9 {
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Misc
+/// 具名的 log 類別, 通常為 global 物件, 建構時自動加入 GetLogModules(), 解構時移除.
+/// - Name_ 必須是字串常數(或生命週期比 LogModule 更長的字串).
+/// - 若有相同名稱的 LogModule, 則只有第一個會加入 GetLogModules().
+struct fon9_API LogModule {
+   fon9_NON_COPY_NON_MOVE(LogModule);
+
+   const StrView  Name_;
+   /// 執行階段的 log 等級, 若 >= LogLevel::Count, 則使用全域的 LogLevel_;
+   /// 與 LogLevel_ 相同, 沒有使用 atomic: 調整等級時, 其他 thread 不一定能立即看到.
+   LogLevel       Level_;
+
+   LogModule(StrView name, LogLevel lv = LogLevel::Count);
+   ~LogModule();
+
+   LogLevel GetLevel() const {
+      return this->Level_ < LogLevel::Count ? this->Level_ : LogLevel_;
+   }
+};
+fon9_WARN_POP;
+
+using LogModuleMap = std::map<StrView, LogModule*>;
+using LogModules = MustLock<LogModuleMap>;
+/// \ingroup Misc
+/// 取得全部的 LogModule, key = LogModule::Name_;
+fon9_API LogModules& GetLogModules();
+
+/// \ingroup Misc
+/// fon9 提供的 LogModule.
+extern fon9_API LogModule  LogModule_Io;   // "io":   fon9/io
+extern fon9_API LogModule  LogModule_Fix;  // "fix":  fon9/fix
+extern fon9_API LogModule  LogModule_Fmkt; // "fmkt": fon9/fmkt
+extern fon9_API LogModule  LogModule_Inn;  // "inn":  fon9/Inn*
+
+} // namespace fon9
+
+/// \ingroup Misc
+/// 根據 module 的 log 等級, 寫入 log; 其餘與 fon9_LOG() 相同.
+#define fon9_LOGM(module, level, ...)  fon9_LOG_IF(level >= (module).GetLevel(), level, __VA_ARGS__)
+
+#ifdef fon9_NOLOG_TRACE
+#define fon9_LOGM_TRACE(module, ...)  do{}while(0)
+#else
+#define fon9_LOGM_TRACE(module, ...)  fon9_LOGM(module, fon9::LogLevel::Trace, __VA_ARGS__)
+#endif
+
+#ifdef fon9_NOLOG_DEBUG
+#define fon9_LOGM_DEBUG(module, ...)  do{}while(0)
+#else
+#define fon9_LOGM_DEBUG(module, ...)  fon9_LOGM(module, fon9::LogLevel::Debug, __VA_ARGS__)
+#endif
+
+#ifdef fon9_NOLOG_INFO
+#define fon9_LOGM_INFO(module, ...)   do{}while(0)
+#else
+#define fon9_LOGM_INFO(module, ...)   fon9_LOGM(module, fon9::LogLevel::Info, __VA_ARGS__)
+#endif
+
+#define fon9_LOGM_IMP(module, ...)    fon9_LOGM(module, fon9::LogLevel::Important, __VA_ARGS__)
+#define fon9_LOGM_WARN(module, ...)   fon9_LOGM(module, fon9::LogLevel::Warn, __VA_ARGS__)
+#define fon9_LOGM_ERROR(module, ...)  fon9_LOGM(module, fon9::LogLevel::Error, __VA_ARGS__)
+#define fon9_LOGM_FATAL(module, ...)  fon9_LOGM(module, fon9::LogLevel::Fatal, __VA_ARGS__)
+
+#endif//__fon9_LogModule_hpp__
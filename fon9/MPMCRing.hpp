@@ -0,0 +1,157 @@
+﻿/// \file fon9/MPMCRing.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_MPMCRing_hpp__
+#define __fon9_MPMCRing_hpp__
+#include "fon9/sys/Config.hpp"
+#include "fon9/Utility.hpp"
+#include <atomic>
+#include <memory>
+#include <new>
+
+namespace fon9 {
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Thrs
+/// 固定容量的 MPMC(multi producers, multi consumers) ring buffer, 不使用 lock.
+/// - 參考: Dmitry Vyukov, "Bounded MPMC queue".
+/// - 容量為 2 的冪次.
+/// - 每個 slot 佔用完整的 cache line(s), 避免相鄰 slot 的 producer/consumer 互相干擾(false sharing).
+/// - PopN() 使用的 T 必須可以 default construct 及 move assign.
+template <class T>
+class MPMCRing {
+   fon9_NON_COPY_NON_MOVE(MPMCRing);
+   enum : size_t { kCacheLineSize = 64 };
+   struct Slot {
+      /// == pos:     可放入 pos 的資料.
+      /// == pos + 1: pos 的資料已放入, 可取出.
+      std::atomic<size_t>  Seq_;
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type Value_;
+      T* GetValuePtr() {
+         return reinterpret_cast<T*>(&this->Value_);
+      }
+   };
+   enum : size_t { kSlotSize = (sizeof(Slot) + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize };
+
+   // Head_(consumers) 與 Tail_(producers) 放在不同的 cache line.
+   std::atomic<size_t>     Head_{0};
+   char                    PaddingHead_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+   std::atomic<size_t>     Tail_{0};
+   char                    PaddingTail_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+   const size_t            Mask_;
+   std::unique_ptr<byte[]> Memory_;
+   byte*                   SlotsBegin_;
+
+   Slot& GetSlot(size_t pos) const {
+      return *reinterpret_cast<Slot*>(this->SlotsBegin_ + (pos & this->Mask_) * kSlotSize);
+   }
+   static size_t CeilPow2(size_t v) {
+      size_t r = 2;
+      while (r < v)
+         r <<= 1;
+      return r;
+   }
+   static intptr_t Diff(size_t seq, size_t pos) {
+      return static_cast<intptr_t>(seq - pos);
+   }
+
+public:
+   /// capacity 會調整成 2 的冪次.
+   explicit MPMCRing(size_t capacity)
+      : Mask_{CeilPow2(capacity) - 1}
+      , Memory_{new byte[(this->Mask_ + 1) * kSlotSize + kCacheLineSize]} {
+      // 讓每個 slot 都從 cache line 的開頭開始.
+      const uintptr_t mem = reinterpret_cast<uintptr_t>(this->Memory_.get());
+      this->SlotsBegin_ = this->Memory_.get() + ((kCacheLineSize - (mem % kCacheLineSize)) % kCacheLineSize);
+      for (size_t L = 0; L <= this->Mask_; ++L)
+         new (&this->GetSlot(L).Seq_) std::atomic<size_t>{L};
+   }
+   ~MPMCRing() {
+      size_t pos = this->Head_.load(std::memory_order_relaxed);
+      const size_t tail = this->Tail_.load(std::memory_order_relaxed);
+      for (; pos != tail; ++pos)
+         this->GetSlot(pos).GetValuePtr()->~T();
+   }
+
+   size_t capacity() const {
+      return this->Mask_ + 1;
+   }
+   /// 僅供參考, 在多 thread 環境下可能已經改變.
+   size_t size() const {
+      const size_t head = this->Head_.load(std::memory_order_relaxed);
+      const size_t tail = this->Tail_.load(std::memory_order_relaxed);
+      return tail > head ? tail - head : 0u;
+   }
+   /// 僅供參考, 在多 thread 環境下可能已經改變.
+   bool empty() const {
+      const size_t head = this->Head_.load(std::memory_order_relaxed);
+      return Diff(this->GetSlot(head).Seq_.load(std::memory_order_acquire), head + 1) < 0;
+   }
+
+   /// \retval false 已滿.
+   template <class... ArgsT>
+   bool TryEmplace(ArgsT&&... args) {
+      size_t pos = this->Tail_.load(std::memory_order_relaxed);
+      for (;;) {
+         Slot&          slot = this->GetSlot(pos);
+         const intptr_t dif = Diff(slot.Seq_.load(std::memory_order_acquire), pos);
+         if (dif == 0) {
+            if (this->Tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         }
+         else if (dif < 0)
+            return false;
+         else
+            pos = this->Tail_.load(std::memory_order_relaxed);
+      }
+      Slot& slot = this->GetSlot(pos);
+      new (slot.GetValuePtr()) T(std::forward<ArgsT>(args)...);
+      slot.Seq_.store(pos + 1, std::memory_order_release);
+      return true;
+   }
+   bool TryPush(T&& value) {
+      return this->TryEmplace(std::move(value));
+   }
+   bool TryPush(const T& value) {
+      return this->TryEmplace(value);
+   }
+
+   /// \retval false 沒有資料.
+   bool TryPop(T& out) {
+      return this->PopN(&out, 1) == 1;
+   }
+
+   /// 一次取出最多 maxCount 筆(連續)資料, 只需要一次 compare_exchange.
+   /// \return 取出的數量, 0 表示沒有資料.
+   size_t PopN(T* out, size_t maxCount) {
+      size_t pos = this->Head_.load(std::memory_order_relaxed);
+      size_t count;
+      for (;;) {
+         for (count = 0; count < maxCount; ++count) {
+            if (this->GetSlot(pos + count).Seq_.load(std::memory_order_acquire) != pos + count + 1)
+               break;
+         }
+         if (count == 0) {
+            if (Diff(this->GetSlot(pos).Seq_.load(std::memory_order_acquire), pos + 1) < 0)
+               return 0;
+            // 其他 consumer 已取走 pos.
+            pos = this->Head_.load(std::memory_order_relaxed);
+            continue;
+         }
+         // 成功後 [pos, pos + count) 就歸 this thread 所有.
+         if (this->Head_.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+            break;
+      }
+      for (size_t L = 0; L < count; ++L) {
+         Slot& slot = this->GetSlot(pos + L);
+         T*    value = slot.GetValuePtr();
+         out[L] = std::move(*value);
+         value->~T();
+         slot.Seq_.store(pos + L + this->Mask_ + 1, std::memory_order_release);
+      }
+      return count;
+   }
+};
+fon9_WARN_POP;
+
+} // namespace fon9
+#endif//__fon9_MPMCRing_hpp__
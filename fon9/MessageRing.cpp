@@ -0,0 +1,36 @@
+﻿// \file fon9/MessageRing.cpp
+// \author fonwinz@gmail.com
+#include "fon9/MessageRing.hpp"
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+namespace fon9 {
+
+#ifdef __linux__
+void RingWaitPolicy_Futex::FutexWait(uint32_t seqno) {
+   // WakeSeqNo_ != seqno 時 futex 會立即返回(EAGAIN), 所以不會遺漏 FutexWake().
+   syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->WakeSeqNo_), FUTEX_WAIT_PRIVATE, seqno, nullptr, nullptr, 0);
+}
+void RingWaitPolicy_Futex::FutexWake(bool isAll) {
+   syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->WakeSeqNo_), FUTEX_WAKE_PRIVATE, isAll ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+#else
+void RingWaitPolicy_Futex::FutexWait(uint32_t seqno) {
+   std::unique_lock<std::mutex> lk{this->Mutex_};
+   this->CV_.wait(lk, [this, seqno]() { return this->WakeSeqNo_.load(std::memory_order_acquire) != seqno; });
+}
+void RingWaitPolicy_Futex::FutexWake(bool isAll) {
+   // 必須 lock, 避免在 FutexWait() 檢查 WakeSeqNo_ 之後, 進入 wait 之前 notify.
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   if (isAll)
+      this->CV_.notify_all();
+   else
+      this->CV_.notify_one();
+}
+#endif
+
+} // namespace
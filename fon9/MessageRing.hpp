@@ -0,0 +1,259 @@
+﻿/// \file fon9/MessageRing.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_MessageRing_hpp__
+#define __fon9_MessageRing_hpp__
+#include "fon9/MPMCRing.hpp"
+#include "fon9/ThreadController.hpp"
+#include "fon9/ThreadTools.hpp"
+#include "fon9/SleepPolicy.hpp"
+#include "fon9/Log.hpp"
+#include <vector>
+#if !defined(__linux__)
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace fon9 {
+
+/// \ingroup Thrs
+/// MessageRing 的 consumer 沒有訊息時, 使用 SleepPolicy::Sleep() 等候.
+/// - 不需要喚醒, 所以 producer 加入訊息時沒有額外負擔.
+/// - 參考 fon9/SleepPolicy.hpp: BusySleepPolicy, YieldSleepPolicy...
+template <class SleepPolicy>
+struct RingWaitPolicy_Spin {
+   /// 等候 fnIsReady() 傳回 true.
+   template <class FnIsReady>
+   void Wait(FnIsReady&& fnIsReady) {
+      while (!fnIsReady())
+         SleepPolicy::Sleep();
+   }
+   void NotifyOne() {
+   }
+   void NotifyAll() {
+   }
+};
+using RingWaitPolicy_Busy = RingWaitPolicy_Spin<BusySleepPolicy>;
+using RingWaitPolicy_Yield = RingWaitPolicy_Spin<YieldSleepPolicy>;
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Thrs
+/// MessageRing 的 consumer 沒有訊息時, 進入睡眠.
+/// - Linux 使用 futex; 其他系統使用 std::mutex + std::condition_variable.
+/// - 只有在 consumer 睡眠時, producer 加入訊息才需要呼叫 system call 喚醒.
+class fon9_API RingWaitPolicy_Futex {
+   fon9_NON_COPY_NON_MOVE(RingWaitPolicy_Futex);
+   std::atomic<uint32_t>   WakeSeqNo_{0};
+   std::atomic<uint32_t>   WaiterCount_{0};
+#if !defined(__linux__)
+   std::mutex              Mutex_;
+   std::condition_variable CV_;
+#endif
+   void FutexWait(uint32_t seqno);
+   void FutexWake(bool isAll);
+
+   void Notify(bool isAll) {
+      // 與 Wait() 的 fence 配對: producer 放入訊息後, 必定能看到 consumer 的 WaiterCount_;
+      // 或 consumer 必定能看到 producer 放入的訊息.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (fon9_LIKELY(this->WaiterCount_.load(std::memory_order_relaxed) == 0))
+         return;
+      this->WakeSeqNo_.fetch_add(1, std::memory_order_release);
+      this->FutexWake(isAll);
+   }
+
+public:
+   enum : unsigned { kSpinCount = 16 };
+   RingWaitPolicy_Futex() = default;
+
+   template <class FnIsReady>
+   void Wait(FnIsReady&& fnIsReady) {
+      // 睡眠前先讓出 cpu 幾次, 讓 producer 有機會放入訊息,
+      // 避免 producer 每次加入訊息都要喚醒 consumer.
+      for (unsigned L = 0; L < kSpinCount; ++L) {
+         if (fnIsReady())
+            return;
+         std::this_thread::yield();
+      }
+      while (!fnIsReady()) {
+         const uint32_t seqno = this->WakeSeqNo_.load(std::memory_order_acquire);
+         this->WaiterCount_.fetch_add(1, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (!fnIsReady())
+            this->FutexWait(seqno);
+         this->WaiterCount_.fetch_sub(1, std::memory_order_relaxed);
+      }
+   }
+   void NotifyOne() {
+      this->Notify(false);
+   }
+   void NotifyAll() {
+      this->Notify(true);
+   }
+};
+fon9_WARN_POP;
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Thrs
+/// 與 MessageQueue 類似, 但使用固定容量的 MPMCRing, 加入及取出訊息都不需要 lock.
+/// - 適合大量的小訊息: 例如行情分送(fan-out) thread.
+/// - 每個 thread 會建立一個 MessageHandlerT 用來處理訊息.
+/// - MessageHandlerT 必須提供:
+///   - `typename MessageHandlerT::MessageType;` 必須可以 default construct 及 move assign.
+///   - `MessageHandlerT::MessageHandlerT(MessageRing&);`
+///   - 處理訊息, 底下函式二選一, 只能提供其中一種:
+///      - 一次一筆:  `void MessageHandlerT::OnMessage(MessageType&);`
+///      - 一次一批:  `void MessageHandlerT::OnMessage(MessageType* msgs, size_t count);`
+///   - `void MessageHandlerT::OnThreadEnd(const std::string& thrName);`
+/// - WaitPolicyT: RingWaitPolicy_Busy, RingWaitPolicy_Yield, RingWaitPolicy_Futex;
+template <
+   class MessageHandlerT,
+   class MessageT = typename MessageHandlerT::MessageType,
+   class WaitPolicyT = RingWaitPolicy_Futex
+>
+class MessageRing {
+   fon9_NON_COPY_NON_MOVE(MessageRing);
+   using Ring = MPMCRing<MessageT>;
+   using ThreadPool = std::vector<std::thread>;
+   Ring                       Ring_;
+   WaitPolicyT                WaitPolicy_;
+   std::atomic<ThreadState>   State_{ThreadState::Idle};
+   ThreadPool                 ThreadPool_;
+   const size_t               BatchSize_;
+
+   template <class MessageHandler>
+   static auto OnMessage(MessageHandler& messageHandler, MessageT* msgs, size_t count)
+      -> decltype(messageHandler.OnMessage(msgs, count)) {
+      return messageHandler.OnMessage(msgs, count);
+   }
+   template <class MessageHandler>
+   static auto OnMessage(MessageHandler& messageHandler, MessageT* msgs, size_t count)
+      -> decltype(messageHandler.OnMessage(*msgs)) {
+      for (size_t L = 0; L < count; ++L)
+         messageHandler.OnMessage(msgs[L]);
+   }
+
+   bool IsReadyForConsumer() const {
+      return !this->Ring_.empty() || this->State_.load(std::memory_order_acquire) > ThreadState::ExecutingOrWaiting;
+   }
+
+   static void ThrRun(std::string thrName, MessageRing* pthis) {
+      fon9_LOG_ThrRun("MessageRing.ThrRun|name=", thrName);
+      MessageHandlerT         messageHandler(*pthis);
+      std::vector<MessageT>   msgs(pthis->BatchSize_);
+      for (;;) {
+         if (const size_t count = pthis->Ring_.PopN(msgs.data(), msgs.size())) {
+            pthis->OnMessage(messageHandler, msgs.data(), count);
+            continue;
+         }
+         const ThreadState st = pthis->State_.load(std::memory_order_acquire);
+         if (st >= ThreadState::EndNow)
+            break;
+         if (st == ThreadState::EndAfterWorkDone) {
+            if (pthis->Ring_.empty())
+               break;
+            continue;
+         }
+         pthis->WaitPolicy_.Wait([pthis]() { return pthis->IsReadyForConsumer(); });
+      }
+      messageHandler.OnThreadEnd(thrName);
+      fon9_LOG_ThrRun("MessageRing.ThrRun.End|name=", thrName);
+   }
+
+   void NotifyEnd(ThreadState st) {
+      ThreadState curr = this->State_.load(std::memory_order_acquire);
+      do {
+         if (curr >= st)
+            return;
+      } while (!this->State_.compare_exchange_weak(curr, st, std::memory_order_acq_rel));
+      this->WaitPolicy_.NotifyAll();
+   }
+   void WaitThreadJoin() {
+      JoinThreads(this->ThreadPool_);
+      this->State_.store(ThreadState::Terminated, std::memory_order_release);
+   }
+
+public:
+   using MessageHandler = MessageHandlerT;
+   using MessageType = MessageT;
+   using WaitPolicyType = WaitPolicyT;
+
+   /// \param capacity  MPMCRing 的容量, 會調整成 2 的冪次.
+   /// \param batchSize 每次最多取出 batchSize 筆訊息處理.
+   explicit MessageRing(size_t capacity, size_t batchSize = 64)
+      : Ring_{capacity}
+      , BatchSize_{batchSize <= 0 ? 1u : batchSize} {
+   }
+   /// 若有剩餘未處理的訊息，將會被拋棄。
+   ~MessageRing() {
+      this->WaitForEndNow();
+   }
+
+   void StartThread(uint32_t threadCount, StrView thrName) {
+      assert(this->ThreadPool_.empty());
+      this->ThreadPool_.reserve(threadCount);
+      this->State_.store(ThreadState::ExecutingOrWaiting, std::memory_order_release);
+      RevBufferFixedSize<1024> rbuf;
+      for (unsigned id = 0; id < threadCount;) {
+         rbuf.Rewind();
+         RevPrint(rbuf, thrName, "|indexInPool=", ++id);
+         this->ThreadPool_.emplace_back(&ThrRun, rbuf.ToStrT<std::string>(), this);
+      }
+   }
+   size_t GetThreadCount() const {
+      return this->ThreadPool_.size();
+   }
+   ThreadState GetThreadState() const {
+      return this->State_.load(std::memory_order_acquire);
+   }
+   size_t capacity() const {
+      return this->Ring_.capacity();
+   }
+
+   /// 加入訊息, 不等候.
+   /// \retval false 已滿, 或已通知結束.
+   template <class... ArgsT>
+   bool TryEmplace(ArgsT&&... args) {
+      if (fon9_UNLIKELY(this->State_.load(std::memory_order_relaxed) > ThreadState::ExecutingOrWaiting))
+         return false;
+      if (!this->Ring_.TryEmplace(std::forward<ArgsT>(args)...))
+         return false;
+      this->WaitPolicy_.NotifyOne();
+      return true;
+   }
+   bool TryPush(MessageT&& msg) {
+      return this->TryEmplace(std::move(msg));
+   }
+   bool TryPush(const MessageT& msg) {
+      return this->TryEmplace(msg);
+   }
+
+   /// 通知結束，若有剩餘未執行的訊息，可透過 WaitForEndNow(remainMessageHandler) 處理。
+   void NotifyForEndNow() {
+      this->NotifyEnd(ThreadState::EndNow);
+   }
+   /// 通知結束, 並在 thread 結束後, 透過 remainMessageHandler 處理剩餘訊息.
+   void WaitForEndNow(MessageHandlerT& remainMessageHandler) {
+      this->WaitForEndNow();
+      std::vector<MessageT> msgs(this->BatchSize_);
+      while (const size_t count = this->Ring_.PopN(msgs.data(), msgs.size()))
+         this->OnMessage(remainMessageHandler, msgs.data(), count);
+   }
+   /// 通知結束, 並在 thread 結束後返回, 但不處理剩餘訊息.
+   void WaitForEndNow() {
+      this->NotifyEnd(ThreadState::EndNow);
+      this->WaitThreadJoin();
+   }
+   /// 通知訊息處理完畢後結束 thread.
+   void NotifyForEndAfterWorkDone() {
+      this->NotifyEnd(ThreadState::EndAfterWorkDone);
+   }
+   /// 等候 thread 處理完訊息後, 結束 thread.
+   void WaitForEndAfterWorkDone() {
+      this->NotifyEnd(ThreadState::EndAfterWorkDone);
+      this->WaitThreadJoin();
+   }
+};
+fon9_WARN_POP;
+
+} // namespace
+#endif//__fon9_MessageRing_hpp__
@@ -0,0 +1,163 @@
+﻿// \file fon9/MessageRing_UT.cpp
+// \author fonwinz@gmail.com
+#include "fon9/MessageRing.hpp"
+#include "fon9/MessageQueue.hpp"
+#include "fon9/TestTools.hpp"
+
+//--------------------------------------------------------------------------//
+
+static std::atomic<int> gLiveCount{0};
+struct LiveMsg {
+   uint64_t Value_{0};
+   LiveMsg() { ++gLiveCount; }
+   LiveMsg(uint64_t v) : Value_{v} { ++gLiveCount; }
+   LiveMsg(const LiveMsg& r) : Value_{r.Value_} { ++gLiveCount; }
+   LiveMsg& operator=(const LiveMsg&) = default;
+   LiveMsg& operator=(LiveMsg&&) = default;
+   ~LiveMsg() { --gLiveCount; }
+};
+
+void TestRingBasic() {
+   {
+      fon9::MPMCRing<LiveMsg> ring{5};
+      fon9_CheckTestResult("MPMCRing.capacity", ring.capacity() == 8 && ring.empty());
+      uint64_t v = 0;
+      while (ring.TryEmplace(++v)) {
+      }
+      fon9_CheckTestResult("MPMCRing.Full", v == 9 && ring.size() == 8);
+      LiveMsg  msgs[5];
+      size_t   count = ring.PopN(msgs, 5);
+      fon9_CheckTestResult("MPMCRing.PopN", count == 5 && msgs[0].Value_ == 1 && msgs[4].Value_ == 5);
+      fon9_CheckTestResult("MPMCRing.PushAfterPop", ring.TryPush(LiveMsg{100}) && ring.size() == 4);
+      count = ring.PopN(msgs, 5);
+      fon9_CheckTestResult("MPMCRing.PopN.Wrap", count == 4 && msgs[0].Value_ == 6 && msgs[3].Value_ == 100);
+      fon9_CheckTestResult("MPMCRing.Empty", ring.PopN(msgs, 5) == 0 && ring.empty());
+      ring.TryEmplace(1u);
+      ring.TryEmplace(2u);
+   }
+   fon9_CheckTestResult("MPMCRing.Destroy", gLiveCount == 0);
+}
+
+void TestRingMPMC() {
+   static const unsigned kProducerCount = 3;
+   static const unsigned kConsumerCount = 3;
+   static const uint64_t kCountPerProducer = 300000;
+   fon9::MPMCRing<uint64_t>   ring{1024};
+   std::atomic<uint64_t>      sum{0}, count{0};
+   std::atomic<unsigned>      producerDone{0};
+   std::vector<std::thread>   thrs;
+   for (unsigned L = 0; L < kConsumerCount; ++L) {
+      thrs.emplace_back([&]() {
+         uint64_t msgs[32];
+         for (;;) {
+            if (size_t n = ring.PopN(msgs, 32)) {
+               uint64_t s = 0;
+               for (size_t i = 0; i < n; ++i)
+                  s += msgs[i];
+               sum += s;
+               count += n;
+            }
+            else if (producerDone == kProducerCount && ring.empty())
+               break;
+            else
+               std::this_thread::yield();
+         }
+      });
+   }
+   for (unsigned L = 0; L < kProducerCount; ++L) {
+      thrs.emplace_back([&]() {
+         for (uint64_t v = 1; v <= kCountPerProducer; ++v) {
+            while (!ring.TryPush(v))
+               std::this_thread::yield();
+         }
+         ++producerDone;
+      });
+   }
+   fon9::JoinThreads(thrs);
+   const uint64_t expected = kProducerCount * (kCountPerProducer * (kCountPerProducer + 1) / 2);
+   std::cout << "count=" << count << "|sum=" << sum << "|expected=" << expected << std::endl;
+   fon9_CheckTestResult("MPMCRing.MPMC", count == kProducerCount * kCountPerProducer && sum == expected);
+}
+
+//--------------------------------------------------------------------------//
+
+static const uint64_t kMsgCount = 1000000;
+static const unsigned kProducerCount = 2;
+static std::atomic<uint64_t> gMsgSum, gMsgCount;
+
+template <class WaitPolicy>
+struct RingHandler {
+   using MessageType = uint64_t;
+   using ThreadPool = fon9::MessageRing<RingHandler, uint64_t, WaitPolicy>;
+   RingHandler(ThreadPool&) {}
+   void OnMessage(uint64_t* msgs, size_t count) {
+      uint64_t s = 0;
+      for (size_t L = 0; L < count; ++L)
+         s += msgs[L];
+      gMsgSum += s;
+      gMsgCount += count;
+   }
+   void OnThreadEnd(const std::string&) {
+   }
+};
+struct QueueHandler {
+   using MessageType = uint64_t;
+   using ThreadPool = fon9::MessageQueue<QueueHandler>;
+   QueueHandler(ThreadPool&) {}
+   void OnMessage(uint64_t& msg) {
+      gMsgSum += msg;
+      ++gMsgCount;
+   }
+   void OnThreadEnd(const std::string&) {
+   }
+};
+
+template <class ThreadPool>
+void PushMsg(ThreadPool& pool, uint64_t v) {
+   while (!pool.TryPush(v))
+      std::this_thread::yield();
+}
+void PushMsg(QueueHandler::ThreadPool& pool, uint64_t v) {
+   pool.EmplaceMessage(v);
+}
+
+template <class ThreadPool>
+void TestPool(const char* name, ThreadPool& pool) {
+   gMsgSum = gMsgCount = 0;
+   pool.StartThread(2, fon9::StrView_cstr(name));
+   fon9::StopWatch          stopWatch;
+   std::vector<std::thread> producers;
+   for (unsigned L = 0; L < kProducerCount; ++L) {
+      producers.emplace_back([&pool]() {
+         for (uint64_t v = 1; v <= kMsgCount; ++v)
+            PushMsg(pool, v);
+      });
+   }
+   fon9::JoinThreads(producers);
+   pool.WaitForEndAfterWorkDone();
+   stopWatch.PrintResult(name, gMsgCount);
+   const uint64_t expected = kProducerCount * (kMsgCount * (kMsgCount + 1) / 2);
+   fon9_CheckTestResult(name, gMsgCount == kProducerCount * kMsgCount && gMsgSum == expected);
+}
+
+int main() {
+   fon9::AutoPrintTestInfo utinfo{"MessageRing"};
+   TestRingBasic();
+
+   utinfo.PrintSplitter();
+   TestRingMPMC();
+
+   utinfo.PrintSplitter();
+   {
+      QueueHandler::ThreadPool pool;
+      TestPool("MessageQueue        ", pool);
+   }
+   {
+      RingHandler<fon9::RingWaitPolicy_Futex>::ThreadPool pool{1024 * 64};
+      TestPool("MessageRing<Futex>  ", pool);
+   }
+   {
+      RingHandler<fon9::RingWaitPolicy_Yield>::ThreadPool pool{1024 * 64};
+      TestPool("MessageRing<Yield>  ", pool);
+   }
+}
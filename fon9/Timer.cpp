@@ -3,6 +3,7 @@
 #include "fon9/Timer.hpp"
 #include "fon9/Log.hpp"
 #include "fon9/ThreadTools.hpp"
+#include "fon9/Tools.hpp"
 #include "fon9/sys/OnWindowsMainExit.hpp"
 
 namespace fon9 {
@@ -25,13 +26,13 @@ TimerThreadSP GetDefaultTimerThread() {
 //--------------------------------------------------------------------------//
 TimerEntry::~TimerEntry() {
    if (this->TimerThread_->TimerController_.IsThreadEnding())
-      TimerThread::Locker{this->TimerThread_->TimerController_}->Erase(this->Key_);
+      TimerThread::Locker{this->TimerThread_->TimerController_}->Erase(*this);
 }
 void TimerEntry::DisposeAndWait() {
    while(!this->TimerThread_->TimerController_.IsThreadEnding()) {
       TimerThread::Locker   timerThread{this->TimerThread_->TimerController_};
       if (IsTimerWaitInLine(this->Key_.SeqNo_)) {
-         timerThread->Erase(this->Key_);
+         timerThread->Erase(*this);
          this->Key_.SeqNo_ = TimerSeqNo::Disposed;
          this->Key_.EmitTime_.AssignNull();
       }
@@ -44,7 +45,7 @@ void TimerEntry::StopAndWait() {
       TimerThread::Locker   timerThread{this->TimerThread_->TimerController_};
       if (this->Key_.SeqNo_ == TimerSeqNo::Disposed)
          break;
-      timerThread->Erase(this->Key_);
+      timerThread->Erase(*this);
       this->Key_.SeqNo_ = TimerSeqNo::NoWaiting;
       this->Key_.EmitTime_.AssignNull();
       if (!this->TimerThread_->CheckCurrEmit(timerThread, *this))
@@ -56,7 +57,7 @@ void TimerEntry::DisposeNoWait() {
    if (this->TimerThread_->TimerController_.IsThreadEnding())
       return;
    if (IsTimerWaitInLine(this->Key_.SeqNo_))
-      timerThread->Erase(this->Key_);
+      timerThread->Erase(*this);
    this->Key_.SeqNo_ = TimerSeqNo::Disposed;
 }
 void TimerEntry::StopNoWait() {
@@ -64,7 +65,7 @@ void TimerEntry::StopNoWait() {
    if (this->TimerThread_->TimerController_.IsThreadEnding())
       return;
    if (IsTimerWaitInLine(this->Key_.SeqNo_)) {
-      timerThread->Erase(this->Key_);
+      timerThread->Erase(*this);
       this->Key_.SeqNo_ = TimerSeqNo::NoWaiting;
    }
 }
@@ -75,7 +76,7 @@ void TimerEntry::SetupRun(TimeStamp atTimePoint, const TimeInterval* after) {
    if (this->Key_.SeqNo_ == TimerSeqNo::Disposed)
       return;
    if (IsTimerWaitInLine(this->Key_.SeqNo_))
-      timerThread->Erase(this->Key_);
+      timerThread->Erase(*this);
 
    this->Key_.EmitTime_ = atTimePoint;
    timerThread->LastSeqNo_ = static_cast<TimerSeqNo>(cast_to_underlying(timerThread->LastSeqNo_) + 1);
@@ -83,8 +84,7 @@ void TimerEntry::SetupRun(TimeStamp atTimePoint, const TimeInterval* after) {
       timerThread->LastSeqNo_ = TimerSeqNo::WaitInLine;
    this->Key_.SeqNo_ = timerThread->LastSeqNo_;
 
-   auto ifind = timerThread->Timers_.insert(TimerThread::TimerThreadData::Timers::value_type{this->Key_, this}).first;
-   if (fon9_LIKELY(ifind != timerThread->Timers_.end() - 1))
+   if (fon9_LIKELY(!timerThread->Insert(*this)))
       return;
    TimeInterval wsecs = after ? *after : TimeInterval{atTimePoint - UtcNow()};
    if (fon9_UNLIKELY(timerThread->CvWaitSecs_ == wsecs))
@@ -114,13 +114,42 @@ void DataMemberTimer::OnTimerEntryReleased() {
 
 //--------------------------------------------------------------------------//
 
-TimerThread::TimerThread(std::string timerName) {
+void TimerThread::TimerThreadData::Erase(TimerEntry& timer) {
+   if (timer.Key_.SeqNo_ == TimerSeqNo::NoWaiting)
+      return;
+   if (this->QueueKind_ == TimerQueueKind::Wheel) {
+      if (timer.WheelNode_.IsLinked()) {
+         this->Wheel_.Remove(timer.WheelNode_);
+         intrusive_ptr_release(&timer);
+      }
+      return;
+   }
+   auto ifind = this->Timers_.find(timer.Key_);
+   if (ifind != this->Timers_.end())
+      this->Timers_.erase(ifind);
+}
+bool TimerThread::TimerThreadData::Insert(TimerEntry& timer) {
+   if (this->QueueKind_ == TimerQueueKind::Wheel) {
+      const uint64_t tick = TimerWheel::ToTick(timer.Key_.EmitTime_);
+      intrusive_ptr_add_ref(&timer);
+      this->Wheel_.Add(timer.WheelNode_, tick);
+      if (fon9_LIKELY(tick >= this->WheelWakeTick_))
+         return false;
+      this->WheelWakeTick_ = tick;
+      return true;
+   }
+   auto ifind = this->Timers_.insert(Timers::value_type{timer.Key_, &timer}).first;
+   return ifind == this->Timers_.end() - 1;
+}
+
+TimerThread::TimerThread(std::string timerName, TimerQueueKind queueKind, int cpuAffinity)
+   : TimerController_{queueKind} {
    this->TimerController_.OnBeforeThreadStart(1);
-   this->Thread_ = std::thread(&TimerThread::ThrRun, this, std::move(timerName));
+   this->Thread_ = std::thread(&TimerThread::ThrRun, this, std::move(timerName), cpuAffinity);
 }
 TimerThread::~TimerThread() {
    this->WaitForEndNow();
-   assert(Locker{this->TimerController_}->Timers_.empty());
+   assert(Locker{this->TimerController_}->empty());
 }
 void TimerThread::WaitForEndNow() {
    this->TimerController_.WaitForEndNow();
@@ -136,6 +165,8 @@ bool TimerThread::CheckCurrEmit(Locker& timerThread, TimerEntry& timer) {
 }
 
 bool TimerThread::RunTimer(Locker& timerThread) {
+   if (timerThread->QueueKind_ == TimerQueueKind::Wheel)
+      return this->RunTimerWheel(timerThread);
    while (this->TimerController_.GetState(timerThread) == ThreadState::ExecutingOrWaiting) {
       if (timerThread->Timers_.empty()) {
          timerThread->CvWaitSecs_ = TimeInterval_Second(-1);
@@ -148,6 +179,7 @@ bool TimerThread::RunTimer(Locker& timerThread) {
          timerThread->CvWaitSecs_ = ti;
          return true;
       }
+      timerThread->Stat_.OnEmit(timer->Key_.EmitTime_, now);
       timer->Key_.SeqNo_ = TimerSeqNo::NoWaiting;
       timerThread->Timers_.pop_back();
       timerThread->CurrEntry_ = timer.get();
@@ -160,10 +192,41 @@ bool TimerThread::RunTimer(Locker& timerThread) {
    }
    return false;
 }
-void TimerThread::ThrRun(std::string timerName) {
+bool TimerThread::RunTimerWheel(Locker& timerThread) {
+   while (this->TimerController_.GetState(timerThread) == ThreadState::ExecutingOrWaiting) {
+      TimeStamp      now = UtcNow();
+      const uint64_t nowTick = TimerWheel::ToTick(now);
+      timerThread->Wheel_.Advance(nowTick);
+      TimerWheelNode* node = timerThread->Wheel_.PopExpired();
+      if (node == nullptr) {
+         const uint64_t ticks = timerThread->Wheel_.NextTimeout();
+         if (ticks == UINT64_MAX) {
+            timerThread->WheelWakeTick_ = UINT64_MAX;
+            timerThread->CvWaitSecs_ = TimeInterval_Second(-1);
+         }
+         else {
+            timerThread->WheelWakeTick_ = timerThread->Wheel_.GetCurrTick() + ticks;
+            timerThread->CvWaitSecs_ = TimeInterval::Make<6>(static_cast<TimeInterval::OrigType>(ticks));
+         }
+         return true;
+      }
+      // Wheel_ 裡面的 timer 都有 add_ref(), 在 EmitOnTimer() 裡面 intrusive_ptr_release(timer);
+      TimerEntry* timer = &ContainerOf(*node, &TimerEntry::WheelNode_);
+      timerThread->Stat_.OnEmit(timer->Key_.EmitTime_, now);
+      timer->Key_.SeqNo_ = TimerSeqNo::NoWaiting;
+      timerThread->CurrEntry_ = timer;
+      timerThread.unlock();
+      timer->EmitOnTimer(now);
+      timerThread.lock();
+      timerThread->CurrEntry_ = nullptr;
+   }
+   return false;
+}
+void TimerThread::ThrRun(std::string timerName, int cpuAffinity) {
    if (gWaitLogSystemReady)
       gWaitLogSystemReady();
-   fon9_LOG_ThrRun("TimerThread.ThrRun|name=", timerName);
+   Result3 cpuResult = SetCpuAffinity(cpuAffinity);
+   fon9_LOG_ThrRun("TimerThread.ThrRun|name=", timerName, "|Cpu=", cpuAffinity, ':', cpuResult);
    {
       Locker   timerThread{this->TimerController_};
       while (this->RunTimer(timerThread)) {
@@ -3,6 +3,7 @@
 #ifndef __fon9_Timer_hpp__
 #define __fon9_Timer_hpp__
 #include "fon9/SortedVector.hpp"
+#include "fon9/TimerWheel.hpp"
 #include "fon9/intrusive_ref_counter.hpp"
 #include "fon9/TimeStamp.hpp"
 #include "fon9/ThreadController.hpp"
@@ -39,6 +40,42 @@ struct TimerEntryKey {
    }
 };
 
+/// \ingroup Thrs
+/// TimerThread 保存 timers 的方式.
+enum class TimerQueueKind : uint8_t {
+   /// 使用 SortedVector: 依照觸發時間排序, 啟動、停止 timer 的成本為 O(n);
+   /// 適合 timer 數量不多的情況, 同時到期的 timer 依照啟動順序觸發.
+   Sorted,
+   /// 使用 TimerWheel(fon9/TimerWheel.hpp): 啟動、停止 timer 的成本為 O(1);
+   /// 適合大量 timer 的情況, 例: 數萬個連線的 heartbeat、flow control timer.
+   /// 同時到期的 timer, 觸發的順序不一定依照時間(或啟動)順序.
+   Wheel,
+};
+
+/// \ingroup Thrs
+/// TimerThread 觸發 timer 的統計資料.
+/// Lag = 實際觸發時間 - 預計觸發時間(TimerEntryKey::EmitTime_);
+/// 若 Lag 持續偏大, 表示此 TimerThread 的 OnTimer() 負擔過重, 應考慮分散到 TimerThreadPool.
+struct TimerThreadStat {
+   /// 已觸發的 timer 數量.
+   uint64_t       EmitCount_{0};
+   TimeInterval   LagTotal_{};
+   TimeInterval   LagMax_{};
+   TimeInterval   LagLast_{};
+
+   void OnEmit(TimeStamp emitTime, TimeStamp now) {
+      ++this->EmitCount_;
+      this->LagLast_ = (emitTime.IsNull() || now < emitTime) ? TimeInterval{} : TimeInterval{now - emitTime};
+      this->LagTotal_ += this->LagLast_;
+      if (this->LagMax_ < this->LagLast_)
+         this->LagMax_ = this->LagLast_;
+   }
+   TimeInterval GetLagAvg() const {
+      return this->EmitCount_ == 0 ? TimeInterval{}
+         : TimeInterval::Make<TimeInterval::Scale>(this->LagTotal_.GetOrigValue() / static_cast<TimeInterval::OrigType>(this->EmitCount_));
+   }
+};
+
 /// \ingroup Thrs
 /// - 每個 TimerThread 擁有一個自己的 thread.
 /// - 每個 timer 啟動時, 不論設定的是 [間隔時間] or [絕對時間], 都會使用 TimeStamp_ 來處理.
@@ -96,6 +133,8 @@ class fon9_API TimerEntry : public intrusive_ref_counter<TimerEntry> {
 
    friend class TimerThread;
    TimerEntryKey  Key_;
+   /// TimerQueueKind::Wheel 使用.
+   TimerWheelNode WheelNode_;
 
    void SetupRun(TimeStamp atTimePoint, const TimeInterval* after);
 public:
@@ -233,21 +272,31 @@ class fon9_API TimerThread : public intrusive_ref_counter<TimerThread> {
    friend class TimerEntry;
 
    struct TimerThreadData {
-      void Erase(TimerEntryKey& key) {
-         if (key.SeqNo_ == TimerSeqNo::NoWaiting)
-            return;
-         auto ifind = this->Timers_.find(key);
-         if (ifind != this->Timers_.end())
-            this->Timers_.erase(ifind);
+      TimerThreadData(TimerQueueKind queueKind)
+         : QueueKind_{queueKind}
+         , Wheel_{TimerWheel::ToTick(UtcNow())} {
+      }
+      void Erase(TimerEntry& timer);
+      /// 將 timer(已設定好 Key_) 加入等候.
+      /// \retval true  timer 為最早觸發者, 必須通知 TimerThread 重新計算等候時間.
+      bool Insert(TimerEntry& timer);
+      bool empty() const {
+         return this->Timers_.empty() && this->Wheel_.empty();
       }
 
       using Timers = SortedVector<TimerEntryKey, TimerEntrySP>;
+      const TimerQueueKind QueueKind_;
       TimerSeqNo        LastSeqNo_{TimerSeqNo::WaitInLine};
       Timers            Timers_;
+      /// QueueKind_ == TimerQueueKind::Wheel 時使用, Wheel_ 裡面的每個 timer 都有 add_ref();
+      TimerWheel        Wheel_;
+      /// QueueKind_ == TimerQueueKind::Wheel 時使用, TimerThread 預計醒來的時間(tick).
+      uint64_t          WheelWakeTick_{UINT64_MAX};
       TimeInterval      CvWaitSecs_;
       /// 如果在 TimerThread 正在觸發, 則會設定此值.
       /// 讓另一 thread 呼叫 TimerEntry::StopAndWait() 時, 可以等到 OnTimer() 真的結束後才返回.
       TimerEntry* CurrEntry_{};
+      TimerThreadStat   Stat_;
    };
    using TimerController = ThreadController<TimerThreadData, WaitPolicy_CV>;
    using Locker = TimerController::Locker;
@@ -256,19 +305,26 @@ class fon9_API TimerThread : public intrusive_ref_counter<TimerThread> {
 
    bool CheckCurrEmit(Locker& timerThread, TimerEntry& timer);
    bool RunTimer(Locker&);
+   bool RunTimerWheel(Locker&);
 
 protected:
-   void ThrRun(std::string timerName);
+   void ThrRun(std::string timerName, int cpuAffinity);
    void NotifyForEndNow() {
       this->TimerController_.NotifyForEndNow();
    }
 
 public:
-   TimerThread(std::string timerName);
+   /// \param cpuAffinity  >= 0 時, 將 TimerThread 綁定在指定的 cpu 上執行.
+   TimerThread(std::string timerName, TimerQueueKind queueKind = TimerQueueKind::Sorted, int cpuAffinity = -1);
    virtual ~TimerThread();
 
    void WaitForEndNow();
 
+   /// 取得觸發 timer 的統計資料.
+   TimerThreadStat GetStat() const {
+      return this->TimerController_.ConstLock()->Stat_;
+   }
+
    bool InThisThread() const {
       return (this->Thread_.get_id() == std::this_thread::get_id());
    }
@@ -0,0 +1,74 @@
+﻿// \file fon9/TimerThreadPool.cpp
+// \author fonwinz@gmail.com
+#include "fon9/TimerThreadPool.hpp"
+#include "fon9/StrTo.hpp"
+#include "fon9/StrTools.hpp"
+#include "fon9/RevPrint.hpp"
+
+namespace fon9 {
+
+ConfigParser::Result TimerThreadPoolArgs::OnTagValue(StrView tag, StrView& value) {
+   const char* pvalbeg = value.begin();
+   if (tag == "ThreadCount") {
+      if ((this->ThreadCount_ = StrTo(value, 0u)) <= 0) {
+         this->ThreadCount_ = 1;
+         value.SetBegin(pvalbeg);
+         return ConfigParser::Result::EValueTooSmall;
+      }
+   }
+   else if (tag == "Queue") {
+      if (value == "Sorted")
+         this->QueueKind_ = TimerQueueKind::Sorted;
+      else if (value == "Wheel")
+         this->QueueKind_ = TimerQueueKind::Wheel;
+      else
+         return ConfigParser::Result::EInvalidValue;
+   }
+   else if (tag == "Cpus") {
+      while (!value.empty()) {
+         StrView v1 = StrFetchTrim(value, ',');
+         if (v1.empty())
+            continue;
+         const char* pend;
+         int n = StrTo(v1, -1, &pend);
+         if (n < 0) {
+            value.SetBegin(v1.begin());
+            return ConfigParser::Result::EInvalidValue;
+         }
+         if (pend != v1.end()) {
+            value.SetBegin(pend);
+            return ConfigParser::Result::EInvalidValue;
+         }
+         this->CpuAffinity_.push_back(static_cast<uint32_t>(n));
+      }
+   }
+   else
+      return ConfigParser::Result::EUnknownTag;
+   return ConfigParser::Result::Success;
+}
+
+//--------------------------------------------------------------------------//
+
+TimerThreadPool::TimerThreadPool(const std::string& name, const TimerThreadPoolArgs& args) {
+   const uint32_t count = (args.ThreadCount_ <= 0 ? 1u : args.ThreadCount_);
+   this->Threads_.reserve(count);
+   for (uint32_t L = 0; L < count; ++L)
+      this->Threads_.emplace_back(new TimerThread(name + "." + RevPrintTo<std::string>(L),
+                                                  args.QueueKind_, args.GetCpuAffinity(L)));
+}
+TimerThreadPool::~TimerThreadPool() {
+   this->WaitForEndNow();
+}
+void TimerThreadPool::WaitForEndNow() {
+   for (auto& thr : this->Threads_)
+      thr->WaitForEndNow();
+}
+std::vector<TimerThreadStat> TimerThreadPool::GetStats() const {
+   std::vector<TimerThreadStat> stats;
+   stats.reserve(this->Threads_.size());
+   for (auto& thr : this->Threads_)
+      stats.push_back(thr->GetStat());
+   return stats;
+}
+
+} // namespace fon9
@@ -0,0 +1,84 @@
+﻿/// \file fon9/TimerThreadPool.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_TimerThreadPool_hpp__
+#define __fon9_TimerThreadPool_hpp__
+#include "fon9/Timer.hpp"
+#include "fon9/ConfigParser.hpp"
+#include <vector>
+
+namespace fon9 {
+
+/// \ingroup Thrs
+/// args: "ThreadCount=n|Cpus=List|Queue=Sorted"
+struct fon9_API TimerThreadPoolArgs {
+   /// 若有設定 CpuAffinity, 則每個 TimerThread 會綁定一個固定的 cpu.
+   /// 例如: ThreadCount_=3; CpuAffinity=0,1;
+   ///       則 Thr0=Cpu0; Thr1=Cpu1; Thr2=Cpu0;
+   using CpuAffinity = std::vector<uint32_t>;
+   CpuAffinity    CpuAffinity_;
+   uint32_t       ThreadCount_{1};
+   TimerQueueKind QueueKind_{TimerQueueKind::Sorted};
+
+   TimerThreadPoolArgs() = default;
+
+   int GetCpuAffinity(size_t threadIndex) const {
+      if (CpuAffinity_.empty())
+         return -1;
+      return static_cast<int>(CpuAffinity_[threadIndex % CpuAffinity_.size()]);
+   }
+
+   /// 用 tag, value 設定參數.
+   /// tag         | value
+   /// ------------|------------------------------
+   /// ThreadCount | > 0
+   /// Cpus        | c0, c1, c2 ... 根據 thread index 依序選擇 c0 或 c1 或 c2...
+   /// Queue       | "Sorted" or "Wheel", 參考 TimerQueueKind.
+   ConfigParser::Result OnTagValue(StrView tag, StrView& value);
+};
+
+class fon9_API TimerThreadPool;
+using TimerThreadPoolSP = intrusive_ptr<TimerThreadPool>;
+
+/// \ingroup Thrs
+/// 將 TimerEntry 分散到 N 個 TimerThread(shard).
+/// - 讓不同的子系統(例: FIX session heartbeat、行情 gap 檢查、seed importer)
+///   使用不同的 TimerThread, 避免某個子系統的 OnTimer() 過慢, 延誤了其他子系統的計時.
+/// - TimerEntry 建構時選擇 TimerThread:
+///   - GetThread(index):          由使用者自行指定.
+///   - GetThreadByHash(hashValue): 例: 依照 session id 的 hash 值.
+///   - GetThreadByOwner(owner):   相同的 owner 總是使用相同的 TimerThread.
+/// - 每個 shard 的延遲統計, 使用 GetThread(i)->GetStat() 取得.
+class fon9_API TimerThreadPool : public intrusive_ref_counter<TimerThreadPool> {
+   fon9_NON_COPY_NON_MOVE(TimerThreadPool);
+   using Threads = std::vector<TimerThreadSP>;
+   Threads  Threads_;
+
+public:
+   /// 建立 args.ThreadCount_ 個 TimerThread, 名稱為: name + "." + index;
+   TimerThreadPool(const std::string& name, const TimerThreadPoolArgs& args);
+   ~TimerThreadPool();
+
+   /// 結束全部的 TimerThread.
+   void WaitForEndNow();
+
+   size_t size() const {
+      return this->Threads_.size();
+   }
+   const TimerThreadSP& GetThread(size_t index) const {
+      return this->Threads_[index % this->Threads_.size()];
+   }
+   /// hashValue 可能分布不均(例: 指標值的低位元都是0), 所以先打散再選擇.
+   const TimerThreadSP& GetThreadByHash(size_t hashValue) const {
+      uint64_t h = static_cast<uint64_t>(hashValue) * UINT64_C(0x9E3779B97F4A7C15);
+      return this->GetThread(static_cast<size_t>(h >> 32));
+   }
+   const TimerThreadSP& GetThreadByOwner(const void* owner) const {
+      return this->GetThreadByHash(reinterpret_cast<uintptr_t>(owner));
+   }
+
+   /// 依序取得每個 TimerThread 的統計資料.
+   std::vector<TimerThreadStat> GetStats() const;
+};
+
+} // namespace fon9
+#endif//__fon9_TimerThreadPool_hpp__
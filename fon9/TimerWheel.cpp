@@ -0,0 +1,122 @@
+﻿// \file fon9/TimerWheel.cpp
+//
+// 演算法參考 William Ahern 的 timeout.c (hierarchical timing wheel):
+// - 上層的 node 放在「到期前一格」, 讓 node 在到期前往下層移動.
+// - Advance() 依照經過的時間, 計算每層有哪些格子需要重新安排.
+//
+// \author fonwinz@gmail.com
+#include "fon9/TimerWheel.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace fon9 {
+
+#ifdef _MSC_VER
+static inline unsigned TimerWheel_Fls(uint64_t v) { // v != 0; 傳回最高位 bit 的位置+1;
+   unsigned long idx;
+   _BitScanReverse64(&idx, v);
+   return static_cast<unsigned>(idx) + 1;
+}
+static inline unsigned TimerWheel_Ctz(uint64_t v) { // v != 0;
+   unsigned long idx;
+   _BitScanForward64(&idx, v);
+   return static_cast<unsigned>(idx);
+}
+#else
+static inline unsigned TimerWheel_Fls(uint64_t v) {
+   return 64u - static_cast<unsigned>(__builtin_clzll(v));
+}
+static inline unsigned TimerWheel_Ctz(uint64_t v) {
+   return static_cast<unsigned>(__builtin_ctzll(v));
+}
+#endif
+static inline uint64_t TimerWheel_Rotl(uint64_t v, unsigned n) {
+   n &= 63;
+   return n ? ((v << n) | (v >> (64 - n))) : v;
+}
+static inline uint64_t TimerWheel_Rotr(uint64_t v, unsigned n) {
+   n &= 63;
+   return n ? ((v >> n) | (v << (64 - n))) : v;
+}
+
+void TimerWheel::Schedule(TimerWheelNode& node) {
+   if (node.Expires_ <= this->CurrTick_) {
+      this->Link(node, kExpiredIndex);
+      return;
+   }
+   unsigned level = (TimerWheel_Fls(node.Expires_ - this->CurrTick_) - 1) / kSlotBits;
+   if (level >= kLevelCount)
+      level = kLevelCount - 1;
+   const unsigned slot = kSlotMask & static_cast<unsigned>((node.Expires_ >> (level * kSlotBits)) - (level != 0));
+   this->Link(node, level * kSlotCount + slot);
+   this->Pending_[level] |= (uint64_t{1} << slot);
+}
+
+void TimerWheel::Advance(uint64_t nowTick) {
+   if (nowTick <= this->CurrTick_)
+      return;
+   TimerWheelNode*   todo = nullptr;
+   uint64_t          elapsed = nowTick - this->CurrTick_;
+   for (unsigned level = 0; level < kLevelCount; ++level) {
+      const unsigned shift = level * kSlotBits;
+      uint64_t       pending;
+      if ((elapsed >> shift) > kSlotMask)
+         pending = ~uint64_t{0};
+      else {
+         const unsigned el = static_cast<unsigned>(kSlotMask & (elapsed >> shift));
+         const unsigned oslot = static_cast<unsigned>(kSlotMask & (this->CurrTick_ >> shift));
+         const unsigned nslot = static_cast<unsigned>(kSlotMask & (nowTick >> shift));
+         const uint64_t bits = (uint64_t{1} << el) - 1;
+         pending = TimerWheel_Rotl(bits, oslot);
+         pending |= TimerWheel_Rotr(TimerWheel_Rotl(bits, nslot), el);
+         pending |= uint64_t{1} << nslot;
+      }
+      while (uint64_t slots = (pending & this->Pending_[level])) {
+         const unsigned slot = TimerWheel_Ctz(slots);
+         TimerWheelNode*& head = this->Slots_[level * kSlotCount + slot];
+         // 整串移到 todo, 稍後(CurrTick_ 更新後)再重新安排.
+         TimerWheelNode*  tail = head;
+         while (tail->Next_)
+            tail = tail->Next_;
+         tail->Next_ = todo;
+         todo = head;
+         head = nullptr;
+         this->Pending_[level] &= ~(uint64_t{1} << slot);
+      }
+      if ((pending & 1) == 0) // 此層沒有繞回 slot 0, 所以上層不會前進.
+         break;
+      // 此層繞了一圈, 上層至少前進一格.
+      const uint64_t minElapsed = uint64_t{kSlotCount} << shift;
+      if (elapsed < minElapsed)
+         elapsed = minElapsed;
+   }
+   this->CurrTick_ = nowTick;
+   while (TimerWheelNode* node = todo) {
+      todo = node->Next_;
+      this->Schedule(*node);
+   }
+}
+
+uint64_t TimerWheel::NextTimeout() const {
+   if (this->Slots_[kExpiredIndex])
+      return 0;
+   uint64_t timeout = ~uint64_t{0};
+   uint64_t relmask = 0;
+   for (unsigned level = 0; level < kLevelCount; ++level) {
+      const unsigned shift = level * kSlotBits;
+      if (this->Pending_[level]) {
+         const unsigned slot = static_cast<unsigned>(kSlotMask & (this->CurrTick_ >> shift));
+         // 上層的格子, 是在「到期前一格」, 所以要 +1;
+         uint64_t t = static_cast<uint64_t>(TimerWheel_Ctz(TimerWheel_Rotr(this->Pending_[level], slot)) + (level != 0)) << shift;
+         // 扣除下層已經前進的時間.
+         t -= (relmask & this->CurrTick_);
+         if (timeout > t)
+            timeout = t;
+      }
+      relmask = (relmask << kSlotBits) | kSlotMask;
+   }
+   return timeout;
+}
+
+} // namespace fon9
@@ -0,0 +1,130 @@
+﻿/// \file fon9/TimerWheel.hpp
+///
+/// 階層式計時輪(hierarchical timing wheel), 提供 TimerThread 在大量 timer 時使用.
+/// - 時間單位(tick) = TimeStamp 的最小單位(us).
+/// - 每層 64 格, 共 kLevelCount 層: 第 n 層每格代表 64^n ticks;
+///   超過最上層範圍的 node, 放在最上層, 輪到時再重新安排.
+/// - Add()、Remove(): O(1);
+/// - Advance(): 將到期(或需要往下層移動)的 node 重新安排, 到期的 node 可用 PopExpired() 取出.
+/// - 同一次 Advance() 到期的 node, 取出的順序不一定依照到期時間.
+/// - 不是 thread safe, 由使用者負責保護.
+///
+/// \author fonwinz@gmail.com
+#ifndef __fon9_TimerWheel_hpp__
+#define __fon9_TimerWheel_hpp__
+#include "fon9/TimeStamp.hpp"
+
+namespace fon9 {
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Thrs
+/// 放在 TimerWheel 的 node(intrusive list), 通常作為 data member.
+struct TimerWheelNode {
+   TimerWheelNode*   Next_{nullptr};
+   /// nullptr 表示: 沒有在 TimerWheel 裡面.
+   TimerWheelNode**  PPrev_{nullptr};
+   uint64_t          Expires_{0};
+   uint16_t          SlotIndex_{0};
+
+   bool IsLinked() const {
+      return this->PPrev_ != nullptr;
+   }
+};
+
+/// \ingroup Thrs
+/// 階層式計時輪, 請參考 fon9/TimerWheel.hpp 的說明.
+class fon9_API TimerWheel {
+   fon9_NON_COPY_NON_MOVE(TimerWheel);
+public:
+   enum : unsigned {
+      kSlotBits = 6,
+      kSlotCount = (1u << kSlotBits),
+      kSlotMask = kSlotCount - 1,
+      /// 6 層 = 2^36 us, 約 19 小時.
+      kLevelCount = 6,
+      kWheelSlotCount = kLevelCount * kSlotCount,
+      /// 已到期的 node 放在 Slots_[kExpiredIndex];
+      kExpiredIndex = kWheelSlotCount,
+   };
+
+   explicit TimerWheel(uint64_t currTick) : CurrTick_{currTick} {
+   }
+
+   /// TimeStamp 轉成 tick, 若 ts <= 0 (包含 Null) 則傳回 0, 表示立即到期.
+   static uint64_t ToTick(TimeStamp ts) {
+      return ts.GetOrigValue() > 0 ? static_cast<uint64_t>(ts.GetOrigValue()) : 0u;
+   }
+
+   /// node 必須沒有在 TimerWheel 裡面.
+   /// 若 expires <= GetCurrTick() 則直接放到「已到期」, 等候 PopExpired() 取出.
+   void Add(TimerWheelNode& node, uint64_t expires) {
+      assert(!node.IsLinked());
+      node.Expires_ = expires;
+      ++this->Count_;
+      this->Schedule(node);
+   }
+   /// node 必須在此 TimerWheel 裡面.
+   void Remove(TimerWheelNode& node) {
+      assert(node.IsLinked());
+      this->Unlink(node);
+      --this->Count_;
+   }
+
+   /// 前進到 nowTick, 將到期(或需要往下層移動)的 node 重新安排.
+   /// 若 nowTick <= GetCurrTick() 則不做任何事.
+   void Advance(uint64_t nowTick);
+
+   /// 取出一個已到期的 node(已從 TimerWheel 移除), 若沒有則傳回 nullptr.
+   TimerWheelNode* PopExpired() {
+      TimerWheelNode* node = this->Slots_[kExpiredIndex];
+      if (node)
+         this->Remove(*node);
+      return node;
+   }
+
+   /// 從現在(GetCurrTick())到下次需要 Advance() 的 ticks:
+   /// - 若有已到期的 node, 則傳回 0;
+   /// - 若沒有任何 node, 則傳回 UINT64_MAX;
+   /// - 若最近的 node 在上層, 則傳回的是該格需要往下層移動的時間, 此時 Advance() 不一定會有到期的 node.
+   uint64_t NextTimeout() const;
+
+   uint64_t GetCurrTick() const {
+      return this->CurrTick_;
+   }
+   size_t size() const {
+      return this->Count_;
+   }
+   bool empty() const {
+      return this->Count_ == 0;
+   }
+
+private:
+   TimerWheelNode*   Slots_[kWheelSlotCount + 1] = {};
+   /// 每層 64 格, 有 node 的格子, 對應的 bit = 1;
+   uint64_t          Pending_[kLevelCount] = {};
+   uint64_t          CurrTick_;
+   size_t            Count_{0};
+
+   void Link(TimerWheelNode& node, unsigned idx) {
+      TimerWheelNode*& head = this->Slots_[idx];
+      if ((node.Next_ = head) != nullptr)
+         head->PPrev_ = &node.Next_;
+      head = &node;
+      node.PPrev_ = &head;
+      node.SlotIndex_ = static_cast<uint16_t>(idx);
+   }
+   void Unlink(TimerWheelNode& node) {
+      if ((*node.PPrev_ = node.Next_) != nullptr)
+         node.Next_->PPrev_ = node.PPrev_;
+      const unsigned idx = node.SlotIndex_;
+      if (idx < kWheelSlotCount && this->Slots_[idx] == nullptr)
+         this->Pending_[idx / kSlotCount] &= ~(uint64_t{1} << (idx % kSlotCount));
+      node.Next_ = nullptr;
+      node.PPrev_ = nullptr;
+   }
+   void Schedule(TimerWheelNode& node);
+};
+fon9_WARN_POP;
+
+} // namespace fon9
+#endif//__fon9_TimerWheel_hpp__
@@ -1,8 +1,10 @@
 ﻿// \file fon9/Timer_UT.cpp
 // \author fonwinz@gmail.com
 #include "fon9/Timer.hpp"
+#include "fon9/TimerThreadPool.hpp"
 #include "fon9/TestTools.hpp"
 #include "fon9/RevPrint.hpp"
+#include <random>
 
 // 壓力測試方法:
 // - 建立4個 thread
@@ -118,8 +120,10 @@ fon9_WARN_POP;
 
 //--------------------------------------------------------------------------//
 
-void TestTimerThread() {
-   fon9::TimerThreadSP timerThread{new fon9::TimerThread{"TestTimerThread"}};
+void TestTimerThread(fon9::TimerQueueKind queueKind) {
+   std::cout << "TimerQueueKind=" << (queueKind == fon9::TimerQueueKind::Wheel ? "Wheel" : "Sorted") << std::endl;
+   gOnTimerTimes = gSessionCount = gSessionDtor = gUnderOnTimer = gOverOnTimer = gOverBegin = gDtorInTimerThread = 0;
+   fon9::TimerThreadSP timerThread{new fon9::TimerThread{"TestTimerThread", queueKind}};
    gTimerThread = timerThread.get();
 
    std::thread thrs[4];
@@ -179,9 +183,141 @@ void TestTimerThread() {
 
 //--------------------------------------------------------------------------//
 
+// 隨機加入、移除、前進, 檢查 TimerWheel 取出的 node: 不可提早, 也不可遺漏(延遲).
+void TestTimerWheel() {
+   std::mt19937_64   rnd{static_cast<uint64_t>(fon9::UtcNow().GetOrigValue())};
+   uint64_t          now = fon9::TimerWheel::ToTick(fon9::UtcNow());
+   fon9::TimerWheel  wheel{now};
+   std::vector<fon9::TimerWheelNode> nodes(3000);
+   auto fnAdd = [&](fon9::TimerWheelNode& node) {
+      switch (rnd() % 4) {
+      case 0:  wheel.Add(node, now + rnd() % 100);                   break; // 第0層.
+      case 1:  wheel.Add(node, now + rnd() % (uint64_t{1} << 40));   break; // 超過最上層.
+      default: wheel.Add(node, now + rnd() % 10000000);              break;
+      }
+   };
+   for (auto& node : nodes)
+      fnAdd(node);
+   uint64_t emitCount = 0, removedCount = 0;
+   for (unsigned L = 0; L < 20000 && !wheel.empty(); ++L) {
+      const uint64_t ticks = wheel.NextTimeout();
+      now += (rnd() % 50 == 0) ? (rnd() % (uint64_t{1} << 33)) : (ticks ? (rnd() % ticks + 1) : 0);
+      wheel.Advance(now);
+      while (fon9::TimerWheelNode* node = wheel.PopExpired()) {
+         if (node->Expires_ > now) {
+            std::cout << "[ERROR] TimerWheel|err=emit too early|expires=" << node->Expires_ << "|now=" << now << std::endl;
+            abort();
+         }
+         ++emitCount;
+         if (L < 10000) // 前半段: 到期後再加入.
+            fnAdd(*node);
+      }
+      for (auto& node : nodes) {
+         if (node.IsLinked() && node.Expires_ <= now) {
+            std::cout << "[ERROR] TimerWheel|err=missing|expires=" << node.Expires_ << "|now=" << now << std::endl;
+            abort();
+         }
+      }
+      if (rnd() % 10 == 0) {
+         fon9::TimerWheelNode& node = nodes[rnd() % nodes.size()];
+         if (node.IsLinked()) {
+            wheel.Remove(node);
+            ++removedCount;
+         }
+      }
+   }
+   std::cout << "[OK   ] TimerWheel|emit=" << emitCount << "|removed=" << removedCount << "|remain=" << wheel.size() << std::endl;
+}
+
+//--------------------------------------------------------------------------//
+void TestTimerThreadPool() {
+   std::cout << "[TEST ] TimerThreadPoolArgs";
+   fon9::TimerThreadPoolArgs  args;
+   fon9::RevBufferList        rbuf{128};
+   if (!fon9::ParseConfig(args, "ThreadCount=3|Cpus=0|Queue=Wheel", rbuf)
+       || args.ThreadCount_ != 3 || args.QueueKind_ != fon9::TimerQueueKind::Wheel
+       || args.GetCpuAffinity(2) != 0) {
+      std::cout << "|err=" << fon9::BufferTo<std::string>(rbuf.MoveOut()) << "\r[ERROR]" << std::endl;
+      abort();
+   }
+   if (fon9::ParseConfig(args, "Queue=Unknown", rbuf)) {
+      std::cout << "|err=Queue=Unknown must fail.\r[ERROR]" << std::endl;
+      abort();
+   }
+   rbuf.MoveOut();
+   std::cout << "\r[OK   ]" << std::endl;
+
+   std::cout << "[TEST ] TimerThreadPool";
+   args.CpuAffinity_.clear();
+   fon9::TimerThreadPool pool{"UT.TimerPool", args};
+   // 相同的 owner 必定使用相同的 TimerThread; 不同的 owner 應能分散到每個 TimerThread.
+   std::vector<unsigned> counts(pool.size());
+   std::vector<char>     owners(256);
+   for (auto& owner : owners) {
+      const fon9::TimerThreadSP& thr = pool.GetThreadByOwner(&owner);
+      if (thr != pool.GetThreadByOwner(&owner)) {
+         std::cout << "|err=GetThreadByOwner() not stable.\r[ERROR]" << std::endl;
+         abort();
+      }
+      for (size_t L = 0; L < pool.size(); ++L) {
+         if (pool.GetThread(L) == thr)
+            ++counts[L];
+      }
+   }
+   for (unsigned c : counts) {
+      if (c == 0) {
+         std::cout << "|err=GetThreadByOwner() not spread.\r[ERROR]" << std::endl;
+         abort();
+      }
+   }
+   // shard[0] 的 OnTimer() 很慢, 不應該延誤 shard[1] 的 timer.
+   struct SlowTimer : public fon9::DataMemberTimer {
+      fon9_NON_COPY_NON_MOVE(SlowTimer);
+      using DataMemberTimer::DataMemberTimer;
+      void EmitOnTimer(fon9::TimeStamp) override {
+         std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      }
+   };
+   struct FastTimer : public fon9::DataMemberTimer {
+      fon9_NON_COPY_NON_MOVE(FastTimer);
+      using DataMemberTimer::DataMemberTimer;
+      std::atomic<bool> Fired_{false};
+      void EmitOnTimer(fon9::TimeStamp) override {
+         this->Fired_ = true;
+      }
+   };
+   SlowTimer slow{pool.GetThread(0)};
+   FastTimer fast{pool.GetThread(1)};
+   slow.RunAfter(fon9::TimeInterval_Millisecond(1));
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   fast.RunAfter(fon9::TimeInterval_Millisecond(10));
+   for (unsigned L = 0; L < 100 && !fast.Fired_; ++L)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+   slow.DisposeAndWait();
+   fast.DisposeAndWait();
+   std::vector<fon9::TimerThreadStat> stats = pool.GetStats();
+   std::cout << "|lag.max[0]=" << stats[0].LagMax_.ToDuration().count()
+             << "|lag.max[1]=" << stats[1].LagMax_.ToDuration().count();
+   if (!fast.Fired_ || stats[0].EmitCount_ != 1 || stats[1].EmitCount_ != 1 || stats[2].EmitCount_ != 0
+       || stats[1].LagMax_ > fon9::TimeInterval_Millisecond(200)) {
+      std::cout << "\r[ERROR]" << std::endl;
+      abort();
+   }
+   std::cout << "\r[OK   ]" << std::endl;
+}
+
 int main() {
    fon9::AutoPrintTestInfo utinfo{"Timer"};
-   TestTimerThread();
+   TestTimerWheel();
+
+   utinfo.PrintSplitter();
+   TestTimerThread(fon9::TimerQueueKind::Sorted);
+
+   utinfo.PrintSplitter();
+   TestTimerThread(fon9::TimerQueueKind::Wheel);
+
+   utinfo.PrintSplitter();
+   TestTimerThreadPool();
 
    // 測試在 main() 結束後, DefaultTimerThread 是否能正常結束.
    fon9::GetDefaultTimerThread();
@@ -0,0 +1,370 @@
+﻿// \file fon9/WorkStealingPool.cpp
+// \author fonwinz@gmail.com
+#define _CRT_SECURE_NO_WARNINGS  // Windows: getenv()
+#include "fon9/WorkStealingPool.hpp"
+#include "fon9/buffer/MemBlock.hpp"
+#include "fon9/buffer/RevBufferList.hpp"
+#include "fon9/sys/OnWindowsMainExit.hpp"
+#include "fon9/ThreadTools.hpp"
+#include "fon9/Tools.hpp"
+#include "fon9/StrTo.hpp"
+#include "fon9/StrTools.hpp"
+#include "fon9/Log.hpp"
+#include <algorithm>
+
+namespace fon9 {
+
+ConfigParser::Result WorkStealingPoolArgs::OnTagValue(StrView tag, StrView& value) {
+   const char* pvalbeg = value.begin();
+   if (tag == "ThreadCount") {
+      if ((this->ThreadCount_ = StrTo(value, 0u)) <= 0) {
+         this->ThreadCount_ = 1;
+         value.SetBegin(pvalbeg);
+         return ConfigParser::Result::EValueTooSmall;
+      }
+   }
+   else if (tag == "Capacity") {
+      if ((this->Capacity_ = StrTo(value, 0u)) <= 0) {
+         this->Capacity_ = WorkStealingPoolArgs{}.Capacity_;
+         value.SetBegin(pvalbeg);
+         return ConfigParser::Result::EValueTooSmall;
+      }
+   }
+   else if (tag == "Cpus") {
+      while (!value.empty()) {
+         StrView v1 = StrFetchTrim(value, ',');
+         if (v1.empty())
+            continue;
+         const char* pend;
+         int n = StrTo(v1, -1, &pend);
+         if (n < 0) {
+            value.SetBegin(v1.begin());
+            return ConfigParser::Result::EInvalidValue;
+         }
+         if (pend != v1.end()) {
+            value.SetBegin(pend);
+            return ConfigParser::Result::EInvalidValue;
+         }
+         this->CpuAffinity_.push_back(static_cast<uint32_t>(n));
+      }
+   }
+   else
+      return ConfigParser::Result::EUnknownTag;
+   return ConfigParser::Result::Success;
+}
+
+//--------------------------------------------------------------------------//
+
+/// 使用 MemBlock 分配: MemBlock 為每個 thread 提供 cache,
+/// 適合 [Thread A 建立工作, Thread B 執行後釋放] 的情況.
+struct WorkStealingPool::WorkNode {
+   fon9_NON_COPY_NON_MOVE(WorkNode);
+   WorkTask       Task_;
+   MemBlockSize   BlockSize_;
+
+   WorkNode(WorkTask&& task, MemBlockSize blockSize)
+      : Task_{std::move(task)}
+      , BlockSize_{blockSize} {
+   }
+   static WorkNode* Make(WorkTask&& task) {
+      MemBlock mblk;
+      if (mblk.Alloc(sizeof(WorkNode)) == nullptr)
+         throw std::bad_alloc{};
+      const MemBlockSize blockSize = mblk.size();
+      return new (mblk.Release()) WorkNode{std::move(task), blockSize};
+   }
+   static void Free(WorkNode* node) {
+      const MemBlockSize blockSize = node->BlockSize_;
+      node->~WorkNode();
+      MemBlock::FreeBlock(node, blockSize);
+   }
+};
+
+struct WorkStealingPool::Worker {
+   fon9_NON_COPY_NON_MOVE(Worker);
+   using Inbox = std::vector<WorkNode*>;
+
+   WorkStealingPool&             Owner_;
+   const uint32_t                Index_;
+   WorkStealingDeque<WorkNode*>  Deque_;
+   /// 由其他 thread 加入的工作.
+   std::mutex                    InboxMutex_;
+   Inbox                         Inbox_;
+   /// Inbox_.size(); 讓 worker 不用 lock 就能判斷 inbox 是否有工作.
+   std::atomic<size_t>           InboxSize_{0};
+   std::thread                   Thread_;
+
+   Worker(WorkStealingPool& owner, uint32_t index, size_t capacity)
+      : Owner_(owner)
+      , Index_{index}
+      , Deque_{capacity} {
+   }
+};
+
+/// 目前 thread 所屬的 WorkStealingPool::Worker;
+static thread_local void* CurrWorker_;
+
+WorkStealingPool::WorkStealingPool() {
+}
+WorkStealingPool::~WorkStealingPool() {
+   this->WaitForEndNow();
+}
+void WorkStealingPool::StartThread(const WorkStealingPoolArgs& args, StrView thrName) {
+   assert(this->Workers_.empty() && this->GetThreadState() == ThreadState::Idle);
+   const uint32_t count = (args.ThreadCount_ <= 0 ? 1u : args.ThreadCount_);
+   this->Workers_.reserve(count);
+   for (uint32_t L = 0; L < count; ++L)
+      this->Workers_.emplace_back(new Worker{*this, L, args.Capacity_});
+   this->State_.store(ThreadState::ExecutingOrWaiting, std::memory_order_release);
+
+   RevBufferFixedSize<1024> rbuf;
+   for (uint32_t L = 0; L < count; ++L) {
+      rbuf.Rewind();
+      RevPrint(rbuf, thrName, "|indexInPool=", L + 1);
+      Worker& worker = *this->Workers_[L];
+      worker.Thread_ = std::thread(&WorkStealingPool::ThrRun, this, std::ref(worker),
+                                   rbuf.ToStrT<std::string>(), args.GetCpuAffinity(L));
+   }
+}
+
+ThreadState WorkStealingPool::AddTask(WorkTask&& task) {
+   struct AddingGuard {
+      fon9_NON_COPY_NON_MOVE(AddingGuard);
+      std::atomic<uint32_t>& Count_;
+      AddingGuard(std::atomic<uint32_t>& count) : Count_(count) {
+         count.fetch_add(1, std::memory_order_seq_cst);
+      }
+      ~AddingGuard() {
+         this->Count_.fetch_sub(1, std::memory_order_release);
+      }
+   };
+   // 必須先增加 AddingCount_ 再檢查 State_: 與 NotifyEnd() 改變 State_ 之後, JoinAndClear() 檢查 AddingCount_ 對應;
+   // 如此, 若這裡看到的是 ExecutingOrWaiting, 則 JoinAndClear() 必定會等這裡放入完畢, 才清除剩餘的工作.
+   AddingGuard       adding{this->AddingCount_};
+   const ThreadState st = this->State_.load(std::memory_order_seq_cst);
+   if (fon9_UNLIKELY(st != ThreadState::ExecutingOrWaiting))
+      return st;
+   WorkNode* node = WorkNode::Make(std::move(task));
+   // 必須在放入 deque 或 inbox 之前增加 PendingCount_,
+   // 讓準備睡眠的 worker 可以發現有新工作.
+   this->PendingCount_.fetch_add(1, std::memory_order_seq_cst);
+   Worker* curr = static_cast<Worker*>(CurrWorker_);
+   if (curr == nullptr || &curr->Owner_ != this || !curr->Deque_.Push(node)) {
+      Worker& dst = *this->Workers_[this->InboxSelector_.fetch_add(1, std::memory_order_relaxed) % this->Workers_.size()];
+      std::lock_guard<std::mutex> lk{dst.InboxMutex_};
+      dst.Inbox_.push_back(node);
+      dst.InboxSize_.store(dst.Inbox_.size(), std::memory_order_release);
+   }
+   if (this->SleepingCount_.load(std::memory_order_seq_cst) > 0)
+      this->WakeupWorkers(false);
+   return ThreadState::ExecutingOrWaiting;
+}
+void WorkStealingPool::WakeupWorkers(bool isAll) {
+   {
+      std::lock_guard<std::mutex> lk{this->SleepMutex_};
+      ++this->WakeSeqNo_;
+   }
+   if (isAll)
+      this->SleepCV_.notify_all();
+   else
+      this->SleepCV_.notify_one();
+}
+
+WorkStealingPool::WorkNode* WorkStealingPool::OnNodeTaken(WorkNode* node) {
+   // 先增加 ExecutingCount_ 再減少 PendingCount_, 避免 GetBusyCount() 短暫為 0.
+   this->ExecutingCount_.fetch_add(1, std::memory_order_relaxed);
+   this->PendingCount_.fetch_sub(1, std::memory_order_release);
+   return node;
+}
+WorkStealingPool::WorkNode* WorkStealingPool::MoveInbox(Worker& src, Worker& dst, size_t maxCount) {
+   Worker::Inbox& inbox = src.Inbox_;
+   const size_t   room = dst.Deque_.capacity() - dst.Deque_.size() + 1;
+   const size_t   count = std::min(std::min(inbox.size(), maxCount), room);
+   if (count <= 0)
+      return nullptr;
+   // inbox[0] 最早加入: 直接執行;
+   // 其餘的反向放入 deque, 讓 Pop() 依照加入的順序取出.
+   WorkNode* node = inbox[0];
+   for (size_t L = count; L > 1;) {
+      const bool isPushed = dst.Deque_.Push(inbox[--L]);
+      assert(isPushed); (void)isPushed;
+   }
+   inbox.erase(inbox.begin(), inbox.begin() + static_cast<Worker::Inbox::difference_type>(count));
+   src.InboxSize_.store(inbox.size(), std::memory_order_release);
+   return node;
+}
+WorkStealingPool::WorkNode* WorkStealingPool::TakeNode(Worker& worker) {
+   WorkNode* node;
+   if (worker.Deque_.Pop(node))
+      return this->OnNodeTaken(node);
+   if (worker.InboxSize_.load(std::memory_order_acquire) > 0) {
+      std::lock_guard<std::mutex> lk{worker.InboxMutex_};
+      if ((node = this->MoveInbox(worker, worker, worker.Inbox_.size())) != nullptr)
+         return this->OnNodeTaken(node);
+   }
+   return this->StealNode(worker);
+}
+WorkStealingPool::WorkNode* WorkStealingPool::StealNode(Worker& worker) {
+   const size_t count = this->Workers_.size();
+   WorkNode*    node;
+   for (size_t L = 1; L < count; ++L) {
+      Worker& victim = *this->Workers_[(worker.Index_ + L) % count];
+      if (victim.Deque_.Steal(node))
+         return this->OnNodeTaken(node);
+   }
+   // 其他 worker 可能正在執行較久的工作, 所以也從他們的 inbox 取出工作.
+   for (size_t L = 1; L < count; ++L) {
+      Worker& victim = *this->Workers_[(worker.Index_ + L) % count];
+      if (victim.InboxSize_.load(std::memory_order_acquire) <= 0)
+         continue;
+      std::unique_lock<std::mutex> lk{victim.InboxMutex_, std::try_to_lock};
+      if (!lk.owns_lock())
+         continue;
+      // 取走一半, 剩下的留給 victim 及其他 worker.
+      if ((node = this->MoveInbox(victim, worker, (victim.Inbox_.size() + 1) / 2)) != nullptr)
+         return this->OnNodeTaken(node);
+   }
+   return nullptr;
+}
+void WorkStealingPool::ExecuteNode(WorkNode* node) {
+   node->Task_();
+   WorkNode::Free(node);
+   this->ExecutingCount_.fetch_sub(1, std::memory_order_release);
+}
+
+void WorkStealingPool::ThrRun(Worker& worker, std::string thrName, int cpuAffinity) {
+   if (gWaitLogSystemReady)
+      gWaitLogSystemReady();
+   Result3 cpuResult = SetCpuAffinity(cpuAffinity);
+   fon9_LOG_ThrRun("WorkStealingPool.ThrRun|name=", thrName, "|Cpu=", cpuAffinity, ':', cpuResult);
+   CurrWorker_ = &worker;
+   for (;;) {
+      if (WorkNode* node = this->TakeNode(worker)) {
+         this->ExecuteNode(node);
+         continue;
+      }
+      const ThreadState st = this->State_.load(std::memory_order_acquire);
+      if (st >= ThreadState::EndNow)
+         break;
+      if (st == ThreadState::EndAfterWorkDone && this->PendingCount_.load(std::memory_order_acquire) <= 0)
+         break;
+      uint64_t seqno;
+      {
+         std::lock_guard<std::mutex> lk{this->SleepMutex_};
+         seqno = this->WakeSeqNo_;
+      }
+      this->SleepingCount_.fetch_add(1, std::memory_order_seq_cst);
+      if (this->PendingCount_.load(std::memory_order_seq_cst) > 0
+          || this->State_.load(std::memory_order_seq_cst) != st) {
+         // 有工作尚未取出: 可能正在放入 deque(或 inbox)的途中, 稍後再試.
+         this->SleepingCount_.fetch_sub(1, std::memory_order_relaxed);
+         std::this_thread::yield();
+         continue;
+      }
+      {
+         std::unique_lock<std::mutex> lk{this->SleepMutex_};
+         this->SleepCV_.wait(lk, [this, seqno]() { return seqno != this->WakeSeqNo_; });
+      }
+      this->SleepingCount_.fetch_sub(1, std::memory_order_relaxed);
+   }
+   CurrWorker_ = nullptr;
+   fon9_LOG_ThrRun("WorkStealingPool.ThrRun.End|name=", thrName);
+}
+
+size_t WorkStealingPool::ClearRemainTasks(bool isRun) {
+   size_t count = 0;
+   for (WorkerSP& worker : this->Workers_) {
+      Worker::Inbox inbox;
+      {
+         std::lock_guard<std::mutex> lk{worker->InboxMutex_};
+         inbox.swap(worker->Inbox_);
+         worker->InboxSize_.store(0, std::memory_order_release);
+      }
+      WorkNode* node;
+      while (worker->Deque_.Steal(node))
+         inbox.push_back(node);
+      for (WorkNode* n : inbox) {
+         this->PendingCount_.fetch_sub(1, std::memory_order_relaxed);
+         if (isRun) {
+            this->ExecutingCount_.fetch_add(1, std::memory_order_relaxed);
+            this->ExecuteNode(n);
+         }
+         else
+            WorkNode::Free(n);
+      }
+      count += inbox.size();
+   }
+   return count;
+}
+void WorkStealingPool::NotifyEnd(ThreadState st) {
+   ThreadState curr = this->State_.load(std::memory_order_acquire);
+   do {
+      if (curr >= st)
+         return;
+   } while (!this->State_.compare_exchange_weak(curr, st, std::memory_order_seq_cst));
+   this->WakeupWorkers(true);
+}
+void WorkStealingPool::JoinAndClear(bool isRun) {
+   for (WorkerSP& worker : this->Workers_)
+      JoinThread(worker->Thread_);
+   // 在 State_ 改變前就已通過檢查的 AddTask(), 可能還在放入 inbox 的途中, 等它們完成後再清除.
+   while (this->AddingCount_.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+   this->ClearRemainTasks(isRun);
+   this->State_.store(ThreadState::Terminated, std::memory_order_release);
+}
+void WorkStealingPool::NotifyForEndNow() {
+   this->NotifyEnd(ThreadState::EndNow);
+}
+void WorkStealingPool::WaitForEndNow() {
+   this->NotifyEnd(ThreadState::EndNow);
+   this->JoinAndClear(false);
+}
+void WorkStealingPool::WaitForEndAfterWorkDone() {
+   this->NotifyEnd(ThreadState::EndAfterWorkDone);
+   this->JoinAndClear(true);
+}
+
+//--------------------------------------------------------------------------//
+
+fon9_API WorkStealingPool& GetDefaultWorkPool() {
+   struct DefaultWorkPoolImpl : public WorkStealingPool, sys::OnWindowsMainExitHandle {
+      fon9_NON_COPY_NON_MOVE(DefaultWorkPoolImpl);
+      DefaultWorkPoolImpl() {
+         // 目前有用到的地方:
+         //  - Device 執行 OpQueue_
+         //  - AsyncFileAppender(log file)
+         //  - InnDbf
+         // 以上的工作都是: 低 CPU 用量, 時間短, 但需要快速回應.
+         WorkStealingPoolArgs args;
+         if (const char* envArgs = getenv("fon9_DefaultWorkPool")) {
+            // 設定有誤的部分, 使用預設值.
+            RevBufferList rbuf{128};
+            ParseConfig(args, StrView_cstr(envArgs), rbuf);
+         }
+         this->StartThread(args, "fon9.DefaultWorkPool");
+      }
+      void OnWindowsMainExit_Notify() {
+         this->NotifyForEndNow();
+      }
+      void OnWindowsMainExit_ThreadJoin() {
+         this->WaitForEndNow();
+      }
+   };
+   static DefaultWorkPoolImpl WorkPool_;
+   return WorkPool_;
+}
+
+fon9_API void WaitWorkPoolQuit(WorkStealingPool& thrPool, unsigned waitTimes, TimeInterval tiSleep) {
+   if (thrPool.GetThreadState() == ThreadState::ExecutingOrWaiting) {
+      for (; waitTimes > 0; --waitTimes) {
+         while (thrPool.GetBusyCount() > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         std::this_thread::sleep_for(tiSleep.ToDuration());
+      }
+   }
+   // 在 WaitForEndAfterWorkDone() 裡面會把剩餘工作做完, 避免 memory leak.
+   thrPool.WaitForEndAfterWorkDone();
+}
+
+} // namespaces
@@ -0,0 +1,358 @@
+﻿/// \file fon9/WorkStealingPool.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_WorkStealingPool_hpp__
+#define __fon9_WorkStealingPool_hpp__
+#include "fon9/ThreadController.hpp"
+#include "fon9/ConfigParser.hpp"
+#include "fon9/TimeInterval.hpp"
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+
+namespace fon9 {
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup Thrs
+/// 在 WorkStealingPool 執行的單一作業.
+/// - 取代 std::function<void()>: 較小的 callable(例: 捕捉一個 intrusive_ptr 的 lambda),
+///   直接放在 WorkTask 裡面, 不用另外分配記憶體.
+/// - 只能移動, 不能複製.
+class WorkTask {
+   fon9_NON_COPYABLE(WorkTask);
+public:
+   enum : size_t {
+      /// 小於等於此大小的 callable, 直接放在 WorkTask 裡面.
+      kInlineSize = sizeof(void*) * 6
+   };
+
+   WorkTask() = default;
+   template <class FnT, class Fn = decay_t<FnT>,
+      class = enable_if_t<!std::is_same<Fn, WorkTask>::value>>
+   WorkTask(FnT&& fn) {
+      this->Emplace<Fn>(std::forward<FnT>(fn), std::integral_constant<bool, IsInline<Fn>()>{});
+   }
+   WorkTask(WorkTask&& rhs) {
+      rhs.MoveTo(*this);
+   }
+   WorkTask& operator=(WorkTask&& rhs) {
+      if (this != &rhs) {
+         this->reset();
+         rhs.MoveTo(*this);
+      }
+      return *this;
+   }
+   ~WorkTask() {
+      this->reset();
+   }
+
+   explicit operator bool() const {
+      return this->Ops_ != nullptr;
+   }
+   void operator()() {
+      assert(this->Ops_ != nullptr);
+      this->Ops_->Invoke_(&this->Buffer_);
+   }
+   void reset() {
+      if (const Ops* ops = this->Ops_) {
+         this->Ops_ = nullptr;
+         ops->Destroy_(&this->Buffer_);
+      }
+   }
+
+   template <class Fn>
+   static constexpr bool IsInline() {
+      return sizeof(Fn) <= kInlineSize
+         && alignof(Fn) <= alignof(Buffer)
+         && std::is_nothrow_move_constructible<Fn>::value;
+   }
+
+private:
+   using Buffer = typename std::aligned_storage<kInlineSize>::type;
+   struct Ops {
+      void (*Invoke_)(void* buf);
+      /// 移動到 dst, 並解構 src.
+      void (*Move_)(void* dst, void* src);
+      void (*Destroy_)(void* buf);
+   };
+   template <class Fn>
+   struct InlineOps {
+      static void Invoke(void* buf) {
+         (*static_cast<Fn*>(buf))();
+      }
+      static void Move(void* dst, void* src) {
+         new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+         static_cast<Fn*>(src)->~Fn();
+      }
+      static void Destroy(void* buf) {
+         static_cast<Fn*>(buf)->~Fn();
+      }
+      static const Ops* Get() {
+         static const Ops ops{&Invoke, &Move, &Destroy};
+         return &ops;
+      }
+   };
+   template <class Fn>
+   struct HeapOps {
+      static void Invoke(void* buf) {
+         (**static_cast<Fn**>(buf))();
+      }
+      static void Move(void* dst, void* src) {
+         *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+      }
+      static void Destroy(void* buf) {
+         delete *static_cast<Fn**>(buf);
+      }
+      static const Ops* Get() {
+         static const Ops ops{&Invoke, &Move, &Destroy};
+         return &ops;
+      }
+   };
+
+   template <class Fn, class FnT>
+   void Emplace(FnT&& fn, std::true_type /*isInline*/) {
+      new (&this->Buffer_) Fn(std::forward<FnT>(fn));
+      this->Ops_ = InlineOps<Fn>::Get();
+   }
+   template <class Fn, class FnT>
+   void Emplace(FnT&& fn, std::false_type /*isInline*/) {
+      *reinterpret_cast<Fn**>(&this->Buffer_) = new Fn(std::forward<FnT>(fn));
+      this->Ops_ = HeapOps<Fn>::Get();
+   }
+   void MoveTo(WorkTask& dst) {
+      assert(dst.Ops_ == nullptr);
+      if ((dst.Ops_ = this->Ops_) != nullptr) {
+         this->Ops_->Move_(&dst.Buffer_, &this->Buffer_);
+         this->Ops_ = nullptr;
+      }
+   }
+
+   const Ops*  Ops_{nullptr};
+   Buffer      Buffer_;
+};
+
+/// \ingroup Thrs
+/// Chase-Lev work stealing deque(固定容量).
+/// - 只有 owner thread 可以呼叫 Push(), Pop(): 從 bottom 端 push/pop (LIFO).
+/// - 其他 thread 使用 Steal(): 從 top 端取出 (FIFO).
+/// - T 必須是 trivially copyable, 通常是指標.
+/// - 參考: "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al, PPoPP 2013.
+template <class T>
+class WorkStealingDeque {
+   fon9_NON_COPY_NON_MOVE(WorkStealingDeque);
+   static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque<T>: T must be trivially copyable.");
+   using Index = int64_t;
+   using Slot = std::atomic<T>;
+   enum : size_t { kCacheLineSize = 64 };
+   // Top_(thieves) 與 Bottom_(owner) 放在不同的 cache line, 避免 false sharing.
+   // 因 C++11 的 new 不支援 alignas(64), 所以使用 padding.
+   std::atomic<Index>               Top_{0};
+   char                             PaddingTop_[kCacheLineSize - sizeof(std::atomic<Index>)];
+   std::atomic<Index>               Bottom_{0};
+   char                             PaddingBottom_[kCacheLineSize - sizeof(std::atomic<Index>)];
+   const Index                      Mask_;
+   std::unique_ptr<Slot[]>          Slots_;
+
+public:
+   /// capacity 會調整成 2 的冪次.
+   explicit WorkStealingDeque(size_t capacity)
+      : Mask_{static_cast<Index>(CeilPow2(capacity < 2 ? 2 : capacity) - 1)}
+      , Slots_{new Slot[static_cast<size_t>(Mask_ + 1)]} {
+   }
+
+   size_t capacity() const {
+      return static_cast<size_t>(this->Mask_ + 1);
+   }
+   /// 僅供參考, 在多 thread 環境下可能已經改變.
+   size_t size() const {
+      const Index b = this->Bottom_.load(std::memory_order_relaxed);
+      const Index t = this->Top_.load(std::memory_order_relaxed);
+      return b > t ? static_cast<size_t>(b - t) : 0u;
+   }
+   bool empty() const {
+      return this->size() == 0;
+   }
+
+   /// 只能在 owner thread 呼叫.
+   /// \retval false 已滿.
+   bool Push(T item) {
+      const Index b = this->Bottom_.load(std::memory_order_relaxed);
+      const Index t = this->Top_.load(std::memory_order_acquire);
+      if (b - t > this->Mask_)
+         return false;
+      this->Slots_[static_cast<size_t>(b & this->Mask_)].store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      this->Bottom_.store(b + 1, std::memory_order_relaxed);
+      return true;
+   }
+   /// 只能在 owner thread 呼叫.
+   /// \retval false 已空, 或最後一個被 Steal() 取走了.
+   bool Pop(T& item) {
+      const Index b = this->Bottom_.load(std::memory_order_relaxed) - 1;
+      this->Bottom_.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      Index t = this->Top_.load(std::memory_order_relaxed);
+      if (t > b) {
+         this->Bottom_.store(b + 1, std::memory_order_relaxed);
+         return false;
+      }
+      item = this->Slots_[static_cast<size_t>(b & this->Mask_)].load(std::memory_order_relaxed);
+      if (t == b) {
+         // 最後一個, 與 Steal() 競爭.
+         const bool isTaken = this->Top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+         this->Bottom_.store(b + 1, std::memory_order_relaxed);
+         return isTaken;
+      }
+      return true;
+   }
+   /// 可在任意 thread 呼叫.
+   /// \retval false 已空, 或與其他 thread 競爭失敗.
+   bool Steal(T& item) {
+      Index t = this->Top_.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const Index b = this->Bottom_.load(std::memory_order_acquire);
+      if (t >= b)
+         return false;
+      item = this->Slots_[static_cast<size_t>(t & this->Mask_)].load(std::memory_order_relaxed);
+      return this->Top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+   }
+
+private:
+   static size_t CeilPow2(size_t v) {
+      size_t r = 1;
+      while (r < v)
+         r <<= 1;
+      return r;
+   }
+};
+
+/// \ingroup Thrs
+/// args: "ThreadCount=n|Cpus=List|Capacity=n"
+struct fon9_API WorkStealingPoolArgs {
+   /// 若有設定 CpuAffinity, 則每個 worker thread 會綁定一個固定的 cpu.
+   /// 例如: ThreadCount_=3; CpuAffinity=0,1;
+   ///       則 Thr0=Cpu0; Thr1=Cpu1; Thr2=Cpu0;
+   using CpuAffinity = std::vector<uint32_t>;
+   CpuAffinity CpuAffinity_;
+   uint32_t    ThreadCount_{4};
+   /// 每個 worker 的 deque 容量, 超過時, 新的工作會暫時留在 worker 的 inbox.
+   uint32_t    Capacity_{1024};
+
+   WorkStealingPoolArgs() = default;
+
+   int GetCpuAffinity(size_t threadIndex) const {
+      if (CpuAffinity_.empty())
+         return -1;
+      return static_cast<int>(CpuAffinity_[threadIndex % CpuAffinity_.size()]);
+   }
+
+   /// 用 tag, value 設定參數.
+   /// tag         | value
+   /// ------------|------------------------------
+   /// ThreadCount | > 0
+   /// Cpus        | c0, c1, c2 ... 根據 thread index 依序選擇 c0 或 c1 或 c2...
+   /// Capacity    | > 0, 每個 worker 的 deque 容量.
+   ConfigParser::Result OnTagValue(StrView tag, StrView& value);
+};
+
+/// \ingroup Thrs
+/// 使用 work stealing 的 thread pool.
+/// - 每個 worker thread 有自己的 WorkStealingDeque, 及一個接收外部工作的 inbox.
+///   - 在 worker thread 裡面加入的工作: 放入自己的 deque, 不需要 lock.
+///   - 在其他 thread 加入的工作: 輪流放入各個 worker 的 inbox(各自的 lock), 避免所有 thread 競爭同一個 lock.
+///   - worker 沒事做時, 從其他 worker 的 deque(或 inbox) 取得工作.
+/// - 只有在有 worker 睡眠時, 加入工作才需要喚醒, 降低喚醒的延遲及負擔.
+/// - 工作的執行順序不保證與加入的順序相同.
+/// - 結束時(WaitForEndNow), 剩餘的工作會被拋棄(解構).
+class fon9_API WorkStealingPool {
+   fon9_NON_COPY_NON_MOVE(WorkStealingPool);
+   struct WorkNode;
+   struct Worker;
+   using WorkerSP = std::unique_ptr<Worker>;
+   using Workers = std::vector<WorkerSP>;
+
+   Workers                    Workers_;
+   std::atomic<ThreadState>   State_{ThreadState::Idle};
+   /// 已加入, 但尚未取出執行的工作數量.
+   std::atomic<int64_t>       PendingCount_{0};
+   /// 正在執行中的工作數量.
+   std::atomic<uint32_t>      ExecutingCount_{0};
+   /// 外部 thread 加入工作時, 輪流選擇 worker 的 inbox.
+   std::atomic<uint32_t>      InboxSelector_{0};
+   /// 正在(或準備)睡眠的 worker 數量.
+   std::atomic<uint32_t>      SleepingCount_{0};
+   /// 正在 AddTask() 的數量: 結束時(JoinAndClear), 必須等這些工作放入 deque 或 inbox 之後,
+   /// 才能清除剩餘的工作, 否則在清除之後才放入的工作會遺失.
+   std::atomic<uint32_t>      AddingCount_{0};
+   std::mutex                 SleepMutex_;
+   std::condition_variable    SleepCV_;
+   uint64_t                   WakeSeqNo_{0};
+
+   void ThrRun(Worker& worker, std::string thrName, int cpuAffinity);
+   WorkNode* OnNodeTaken(WorkNode* node);
+   /// 從 src.Inbox_ 取出最多 maxCount 個工作(必須已鎖定 src.InboxMutex_, 且在 dst 的 thread 呼叫):
+   /// 第一個直接傳回, 其餘的放入 dst.Deque_;
+   WorkNode* MoveInbox(Worker& src, Worker& dst, size_t maxCount);
+   WorkNode* TakeNode(Worker& worker);
+   WorkNode* StealNode(Worker& worker);
+   void ExecuteNode(WorkNode* node);
+   void WakeupWorkers(bool isAll);
+   void NotifyEnd(ThreadState st);
+   void JoinAndClear(bool isRun);
+   /// 移除 inbox, deque 裡面的工作, 必須在 threads 結束後才能呼叫.
+   /// \retval 移除的數量.
+   size_t ClearRemainTasks(bool isRun);
+
+public:
+   WorkStealingPool();
+   /// 若有剩餘未執行的工作, 將會被拋棄.
+   ~WorkStealingPool();
+
+   /// 只能呼叫一次.
+   void StartThread(const WorkStealingPoolArgs& args, StrView thrName);
+   size_t GetThreadCount() const {
+      return this->Workers_.size();
+   }
+   ThreadState GetThreadState() const {
+      return this->State_.load(std::memory_order_acquire);
+   }
+   /// 已加入, 但尚未執行完畢的工作數量, 僅供參考.
+   size_t GetBusyCount() const {
+      const uint32_t executing = this->ExecutingCount_.load(std::memory_order_acquire);
+      return static_cast<size_t>(this->PendingCount_.load(std::memory_order_acquire)) + executing;
+   }
+
+   /// 加入一個工作.
+   /// 傳回 == ThreadState::ExecutingOrWaiting 表示有加入, 否則 task 會被拋棄.
+   ThreadState AddTask(WorkTask&& task);
+
+   /// 通知結束, 剩餘未執行的工作, 會在 WaitForEndNow() 時拋棄.
+   void NotifyForEndNow();
+   /// 通知結束, 並在 thread 結束後返回, 剩餘未執行的工作會被拋棄.
+   void WaitForEndNow();
+   /// 等候 thread 處理完工作後, 結束 thread.
+   /// 返回前, 在呼叫端 thread 執行剩餘的工作(例: 在結束過程中, 由其他 thread 加入的工作).
+   void WaitForEndAfterWorkDone();
+};
+fon9_WARN_POP;
+
+/// \ingroup Thrs
+/// 取得 fon9 提供的一個 WorkStealingPool.
+/// * 用於需要快速回應的短暫工作, 例如: Device 的 OpQueue_、AsyncFileAppender、InnDbf 的更新.
+/// * 第一次呼叫時啟動, 參數可由環境變數 "fon9_DefaultWorkPool" 設定, 例: "ThreadCount=4|Cpus=2,3".
+/// * 程式結束時, 剩餘的工作會被拋棄!
+fon9_API WorkStealingPool& GetDefaultWorkPool();
+
+/// \ingroup Thrs
+/// 等候 thread pool 將所有的工作完成之後結束 thread pool.
+/// 結束 thread pool 之後, 不會再處理後續加入的工作!!
+/// 為了讓等候中的工作有機會全部做完, 所以:
+/// - 總共等候 waitTimes 次循環(全部工作都完成).
+/// - 每次循環之後睡一會兒(tiSleep) 等看看有沒有新工作.
+fon9_API void WaitWorkPoolQuit(WorkStealingPool& thrPool,
+                               unsigned waitTimes = 3,
+                               TimeInterval tiSleep = TimeInterval_Millisecond(10));
+
+} // namespaces
+#endif//__fon9_WorkStealingPool_hpp__
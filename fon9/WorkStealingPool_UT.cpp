@@ -0,0 +1,265 @@
+﻿// \file fon9/WorkStealingPool_UT.cpp
+// \author fonwinz@gmail.com
+#include "fon9/WorkStealingPool.hpp"
+#include "fon9/MessageQueue.hpp"
+#include "fon9/CountDownLatch.hpp"
+#include "fon9/TestTools.hpp"
+#include "fon9/Log.hpp"
+
+//--------------------------------------------------------------------------//
+
+static std::atomic<int> gCaptureCount{0};
+struct Capture {
+   Capture() { ++gCaptureCount; }
+   Capture(const Capture&) { ++gCaptureCount; }
+   Capture(Capture&&) noexcept { ++gCaptureCount; }
+   ~Capture() { --gCaptureCount; }
+};
+
+struct SmallFn {
+   void* Ptrs_[2];
+   void operator()() {}
+};
+struct BigFn {
+   char Buffer_[fon9::WorkTask::kInlineSize + 1];
+   void operator()() {}
+};
+
+void TestWorkTask() {
+   fon9_CheckTestResult("WorkTask.IsInline", fon9::WorkTask::IsInline<SmallFn>() && !fon9::WorkTask::IsInline<BigFn>());
+   int   runCount = 0;
+   {
+      Capture           cap;
+      fon9::WorkTask    inl{[&runCount, cap]() { ++runCount; }};
+      char              big[fon9::WorkTask::kInlineSize * 2];
+      big[0] = 1;
+      fon9::WorkTask    heap{[&runCount, cap, big]() { runCount += big[0]; }};
+      fon9::WorkTask    moved{std::move(inl)};
+      fon9_CheckTestResult("WorkTask.Move", !inl && moved && heap);
+      moved();
+      heap();
+      inl = std::move(heap);
+      inl();
+      fon9_CheckTestResult("WorkTask.Invoke", runCount == 3);
+   }
+   fon9_CheckTestResult("WorkTask.Destroy", gCaptureCount == 0);
+}
+
+//--------------------------------------------------------------------------//
+
+void TestDeque() {
+   static const uint32_t kItemCount = 1000000;
+   static const uint32_t kThiefCount = 3;
+   using Deque = fon9::WorkStealingDeque<uint32_t*>;
+   std::vector<uint32_t>   items(kItemCount);
+   std::vector<uint32_t>   taken(kItemCount);
+   Deque                   deque{256};
+   std::atomic<bool>       isEnd{false};
+   std::atomic<uint32_t>   stolenCount{0};
+   auto fnTake = [&](uint32_t* item) {
+      ++taken[static_cast<size_t>(item - &items[0])];
+   };
+   std::vector<std::thread> thieves;
+   for (uint32_t L = 0; L < kThiefCount; ++L) {
+      thieves.emplace_back([&]() {
+         uint32_t* item;
+         while (!isEnd) {
+            if (deque.Steal(item)) {
+               fnTake(item);
+               ++stolenCount;
+            }
+         }
+      });
+   }
+   uint32_t* item;
+   for (uint32_t L = 0; L < kItemCount; ++L) {
+      while (!deque.Push(&items[L])) {
+         if (deque.Pop(item))
+            fnTake(item);
+      }
+      if ((L % 3) == 0 && deque.Pop(item))
+         fnTake(item);
+   }
+   while (!deque.empty()) {
+      if (deque.Pop(item))
+         fnTake(item);
+   }
+   isEnd = true;
+   fon9::JoinThreads(thieves);
+   bool isOK = true;
+   for (uint32_t v : taken) {
+      if (v != 1)
+         isOK = false;
+   }
+   std::cout << "stolen=" << stolenCount << std::endl;
+   fon9_CheckTestResult("WorkStealingDeque.TakeOnce", isOK);
+}
+
+//--------------------------------------------------------------------------//
+
+void TestPool() {
+   static const uint32_t kProducerCount = 4;
+   static const uint32_t kTaskCount = 100000;
+   fon9::WorkStealingPool     pool;
+   fon9::WorkStealingPoolArgs args;
+   args.ThreadCount_ = 3;
+   args.Capacity_ = 64;
+   pool.StartThread(args, "UT.WorkPool");
+
+   std::atomic<uint32_t> runCount{0};
+   std::vector<std::thread> producers;
+   for (uint32_t L = 0; L < kProducerCount; ++L) {
+      producers.emplace_back([&]() {
+         for (uint32_t i = 0; i < kTaskCount; ++i) {
+            pool.AddTask([&pool, &runCount, i]() {
+               ++runCount;
+               // 在 worker thread 加入的工作, 放在自己的 deque.
+               if (i % 10 == 0)
+                  pool.AddTask([&runCount]() { ++runCount; });
+            });
+         }
+      });
+   }
+   fon9::JoinThreads(producers);
+   fon9::WaitWorkPoolQuit(pool);
+   const uint32_t expected = kProducerCount * (kTaskCount + kTaskCount / 10);
+   std::cout << "runCount=" << runCount << "|expected=" << expected << std::endl;
+   fon9_CheckTestResult("WorkStealingPool.AllDone", runCount == expected && pool.GetBusyCount() == 0);
+   fon9_CheckTestResult("WorkStealingPool.AddAfterEnd",
+                        pool.AddTask([&runCount]() { ++runCount; }) == fon9::ThreadState::Terminated);
+
+   // WaitForEndNow(): 剩餘的工作被拋棄(解構).
+   fon9::WorkStealingPool  pool2;
+   args.ThreadCount_ = 1;
+   pool2.StartThread(args, "UT.WorkPool2");
+   fon9::CountDownLatch blocker{1};
+   pool2.AddTask([&blocker]() { blocker.Wait(); });
+   {
+      Capture cap;
+      for (unsigned L = 0; L < 100; ++L)
+         pool2.AddTask([cap]() {});
+   }
+   pool2.NotifyForEndNow();
+   blocker.CountDown();
+   pool2.WaitForEndNow();
+   fon9_CheckTestResult("WorkStealingPool.EndNow.Discard", gCaptureCount == 0);
+}
+
+/// 結束 pool 的同時, 有其他 thread 正在 AddTask():
+/// AddTask() 傳回 ExecutingOrWaiting 的工作, 必定會被執行(WaitForEndAfterWorkDone) 或 拋棄(WaitForEndNow), 不會遺失.
+void TestEndWhileAdding() {
+   static const uint32_t kProducerCount = 3;
+   static const unsigned kRounds = 200;
+   fon9::WorkStealingPoolArgs args;
+   args.ThreadCount_ = 2;
+   args.Capacity_ = 64;
+   bool isOK = true;
+   // 避免每個 round 的 ThrRun log 干擾測試結果的輸出.
+   const fon9::LogLevel logLevelBak = fon9::LogLevel_;
+   fon9::LogLevel_ = fon9::LogLevel::Error;
+   for (unsigned round = 0; round < kRounds && isOK; ++round) {
+      const bool              isEndNow = ((round % 2) != 0);
+      fon9::WorkStealingPool  pool;
+      pool.StartThread(args, "UT.WorkPoolEnd");
+      std::atomic<uint32_t>   addedCount{0};
+      std::atomic<uint32_t>   runCount{0};
+      std::vector<std::thread> producers;
+      for (uint32_t L = 0; L < kProducerCount; ++L) {
+         producers.emplace_back([&]() {
+            Capture cap;
+            while (pool.AddTask([&runCount, cap]() { ++runCount; }) == fon9::ThreadState::ExecutingOrWaiting)
+               ++addedCount;
+         });
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds{200 + round * 5});
+      if (isEndNow)
+         pool.WaitForEndNow();
+      else
+         pool.WaitForEndAfterWorkDone();
+      fon9::JoinThreads(producers);
+      if (isEndNow)
+         isOK = (gCaptureCount == 0);
+      else
+         isOK = (runCount == addedCount && gCaptureCount == 0);
+      if (!isOK)
+         std::cout << "|round=" << round << "|added=" << addedCount << "|run=" << runCount
+                   << "|capture=" << gCaptureCount << std::endl;
+   }
+   fon9::LogLevel_ = logLevelBak;
+   fon9_CheckTestResult("WorkStealingPool.EndWhileAdding", isOK);
+}
+
+//--------------------------------------------------------------------------//
+
+struct BenchHandler {
+   using MessageType = std::function<void()>;
+   using ThreadPool = fon9::MessageQueue<BenchHandler>;
+   BenchHandler(ThreadPool&) {}
+   void OnMessage(MessageType& task) {
+      task();
+   }
+   void OnThreadEnd(const std::string&) {
+   }
+};
+struct BenchTask {
+   std::atomic<uint32_t>* RunCount_;
+   void operator()() {
+      ++*this->RunCount_;
+   }
+};
+static void AddBenchTask(BenchHandler::ThreadPool& pool, BenchTask task) {
+   pool.EmplaceMessage(task);
+}
+static void AddBenchTask(fon9::WorkStealingPool& pool, BenchTask task) {
+   pool.AddTask(task);
+}
+static void WaitBenchDone(BenchHandler::ThreadPool& pool) {
+   pool.WaitForEndAfterWorkDone();
+}
+static void WaitBenchDone(fon9::WorkStealingPool& pool) {
+   pool.WaitForEndAfterWorkDone();
+}
+template <class Pool>
+void Benchmark(const char* name, Pool& pool, unsigned producerCount) {
+   static const uint32_t kTaskCount = 200000;
+   std::atomic<uint32_t>    runCount{0};
+   std::vector<std::thread> producers;
+   fon9::StopWatch          stopWatch;
+   for (unsigned L = 0; L < producerCount; ++L) {
+      producers.emplace_back([&]() {
+         for (uint32_t i = 0; i < kTaskCount; ++i)
+            AddBenchTask(pool, BenchTask{&runCount});
+      });
+   }
+   fon9::JoinThreads(producers);
+   WaitBenchDone(pool);
+   stopWatch.PrintResult(name, runCount);
+}
+
+int main() {
+   fon9::AutoPrintTestInfo utinfo{"WorkStealingPool"};
+   TestWorkTask();
+
+   utinfo.PrintSplitter();
+   TestDeque();
+
+   utinfo.PrintSplitter();
+   TestPool();
+   TestEndWhileAdding();
+
+   utinfo.PrintSplitter();
+   const unsigned kProducerCount = 4;
+   const uint32_t kThreadCount = 4;
+   {
+      BenchHandler::ThreadPool pool;
+      pool.StartThread(kThreadCount, "UT.MessageQueue");
+      Benchmark("MessageQueue    ", pool, kProducerCount);
+   }
+   {
+      fon9::WorkStealingPool     pool;
+      fon9::WorkStealingPoolArgs args;
+      args.ThreadCount_ = kThreadCount;
+      pool.StartThread(args, "UT.WorkPool");
+      Benchmark("WorkStealingPool", pool, kProducerCount);
+   }
+}
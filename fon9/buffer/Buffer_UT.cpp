@@ -91,6 +91,28 @@ void TestBuffer() {
          goto __TEST_ERROR;
    }
    std::cout << "\r[OK   ]" << std::endl;
+
+   std::cout << "[TEST ] DcQueueList.MoveOutConsumed()";
+   for (step = 1; step < msgsz + 10; ++step) {
+      fon9::DcQueueList dcq{InitTestData().MoveOut()};
+      res.clear();
+      for (size_t pos = 0; pos < msgsz; pos += step) {
+         // 移出的節點必須在剩餘的資料取出後, 仍可正確釋放.
+         fon9::BufferList consumed = dcq.MoveOutConsumed(std::min(step, msgsz - pos));
+         if (dcq.CalcSize() != msgsz - std::min(pos + step, msgsz))
+            goto __TEST_ERROR;
+         if (const fon9::byte* p = dcq.Peek1())
+            res.push_back(static_cast<char>(*p));
+      }
+      if (!dcq.empty())
+         goto __TEST_ERROR;
+      std::string expected;
+      for (size_t pos = step; pos < msgsz; pos += step)
+         expected.push_back(msg[pos]);
+      if (res != expected)
+         goto __TEST_ERROR;
+   }
+   std::cout << "\r[OK   ]" << std::endl;
    return;
 
 __TEST_ERROR:
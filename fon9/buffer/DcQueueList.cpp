@@ -1,6 +1,7 @@
 ﻿// \file fon9/buffer/DcQueueList.cpp
 // \author fonwinz@gmail.com
 #include "fon9/buffer/DcQueueList.hpp"
+#include "fon9/buffer/FwdBufferList.hpp"
 
 namespace fon9 {
 
@@ -66,6 +67,37 @@ void DcQueueList::DcQueueRemoveMore(size_t sz) {
    assert(sz == 0 && this->BlockList_.empty());
    this->ClearCurrBlock();
 }
+BufferList DcQueueList::MoveOutConsumed(size_t sz) {
+   BufferList consumed;
+   while (this->BlockList_.front()) {
+      const size_t blksz = this->GetCurrBlockSize();
+      if (sz < blksz) {
+         if (sz > 0) {
+            const size_t   remain = blksz - sz;
+            FwdBufferNode* node = FwdBufferNode::Alloc(remain);
+            byte*          beg = node->GetDataEnd();
+            memcpy(beg, this->MemCurrent_ + sz, remain);
+            node->SetDataEnd(beg + remain);
+            consumed.push_back(this->BlockList_.pop_front());
+            this->BlockList_.push_front(node);
+            this->ResetCurrBlock(beg, remain);
+         }
+         break;
+      }
+      sz -= blksz;
+      consumed.push_back(this->BlockList_.pop_front());
+      this->ClearCurrBlock();
+      while (BufferNode* node = this->BlockList_.front()) {
+         if (node->GetDataSize() > 0) {
+            this->ResetCurrBlock(node->GetDataBegin(), node->GetDataEnd());
+            break;
+         }
+         consumed.push_back(this->BlockList_.pop_front());
+      }
+   }
+   assert(sz == 0);
+   return consumed;
+}
 size_t DcQueueList::DcQueueReadMore(byte* buf, size_t sz) {
    // 先釋放 curr block.
    this->NodeConsumed(this->BlockList_.pop_front());
@@ -103,6 +103,12 @@ public:
       return this->BlockList_.size();
    }
 
+   /// 與 PopConsumed(sz) 類似, 但已消費的節點不釋放, 而是移出給呼叫端.
+   /// - 例: send(MSG_ZEROCOPY) 送出的資料, 必須等 kernel 的完成通知後, 才能釋放.
+   /// - 若最後一個節點只消費了部分資料, 則將剩餘的資料複製到新的節點, 原節點移出.
+   /// - 緊接在已消費資料之後的控制節點, 也會一併移出, 等呼叫端釋放時才觸發 OnBufferConsumed().
+   BufferList MoveOutConsumed(size_t sz);
+
    /// 一次取得數個資料區塊.
    /// 透過 fon9_PutIoVectorElement(T* piov, void* dat, size_t datsz); 設定資料區塊位置&大小.
    /// \return 傳回取出的區塊數量.
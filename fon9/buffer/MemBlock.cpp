@@ -1,19 +1,90 @@
 ﻿// \file fon9/buffer/MemBlock.hpp
 // \author fonwinz@gmail.com
+#define _CRT_SECURE_NO_WARNINGS  // Windows: getenv()
 #include "fon9/buffer/MemBlockImpl.hpp"
 #include "fon9/StaticPtr.hpp"
+#include "fon9/StrTo.hpp"
+#include <mutex>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#ifndef fon9_WINDOWS
+#include <sys/mman.h>
+#endif
 
 namespace fon9 {
 
-static std::array<size_t, kMemBlockLevelCount> MemBlockLevelMaxNodeCount_{
-   128,  // [0]: Size=128, 通常用在 BufferNodeVirtual.
-   1024, // [1]: Size=256, 通常用在 Log: RevBufferList rbuf{kLogBlockNodeSize};
-   1024, // [2]: Size=512, 通常用在 FIX Message builder.
-   32,   // [3]: Size=1024, 通常用在 device input.
-   32,   // [4]: Size=4096
-   32,   // [5]: Size=16K
-   32,   // [6]: Size=64K
-};
+fon9_API MemBlockLevels MemBlockLevels_;
+
+static const char kMemBlockLevelsDefault[] =
+   "128/128,"  // [0]: Size=128, 通常用在 BufferNodeVirtual.
+   "256/1024," // [1]: Size=256, 通常用在 Log: RevBufferList rbuf{kLogBlockNodeSize};
+   "512/1024," // [2]: Size=512, 通常用在 FIX Message builder.
+   "1K/32,"    // [3]: Size=1024, 通常用在 device input.
+   "4K/32,"    // [4]: Size=4096
+   "16K/32,"   // [5]: Size=16K
+   "64K/32";   // [6]: Size=64K
+static const MemBlockSize kMemBlockHugePageMinSizeDefault = 1024 * 4;
+
+static MemBlockSize MemBlockFetchSize(StrView& cfg) {
+   MemBlockSize sz = StrTo(&StrTrimHead(&cfg), MemBlockSize{0});
+   if (cfg.Get1st() == 'K' || cfg.Get1st() == 'k') {
+      sz *= 1024;
+      cfg.SetBegin(cfg.begin() + 1);
+   }
+   return sz;
+}
+static bool MemBlockLevelsParse(MemBlockLevels& levels, StrView cfg, MemBlockSize hugePageMinSize) {
+   memset(&levels, 0, sizeof(levels));
+   while (!StrTrimHead(&cfg).empty()) {
+      StrView            item = StrFetchTrim(cfg, ',');
+      const MemBlockSize sz = MemBlockFetchSize(item);
+      if (sz <= levels.MaxSize_ || sz > kMemBlockLevelMaxSize || sz % kMemBlockLevelGranularity != 0
+          || levels.Count_ >= kMemBlockLevelCount)
+         return false;
+      size_t maxNodeCount = (sz < 1024 ? 1024u : 32u);
+      if (StrTrimHead(&item).Get1st() == '/') {
+         item.SetBegin(item.begin() + 1);
+         if ((maxNodeCount = StrTo(item, maxNodeCount)) <= 0)
+            return false;
+      }
+      levels.Sizes_[levels.Count_] = sz;
+      levels.MaxNodeCount_[levels.Count_] = maxNodeCount;
+      levels.UseSlab_[levels.Count_] = (hugePageMinSize > 0 && sz >= hugePageMinSize);
+      levels.MaxSize_ = sz;
+      ++levels.Count_;
+   }
+   if (levels.Count_ <= 0)
+      return false;
+   uint8_t lvidx = 0;
+   for (MemBlockSize idx = 0; idx < levels.MaxSize_ / kMemBlockLevelGranularity; ++idx) {
+      while (levels.Sizes_[lvidx] < (idx + 1) * kMemBlockLevelGranularity)
+         ++lvidx;
+      levels.Index_[idx] = lvidx;
+   }
+   return true;
+}
+/// 在建立第一個 MemBlockCenter 時呼叫, 若尚未設定, 則使用環境變數或預設值.
+static void MemBlockLevelsFreeze() {
+   if (MemBlockLevels_.MaxSize_)
+      return;
+   MemBlockLevels levels;
+   if (const char* envLevels = getenv("fon9_MemBlockLevels")) {
+      MemBlockSize hugePageMinSize = kMemBlockHugePageMinSizeDefault;
+      if (const char* envHugePage = getenv("fon9_MemBlockHugePage")) {
+         StrView cfg = StrView_cstr(envHugePage);
+         hugePageMinSize = MemBlockFetchSize(cfg);
+      }
+      if (MemBlockLevelsParse(levels, StrView_cstr(envLevels), hugePageMinSize)) {
+         MemBlockLevels_ = levels;
+         return;
+      }
+   }
+   MemBlockLevelsParse(levels, StrView{kMemBlockLevelsDefault}, kMemBlockHugePageMinSizeDefault);
+   MemBlockLevels_ = levels;
+}
 
 //--------------------------------------------------------------------------//
 namespace impl {
@@ -21,7 +92,142 @@ namespace impl {
 // 不用太頻繁，因為若瞬間有大用量，則應暫時保留較多的緩衝。若用量不大，也沒必要頻繁的整理。
 static const TimeInterval  kMemBlockCenter_CheckInterval{TimeInterval_Millisecond(2000)};
 
-MemBlockCenter::MemBlockCenter() : Timer_{GetDefaultTimerThread()} {
+static std::array<size_t, kMemBlockLevelCount> MemBlockLevelReservedCount_{
+   4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+};
+
+//--------------------------------------------------------------------------//
+/// 已從 slab 切割, 但目前沒有使用的記憶體; slab 不會還給系統.
+static std::array<std::atomic<FreeMemNode*>, kMemBlockLevelCount> MemBlockSlabFree_;
+
+static FreeMemList MemBlockSlabTake(unsigned lvidx) {
+   FreeMemNode* head = MemBlockSlabFree_[lvidx].exchange(nullptr, std::memory_order_acquire);
+   return FreeMemList{head, CalcNodeCount(head)};
+}
+static void MemBlockSlabPut(unsigned lvidx, FreeMemList&& fmlist) {
+   if (FreeMemNode* front = fmlist.ReleaseList()) {
+      FreeMemNode* back = front;
+      while (FreeMemNode* next = back->GetNext())
+         back = next;
+      PushToHead(MemBlockSlabFree_[lvidx], front, back);
+   }
+}
+fon9_API void MemBlockSlabFree(void* mem) {
+   const unsigned lvidx = MemBlockPoolHeader(mem).SlabLevel_ - 1;
+   FreeMemNode*   node = InplaceNew<FreeMemNode>(mem);
+   PushToHead(MemBlockSlabFree_[lvidx], node, node);
+}
+
+/// 從系統取得一個 kMemBlockSlabSize 大小, 並對齊 kMemBlockSlabSize 的記憶體.
+static byte* MemBlockSlabMap() {
+#ifdef fon9_WINDOWS
+   SIZE_T largePageSize = GetLargePageMinimum();
+   if (largePageSize > 0 && kMemBlockSlabSize % largePageSize == 0) {
+      if (void* mem = VirtualAlloc(nullptr, kMemBlockSlabSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE))
+         return static_cast<byte*>(mem);
+   }
+   return static_cast<byte*>(VirtualAlloc(nullptr, kMemBlockSlabSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+   void* mem;
+#ifdef MAP_HUGETLB
+   mem = mmap(nullptr, kMemBlockSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+   if (mem != MAP_FAILED)
+      return static_cast<byte*>(mem);
+#endif
+   // 沒有設定 hugetlbfs 的 huge pages, 改用一般的 mmap(), 對齊 kMemBlockSlabSize 之後, 讓 THP 有機會使用 huge page.
+   mem = mmap(nullptr, kMemBlockSlabSize * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (mem == MAP_FAILED)
+      return nullptr;
+   const uintptr_t beg = reinterpret_cast<uintptr_t>(mem);
+   const uintptr_t aligned = (beg + kMemBlockSlabSize - 1) & ~static_cast<uintptr_t>(kMemBlockSlabSize - 1);
+   if (aligned > beg)
+      munmap(mem, aligned - beg);
+   if (aligned + kMemBlockSlabSize < beg + kMemBlockSlabSize * 2)
+      munmap(reinterpret_cast<void*>(aligned + kMemBlockSlabSize), beg + kMemBlockSlabSize - aligned);
+   mem = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+   madvise(mem, kMemBlockSlabSize, MADV_HUGEPAGE);
+#endif
+   return static_cast<byte*>(mem);
+#endif
+}
+/// 取得一個新的 slab, 切割成 lvidx 等級的記憶體, 放入 fmlist.
+static bool MemBlockSlabCarve(unsigned lvidx, FreeMemList& fmlist) {
+   byte* slab = MemBlockSlabMap();
+   if (slab == nullptr)
+      return false;
+   const size_t stride = (MemBlockLevelSize(lvidx) + sizeof(MemBlockHeader) + kMemBlockLevelGranularity - 1)
+                       / kMemBlockLevelGranularity * kMemBlockLevelGranularity;
+   for (size_t ofs = 0; ofs + stride <= kMemBlockSlabSize; ofs += stride) {
+      byte* mem = slab + ofs + sizeof(MemBlockHeader);
+      MemBlockPoolHeader(mem).SlabLevel_ = lvidx + 1;
+      fmlist.push_front(InplaceNew<FreeMemNode>(mem));
+   }
+   return true;
+}
+
+//--------------------------------------------------------------------------//
+/// 沒經過 TCache, 直接使用 malloc()/free() 的次數.
+static std::atomic<uint64_t> MemBlockRawAllocCount_{0};
+static std::atomic<uint64_t> MemBlockRawFreeCount_{0};
+static inline void MemBlockRawFree(void* ptr) {
+   MemBlockRawFreeCount_.fetch_add(1, std::memory_order_relaxed);
+   ::free(ptr);
+}
+/// [0..kMemBlockLevelCount-1]: 各等級的 InUse 取樣最大值; [kMemBlockLevelCount]: 直接使用 malloc() 的.
+static std::array<std::atomic<uint64_t>, kMemBlockLevelCount + 1> MemBlockInUseHighWater_;
+
+static uint64_t MemBlockUpdateHighWater(unsigned idx, uint64_t inUse) {
+   uint64_t hw = MemBlockInUseHighWater_[idx].load(std::memory_order_relaxed);
+   while (hw < inUse) {
+      if (MemBlockInUseHighWater_[idx].compare_exchange_weak(hw, inUse, std::memory_order_relaxed))
+         return inUse;
+   }
+   return hw;
+}
+static inline uint64_t MemBlockCalcInUse(uint64_t allocCount, uint64_t freeCount) {
+   // 計數器是分別取得的, 所以可能會有 freeCount > allocCount 的情況.
+   return allocCount > freeCount ? allocCount - freeCount : 0;
+}
+
+//--------------------------------------------------------------------------//
+static std::atomic<MemBlockOwner*> MemBlockOwnerHead_{nullptr};
+
+MemBlockOwner* MemBlockOwner::Head() {
+   return MemBlockOwnerHead_.load(std::memory_order_acquire);
+}
+MemBlockOwner* MemBlockOwner::Adopt() {
+   for (MemBlockOwner* owner = Head(); owner; owner = owner->NextOwner_) {
+      if (owner->TryClaim())
+         return owner;
+   }
+   MemBlockOwner* owner = new MemBlockOwner;
+   owner->NextOwner_ = MemBlockOwnerHead_.load(std::memory_order_relaxed);
+   while (!MemBlockOwnerHead_.compare_exchange_weak(owner->NextOwner_, owner,
+                                                    std::memory_order_release, std::memory_order_relaxed)) {
+   }
+   return owner;
+}
+
+fon9_API unsigned GetCurrentNumaNode() {
+#if defined(fon9_WINDOWS)
+   PROCESSOR_NUMBER  pn;
+   USHORT            node;
+   GetCurrentProcessorNumberEx(&pn);
+   if (GetNumaProcessorNodeEx(&pn, &node))
+      return node;
+#elif defined(__linux__)
+   unsigned cpu, node;
+   if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+      return node;
+#endif
+   return 0;
+}
+
+//--------------------------------------------------------------------------//
+MemBlockCenter::MemBlockCenter(unsigned numaNode) : Timer_{GetDefaultTimerThread()}, NumaNode_{numaNode} {
+   for (unsigned lvidx = 0; lvidx < MemBlockLevelCount(); ++lvidx)
+      CenterLevel::Locker{this->Levels_[lvidx]}->ReservedCount_ = MemBlockLevelReservedCount_[lvidx];
    Timer_.RunAfter(TimeInterval{});
 }
 MemBlockCenter::~MemBlockCenter() {
@@ -72,6 +278,15 @@ void MemBlockCenter::Recycle(TCacheLevelPools& levels) {
    }
 }
 
+void MemBlockCenter::RecycleRemote(MemBlockOwner& owner) {
+   for (unsigned lvidx = 0; lvidx < MemBlockLevelCount(); ++lvidx) {
+      if (CenterLevelNode* cnode = CenterLevelNode::FromFreeMemList(owner.TakeRemoteFree(lvidx))) {
+         CenterLevel::Locker lvCenter{this->Levels_[lvidx]};
+         lvCenter->Recycle_.push_front(cnode);
+      }
+   }
+}
+
 static bool FreeMemListMerge(FreeMemList& dst, FreeMemList& src, size_t maxNodeCount) {
    while (dst.size() < maxNodeCount) {
       if (FreeMemNode* mnode = src.pop_front())
@@ -81,27 +296,44 @@ static bool FreeMemListMerge(FreeMemList& dst, FreeMemList& src, size_t maxNodeC
    }
    return true;
 }
+void MemBlockCenter::FillFreeMemList(unsigned lvidx, FreeMemList& fmlist, size_t maxNodeCount) {
+   if (MemBlockLevels_.UseSlab_[lvidx]) {
+      // 優先使用 slab 備用的記憶體, 不足時再切割新的 slab, 剩餘的放回備用.
+      FreeMemList slabFree{MemBlockSlabTake(lvidx)};
+      while (!FreeMemListMerge(fmlist, slabFree, maxNodeCount)) {
+         if (!MemBlockSlabCarve(lvidx, slabFree))
+            break;
+      }
+      MemBlockSlabPut(lvidx, std::move(slabFree));
+   }
+   // 若無法取得 slab, 則使用 malloc().
+   const MemBlockSize sz = MemBlockLevelSize(lvidx);
+   while (fmlist.size() < maxNodeCount) {
+      byte* mem = MemBlockPoolMalloc(sz);
+      if (mem == nullptr)
+         break;
+      fmlist.push_front(InplaceNew<FreeMemNode>(mem));
+   }
+}
 void MemBlockCenter::InitLevel(unsigned lvidx, CenterLevel::Locker& lvCenter) {
    size_t   count = (lvCenter->ReservedCount_ + lvCenter->RequiredCount_);
    size_t   curr = lvCenter->Reserved_.size();
    CenterLevelList recycle = std::move(lvCenter->Recycle_);
    if (curr > count) {
       CenterLevelList r2 = lvCenter->Reserved_.pop_front(curr - count);
+      lvCenter->TrimCount_ += r2.size();
       lvCenter.unlock();
       // auto free: r2, recycle;
       return;
    }
    lvCenter.unlock();
 
-   const size_t maxNodeCount = MemBlockLevelMaxNodeCount_[lvidx];
+   const size_t maxNodeCount = MemBlockLevels_.MaxNodeCount_[lvidx];
    FreeMemList  fmlist{CenterLevelNode::ToFreeMemList(recycle.pop_front())};
    for (; curr < count; ++curr) {
       FreeMemList fmlist2{CenterLevelNode::ToFreeMemList(recycle.pop_front())};
-      if (!FreeMemListMerge(fmlist, fmlist2, maxNodeCount)) {
-         do {
-            fmlist.push_front(InplaceNew<FreeMemNode>(malloc(MemBlockLevelSize_[lvidx])));
-         } while (fmlist.size() < maxNodeCount);
-      }
+      if (!FreeMemListMerge(fmlist, fmlist2, maxNodeCount))
+         FillFreeMemList(lvidx, fmlist, maxNodeCount);
       CenterLevelNode* cnode = CenterLevelNode::FromFreeMemList(std::move(fmlist));
       fmlist = std::move(fmlist2);
       lvCenter.lock();
@@ -120,32 +352,140 @@ void MemBlockCenter::InitLevel(unsigned lvidx, const size_t* reserveFreeListCoun
    this->InitLevel(lvidx, lvCenter);
 }
 
+void MemBlockCenter::GetStats(MemBlockStats& stats) {
+   for (unsigned lvidx = 0; lvidx < MemBlockLevelCount(); ++lvidx) {
+      CenterLevel::Locker lvCenter{this->Levels_[lvidx]};
+      stats[lvidx].TrimCount_ += lvCenter->TrimCount_;
+      stats[lvidx].CenterReservedCount_ += lvCenter->Reserved_.size();
+   }
+}
+
+/// 取樣各等級的 InUse, 更新 MemBlockInUseHighWater_; 傳回時 stats 已填妥 owner 的計數器.
+static void MemBlockSampleOwners(MemBlockStats& stats) {
+   for (MemBlockOwner* owner = MemBlockOwner::Head(); owner; owner = owner->NextOwner_) {
+      for (unsigned lvidx = 0; lvidx < MemBlockLevelCount(); ++lvidx) {
+         const MemBlockOwner::LevelStat& src = owner->Stats_[lvidx];
+         MemBlockLevelStat&              dst = stats[lvidx];
+         dst.AllocCount_ += src.AllocCount_.load(std::memory_order_relaxed);
+         dst.FreeCount_ += src.FreeCount_.load(std::memory_order_relaxed);
+         dst.CenterRefillCount_ += src.CenterRefillCount_.load(std::memory_order_relaxed);
+         dst.MallocFallbackCount_ += src.MallocFallbackCount_.load(std::memory_order_relaxed);
+         dst.ThreadCachedCount_ += src.CachedCount_.load(std::memory_order_relaxed);
+      }
+   }
+   const unsigned lvCount = MemBlockLevelCount();
+   MemBlockLevelStat& raw = stats[lvCount];
+   raw.AllocCount_ = MemBlockRawAllocCount_.load(std::memory_order_relaxed);
+   raw.FreeCount_ = MemBlockRawFreeCount_.load(std::memory_order_relaxed);
+   for (unsigned lvidx = 0; lvidx <= lvCount; ++lvidx) {
+      MemBlockLevelStat& dst = stats[lvidx];
+      dst.InUseCount_ = MemBlockCalcInUse(dst.AllocCount_, dst.FreeCount_);
+      dst.InUseHighWater_ = MemBlockUpdateHighWater(lvidx < lvCount ? lvidx : kMemBlockLevelCount, dst.InUseCount_);
+   }
+}
+
 void MemBlockCenter::EmitOnTimer(TimerEntry* timer, TimeStamp) {
    MemBlockCenter& rthis = ContainerOf(*static_cast<decltype(MemBlockCenter::Timer_)*>(timer), &MemBlockCenter::Timer_);
-   for (unsigned lvidx = 0; lvidx < kMemBlockLevelCount; ++lvidx)
+   // 已結束的 thread, 在結束後才被其他 thread 歸還的記憶體, 移到 Recycle_ 重新整理.
+   MemBlockOwner::RecycleAbandoned([&rthis](MemBlockOwner& owner) {
+      rthis.RecycleRemote(owner);
+   });
+   for (unsigned lvidx = 0; lvidx < MemBlockLevelCount(); ++lvidx)
       rthis.InitLevel(lvidx, nullptr);
+   // 定時取樣, 更新 InUseHighWater_;
+   MemBlockStats stats{};
+   MemBlockSampleOwners(stats);
    timer->RunAfter(kMemBlockCenter_CheckInterval);
 }
 
 using MemBlockCenterSP = intrusive_ptr<MemBlockCenter>;
+struct MemBlockCenters {
+   fon9_NON_COPY_NON_MOVE(MemBlockCenters);
+   MemBlockCenters() = default;
+   std::mutex        Mutex_;
+   MemBlockCenterSP  Centers_[kMemBlockMaxNumaNodes];
+   bool              IsDisposed_{false};
+   ~MemBlockCenters() {
+      std::lock_guard<std::mutex> lk{this->Mutex_};
+      this->IsDisposed_ = true;
+      for (MemBlockCenterSP& center : this->Centers_)
+         center.reset();
+   }
+   /// 如果系統正在結束 MemBlockCenter 已死, 此時應傳回 nullptr, 然後使用 MemBlock::UseMalloc();
+   MemBlockCenterSP Get(unsigned numaNode) {
+      if (numaNode >= kMemBlockMaxNumaNodes)
+         numaNode = kMemBlockMaxNumaNodes - 1;
+      std::lock_guard<std::mutex> lk{this->Mutex_};
+      if (this->IsDisposed_)
+         return nullptr;
+      MemBlockLevelsFreeze();
+      MemBlockCenterSP& center = this->Centers_[numaNode];
+      if (!center)
+         center.reset(new MemBlockCenter{numaNode});
+      return center;
+   }
+};
+static MemBlockCenters& GetMemBlockCenters() {
+   static MemBlockCenters MemBlockCenters_;
+   return MemBlockCenters_;
+}
+/// 每個 NUMA node 使用各自的 MemBlockCenter, 避免跨 node 共用 FreeMemList.
 static MemBlockCenterSP GetMemBlockCenter() {
-   static MemBlockCenterSP MemBlockCenter{new impl::MemBlockCenter{}};
-   // 如果系統正在結束 MemBlockCenter 已死, 此時應傳回 nullptr, 然後使用 MemBlock::UseMalloc();
-   return MemBlockCenter->use_count() ? MemBlockCenter : nullptr;
+   return GetMemBlockCenters().Get(GetCurrentNumaNode());
 }
 
 fon9_API bool MemBlockInit(MemBlockSize size, size_t reserveFreeListCount, size_t maxNodeCount) {
+   // 確保目前 thread 所在 node 的 center 已建立(MemBlockLevels_ 已確定), 然後套用到全部已建立的 center.
+   if (!GetMemBlockCenter())
+      return false;
    unsigned lvidx = MemBlockSizeToIndex(size);
-   if (lvidx >= kMemBlockLevelCount)
+   if (lvidx >= MemBlockLevelCount())
       return false;
-   if (MemBlockLevelMaxNodeCount_[lvidx] < maxNodeCount)
-      MemBlockLevelMaxNodeCount_[lvidx] = maxNodeCount;
-   GetMemBlockCenter()->InitLevel(lvidx, &reserveFreeListCount);
+   if (MemBlockLevels_.MaxNodeCount_[lvidx] < maxNodeCount)
+      MemBlockLevels_.MaxNodeCount_[lvidx] = maxNodeCount;
+   MemBlockLevelReservedCount_[lvidx] = reserveFreeListCount;
+   MemBlockCenters& centers = GetMemBlockCenters();
+   for (unsigned node = 0; node < kMemBlockMaxNumaNodes; ++node) {
+      std::unique_lock<std::mutex> lk{centers.Mutex_};
+      MemBlockCenterSP center = centers.Centers_[node];
+      lk.unlock();
+      if (center)
+         center->InitLevel(lvidx, &reserveFreeListCount);
+   }
    return true;
 }
 } // namespace impl
 using namespace impl;
 
+fon9_API bool MemBlockConfigLevels(StrView cfgLevels, MemBlockSize hugePageMinSize) {
+   MemBlockCenters&            centers = GetMemBlockCenters();
+   std::lock_guard<std::mutex> lk{centers.Mutex_};
+   if (MemBlockLevels_.MaxSize_)
+      return false;
+   MemBlockLevels levels;
+   if (!MemBlockLevelsParse(levels, cfgLevels, hugePageMinSize))
+      return false;
+   MemBlockLevels_ = levels;
+   return true;
+}
+
+fon9_API unsigned MemBlockGetStats(MemBlockStats& stats) {
+   stats = MemBlockStats{};
+   const unsigned lvCount = MemBlockLevelCount();
+   for (unsigned lvidx = 0; lvidx < lvCount; ++lvidx)
+      stats[lvidx].BlockSize_ = MemBlockLevelSize(lvidx);
+   MemBlockSampleOwners(stats);
+   MemBlockCenters& centers = GetMemBlockCenters();
+   for (unsigned node = 0; node < kMemBlockMaxNumaNodes; ++node) {
+      std::unique_lock<std::mutex> lk{centers.Mutex_};
+      MemBlockCenterSP center = centers.Centers_[node];
+      lk.unlock();
+      if (center)
+         center->GetStats(stats);
+   }
+   return lvCount + 1;
+}
+
 //--------------------------------------------------------------------------//
 
 class MemBlock::TCache {
@@ -153,17 +493,61 @@ class MemBlock::TCache {
    TCacheLevelPools        Levels_;
 public:
    const MemBlockCenterSP  Center_;
-   TCache() : Center_{GetMemBlockCenter()} {
+   MemBlockOwner* const    Owner_;
+   TCache() : Center_{GetMemBlockCenter()}, Owner_{MemBlockOwner::Adopt()} {
    }
    ~TCache() {
-      this->Center_->Recycle(this->Levels_);
+      if (this->Center_) {
+         this->Center_->Recycle(this->Levels_);
+         this->Center_->RecycleRemote(*this->Owner_);
+      }
+      for (auto& stat : this->Owner_->Stats_)
+         stat.CachedCount_.store(0, std::memory_order_relaxed);
+      this->Owner_->Abandon();
+   }
+   /// 不經過 TCache 直接釋放: size 在 pool 範圍內的, 必定有 MemBlockHeader.
+   static void FreeRaw(void* ptr, MemBlockSize sz) {
+      if (MemBlockSizeToIndex(sz) < kMemBlockLevelCount) {
+         MemBlockRawFreeCount_.fetch_add(1, std::memory_order_relaxed);
+         MemBlockPoolFree(ptr);
+      }
+      else
+         MemBlockRawFree(ptr);
+   }
+   /// 在沒有 TCache 的 thread 釋放(例: 僅負責送出後釋放的 thread): 若有 owner 則直接歸還給 owner.
+   static void FreeNoCache(void* ptr, MemBlockSize sz) {
+      const unsigned lvidx = MemBlockSizeToIndex(sz);
+      if (lvidx < kMemBlockLevelCount) {
+         if (MemBlockOwner* owner = MemBlockPoolHeader(ptr).Owner_)
+            owner->PushRemoteFree(lvidx, InplaceNew<FreeMemNode>(ptr));
+         else {
+            MemBlockRawFreeCount_.fetch_add(1, std::memory_order_relaxed);
+            MemBlockPoolFree(ptr);
+         }
+      }
+      else
+         MemBlockRawFree(ptr);
    }
    static byte* UseMalloc(MemBlock& mblk, MemBlockSize sz) {
-      if (fon9_UNLIKELY(mblk.MemPtr_))
-         free(mblk.MemPtr_);
-      if (fon9_LIKELY((mblk.Size_ = -static_cast<SSizeT>(sz)) <= 0))
-         if (fon9_LIKELY((mblk.MemPtr_ = reinterpret_cast<byte*>(malloc(sz))) != nullptr))
+      if (fon9_UNLIKELY(mblk.MemPtr_)) {
+         const MemBlockSize oldsz = mblk.size();
+         FreeRaw(mblk.Release(), oldsz);
+      }
+      // 在 pool 範圍內的, 必須使用 level size 分配:
+      // 因為之後可能在有 TCache 的 thread 釋放, 此時會放入該 level 的 FreeMemList, 成為一般的 level block.
+      const unsigned lvidx = MemBlockSizeToIndex(sz);
+      if (lvidx < kMemBlockLevelCount)
+         sz = MemBlockLevelSize(lvidx);
+      if (fon9_LIKELY((mblk.Size_ = -static_cast<SSizeT>(sz)) <= 0)) {
+         mblk.MemPtr_ = (lvidx < kMemBlockLevelCount
+                         ? MemBlockPoolMalloc(sz) : static_cast<byte*>(malloc(sz)));
+         if (fon9_LIKELY(mblk.MemPtr_ != nullptr)) {
+            MemBlockRawAllocCount_.fetch_add(1, std::memory_order_relaxed);
+            if (lvidx < kMemBlockLevelCount)
+               MemBlockPoolHeader(mblk.MemPtr_).Owner_ = nullptr;
             return mblk.MemPtr_;
+         }
+      }
       mblk.Size_ = 0;
       return mblk.MemPtr_ = nullptr;
    }
@@ -171,23 +555,34 @@ public:
       const MemBlockSize oldsz = mblk.size();
       if (oldsz >= newsz)
          return mblk.begin();
+      this->Free(mblk.Release(), oldsz);
       const unsigned lvidx = MemBlockSizeToIndex(newsz);
       if (lvidx >= kMemBlockLevelCount)
          return this->UseMalloc(mblk, newsz);
 
-      this->Free(mblk.Release(), oldsz);
-      newsz = MemBlockLevelSize_[lvidx];
-      TCacheLevelPool& lv = this->Levels_[lvidx];
+      newsz = MemBlockLevelSize(lvidx);
+      TCacheLevelPool&           lv = this->Levels_[lvidx];
+      MemBlockOwner::LevelStat&  stat = this->Owner_->Stats_[lvidx];
       if (lv.FreeMemCurr_.empty())
          lv.FreeMemCurr_ = std::move(lv.FreeMemNext_);
       byte* pmem = reinterpret_cast<byte*>(lv.FreeMemCurr_.pop_front());
       if (fon9_UNLIKELY(pmem == nullptr)) {
-         if ((pmem = this->Center_->Alloc(lvidx, lv)) == nullptr) {
-            ++lv.EmptyCount_;
-            if ((pmem = static_cast<byte*>(malloc(newsz))) == nullptr)
-               return nullptr;
+         // 優先使用其他 thread 歸還的記憶體, 若沒有才跟 MemBlockCenter 要.
+         lv.FreeMemCurr_ = this->Owner_->TakeRemoteFree(lvidx);
+         if ((pmem = reinterpret_cast<byte*>(lv.FreeMemCurr_.pop_front())) == nullptr) {
+            if ((pmem = this->Center_->Alloc(lvidx, lv)) != nullptr)
+               MemBlockStatAdd(stat.CenterRefillCount_, 1);
+            else {
+               ++lv.EmptyCount_;
+               if ((pmem = MemBlockPoolMalloc(newsz)) == nullptr)
+                  return nullptr;
+               MemBlockStatAdd(stat.MallocFallbackCount_, 1);
+            }
          }
       }
+      MemBlockStatAdd(stat.AllocCount_, 1);
+      stat.CachedCount_.store(lv.FreeMemCurr_.size() + lv.FreeMemNext_.size(), std::memory_order_relaxed);
+      MemBlockPoolHeader(pmem).Owner_ = this->Owner_;
       mblk.Size_ = static_cast<SSizeT>(newsz);
       return mblk.MemPtr_ = pmem;
    }
@@ -196,23 +591,39 @@ public:
          return;
       const unsigned lvidx = MemBlockSizeToIndex(sz);
       if (fon9_UNLIKELY(lvidx >= kMemBlockLevelCount)) {
-         ::free(ptr);
+         MemBlockRawFree(ptr);
+         return;
+      }
+      if (fon9_UNLIKELY(sz != MemBlockLevelSize(lvidx))) {
+         // 不是 level size 的區塊, 不可放入 FreeMemList, 否則下次分配時會被當成完整的 level block 使用.
+         FreeRaw(ptr, sz);
          return;
       }
-      assert(sz == MemBlockLevelSize_[lvidx]);
+      MemBlockOwner* owner = MemBlockPoolHeader(ptr).Owner_;
       // 重建 node = 初始值. 然後放入 list.
-      FreeMemNode*      node = InplaceNew<FreeMemNode>(ptr);
-      const size_t      maxNodeCount = MemBlockLevelMaxNodeCount_[lvidx];
+      FreeMemNode*   node = InplaceNew<FreeMemNode>(ptr);
+      if (owner && owner != this->Owner_) {
+         // 在其他 thread 分配的記憶體, 直接歸還給分配者, 避免經過 MemBlockCenter 的 SpinMutex.
+         owner->PushRemoteFree(lvidx, node);
+         return;
+      }
+      MemBlockOwner::LevelStat& stat = this->Owner_->Stats_[lvidx];
+      if (fon9_LIKELY(owner))
+         MemBlockStatAdd(stat.FreeCount_, 1);
+      else // 在 TCache 建立前(或 MemBlockCenter 結束後)分配的, 歸還後成為本地 pool 的一員.
+         MemBlockRawFreeCount_.fetch_add(1, std::memory_order_relaxed);
+      const size_t      maxNodeCount = MemBlockLevels_.MaxNodeCount_[lvidx];
       TCacheLevelPool&  lv = this->Levels_[lvidx];
       FreeMemList*      fmlist = (lv.FreeMemCurr_.size() < maxNodeCount ? &lv.FreeMemCurr_
                                   : lv.FreeMemNext_.size() < maxNodeCount ? &lv.FreeMemNext_
                                   : nullptr);
-      if (fon9_LIKELY(fmlist)) {
+      if (fon9_LIKELY(fmlist))
          fmlist->push_front(node);
-         return;
+      else {
+         this->Center_->FreeFull(lvidx, std::move(lv.FreeMemCurr_));
+         lv.FreeMemCurr_.push_front(node);
       }
-      this->Center_->FreeFull(lvidx, std::move(lv.FreeMemCurr_));
-      lv.FreeMemCurr_.push_front(node);
+      stat.CachedCount_.store(lv.FreeMemCurr_.size() + lv.FreeMemNext_.size(), std::memory_order_relaxed);
    }
 };
 static thread_local StaticPtr<MemBlock::TCache> TlsTCache_;
@@ -239,7 +650,7 @@ void MemBlock::FreeBlock(void* mem, MemBlockSize sz) {
       if (fon9_LIKELY(TCache_))
          TCache_->Free(mem, sz);
       else
-         free(mem);
+         TCache::FreeNoCache(mem, sz);
    }
 }
 
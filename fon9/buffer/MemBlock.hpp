@@ -35,7 +35,8 @@ public:
       this->Alloc(sz);
    }
 
-   MemBlock(MemBlock&& r) : MemPtr_(r.Release()), Size_(r.Size_) {
+   MemBlock(MemBlock&& r) : MemPtr_(r.MemPtr_), Size_(r.Size_) {
+      r.Release();
    }
    MemBlock& operator=(MemBlock&& r) {
       if (this->MemPtr_ != r.MemPtr_) {
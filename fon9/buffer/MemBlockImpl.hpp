@@ -6,55 +6,219 @@
 #include "fon9/SinglyLinkedList.hpp"
 #include "fon9/SpinMutex.hpp"
 #include "fon9/Timer.hpp"
+#include "fon9/StrView.hpp"
 #include <array>
+#include <atomic>
 
 namespace fon9 {
 
-#ifdef _MSC_VER
-#pragma intrinsic(_BitScanReverse) 
-#endif
+enum : unsigned {
+   /// 最多可設定的等級數量.
+   kMemBlockLevelCount = 16,
+};
+enum : MemBlockSize {
+   /// 每個等級的大小必須是 kMemBlockLevelGranularity 的倍數.
+   kMemBlockLevelGranularity = 64,
+   /// 最大等級的大小上限, 超過此大小一律使用 malloc().
+   kMemBlockLevelMaxSize = 1024 * 256,
+   /// 使用 huge page slab 的等級, 每次從系統取得 kMemBlockSlabSize 的記憶體, 然後切割使用.
+   kMemBlockSlabSize = 1024 * 1024 * 2,
+};
+
+fon9_WARN_DISABLE_PADDING;
+/// MemBlock 的大小等級設定.
+/// - 在第一次使用 MemBlock 時(建立第一個 MemBlockCenter 時)確定, 之後不可再變動.
+/// - 預設為: 128B, 256B, 512B, 1K, 4K, 16K, 64K; 其中 4K 以上使用 huge page slab.
+/// - 可在第一次使用 MemBlock 之前, 透過 MemBlockConfigLevels() 設定;
+///   或使用環境變數 "fon9_MemBlockLevels", "fon9_MemBlockHugePage" 設定, 格式請參考 MemBlockConfigLevels().
+struct MemBlockLevels {
+   /// 在確定之前 MaxSize_ == 0, 此時 MemBlockSizeToIndex() 一律傳回 kMemBlockLevelCount;
+   MemBlockSize   MaxSize_;
+   unsigned       Count_;
+   MemBlockSize   Sizes_[kMemBlockLevelCount];
+   size_t         MaxNodeCount_[kMemBlockLevelCount];
+   /// 此等級是否使用 huge page slab 分配.
+   bool           UseSlab_[kMemBlockLevelCount];
+   /// MemBlockSizeToIndex() 的查表: Index_[(size - 1) / kMemBlockLevelGranularity];
+   uint8_t        Index_[kMemBlockLevelMaxSize / kMemBlockLevelGranularity];
+};
+fon9_WARN_POP;
+extern fon9_API MemBlockLevels MemBlockLevels_;
 
+/// 若傳回值 >= MemBlockLevelCount() 表示 sz 超過 pool 的範圍, 使用 malloc().
 inline unsigned MemBlockSizeToIndex(MemBlockSize sz) {
-#ifdef _MSC_VER
-   unsigned long res;
-   if (!_BitScanReverse(&res, (sz - 1) >> 6))
-      return 0;
-#else
-   if ((sz = (sz - 1) >> 6) == 0)
-      return 0;
-   unsigned res = 31 - __builtin_clz(sz);
-#endif
-   if (res <= 3) // size <= 1024
-      return res;
-   return (res >> 1) + 2;
+   if (fon9_UNLIKELY(--sz >= MemBlockLevels_.MaxSize_))
+      return kMemBlockLevelCount;
+   return MemBlockLevels_.Index_[sz / kMemBlockLevelGranularity];
+}
+inline unsigned MemBlockLevelCount() {
+   return MemBlockLevels_.Count_;
+}
+inline MemBlockSize MemBlockLevelSize(unsigned lvidx) {
+   assert(lvidx < MemBlockLevelCount());
+   return MemBlockLevels_.Sizes_[lvidx];
 }
 
-enum : unsigned {
-   kMemBlockLevelCount = 7
-};
+/// 設定 MemBlock 的大小等級, 必須在第一次使用 MemBlock 之前呼叫, 否則傳回 false.
+/// - cfgLevels: "size[/maxNodeCount],..."; size 可用 K 結尾, 表示 * 1024; 例:
+///   "64,128,192,256,320,384,448,512,1K,4K,16K,64K,256K/8"
+///   - size 必須為 kMemBlockLevelGranularity 的倍數, 由小到大排列, 最多 kMemBlockLevelCount 個等級.
+///   - maxNodeCount: 每個 thread 每個串列的最大節點數量, 預設: size < 1K 為 1024, 其餘為 32.
+/// - hugePageMinSize: size >= hugePageMinSize 的等級, 使用 huge page slab 分配; 0 表示不使用.
+///   - Linux: 優先使用 MAP_HUGETLB, 若失敗則使用一般的 mmap() + madvise(MADV_HUGEPAGE).
+///   - Windows: 優先使用 MEM_LARGE_PAGES, 若失敗則使用一般的 VirtualAlloc().
+fon9_API bool MemBlockConfigLevels(StrView cfgLevels, MemBlockSize hugePageMinSize);
 
-constexpr std::array<MemBlockSize, kMemBlockLevelCount> MemBlockLevelSize_{
-   128,
-   256,
-   512,
-   1024,
-   1024 * 4,
-   1024 * 16,
-   1024 * 64,
+//--------------------------------------------------------------------------//
+
+/// MemBlock 各等級的使用統計, 透過 MemBlockGetStats() 取得.
+/// - 各 thread 的計數器由 thread 自己更新(不使用 lock), 取得統計時才加總, 所以僅供監控參考.
+/// - 其他 thread 歸還的記憶體, 在 owner thread 取回(或 thread 結束回收)時才計入 FreeCount_.
+struct MemBlockLevelStat {
+   /// 0 表示: 直接使用 malloc() 的統計(超過 pool 範圍, 或 thread 結束後的分配).
+   MemBlockSize   BlockSize_;
+   uint64_t       AllocCount_;
+   uint64_t       FreeCount_;
+   /// = AllocCount_ - FreeCount_;
+   uint64_t       InUseCount_;
+   /// InUseCount_ 的最大值, 由 MemBlockCenter 定時(及 MemBlockGetStats() 時)取樣.
+   uint64_t       InUseHighWater_;
+   /// thread 本地的 pool 用完時, 從 MemBlockCenter 取得一個 FreeMemList 的次數.
+   uint64_t       CenterRefillCount_;
+   /// MemBlockCenter 也沒有可用的 FreeMemList, 只好使用 malloc() 的次數.
+   uint64_t       MallocFallbackCount_;
+   /// MemBlockCenter 保留的 FreeMemList 超過需求, 釋放的 FreeMemList 數量.
+   uint64_t       TrimCount_;
+   /// 目前各 thread 本地 pool 保留的 MemBlock 數量合計.
+   uint64_t       ThreadCachedCount_;
+   /// 目前 MemBlockCenter(全部 NUMA nodes) 保留的 FreeMemList 數量合計.
+   uint64_t       CenterReservedCount_;
 };
+using MemBlockStats = std::array<MemBlockLevelStat, kMemBlockLevelCount + 1>;
+/// 取得 MemBlock 的使用統計.
+/// \retval 有效的統計數量 = MemBlockLevelCount() + 1; 最後一筆為直接使用 malloc() 的統計.
+fon9_API unsigned MemBlockGetStats(MemBlockStats& stats);
 
 //--------------------------------------------------------------------------//
 
 namespace impl {
+struct MemBlockOwner;
+
+/// 由 MemBlock pool 分配的記憶體(size <= MemBlockLevels_.MaxSize_), 在傳回給使用者的位置之前,
+/// 會保留一個 MemBlockHeader, 記錄分配此區塊的 MemBlockOwner(也就是分配時的 thread).
+/// 釋放時若不是在 owner thread, 則直接透過 lock-free 的方式歸還給 owner, 不用經過 MemBlockCenter.
+struct MemBlockHeader {
+   MemBlockOwner* Owner_;
+   /// 0 表示由 malloc() 分配; 否則為 (從 huge page slab 切割時的等級 + 1).
+   uint32_t       SlabLevel_;
+   uint32_t       Padding_; // 讓使用者的記憶體保持 16 bytes 對齊.
+};
+static_assert(sizeof(MemBlockHeader) == 16, "sizeof(MemBlockHeader) must be 16.");
+
+inline MemBlockHeader& MemBlockPoolHeader(void* mem) {
+   return *reinterpret_cast<MemBlockHeader*>(static_cast<byte*>(mem) - sizeof(MemBlockHeader));
+}
+/// 分配一塊 pool 使用的記憶體: 包含 MemBlockHeader, 傳回值為 header 之後的位置.
+inline byte* MemBlockPoolMalloc(MemBlockSize sz) {
+   if (byte* mem = static_cast<byte*>(::malloc(sz + sizeof(MemBlockHeader)))) {
+      mem += sizeof(MemBlockHeader);
+      MemBlockPoolHeader(mem).SlabLevel_ = 0;
+      return mem;
+   }
+   return nullptr;
+}
+/// 歸還從 huge page slab 切割出來的記憶體, slab 不會還給系統, 放到 slab 的備用串列, 給 MemBlockCenter 再次使用.
+fon9_API void MemBlockSlabFree(void* mem);
+/// 釋放由 MemBlockPoolMalloc() 或 huge page slab 分配的記憶體.
+inline void MemBlockPoolFree(void* mem) {
+   if (fon9_UNLIKELY(MemBlockPoolHeader(mem).SlabLevel_))
+      MemBlockSlabFree(mem);
+   else
+      ::free(static_cast<byte*>(mem) - sizeof(MemBlockHeader));
+}
+
+/// 僅由一個 thread 更新的計數器, 其他 thread 只會讀取, 所以不需要 atomic 的 fetch_add().
+inline void MemBlockStatAdd(std::atomic<uint64_t>& counter, uint64_t n) {
+   counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
 struct FreeMemNode : public SinglyLinkedListNode<FreeMemNode> {
    fon9_NON_COPY_NON_MOVE(FreeMemNode);
    FreeMemNode() = default;
    inline friend void FreeNode(FreeMemNode* mnode) {
-      ::free(mnode);
+      MemBlockPoolFree(mnode);
    }
 };
 using FreeMemList = SinglyLinkedList<FreeMemNode>;
 
+/// 每個使用 MemBlock 的 thread, 擁有一個 MemBlockOwner.
+/// - 其他 thread 釋放屬於此 owner 的記憶體時, 透過 PushToHead() 放入 RemoteFree_[lvidx];
+///   owner thread 在本地 pool 用完時, 一次取走(exchange)整個串列; 所以沒有 ABA 的問題.
+/// - MemBlockOwner 建立後不會刪除(因為別的 thread 可能還持有屬於他的記憶體),
+///   thread 結束後 InUse_ = false, 之後可由新的 thread 接手,
+///   或由 MemBlockCenter 定時回收 RemoteFree_ 裡面的記憶體.
+struct MemBlockOwner {
+   fon9_NON_COPY_NON_MOVE(MemBlockOwner);
+   MemBlockOwner() {
+      for (auto& rlist : this->RemoteFree_)
+         rlist.store(nullptr, std::memory_order_relaxed);
+   }
+   std::array<std::atomic<FreeMemNode*>, kMemBlockLevelCount> RemoteFree_;
+
+   /// 由使用此 owner 的 thread 更新(thread 結束後, 由回收者更新), 參考 MemBlockLevelStat.
+   struct LevelStat {
+      std::atomic<uint64_t>   AllocCount_{0};
+      std::atomic<uint64_t>   FreeCount_{0};
+      std::atomic<uint64_t>   CenterRefillCount_{0};
+      std::atomic<uint64_t>   MallocFallbackCount_{0};
+      std::atomic<uint64_t>   CachedCount_{0};
+   };
+   std::array<LevelStat, kMemBlockLevelCount> Stats_;
+
+   std::atomic<bool> InUse_{true};
+   /// 全部的 MemBlockOwner 串成一個只增不減的串列.
+   MemBlockOwner*    NextOwner_{nullptr};
+
+   /// 取走 RemoteFree_[lvidx] 的全部節點.
+   FreeMemList TakeRemoteFree(unsigned lvidx) {
+      if (this->RemoteFree_[lvidx].load(std::memory_order_relaxed) == nullptr)
+         return FreeMemList{};
+      FreeMemNode* head = this->RemoteFree_[lvidx].exchange(nullptr, std::memory_order_acquire);
+      const size_t count = CalcNodeCount(head);
+      MemBlockStatAdd(this->Stats_[lvidx].FreeCount_, count);
+      return FreeMemList{head, count};
+   }
+   void PushRemoteFree(unsigned lvidx, FreeMemNode* node) {
+      PushToHead(this->RemoteFree_[lvidx], node, node);
+   }
+
+   /// 取得一個可用的 MemBlockOwner: 優先接手已結束 thread 的 owner, 若沒有則建立新的.
+   static MemBlockOwner* Adopt();
+   /// 嘗試取得一個已結束 thread 的 owner 的使用權, 由 fnRecycle(owner) 回收 owner.RemoteFree_ 之後,
+   /// 再將 owner 設為未使用.
+   template <class FnRecycle>
+   static void RecycleAbandoned(FnRecycle&& fnRecycle);
+   static MemBlockOwner* Head();
+
+   bool TryClaim() {
+      return !this->InUse_.load(std::memory_order_relaxed)
+         && !this->InUse_.exchange(true, std::memory_order_acquire);
+   }
+   void Abandon() {
+      this->InUse_.store(false, std::memory_order_release);
+   }
+};
+
+template <class FnRecycle>
+void MemBlockOwner::RecycleAbandoned(FnRecycle&& fnRecycle) {
+   for (MemBlockOwner* owner = Head(); owner; owner = owner->NextOwner_) {
+      if (owner->TryClaim()) {
+         fnRecycle(*owner);
+         owner->Abandon();
+      }
+   }
+}
+
 //--------------------------------------------------------------------------//
 
 enum class TCacheLevelFlag {
@@ -129,6 +293,7 @@ class MemBlockCenter : public intrusive_ref_counter<MemBlockCenter> {
       CenterLevelList   Recycle_;  // 尚未整理的歸還, 每個 FreeMemList 數量不定.
       size_t            ReservedCount_{4}; // 預設 or 透過 MemBlockInit() 設定的最少串列保留數量.
       size_t            RequiredCount_{0}; // 每個 thread 會要求增加一個保留數量.
+      uint64_t          TrimCount_{0};     // 保留數量超過需求時, 釋放的串列數量.
    };
    using CenterLevel = MustLock<CenterLevelImpl, SpinBusy>;
 
@@ -139,18 +304,37 @@ class MemBlockCenter : public intrusive_ref_counter<MemBlockCenter> {
    DataMemberEmitOnTimer<&MemBlockCenter::EmitOnTimer> Timer_;
 
    void InitLevel(unsigned lvidx, CenterLevel::Locker& lvCenter);
+   /// 補足 fmlist 的節點數量, 直到 maxNodeCount; 若該等級使用 huge page slab, 則從 slab 切割.
+   static void FillFreeMemList(unsigned lvidx, FreeMemList& fmlist, size_t maxNodeCount);
 public:
-   MemBlockCenter();
+   /// 此 center 負責的 NUMA node.
+   const unsigned NumaNode_;
+
+   MemBlockCenter(unsigned numaNode);
    ~MemBlockCenter();
 
    byte* Alloc(unsigned lvidx, TCacheLevelPool& lv);
    void FreeFull(unsigned lvidx, FreeMemList&& fmlist);
    void Recycle(TCacheLevelPools& levels);
+   /// 將 owner.RemoteFree_ 的全部節點移到 Recycle_, 等候整理.
+   void RecycleRemote(MemBlockOwner& owner);
    void InitLevel(unsigned lvidx, const size_t* reserveFreeListCount);
+   /// 加總此 center 的 TrimCount_, CenterReservedCount_;
+   void GetStats(MemBlockStats& stats);
 };
 fon9_WARN_POP;
 
+/// 設定 size 所在等級的保留數量.
+/// - 會套用到全部已建立的 MemBlockCenter(每個 NUMA node 一個), 及之後建立的 MemBlockCenter.
 fon9_API bool MemBlockInit(MemBlockSize size, size_t reserveFreeListCount, size_t maxNodeCount);
+
+/// 取得目前 thread 所在的 NUMA node; 若無法取得, 則傳回 0.
+fon9_API unsigned GetCurrentNumaNode();
+
+enum : unsigned {
+   /// 最多支援的 NUMA node 數量, 超過此數量的 node, 共用最後一個 MemBlockCenter.
+   kMemBlockMaxNumaNodes = 8
+};
 } // namespace impl
 } // namespace fon9
 #endif//__fon9_buffer_MemBlockImpl_hpp__
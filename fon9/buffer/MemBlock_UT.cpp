@@ -126,6 +126,71 @@ fon9_WARN_POP;
 
 //--------------------------------------------------------------------------//
 
+// ThrA:Alloc => ThrB:Free 之後, 記憶體應直接歸還給 ThrA(不經過 MemBlockCenter), ThrA 再次分配時可以取回.
+void TestRemoteFree() {
+   static const unsigned   kCount = 100;
+   std::vector<fon9::byte*> ptrs;
+   std::vector<fon9::MemBlock> blks(kCount);
+   for (fon9::MemBlock& blk : blks)
+      ptrs.push_back(blk.Alloc(1000));
+   std::thread thr{[&blks]() {
+      blks.clear();
+   }};
+   thr.join();
+   std::sort(ptrs.begin(), ptrs.end());
+   // ThrA 的 cache 可能還有剩餘的記憶體, 所以多分配一些, 直到取回全部歸還的記憶體.
+   unsigned reused = 0;
+   blks.resize(kCount * 4);
+   for (fon9::MemBlock& blk : blks) {
+      if (std::binary_search(ptrs.begin(), ptrs.end(), blk.Alloc(1000)))
+         if (++reused == kCount)
+            break;
+   }
+   std::cout << "[" << (reused == kCount ? "OK   " : "ERROR") << "] RemoteFree: reused=" << reused << "/" << kCount << std::endl;
+   if (reused != kCount)
+      abort();
+}
+
+//--------------------------------------------------------------------------//
+
+// MemBlockGetStats(): 本 thread 的分配及歸還, 應立即反應在統計裡.
+void TestStats() {
+   static const unsigned   kCount = 10;
+   fon9::MemBlockStats     before, after;
+   const unsigned          lvidx = fon9::MemBlockSizeToIndex(1000);
+   const unsigned          rawidx = fon9::MemBlockGetStats(before) - 1;
+   bool                    isOK = true;
+   {
+      std::vector<fon9::MemBlock> blks(kCount);
+      for (fon9::MemBlock& blk : blks)
+         blk.Alloc(1000);
+      fon9::MemBlock big{fon9::kMemBlockLevelMaxSize + 1};
+      fon9::MemBlockGetStats(after);
+      isOK = (after[lvidx].AllocCount_ - before[lvidx].AllocCount_ == kCount
+              && after[lvidx].InUseCount_ >= kCount
+              && after[lvidx].InUseHighWater_ >= after[lvidx].InUseCount_
+              && after[rawidx].AllocCount_ - before[rawidx].AllocCount_ == 1
+              && after[rawidx].BlockSize_ == 0);
+   }
+   fon9::MemBlockGetStats(after);
+   isOK = isOK && (after[lvidx].FreeCount_ - before[lvidx].FreeCount_ == kCount
+                   && after[rawidx].FreeCount_ - before[rawidx].FreeCount_ == 1);
+   for (unsigned L = 0; L <= rawidx; ++L) {
+      const fon9::MemBlockLevelStat& st = after[L];
+      std::cout << "BlockSize=" << std::setw(7) << st.BlockSize_
+         << "|Alloc=" << st.AllocCount_ << "|Free=" << st.FreeCount_
+         << "|InUse=" << st.InUseCount_ << "|HighWater=" << st.InUseHighWater_
+         << "|Refill=" << st.CenterRefillCount_ << "|Fallback=" << st.MallocFallbackCount_
+         << "|Trim=" << st.TrimCount_ << "|Cached=" << st.ThreadCachedCount_
+         << "|Reserved=" << st.CenterReservedCount_ << std::endl;
+   }
+   std::cout << "[" << (isOK ? "OK   " : "ERROR") << "] MemBlockGetStats()" << std::endl;
+   if (!isOK)
+      abort();
+}
+
+//--------------------------------------------------------------------------//
+
 int main() {
 #if defined(_MSC_VER) && defined(_DEBUG)
    _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
@@ -140,21 +205,32 @@ int main() {
                 "3.MemBlock主要用途是提供 async io 的緩衝區基底.\n"
                 "4.此測試的主要目的是驗證正確性\n";
 
+   // 使用自訂的大小等級: 較細的 64B 等級, 及 256K 的等級; 4K 以上使用 huge page slab.
+   if (!fon9::MemBlockConfigLevels(fon9::StrView{"64,128,192,256,384,512,1K,4K,16K,64K,256K/8"}, 1024 * 4)) {
+      std::cout << "[ERROR] MemBlockConfigLevels()" << std::endl;
+      abort();
+   }
+   if (fon9::MemBlockConfigLevels(fon9::StrView{"128,256"}, 0)) {
+      std::cout << "[ERROR] MemBlockConfigLevels(): cannot config again." << std::endl;
+      abort();
+   }
+   fon9::MemBlock{1}; // 第一次使用 MemBlock, 確定大小等級.
+   const unsigned kLevelCount = fon9::MemBlockLevelCount();
    unsigned idx = 0xff;
    for (unsigned L = 0; L < 0xfffff; ++L) {
       unsigned n = fon9::MemBlockSizeToIndex(L);
-      bool isOK = (n >= fon9::MemBlockLevelSize_.size() || L <= fon9::MemBlockLevelSize_[n]);
+      bool isOK = (n >= kLevelCount || L <= fon9::MemBlockLevelSize(n));
       if (n != idx || !isOK) {
          if (n != idx) {
             idx = n;
-            if (0 < n && n < fon9::kMemBlockLevelCount && isOK && (fon9::MemBlockLevelSize_[n - 1] != (L - 1)))
+            if (0 < n && n < kLevelCount && isOK && (fon9::MemBlockLevelSize(n - 1) != (L - 1)))
                isOK = false;
          }
          std::cout << "size=" << std::setw(7) << L << "|index=" << idx;
-         if (idx >= fon9::MemBlockLevelSize_.size())
+         if (idx >= kLevelCount)
             std::cout << "|use malloc()" << std::endl;
          else {
-            std::cout << "|use MemPool.Size=" << std::setw(7) << fon9::MemBlockLevelSize_[idx];
+            std::cout << "|use MemPool.Size=" << std::setw(7) << fon9::MemBlockLevelSize(idx);
             if (isOK)
                std::cout << "|OK!" << std::endl;
             else {
@@ -165,6 +241,11 @@ int main() {
       }
    }
 
+   utinfo.PrintSplitter();
+   TestRemoteFree();
+   utinfo.PrintSplitter();
+   TestStats();
+
    utinfo.PrintSplitter();
    static const unsigned   kTimes = 1000 * 1000;
 
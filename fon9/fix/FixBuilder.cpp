@@ -1,6 +1,7 @@
 ﻿// \file fon9/fix/FixBuilder.cpp
 // \author fonwinz@gmail.com
 #include "fon9/fix/FixBuilder.hpp"
+#include "fon9/fix/FixScan.hpp"
 
 namespace fon9 { namespace fix {
 
@@ -15,28 +16,63 @@ void FixBuilder::PutUtcNow() {
       this->PutUtcTime(UtcNow());
 }
 
-BufferList FixBuilder::Final(const StrView& beginHeader) {
-   assert(this->CheckSumPos_ != nullptr);
-   const size_t bodyLength = CalcDataSize(this->Buffer_.cfront()) - kFixTailWidth;
-   RevPrint(this->Buffer_, beginHeader, bodyLength);
-
-   char* const psum = this->CheckSumPos_;
-   this->CheckSumPos_ = nullptr;
-   this->TimeFIXMS_ = nullptr;
-
+void FixBuilder::UpdateCheckSum() {
+   assert(this->CksPos_ != nullptr);
+   const char* const pcur = this->Buffer_.GetCurrent();
+   if (pcur == this->CksPos_)
+      return;
+   // 新資料在 CksPos_ 之前: [cfront..CksPos_), 從前端的 node 開始計算, 直到 CksPos_ 所在的 node.
    const BufferNode* cfront = this->Buffer_.cfront();
-   byte  cks = f9fix_kCHAR_SPL;
+   const byte* const pstop = reinterpret_cast<const byte*>(this->CksPos_);
    while (cfront) {
-      const byte* pend = cfront->GetDataEnd();
       const byte* pbeg = cfront->GetDataBegin();
-      if ((cfront = cfront->GetNext()) == nullptr)
-         pend = reinterpret_cast<byte*>(psum);
-      for (; pbeg != pend; ++pbeg)
-         cks = static_cast<byte>(cks + *pbeg);
+      const byte* pend = cfront->GetDataEnd();
+      const bool  isLast = (pbeg <= pstop && pstop <= pend);
+      if (isLast)
+         pend = pstop;
+      const size_t sz = static_cast<size_t>(pend - pbeg);
+      this->Cks_ = FixCheckSum(pbeg, sz, this->Cks_);
+      this->CksSize_ += sz;
+      if (isLast)
+         break;
+      cfront = cfront->GetNext();
    }
+   this->CksPos_ = pcur;
+}
+BufferList FixBuilder::Final(const StrView& beginHeader) {
+   assert(this->CheckSumPos_ != nullptr);
+   this->UpdateCheckSum();
+   RevPrint(this->Buffer_, beginHeader, this->CksSize_);
+   this->UpdateCheckSum();
 
-   this->PutCheckSumField(psum, cks);
+   this->PutCheckSumField(this->CheckSumPos_, this->Cks_);
+   this->CheckSumPos_ = nullptr;
+   this->TimeFIXMS_ = nullptr;
+   this->CksPos_ = nullptr;
    return this->Buffer_.MoveOut();
 }
+//--------------------------------------------------------------------------//
+void FixHeaderTemplate::Reset(const StrView& compIDsHeader) {
+   static const char kFldSendingTime[] = f9fix_SPLTAGEQ(SendingTime);
+   this->Str_.clear();
+   this->Str_.append(kFldSendingTime, sizeof(kFldSendingTime) - 1);
+   this->Str_.append(kDateTimeStrWidth_FIXMS, '0');
+   this->Str_.append(compIDsHeader.begin(), compIDsHeader.size());
+   this->CksConst_ = FixCheckSum(kFldSendingTime, sizeof(kFldSendingTime) - 1);
+   this->CksConst_ = FixCheckSum(compIDsHeader.begin(), compIDsHeader.size(), this->CksConst_);
+   this->CksTime_ = 0;
+   this->TimeMS_ = -1;
+}
+void FixHeaderTemplate::SetSendingTime(TimeStamp now) {
+   static_assert(TimeStamp::Scale >= 3, "TimeStamp::Scale must >= 3(ms).");
+   const int64_t ms = now.GetOrigValue() / static_cast<int64_t>(TimeStamp::Divisor / 1000);
+   if (this->TimeMS_ == ms)
+      return;
+   assert(!this->empty());
+   this->TimeMS_ = ms;
+   char* const pend = this->Str_.begin() + sizeof(f9fix_SPLTAGEQ(SendingTime)) - 1 + kDateTimeStrWidth_FIXMS;
+   ToStrRev_FIXMS(pend, now);
+   this->CksTime_ = FixCheckSum(pend - kDateTimeStrWidth_FIXMS, kDateTimeStrWidth_FIXMS);
+}
 
 } } // namespaces
@@ -5,6 +5,7 @@
 #include "fon9/fix/FixBase.hpp"
 #include "fon9/RevPrint.hpp"
 #include "fon9/TimeStamp.hpp"
+#include "fon9/CharVector.hpp"
 
 namespace fon9 { namespace fix {
 
@@ -29,17 +30,29 @@ namespace fon9 { namespace fix {
 ///        f9fix_SPLTAGEQ(SenderCompID) "Server");
 ///   auto fixmsg = fbuf.Final(f9fix_BEGIN_HEADER_V44);
 /// \endcode
+/// - CheckSum 採累加方式計算:
+///   - 已計算過的範圍: [CksPos_..CheckSumPos_), 累加結果在 Cks_, 長度在CksSize_;
+///   - UpdateCheckSum() 僅計算新加入(在 CksPos_ 之前)的資料;
+///   - 預先計算好 CheckSum 的內容(例: FixHeaderTemplate), 可用 RevPutMemCks() 加入, 不用再次計算;
+///   - 所以 Final() 只需要計算尚未計算過的部分, 也不用再次計算 BodyLength.
 class fon9_API FixBuilder {
    fon9_NON_COPYABLE(FixBuilder);
    RevBufferList  Buffer_{512};
    char*          CheckSumPos_;
    const char*    TimeFIXMS_;
    TimeStamp      Time_;
+   const char*    CksPos_;
+   size_t         CksSize_;
+   byte           Cks_;
 
    void Start() {
       this->TimeFIXMS_ = nullptr;
       this->CheckSumPos_ = this->Buffer_.AllocPrefix(kFixTailWidth);
       this->Buffer_.SetPrefixUsed(this->CheckSumPos_ -= kFixTailWidth);
+      this->CksPos_ = this->CheckSumPos_;
+      this->CksSize_ = 0;
+      // CheckSum 的範圍包含 "|10=" 之前的 '|';
+      this->Cks_ = f9fix_kCHAR_SPL;
    }
 public:
    FixBuilder() {
@@ -49,6 +62,7 @@ public:
       if (isManualStart) {
          this->CheckSumPos_ = nullptr;
          this->TimeFIXMS_ = nullptr;
+         this->CksPos_ = nullptr;
       }
       else
          this->Start();
@@ -89,6 +103,18 @@ public:
       assert(this->CheckSumPos_ == nullptr);
       return this->Start();
    }
+   /// 計算(到目前為止)尚未計算過的資料的 CheckSum, 累加到內部的 CheckSum.
+   /// - 之後再加入的資料(在目前資料之前), 在下次 UpdateCheckSum() 或 Final() 時才計算.
+   void UpdateCheckSum();
+   /// 加入已預先計算好 CheckSum 的內容, 例如: 固定的 header 欄位.
+   /// - 會先呼叫 UpdateCheckSum(), 然後加入 mem, 並直接累加 cks.
+   void RevPutMemCks(const void* mem, size_t size, byte cks) {
+      this->UpdateCheckSum();
+      RevPutMem(this->Buffer_, mem, size);
+      this->CksPos_ = this->Buffer_.GetCurrent();
+      this->CksSize_ += size;
+      this->Cks_ = static_cast<byte>(this->Cks_ + cks);
+   }
    /// 訊息建立完畢, 最終填入 BeginString, BodyLength, 計算 CheckSum.
    /// \param beginHeader "8=FIX.4.x|9=" 這裡不檢查 header 是否正確!
    /// \return 傳回建立好的 FIX Message: 包含 beginHeader + body + checksum.
@@ -116,7 +142,53 @@ public:
    TimeStamp GetUtcNow() const {
       return this->Time_;
    }
+   /// 是否已呼叫過 PutUtcNow() 或 PutUtcTime(); 若是, 則 GetUtcNow() 為當時填入的時間.
+   bool HasUtcTime() const {
+      return this->TimeFIXMS_ != nullptr;
+   }
+};
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup fix
+/// 每個 FIX session 預先建立好的 header 欄位: "|52=SendingTime|CompIDs".
+/// - 傳送訊息時, 只需要在同一塊記憶體內, 更新 SendingTime(同一毫秒內不用更新),
+///   再透過 FixBuilder::RevPutMemCks() 一次填入, 不用再格式化時間, 也不用重算這段的 CheckSum.
+/// - 不負責 thread safe, 例: FixSender 在 Lock() 狀態下使用.
+class fon9_API FixHeaderTemplate {
+   fon9_NON_COPY_NON_MOVE(FixHeaderTemplate);
+   /// "|52=yyyymmdd-hh:mm:ss.sss" + compIDsHeader;
+   CharVector  Str_;
+   /// 目前 SendingTime(毫秒) 的值, 及 SendingTime 的 CheckSum.
+   int64_t     TimeMS_{-1};
+   byte        CksTime_{0};
+   /// 除了 SendingTime 之外, 其餘固定內容的 CheckSum.
+   byte        CksConst_{0};
+
+public:
+   FixHeaderTemplate() = default;
+
+   /// 建立樣板, 建立後 SendingTime 尚未設定, 必須先呼叫 SetSendingTime().
+   /// \param compIDsHeader 例: CompIDs::Header_;
+   void Reset(const StrView& compIDsHeader);
+   bool empty() const {
+      return this->Str_.empty();
+   }
+
+   /// 若 now 與目前樣板的時間不是同一毫秒, 則更新樣板裡面的 SendingTime.
+   void SetSendingTime(TimeStamp now);
+
+   StrView ToStrView() const {
+      return fon9::ToStrView(this->Str_);
+   }
+   byte GetCheckSum() const {
+      return static_cast<byte>(this->CksConst_ + this->CksTime_);
+   }
+   /// 將樣板填入 fixmsgBuilder.
+   void RevPutTo(FixBuilder& fixmsgBuilder) const {
+      fixmsgBuilder.RevPutMemCks(this->Str_.begin(), this->Str_.size(), this->GetCheckSum());
+   }
 };
+fon9_WARN_POP;
 
 } } // namespace
 #endif//__fon9_fix_FixBuilder_hpp__
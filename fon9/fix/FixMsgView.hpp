@@ -0,0 +1,236 @@
+﻿/// \file fon9/fix/FixMsgView.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_fix_FixMsgView_hpp__
+#define __fon9_fix_FixMsgView_hpp__
+#include "fon9/fix/FixParser.hpp"
+#include "fon9/fix/FixApDef.hpp"
+#include "fon9/fmkt/FmktTypes.hpp"
+#include "fon9/TimeStamp.hpp"
+#include <tuple>
+
+namespace fon9 { namespace fix {
+
+/// \ingroup fix
+/// 定義 FIX 欄位: tag 及 解碼後的型別.
+/// - 通常使用 f9fix_DEF_FIELD() 定義.
+template <FixTag tag, class ValueT = StrView>
+struct FixFieldDef {
+   enum : FixTag {
+      kTag = tag
+   };
+   using ValueType = ValueT;
+};
+
+/// \ingroup fix
+/// 在 namespace fon9::fix::fld 裡面, 定義 FIX 欄位:
+/// - 必須要先定義 \#`define f9fix_kTAG_OrderQty  38`
+/// - `f9fix_DEF_FIELD(OrderQty, fmkt::Qty);` 定義了 fld::OrderQty;
+#define f9fix_DEF_FIELD(tagName, ValueT) \
+   using tagName = fon9::fix::FixFieldDef<f9fix_kTAG_##tagName, ValueT>
+
+/// \ingroup fix
+/// 將 FIX 欄位字串, 轉成 ValueT 型別.
+/// - 預設使用 StrTo(value, Null());
+/// - 若有其他型別, 可自行特化.
+template <class ValueT>
+struct FixValueDecoder {
+   static ValueT Null() {
+      return ValueT{};
+   }
+   static ValueT Decode(const StrView& value) {
+      return StrTo(value, Null());
+   }
+};
+template <>
+struct FixValueDecoder<StrView> {
+   static StrView Null() {
+      return StrView{nullptr};
+   }
+   static StrView Decode(const StrView& value) {
+      return value;
+   }
+};
+/// 例: Side, OrdStatus, ExecType...
+template <>
+struct FixValueDecoder<char> {
+   static char Null() {
+      return '\0';
+   }
+   static char Decode(const StrView& value) {
+      return value.empty() ? '\0' : *value.begin();
+   }
+};
+template <>
+struct FixValueDecoder<TimeStamp> {
+   static TimeStamp Null() {
+      return TimeStamp::Null();
+   }
+   static TimeStamp Decode(const StrView& value) {
+      return StrTo(value, Null());
+   }
+};
+template <typename IntTypeT, DecScaleT ScaleN>
+struct FixValueDecoder<Decimal<IntTypeT, ScaleN>> {
+   using ValueT = Decimal<IntTypeT, ScaleN>;
+   static ValueT Null() {
+      return ValueT::Null();
+   }
+   static ValueT Decode(const StrView& value) {
+      return StrTo(value, Null());
+   }
+};
+
+/// \ingroup fix
+/// 取得 FieldDef 在 FieldDefs... 裡面的位置.
+template <class FieldDef, class... FieldDefs>
+struct FixFieldIndex;
+template <class FieldDef, class... FieldDefs>
+struct FixFieldIndex<FieldDef, FieldDef, FieldDefs...> : public std::integral_constant<size_t, 0> {
+};
+template <class FieldDef, class FirstDef, class... FieldDefs>
+struct FixFieldIndex<FieldDef, FirstDef, FieldDefs...>
+   : public std::integral_constant<size_t, 1 + FixFieldIndex<FieldDef, FieldDefs...>::value> {
+};
+template <class FieldDef>
+struct FixFieldIndex<FieldDef> {
+   static_assert(sizeof(FieldDef) == 0, "FixMsgView: FieldDef not in FieldDefs...");
+};
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup fix
+/// 依照欄位定義, 直接取用 FixParser 解析後的結果.
+/// - 欄位位置預先取得(FixMsgView::Slots), 取用時不用再經過 FixParser::GetField(tag) 的查找.
+/// - Get<FieldDef>() 在第一次呼叫時才解碼, 解碼後保留結果, 再次呼叫時直接傳回.
+/// - 必須在 FixParser 解析下一筆訊息前使用完畢.
+///
+/// \code
+///   namespace fld = fon9::fix::fld;
+///   using ExecRptView = fon9::fix::FixMsgView<fld::ClOrdID, fld::OrdStatus, fld::LastQty, fld::LastPx>;
+///   // 每個 FixParser 只需要建立一次.
+///   ExecRptView::Slots slots{fixParser};
+///   // 每筆訊息:
+///   ExecRptView rpt{fixParser, slots};
+///   if (rpt.Has<fld::LastQty>())
+///      OnFilled(rpt.GetStr<fld::ClOrdID>(), rpt.Get<fld::LastQty>(), rpt.Get<fld::LastPx>());
+/// \endcode
+template <class... FieldDefs>
+class FixMsgView {
+   fon9_NON_COPY_NON_MOVE(FixMsgView);
+public:
+   enum : size_t {
+      kFieldCount = sizeof...(FieldDefs)
+   };
+   static_assert(kFieldCount <= 64, "FixMsgView: too many fields.");
+
+   /// 欄位在 FixParser 裡面的固定位置, 在 FixParser 的生命週期內都不會改變.
+   /// 所以每個 FixParser 只需要建立一次, 之後每筆訊息都可使用.
+   class Slots {
+      friend class FixMsgView;
+      const FixParser::FixField* Fields_[kFieldCount];
+   public:
+      explicit Slots(const FixParser& parser) : Fields_{&parser.GetFieldSlot(FieldDefs::kTag)...} {
+      }
+   };
+
+   FixMsgView(const FixParser& parser, const Slots& slots) : Parser_(parser), Slots_(slots) {
+   }
+
+   const FixParser& GetParser() const {
+      return this->Parser_;
+   }
+
+   template <class FieldDef>
+   static constexpr size_t IndexOf() {
+      return FixFieldIndex<FieldDef, FieldDefs...>::value;
+   }
+
+   /// \retval nullptr 此筆訊息沒有 FieldDef 欄位.
+   template <class FieldDef>
+   const FixParser::FixField* GetField() const {
+      const FixParser::FixField* fld = this->Slots_.Fields_[IndexOf<FieldDef>()];
+      return fld->ValueCount_ > 0 ? fld : nullptr;
+   }
+   template <class FieldDef>
+   bool Has() const {
+      return this->Slots_.Fields_[IndexOf<FieldDef>()]->ValueCount_ > 0;
+   }
+   /// 取得未解碼的字串, 若欄位不存在則傳回 StrView{nullptr};
+   /// 若欄位重複出現, 可用 index 取得後續出現的值.
+   template <class FieldDef>
+   StrView GetStr(unsigned index = 0) const {
+      return this->Parser_.GetValue(*this->Slots_.Fields_[IndexOf<FieldDef>()], index);
+   }
+   /// 取得解碼後的值, 第一次呼叫時才解碼;
+   /// 若欄位不存在, 則傳回 FixValueDecoder<ValueType>::Null();
+   template <class FieldDef>
+   const typename FieldDef::ValueType& Get() const {
+      enum : size_t { kIndex = FixFieldIndex<FieldDef, FieldDefs...>::value };
+      using Decoder = FixValueDecoder<typename FieldDef::ValueType>;
+      auto& value = std::get<kIndex>(this->Values_);
+      const uint64_t bit = static_cast<uint64_t>(1) << kIndex;
+      if ((this->DecodedFlags_ & bit) == 0) {
+         this->DecodedFlags_ |= bit;
+         const FixParser::FixField* fld = this->Slots_.Fields_[kIndex];
+         value = (fld->ValueCount_ > 0 ? Decoder::Decode(fld->Value_) : Decoder::Null());
+      }
+      return value;
+   }
+
+private:
+   const FixParser&  Parser_;
+   const Slots&      Slots_;
+   mutable uint64_t  DecodedFlags_{0};
+   mutable std::tuple<typename FieldDefs::ValueType...>  Values_;
+};
+fon9_WARN_POP;
+
+//--------------------------------------------------------------------------//
+
+/// \ingroup fix
+/// 常用的 FIX 欄位定義.
+namespace fld {
+f9fix_DEF_FIELD(MsgType,         StrView);
+f9fix_DEF_FIELD(MsgSeqNum,       FixSeqNum);
+f9fix_DEF_FIELD(SendingTime,     TimeStamp);
+f9fix_DEF_FIELD(PossDupFlag,     char);
+f9fix_DEF_FIELD(Text,            StrView);
+
+f9fix_DEF_FIELD(Account,         StrView);
+f9fix_DEF_FIELD(Symbol,          StrView);
+f9fix_DEF_FIELD(TransactTime,    TimeStamp);
+f9fix_DEF_FIELD(OrderQty,        fmkt::Qty);
+f9fix_DEF_FIELD(Price,           fmkt::Pri);
+f9fix_DEF_FIELD(OrderID,         StrView);
+f9fix_DEF_FIELD(ClOrdID,         StrView);
+f9fix_DEF_FIELD(OrigClOrdID,     StrView);
+f9fix_DEF_FIELD(OrdType,         char);
+f9fix_DEF_FIELD(TimeInForce,     char);
+f9fix_DEF_FIELD(Side,            char);
+f9fix_DEF_FIELD(ExecID,          StrView);
+f9fix_DEF_FIELD(ExecType,        char);
+f9fix_DEF_FIELD(OrdStatus,       char);
+f9fix_DEF_FIELD(LastPx,          fmkt::Pri);
+f9fix_DEF_FIELD(LastQty,         fmkt::Qty);
+f9fix_DEF_FIELD(LeavesQty,       fmkt::Qty);
+f9fix_DEF_FIELD(CumQty,          fmkt::Qty);
+f9fix_DEF_FIELD(AvgPx,           fmkt::Pri);
+f9fix_DEF_FIELD(OrdRejReason,    uint32_t);
+f9fix_DEF_FIELD(CxlRejReason,    uint32_t);
+} // namespace fld
+
+/// \ingroup fix
+/// NewOrderSingle(MsgType=D) 常用欄位.
+using FixNewOrderSingleView = FixMsgView<
+   fld::ClOrdID, fld::Account, fld::Symbol, fld::Side, fld::OrdType, fld::TimeInForce,
+   fld::OrderQty, fld::Price, fld::TransactTime>;
+
+/// \ingroup fix
+/// ExecutionReport(MsgType=8) 常用欄位.
+using FixExecutionReportView = FixMsgView<
+   fld::OrderID, fld::ClOrdID, fld::OrigClOrdID, fld::ExecID, fld::ExecType, fld::OrdStatus,
+   fld::Account, fld::Symbol, fld::Side, fld::OrderQty, fld::Price,
+   fld::LastQty, fld::LastPx, fld::LeavesQty, fld::CumQty, fld::AvgPx,
+   fld::OrdRejReason, fld::TransactTime, fld::Text>;
+
+} } // namespaces
+#endif//__fon9_fix_FixMsgView_hpp__
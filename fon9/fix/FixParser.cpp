@@ -1,10 +1,23 @@
 ﻿// \file fon9/fix/FixParser.cpp
 // \author fonwinz@gmail.com
 #include "fon9/fix/FixParser.hpp"
+#include "fon9/fix/FixScan.hpp"
 #include "fon9/StrTo.hpp"
 
 namespace fon9 { namespace fix {
 
+#ifdef _MSC_VER
+static inline unsigned FixParser_Ctz(uint64_t v) { // v != 0;
+   unsigned long idx;
+   _BitScanForward64(&idx, v);
+   return static_cast<unsigned>(idx);
+}
+#else
+static inline unsigned FixParser_Ctz(uint64_t v) {
+   return static_cast<unsigned>(__builtin_ctzll(v));
+}
+#endif
+
 FixParser::FixParser() {
    // 預先分配必用(常用)的欄位: 1..511.
    // 0..0xff(255)
@@ -81,8 +94,7 @@ FixParser::Result FixParser::Verify(StrView& fixmsg, VerifyItem vitem) {
           || pend[3] != '=')
          return EFormat;
       byte cks = Pic9StrTo<3, byte>(pend + 4);// static_cast<byte>(((pend[4] - '0') * 10 + (pend[5] - '0')) * 10 + (pend[6] - '0'));
-      while (pbeg < pend)
-         cks = static_cast<byte>(cks - static_cast<byte>(*pbeg++));
+      cks = static_cast<byte>(cks - FixCheckSum(pbeg, static_cast<size_t>(pend - pbeg)));
       if (cks != f9fix_kCHAR_SPL) {
          this->Clear();
          this->ExpectSize_ = static_cast<ExpectSize>(expsz);
@@ -104,10 +116,65 @@ FixParser::Result FixParser::Parse(StrView& fixmsg, Until until) {
       return pcode;
    return rcode;
 }
+/// 依序從 FixScanSpl() 的 bitmap 取出分隔字元的位置.
+struct FixSplCursor {
+   const uint64_t*   PWord_;
+   const uint64_t*   PWordEnd_;
+   const char*       WordBase_;
+   const char*       MsgEnd_;
+   uint64_t          Word_{0};
+
+   FixSplCursor(const uint64_t* bitmap, const char* msgbeg, const char* msgend)
+      : PWord_{bitmap - 1}
+      , PWordEnd_{bitmap + FixScanSplBitmapWords(static_cast<size_t>(msgend - msgbeg))}
+      , WordBase_{msgbeg - 64}
+      , MsgEnd_{msgend} {
+   }
+   /// 取出 >= pos 的下一個分隔字元位置, 若找不到則傳回 MsgEnd_;
+   /// pos 之前的分隔字元(例: RawData 裡面的 SPL)會被略過.
+   const char* Next(const char* pos) {
+      for (;;) {
+         while (this->Word_ == 0) {
+            if (++this->PWord_ >= this->PWordEnd_)
+               return this->MsgEnd_;
+            this->Word_ = *this->PWord_;
+            this->WordBase_ += 64;
+         }
+         const char* pspl = this->WordBase_ + FixParser_Ctz(this->Word_);
+         this->Word_ &= this->Word_ - 1;
+         if (fon9_LIKELY(pspl >= pos))
+            return pspl;
+      }
+   }
+};
+/// FIX tag 只會有數字, 不用考慮正負號及前方空白, 所以不用 StrTo().
+static inline FixTag FetchFixTag(StrView& fixmsg) {
+   FixTag      tag = 0;
+   const char* pcur = fixmsg.begin();
+   for (const char* const pend = fixmsg.end(); pcur != pend; ++pcur) {
+      const unsigned char digit = static_cast<unsigned char>(*pcur - '0');
+      if (digit > 9)
+         break;
+      tag = tag * 10 + digit;
+   }
+   fixmsg.SetBegin(pcur);
+   return tag;
+}
 FixParser::Result FixParser::ParseFields(StrView& fixmsg, Until until) {
    const char* msgend = fixmsg.end();
+   // 解析全部欄位時, 先一次找出全部的分隔字元位置(FixScanSpl() 使用 SIMD),
+   // 之後每個欄位就不用再逐字尋找.
+   // 若 CPU 不支援 SIMD, 則逐欄使用 memchr() 尋找, 會比 Scalar 的 FixScanSpl() 快.
+   const bool  isUseBitmap = (until == Until::FullMessage && FixScan_GetImpl() != FixScanImpl::Scalar);
+   if (isUseBitmap) {
+      const size_t words = FixScanSplBitmapWords(fixmsg.size());
+      if (this->SplBitmap_.size() < words)
+         this->SplBitmap_.resize(words);
+      FixScanSpl(fixmsg.begin(), fixmsg.size(), this->SplBitmap_.data());
+   }
+   FixSplCursor splCursor{this->SplBitmap_.data(), fixmsg.begin(), msgend};
    while (fixmsg.begin() < msgend) {
-      const FixTag tag = StrTo(&fixmsg, 0u);
+      const FixTag tag = FetchFixTag(fixmsg);
       if (fon9_UNLIKELY(tag == 0 || fixmsg.Get1st() != '='))
          return EFormat;
       fixmsg.SetBegin(fixmsg.begin() + 1); //移除 '='
@@ -131,8 +198,16 @@ FixParser::Result FixParser::ParseFields(StrView& fixmsg, Until until) {
          pValue = &this->MFields_[fld.MIndex_ * static_cast<size_t>(kMaxDupFieldCount) + (fld.ValueCount_ - 1)];
       }
 
-      if (fon9_LIKELY(tag != f9fix_kTAG_RawData))
-         *pValue = StrFetchNoTrim(fixmsg, f9fix_kCHAR_SPL);
+      if (fon9_LIKELY(tag != f9fix_kTAG_RawData)) {
+         if (fon9_LIKELY(isUseBitmap)) {
+            const char* pspl = splCursor.Next(fixmsg.begin());
+            pValue->Reset(fixmsg.begin(), pspl);
+            fixmsg.SetBegin(pspl == msgend ? msgend : pspl + 1);
+         }
+         else {
+            *pValue = StrFetchNoTrim(fixmsg, f9fix_kCHAR_SPL);
+         }
+      }
       else { // RawData 可包含任意字元, 所以要用 RawDataLength 來判斷長度.
          const FixField* fldRawDataLength = GetField(f9fix_kTAG_RawDataLength);
          if (fon9_UNLIKELY(!fldRawDataLength)) {
@@ -163,6 +163,12 @@ public:
       const FixField& fld = this->FieldArray_[tag];
       return(fld.ValueCount_ > 0 ? &fld : nullptr);
    }
+   /// 取得 tag 欄位在 FixParser 裡面的位置, 在 FixParser 的生命週期內都不會改變.
+   /// - 可預先取得需要的欄位位置(例: FixMsgView::Slots), 每次解析後不用再查找.
+   /// - 使用 (slot.ValueCount_ > 0) 判斷欄位是否存在.
+   const FixField& GetFieldSlot(FixTag tag) const {
+      return this->FieldArray_[tag];
+   }
    /// 當同一個欄位重複出現, 則透過此處找後續出現的 values.
    /// - 若 index >= fld.ValueCount_ 則返回 nullptr;
    /// - 若 index == 0 則返回 fld.Value_;
@@ -197,6 +203,10 @@ private:
    uint16_t    MIndexNext_{0};
    using MFields = std::vector<StrView>;
    MFields     MFields_;
+
+   /// ParseFields(Until::FullMessage) 時, 透過 FixScanSpl() 一次找出全部的分隔字元.
+   using SplBitmap = std::vector<uint64_t>;
+   SplBitmap   SplBitmap_;
 };
 fon9_ENABLE_ENUM_BITWISE_OP(FixParser::Until);
 fon9_ENABLE_ENUM_BITWISE_OP(FixParser::VerifyItem);
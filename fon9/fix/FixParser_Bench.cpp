@@ -0,0 +1,120 @@
+﻿// \file fon9/fix/FixParser_Bench.cpp
+// \author fonwinz@gmail.com
+//
+// 比較 FixScanImpl(Scalar = 逐字解析, SSE2, AVX2) 的 FixParser::Parse() 效率.
+// Usage: FixParser_Bench [input [times]]
+// - input: FixReceiver_UT_Case.txt 格式, 每行一筆 FIX 訊息(不是 "8=" 開頭的行會被忽略);
+//   若沒提供 input, 則使用內建的 ExecutionReport.
+// - times: 每種 impl 重複解析全部訊息的次數, 預設 100000 筆訊息.
+//
+#define _CRT_SECURE_NO_WARNINGS
+#include "fon9/TestTools.hpp"
+#include "fon9/fix/FixParser.hpp"
+#include "fon9/fix/FixScan.hpp"
+#include "fon9/StrTo.hpp"
+#include <vector>
+
+namespace f9fix = fon9::fix;
+
+static const char cstrExecutionReport[] =
+   "8=FIX.4.2" "\x01" "9=0" "\x01" "35=8" "\x01" "34=4" "\x01" "52=20170508-10:21:55.048" "\x01" "49=SenderId" "\x01"
+   "50=SenderSubId" "\x01" "56=TargetId" "\x01" "57=TargetSubId" "\x01" "200=201703" "\x01" "1=010007-8-06" "\x01"
+   "206=0" "\x01" "167=FUT" "\x01" "207=TAIFEX" "\x01" "40=2" "\x01" "60=20170508102155.048787" "\x01" "21=1" "\x01"
+   "11=04170301110144006300" "\x01" "37=A0001" "\x01" "17=A0001-00003" "\x01" "150=2" "\x01" "39=2" "\x01"
+   "54=2" "\x01" "44=1117.6" "\x01" "55=FITF" "\x01" "77=N" "\x01" "47=A" "\x01" "38=1" "\x01" "59=0" "\x01"
+   "31=1117.6" "\x01" "32=1" "\x01" "14=1" "\x01" "151=0" "\x01" "6=1117.6" "\x01" "58=Filled" "\x01"
+   "10001=D" "\x01" "10002=D02" "\x01" "10=000" "\x01";
+
+/// 重新計算 BodyLength & CheckSum, 讓測試資料一定可以解析成功.
+/// msg 必須是 "8=BeginString|9=BodyLength|...|10=CheckSum|" 的格式.
+static std::string MakeValidFixMsg(fon9::StrView msg) {
+   while (!msg.empty() && (msg.end()[-1] == '\n' || msg.end()[-1] == '\r'))
+      msg.SetEnd(msg.end() - 1);
+   const char* pspl = static_cast<const char*>(memchr(msg.begin(), f9fix_kCHAR_SPL, msg.size()));
+   if (!pspl)
+      return std::string{};
+   const char* pbody = static_cast<const char*>(memchr(pspl + 1, f9fix_kCHAR_SPL, static_cast<size_t>(msg.end() - pspl - 1)));
+   // ptail = "|10=xxx|" 的開頭.
+   const char* ptail = msg.end() - f9fix::kFixTailWidth;
+   if (!pbody || ptail <= pbody)
+      return std::string{};
+   std::string res{msg.begin(), pspl + 1};
+   res.append("9=");
+   res.append(std::to_string(ptail - pbody));
+   res.append(pbody, ptail + 1);
+   char strcks[8];
+   sprintf(strcks, "10=%03u", static_cast<unsigned>(f9fix::FixCheckSum(res.data(), res.size())));
+   res.append(strcks);
+   res.push_back(f9fix_kCHAR_SPL);
+   return res;
+}
+
+int main(int argc, char** argv) {
+   fon9::AutoPrintTestInfo utinfo{"FixParser_Bench"};
+   std::vector<std::string> msgs;
+   if (argc >= 2) {
+      FILE* infd = fopen(argv[1], "rt");
+      if (infd == nullptr) {
+         perror("Open input file error:");
+         return 3;
+      }
+      char strbuf[1024 * 8];
+      while (fgets(strbuf, sizeof(strbuf), infd)) {
+         if (strbuf[0] != '8' || strbuf[1] != '=')
+            continue;
+         std::string msg = MakeValidFixMsg(fon9::StrView_cstr(strbuf));
+         if (!msg.empty())
+            msgs.push_back(std::move(msg));
+      }
+      fclose(infd);
+   }
+   else {
+      msgs.push_back(MakeValidFixMsg(fon9::StrView{cstrExecutionReport}));
+   }
+   if (msgs.empty()) {
+      std::cout << "No FIX message." << std::endl;
+      return 3;
+   }
+   size_t msgBytes = 0;
+   for (const std::string& msg : msgs)
+      msgBytes += msg.size();
+   const size_t kTimes = (argc >= 3 ? fon9::StrTo(fon9::StrView_cstr(argv[2]), 0u) : (100000u / msgs.size() + 1));
+   std::cout << "msgs=" << msgs.size() << "|bytes=" << msgBytes << "|times=" << kTimes << std::endl;
+
+   f9fix::FixParser         fixpr;
+   const f9fix::FixScanImpl implOrig = f9fix::FixScan_GetImpl();
+   const f9fix::FixScanImpl impls[] = {f9fix::FixScanImpl::Scalar, f9fix::FixScanImpl::Sse2, f9fix::FixScanImpl::Avx2};
+   for (f9fix::FixScanImpl impl : impls) {
+      if (!f9fix::FixScan_SetImpl(impl)) {
+         std::cout << "[SKIP ] " << f9fix::FixScan_ImplName(impl) << ": not supported." << std::endl;
+         continue;
+      }
+      size_t            fieldCount = 0;
+      fon9::StopWatch   stopWatch;
+      for (size_t L = 0; L < kTimes; ++L) {
+         for (const std::string& msg : msgs) {
+            fon9::StrView fixmsg{fon9::ToStrView(msg)};
+            if (fixpr.Parse(fixmsg) <= f9fix::FixParser::NeedsMore) {
+               std::cout << "[ERROR] Parse|msg=" << msg << std::endl;
+               return 3;
+            }
+            fieldCount += fixpr.count();
+         }
+      }
+      char msgbuf[128];
+      sprintf(msgbuf, "[BENCH] %-6s Parse", f9fix::FixScan_ImplName(impl));
+      stopWatch.PrintResultNoEOL(msgbuf, kTimes * msgs.size())
+         << "|fields=" << fieldCount << std::endl;
+
+      fon9::byte cks = 0;
+      stopWatch.ResetTimer();
+      for (size_t L = 0; L < kTimes; ++L) {
+         for (const std::string& msg : msgs)
+            cks = static_cast<fon9::byte>(cks + f9fix::FixCheckSum(msg.data(), msg.size()));
+      }
+      sprintf(msgbuf, "[BENCH] %-6s CheckSum", f9fix::FixScan_ImplName(impl));
+      stopWatch.PrintResultNoEOL(msgbuf, kTimes * msgs.size())
+         << "|cks=" << static_cast<unsigned>(cks) << std::endl;
+   }
+   f9fix::FixScan_SetImpl(implOrig);
+}
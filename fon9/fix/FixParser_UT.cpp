@@ -4,6 +4,8 @@
 #include "fon9/TestTools.hpp"
 #include "fon9/fix/FixParser.hpp"
 #include "fon9/fix/FixBuilder.hpp"
+#include "fon9/fix/FixScan.hpp"
+#include "fon9/fix/FixMsgView.hpp"
 #include "fon9/Timer.hpp"
 
 namespace f9fix = fon9::fix;
@@ -78,6 +80,85 @@ f9fix::FixParser::Result TestFixParser(const char* testName,
    return res;
 }
 
+//--------------------------------------------------------------------------//
+
+/// 各種 FixScanImpl 的結果, 必須與 FixScanImpl::Scalar 相同.
+void TestFixScan() {
+   const f9fix::FixScanImpl implOrig = f9fix::FixScan_GetImpl();
+   std::cout << "[TEST ] FixScan|impl=" << f9fix::FixScan_ImplName(implOrig);
+   char     buf[300];
+   uint64_t bitmapScalar[f9fix::FixScanSplBitmapWords(sizeof(buf)) + 1];
+   uint64_t bitmapImpl[f9fix::FixScanSplBitmapWords(sizeof(buf)) + 1];
+   for (size_t idx = 0; idx < sizeof(buf); ++idx)
+      buf[idx] = static_cast<char>(rand() % 8 == 0 ? f9fix_kCHAR_SPL : rand());
+   const f9fix::FixScanImpl impls[] = {f9fix::FixScanImpl::Sse2, f9fix::FixScanImpl::Avx2};
+   for (f9fix::FixScanImpl impl : impls) {
+      if (!f9fix::FixScan_SetImpl(impl))
+         continue;
+      for (size_t ofs = 0; ofs < 3; ++ofs) {
+         for (size_t sz = 0; sz + ofs <= sizeof(buf); ++sz) {
+            f9fix::FixScan_SetImpl(f9fix::FixScanImpl::Scalar);
+            const fon9::byte cksScalar = f9fix::FixCheckSum(buf + ofs, sz, 1);
+            f9fix::FixScanSpl(buf + ofs, sz, bitmapScalar);
+            f9fix::FixScan_SetImpl(impl);
+            bitmapImpl[f9fix::FixScanSplBitmapWords(sz)] = 0;
+            f9fix::FixScanSpl(buf + ofs, sz, bitmapImpl);
+            if (cksScalar != f9fix::FixCheckSum(buf + ofs, sz, 1)
+                || memcmp(bitmapScalar, bitmapImpl, f9fix::FixScanSplBitmapWords(sz) * sizeof(uint64_t)) != 0) {
+               std::cout << "|err=" << f9fix::FixScan_ImplName(impl) << "|ofs=" << ofs << "|sz=" << sz
+                  << "\r[ERROR]" << std::endl;
+               abort();
+            }
+         }
+      }
+      std::cout << '|' << f9fix::FixScan_ImplName(impl);
+   }
+   f9fix::FixScan_SetImpl(implOrig);
+   std::cout << "\r[OK   ]" << std::endl;
+}
+
+/// FixHeaderTemplate + FixBuilder 累加 CheckSum 的結果, 必須與一般方式建立的訊息相同.
+void TestFixHeaderTemplate(f9fix::FixParser& fixpr) {
+   #define _   f9fix_kCSTR_SPL
+   std::cout << "[TEST ] FixHeaderTemplate";
+   f9fix::FixHeaderTemplate hdr;
+   hdr.Reset(fon9::StrView{_ "56=Client" _ "49=Server"});
+   const fon9::TimeStamp now = fon9::StrTo(fon9::StrView{"20170426-00:49:26.625"}, fon9::TimeStamp{});
+   for (unsigned L = 0; L < 2; ++L) {
+      // L==1: 同一毫秒, 使用樣板內已填好的 SendingTime.
+      hdr.SetSendingTime(now + fon9::TimeInterval_Microsecond(L * 100));
+      f9fix::FixBuilder fbuf;
+      fon9::RevPrint(fbuf.GetBuffer(), _ "98=0");
+      fbuf.UpdateCheckSum();
+      fon9::RevPrint(fbuf.GetBuffer(), _ "108=3000");
+      hdr.RevPutTo(fbuf);
+      fon9::RevPrint(fbuf.GetBuffer(), _ "35=A" _ "34=1");
+      std::string msg = fon9::BufferTo<std::string>(fbuf.Final(f9fix_BEGIN_HEADER_V44));
+      if (msg != "8=FIX.4.4" _ "9=69" _ "35=A" _ "34=1" _ "52=20170426-00:49:26.625" _ "56=Client" _ "49=Server" _ "108=3000" _ "98=0" _ "10=067" _) {
+         std::cout << "|L=" << L << "|msg=" << msg << "\r[ERROR]" << std::endl;
+         abort();
+      }
+   }
+   // 跨越多個 buffer node, 且在過程中多次 UpdateCheckSum().
+   f9fix::FixBuilder fbuf;
+   for (unsigned L = 0; L < 200; ++L) {
+      fon9::RevPrint(fbuf.GetBuffer(), f9fix_kCHAR_SPL, 10000 + L, '=', std::string(L % 50 + 1, static_cast<char>('A' + L % 26)));
+      if (L % 7 == 0)
+         fbuf.UpdateCheckSum();
+   }
+   hdr.SetSendingTime(fon9::UtcNow());
+   hdr.RevPutTo(fbuf);
+   fon9::RevPrint(fbuf.GetBuffer(), _ "35=B" _ "34=2");
+   std::string    msg = fon9::BufferTo<std::string>(fbuf.Final(f9fix_BEGIN_HEADER_V44));
+   fon9::StrView  fixmsg = fon9::ToStrView(msg);
+   if (fixpr.Parse(fixmsg) <= f9fix::FixParser::NeedsMore) {
+      std::cout << "|err=Parse|msg=" << msg << "\r[ERROR]" << std::endl;
+      abort();
+   }
+   #undef _
+   std::cout << "\r[OK   ]" << std::endl;
+}
+
 int main(int argc, char** args) {
    (void)argc; (void)args;
 
@@ -89,7 +170,10 @@ int main(int argc, char** args) {
    fon9::GetDefaultTimerThread();
    std::this_thread::sleep_for(std::chrono::milliseconds{10});
 
+   TestFixScan();
+
    f9fix::FixParser   fixpr;
+   TestFixHeaderTemplate(fixpr);
    #define _   f9fix_kCSTR_SPL
 
    // 一般訊息.
@@ -153,4 +237,37 @@ int main(int argc, char** args) {
                  "98=0" _ "98=1" _ "98=2" _ "98=3" _ "98=4" _
                  "99=A" _ "99=B" _ "99=C" _ "99=D" _ "99=E" _ "10=240" _,
                  vs7, fon9::numofele(vs7));
+
+   // Test: FixMsgView.
+   std::cout << "[TEST ] FixExecutionReportView";
+   namespace fld = f9fix::fld;
+   f9fix::FixExecutionReportView::Slots rptSlots{fixpr};
+   f9fix::FixBuilder fbuf;
+   fon9::RevPrint(fbuf.GetBuffer(), f9fix_SPLFLDMSGTYPE(ExecutionReport) _ "34=8" _ "37=A0001" _ "11=C0001" _
+                  "17=A0001-3" _ "150=F" _ "39=1" _ "55=2330" _ "54=1" _ "38=5" _ "44=580.5" _
+                  "32=2" _ "31=580" _ "151=3" _ "14=2" _ "60=20170508-10:21:55.048");
+   std::string rptmsg = fon9::BufferTo<std::string>(fbuf.Final(f9fix_BEGIN_HEADER_V44));
+   fixmsg = fon9::ToStrView(rptmsg);
+   if (fixpr.Parse(fixmsg) <= f9fix::FixParser::NeedsMore) {
+      std::cout << "|err=Parse\r[ERROR]" << std::endl;
+      abort();
+   }
+   f9fix::FixExecutionReportView rpt{fixpr, rptSlots};
+   if (rpt.GetStr<fld::ClOrdID>() != "C0001"
+       || rpt.Get<fld::ExecType>() != 'F'
+       || rpt.Get<fld::OrdStatus>() != '1'
+       || rpt.Get<fld::Side>() != '1'
+       || rpt.Get<fld::OrderQty>() != 5
+       || rpt.Get<fld::Price>() != fon9::fmkt::Pri{580.5}
+       || rpt.Get<fld::LastQty>() != 2
+       || rpt.Get<fld::LastPx>() != fon9::fmkt::Pri{580.0}
+       || rpt.Get<fld::LeavesQty>() != 3
+       || rpt.Get<fld::TransactTime>() != fon9::StrTo(fon9::StrView{"20170508102155.048"}, fon9::TimeStamp{})
+       || rpt.Has<fld::Text>()
+       || !rpt.GetStr<fld::Text>().IsNull()
+       || !rpt.Get<fld::AvgPx>().IsNull()) {
+      std::cout << "|err=value\r[ERROR]" << std::endl;
+      abort();
+   }
+   std::cout << "\r[OK   ]" << std::endl;
 }
@@ -25,6 +25,8 @@ File::Result FixRecorder::Initialize(std::string fileName) {
    LastSeqSearcher   seqSearcher{fixParser};
    File&             file = this->GetStorage();
    res = seqSearcher.Start(file);
+   if (res)
+      res = file.GetFileSize();
    if (!res)
       file.Close();
    else {
@@ -33,6 +35,8 @@ File::Result FixRecorder::Initialize(std::string fileName) {
       if ((this->NextRecvSeq_ = seqSearcher.NextRecvSeq_) == 0)
          this->NextRecvSeq_ = 1;
       this->IdxInfoSizeInterval_ = 0;
+      this->AppendPos_ = this->ConsumedPos_ = res.GetResult();
+      this->InitSentIndex(file.GetOpenName() + f9fix_kCSTR_SentIndexFileExt, res.GetResult());
       this->Write(f9fix_kCSTR_HdrInfo,
                   "f9fix.FixRecorder Initialized"
                   "|NextSendSeq=", this->NextSendSeq_,
@@ -42,18 +46,67 @@ File::Result FixRecorder::Initialize(std::string fileName) {
 }
 
 void FixRecorder::WriteBuffer(Locker&& lk, RevBufferList&& rbuf) {
-   BufferList wbuf = rbuf.MoveOut();
-   if (fon9_UNLIKELY((this->IdxInfoSizeInterval_ += CalcDataSize(wbuf.cfront())) > kIdxInfoSizeInterval)) {
+   BufferList   wbuf = rbuf.MoveOut();
+   const size_t wsz = CalcDataSize(wbuf.cfront());
+   this->AddWork(std::move(lk), std::move(wbuf), wsz);
+}
+void FixRecorder::AddWork(Locker&& lk, BufferList&& wbuf, size_t wsz) {
+   this->AppendPos_ += wsz;
+   if (fon9_UNLIKELY((this->IdxInfoSizeInterval_ += wsz) > kIdxInfoSizeInterval)) {
       this->IdxInfoSizeInterval_ = 0;
+      RevBufferList rbuf{kControlMsgSeqNumMaxLength};
       RevPrint(rbuf, f9fix_kCSTR_HdrIdx
                f9fix_kCSTR_HdrNextSendSeq, this->NextSendSeq_,
                f9fix_kCSTR_HdrNextRecvSeq, this->NextRecvSeq_,
                '\n');
-      wbuf.push_back(rbuf.MoveOut());
+      BufferList ibuf = rbuf.MoveOut();
+      this->AppendPos_ += CalcDataSize(ibuf.cfront());
+      wbuf.push_back(std::move(ibuf));
    }
    WorkContentController* app = static_cast<WorkContentController*>(&WorkContentController::StaticCast(*lk));
    app->AddWork(std::move(lk), std::move(wbuf));
 }
+void FixRecorder::WriteAfterSend(Locker&& lk, RevBufferList&& lineMessage, FixSeqNum nextSendSeq) {
+   BufferList   wbuf = lineMessage.MoveOut();
+   const size_t wsz = CalcDataSize(wbuf.cfront());
+   if (this->IsSentIndexReady_) {
+      FixSeqNum expectNextSeq = this->NextSendSeq_;
+      const BufferNode* front = wbuf.cfront();
+      if (front && front->GetDataSize() > 0 && *front->GetDataBegin() == f9fix_kCSTR_HdrSend[0]) {
+         this->SentIndexPending_.push_back(FixRecorderIndexRec{this->AppendPos_, expectNextSeq, FixRecorderIndexKind::Sent});
+         ++expectNextSeq;
+      }
+      if (fon9_UNLIKELY(nextSendSeq != expectNextSeq))
+         this->SentIndexPending_.push_back(FixRecorderIndexRec{this->AppendPos_ + wsz, nextSendSeq, FixRecorderIndexKind::RstSend});
+   }
+   this->NextSendSeq_ = nextSendSeq;
+   this->AddWork(std::move(lk), std::move(wbuf), wsz);
+}
+void FixRecorder::ConsumeAppendBuffer(DcQueueList& buffer) {
+   this->ConsumedPos_ += buffer.CalcSize();
+   base::ConsumeAppendBuffer(buffer);
+   if (!this->IsSentIndexReady_)
+      return;
+   {
+      Locker lk{this->Worker_.Lock()};
+      // 取出 buffer 之後, 在取得 lock 之前, 可能已有其他 thread 加入了新的訊息及索引,
+      // 這些索引的訊息尚未寫入記錄檔, 必須留到下次再處理.
+      auto ibeg = this->SentIndexPending_.begin();
+      auto iend = ibeg;
+      for (auto iendPending = this->SentIndexPending_.end(); iend != iendPending; ++iend) {
+         // Sent: Pos_ = 訊息開始位置; RstSend: Pos_ = 訊息結束位置(可能剛好等於 ConsumedPos_).
+         if (iend->Kind_ == FixRecorderIndexKind::Sent ? (iend->Pos_ >= this->ConsumedPos_)
+                                                         : (iend->Pos_ > this->ConsumedPos_))
+            break;
+      }
+      if (ibeg == iend)
+         return;
+      this->SentIndexWorking_.assign(ibeg, iend);
+      this->SentIndexPending_.erase(ibeg, iend);
+   }
+   this->SentIndex_.Append(this->SentIndexWorking_.data(), this->SentIndexWorking_.size());
+   this->SentIndexWorking_.clear();
+}
 void FixRecorder::WriteInputSeqReset(const StrView& fixmsg, FixSeqNum newSeqNo, bool isGapFill) {
    RevBufferList rbuf{static_cast<BufferNodeSize>(fixmsg.size() + 64)};
    RevPrint(rbuf,
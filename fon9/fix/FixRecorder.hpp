@@ -4,8 +4,14 @@
 #define __fon9_fix_FixRecorder_hpp__
 #include "fon9/fix/FixParser.hpp"
 #include "fon9/fix/FixCompID.hpp"
+#include "fon9/fix/FixRecorderIndex.hpp"
 #include "fon9/buffer/RevBufferList.hpp"
 #include "fon9/FileAppender.hpp"
+#include "fon9/FileMap.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <vector>
+fon9_AFTER_INCLUDE_STD;
 
 namespace fon9 { namespace fix {
 
@@ -38,17 +44,41 @@ fon9_WARN_DISABLE_PADDING;
 ///               FIX 有 Sequence Reset 機制, 當發生此情況時, 必定會跟隨一個 RST 訊息.
 ///        其他 = 額外資訊, 參考 f9fix_kCSTR_Hdr*
 ///   \endcode
+/// - 送出訊息的索引檔: 檔名 = 記錄檔名 + f9fix_kCSTR_SentIndexFileExt, 參考 FixRecorderIndex.
+///   - 在 async appender 寫入記錄檔之後, 寫入索引檔.
+///   - ReloadSent 優先使用索引檔, 直接讀取所需的訊息,
+///     若索引檔無法使用(或與記錄檔不一致), 才從記錄檔尾端往前尋找.
 class fon9_API FixRecorder : protected AsyncFileAppender {
    fon9_NON_COPY_NON_MOVE(FixRecorder);
    using base = AsyncFileAppender;
    FixSeqNum   NextSendSeq_{0};
    FixSeqNum   NextRecvSeq_{0};
    size_t      IdxInfoSizeInterval_;
-   
+   /// 已寫入(包含尚在 queue 裡面)的資料尾端, 也就是下一筆寫入資料在記錄檔的位置.
+   File::PosType  AppendPos_{0};
+   bool           IsSentIndexReady_{false};
+   /// 在 Worker_ lock 保護下, 加入等候寫入索引檔的記錄.
+   std::vector<FixRecorderIndexRec> SentIndexPending_;
+   /// 僅在 ConsumeAppendBuffer() 裡面使用.
+   std::vector<FixRecorderIndexRec> SentIndexWorking_;
+   /// 僅在 ConsumeAppendBuffer() 裡面使用: 已寫入記錄檔的資料尾端.
+   File::PosType                    ConsumedPos_{0};
+   FixRecorderIndex                 SentIndex_;
+
    struct FixRevSercher;
    struct LastSeqSearcher;
    struct SentMessageSearcher;
+   struct SentIndexBuilder;
    friend intrusive_ptr<FixRecorder>;
+
+   void AddWork(base::WorkContentLocker&& lk, BufferList&& wbuf, size_t wsz);
+   /// 在 Initialize() 開檔成功後呼叫:
+   /// 開啟索引檔, 並從最後一筆索引之後, 讀取記錄檔, 補齊缺少的索引.
+   void InitSentIndex(std::string fileName, File::PosType dataFileSize);
+
+protected:
+   /// 寫入記錄檔之後, 寫入索引檔.
+   void ConsumeAppendBuffer(DcQueueList& buffer) override;
 public:
    using Locker = base::WorkContentLocker;
 
@@ -100,6 +130,9 @@ public:
    /// 返回前 lk 可能已被解鎖!
    void WriteBuffer(Locker&& lk, RevBufferList&& rbuf);
 
+   /// 送出訊息索引檔的副檔名: 索引檔名 = 記錄檔名 + f9fix_kCSTR_SentIndexFileExt;
+   #define f9fix_kCSTR_SentIndexFileExt   ".sidx"
+
    #define f9fix_kCSTR_HdrInfo        "i "
    #define f9fix_kCSTR_HdrError       "e "
    #define f9fix_kCSTR_HdrSend        "S "
@@ -124,11 +157,9 @@ public:
    /// 送出後, 設定 this->NextSendSeq_, 並寫入送出的訊息;
    /// lineMessage 必須為一行完整的訊息: "S " + timestamp + ' ' + FIX Message + '\n';
    /// 請參考 FixSender::Send()
-   /// 返回前 lk 可能已被解鎖!
-   void WriteAfterSend(Locker&& lk, RevBufferList&& lineMessage, FixSeqNum nextSendSeq) {
-      this->NextSendSeq_ = nextSendSeq;
-      this->WriteBuffer(std::move(lk), std::move(lineMessage));
-   }
+   /// - 若 lineMessage 不是 "S " 開頭, 則表示只有 "RST|S=nextSendSeq", 沒有送出訊息.
+   /// - 返回前 lk 可能已被解鎖!
+   void WriteAfterSend(Locker&& lk, RevBufferList&& lineMessage, FixSeqNum nextSendSeq);
 
    /// 寫入依正常順序收到的 FIX Message.
    /// 返回前 ++this->NextRecvSeq_;
@@ -145,7 +176,9 @@ public:
    /// 寫入 buf, 前後都不加料.
    /// 返回前 lk 可能已被解鎖!
    void Append(Locker&& lk, BufferList&& buf) {
-      this->IdxInfoSizeInterval_ += CalcDataSize(buf.cfront());
+      const size_t wsz = CalcDataSize(buf.cfront());
+      this->IdxInfoSizeInterval_ += wsz;
+      this->AppendPos_ += wsz;
       WorkContentController* app = static_cast<WorkContentController*>(&WorkContentController::StaticCast(*lk));
       app->AddWork(std::move(lk), std::move(buf));
    }
@@ -160,6 +193,9 @@ public:
       const char* FoundDataEnd_;
       friend struct SentMessageSearcher;
       bool InitStart(FixRecorder& fixRecorder, FixSeqNum seqFrom);
+      /// 使用索引檔, 載入第一筆序號 >= seqFrom 的訊息.
+      /// \retval false 索引檔無法使用, 或索引與記錄檔的內容不符, 此時應改用 SentMessageSearcher 尋找.
+      bool StartByIndex(FixRecorder& fixRecorder, FixSeqNum seqFrom);
 
    public:
       FixParser  FixParser_;
@@ -185,6 +221,53 @@ public:
       StrView FindNext(FixRecorder& fixRecorder);
 
       bool IsErrOrEOF(FixRecorder& fixRecorder, FixRecorder::Locker&& locker) const;
+
+      /// 目前找到的訊息(FIX Message 的開頭)在記錄檔的位置.
+      PosType GetCurMsgPos() const {
+         return this->CurBufferPos_ + static_cast<PosType>(this->CurMsg_.begin() - this->Buffer_);
+      }
+   };
+
+   /// 使用 FileMap 取回已送出的訊息, 適用於大量重送(例: FixSender::Replay()).
+   /// - 與 ReloadSent 的用法相同, 但傳回的訊息直接指向記錄檔的映射, 不用複製到緩衝區.
+   /// - 傳回的訊息, 在下次呼叫 FindNext() 之前有效(到達映射尾端時, 可能會重新映射).
+   /// - 若索引檔無法使用, 則透過 ReloadSent::Start() 找到開始位置.
+   class fon9_API ReplayReader {
+      fon9_NON_COPY_NON_MOVE(ReplayReader);
+      FileMap     Map_;
+      /// Map_.begin() 在記錄檔的位置.
+      PosType     MapPos_{0};
+      /// 下一行的開始位置(在 Map_ 裡面).
+      const char* NextLine_{nullptr};
+      StrView     CurMsg_;
+      bool        IsMapFailed_{false};
+
+      /// 每次映射的最大範圍, 避免記錄檔很大時, 因位址空間不足而映射失敗.
+      enum : size_t { kMapWindowSize = 64 * 1024 * 1024 };
+      /// 映射記錄檔的 [pos..檔尾), 但最多映射 max(kMapWindowSize, minSize).
+      bool MapFrom(FixRecorder& fixRecorder, PosType pos, size_t minSize = 0);
+      /// 已到映射尾端: 若記錄檔還有後續的資料, 則從 NextLine_ 開始重新映射.
+      /// \retval false 沒有後續資料, 或映射失敗(此時 this->CurMsg_ = nullptr).
+      bool Remap(FixRecorder& fixRecorder);
+      StrView StartByIndex(FixRecorder& fixRecorder, FixSeqNum seqFrom);
+
+   public:
+      FixParser   FixParser_;
+
+      ReplayReader() = default;
+
+      /// \copydoc ReloadSent::Start()
+      StrView Start(FixRecorder& fixRecorder, FixSeqNum seqFrom);
+      /// \copydoc ReloadSent::FindNext()
+      StrView FindNext(FixRecorder& fixRecorder);
+      /// 是否有錯誤, 或已讀到記錄檔尾端.
+      /// 若記錄檔在映射之後有新增資料, 則返回 false, 此時可以再呼叫 FindNext() 取得後續訊息.
+      bool IsErrOrEOF(FixRecorder& fixRecorder, FixRecorder::Locker&& locker) const;
+      /// Start() 或 FindNext() 傳回 nullptr 的原因是否為映射記錄檔失敗?
+      /// 此時可改用 ReloadSent 從尚未取得的序號繼續.
+      bool IsMapFailed() const {
+         return this->IsMapFailed_;
+      }
    };
 };
 using FixRecorderSP = intrusive_ptr<FixRecorder>;
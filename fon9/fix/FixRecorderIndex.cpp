@@ -0,0 +1,191 @@
+﻿// \file fon9/fix/FixRecorderIndex.cpp
+// \author fonwinz@gmail.com
+#include "fon9/fix/FixRecorderIndex.hpp"
+#include <algorithm>
+
+namespace fon9 { namespace fix {
+
+static const char kFixRecorderIndexMagic[8] = {'f','9','f','i','x','I','d','x'};
+enum : size_t {
+   /// 建立新檔時, 預設可容納的記錄數量.
+   kFixRecorderIndexInitCapacity = 1024 * 64,
+};
+
+struct FixRecorderIndex::Header {
+   char     Magic_[8];
+   uint32_t RecSize_;
+   uint32_t Reserved_;
+   /// 有效的記錄數量: 先寫入記錄, 然後才更新 Count_;
+   uint64_t Count_;
+   /// 最後一個 RstSend 記錄的 index + 1; 0 表示沒有 RstSend.
+   uint64_t LastRstNext_;
+};
+
+FixRecorderIndex::~FixRecorderIndex() {
+}
+FixRecorderIndexRec* FixRecorderIndex::GetRecs() const {
+   return reinterpret_cast<Rec*>(static_cast<byte*>(this->Map_.data()) + sizeof(Header));
+}
+void FixRecorderIndex::ResetHeader() {
+   static_assert(sizeof(Header) == 32, "sizeof(FixRecorderIndex::Header) must be 32.");
+   Header* hdr = this->GetHeader();
+   memcpy(hdr->Magic_, kFixRecorderIndexMagic, sizeof(hdr->Magic_));
+   hdr->RecSize_ = sizeof(Rec);
+   hdr->Reserved_ = 0;
+   hdr->Count_ = 0;
+   hdr->LastRstNext_ = 0;
+}
+File::Result FixRecorderIndex::MapFile(File::SizeType fileSize) {
+   this->Capacity_ = 0;
+   File::Result res = this->Map_.Map(this->File_, static_cast<size_t>(fileSize), true);
+   if (res && fileSize >= sizeof(Header))
+      this->Capacity_ = static_cast<size_t>((fileSize - sizeof(Header)) / sizeof(Rec));
+   return res;
+}
+File::Result FixRecorderIndex::Reserve(size_t count) {
+   if (count <= this->Capacity_)
+      return File::Result{this->Capacity_};
+   size_t newCapacity = (this->Capacity_ < kFixRecorderIndexInitCapacity ? kFixRecorderIndexInitCapacity : this->Capacity_ * 2);
+   if (newCapacity < count)
+      newCapacity = count;
+   const File::SizeType newFileSize = sizeof(Header) + newCapacity * sizeof(Rec);
+   // Windows: 映射中的檔案無法改變大小, 所以先 Unmap();
+   this->Map_.Unmap();
+   File::Result res = this->File_.SetFileSize(newFileSize);
+   if (!res) {
+      if (File::Result fsz = this->File_.GetFileSize())
+         this->MapFile(fsz.GetResult());
+      return res;
+   }
+   return this->MapFile(newFileSize);
+}
+
+File::Result FixRecorderIndex::Open(std::string fileName, File::PosType dataFileSize) {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   this->Map_.Unmap();
+   this->Capacity_ = 0;
+   File::Result res = this->File_.Open(std::move(fileName), FileMode::Read | FileMode::Write | FileMode::CreatePath | FileMode::DenyWrite);
+   if (!res)
+      return res;
+   if (!(res = this->File_.GetFileSize()))
+      goto __OPEN_ERROR;
+   if (res.GetResult() < sizeof(Header) + sizeof(Rec)) {
+      if (!(res = this->Reserve(kFixRecorderIndexInitCapacity)))
+         goto __OPEN_ERROR;
+      this->ResetHeader();
+      return res;
+   }
+   if (!(res = this->MapFile(res.GetResult())))
+      goto __OPEN_ERROR;
+   {
+      Header* hdr = this->GetHeader();
+      if (memcmp(hdr->Magic_, kFixRecorderIndexMagic, sizeof(hdr->Magic_)) != 0
+          || hdr->RecSize_ != sizeof(Rec)
+          || hdr->Count_ > this->Capacity_) {
+         this->ResetHeader();
+         return res;
+      }
+      // 移除超過 dataFileSize 的記錄.
+      const Rec* recs = this->GetRecs();
+      size_t     count = static_cast<size_t>(hdr->Count_);
+      while (count > 0) {
+         const Rec& back = recs[count - 1];
+         if (back.Kind_ == FixRecorderIndexKind::Sent ? (back.Pos_ < dataFileSize) : (back.Pos_ <= dataFileSize))
+            break;
+         --count;
+      }
+      if (hdr->Count_ != count) {
+         hdr->Count_ = count;
+         if (hdr->LastRstNext_ > count) {
+            hdr->LastRstNext_ = count;
+            while (hdr->LastRstNext_ > 0 && recs[hdr->LastRstNext_ - 1].Kind_ != FixRecorderIndexKind::RstSend)
+               --hdr->LastRstNext_;
+         }
+      }
+   }
+   return res;
+
+__OPEN_ERROR:
+   this->Map_.Unmap();
+   this->Capacity_ = 0;
+   this->File_.Close();
+   return res;
+}
+void FixRecorderIndex::Close() {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   this->Map_.Unmap();
+   this->Capacity_ = 0;
+   this->File_.Close();
+}
+bool FixRecorderIndex::IsOpened() const {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   return this->Map_.IsMapped();
+}
+void FixRecorderIndex::Clear() {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   if (this->Map_.IsMapped())
+      this->ResetHeader();
+}
+size_t FixRecorderIndex::size() const {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   return this->Map_.IsMapped() ? static_cast<size_t>(this->GetHeader()->Count_) : 0;
+}
+bool FixRecorderIndex::GetLast(FixRecorderIndexRec& rec) const {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   if (!this->Map_.IsMapped())
+      return false;
+   const size_t count = static_cast<size_t>(this->GetHeader()->Count_);
+   if (count == 0)
+      return false;
+   rec = this->GetRecs()[count - 1];
+   return true;
+}
+bool FixRecorderIndex::Append(const FixRecorderIndexRec* recs, size_t count) {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   if (!this->Map_.IsMapped())
+      return false;
+   const size_t oldCount = static_cast<size_t>(this->GetHeader()->Count_);
+   if (!this->Reserve(oldCount + count) || !this->Map_.IsMapped())
+      return false;
+   Header* hdr = this->GetHeader();
+   memcpy(this->GetRecs() + oldCount, recs, count * sizeof(Rec));
+   for (size_t L = count; L > 0;) {
+      if (recs[--L].Kind_ == FixRecorderIndexKind::RstSend) {
+         hdr->LastRstNext_ = oldCount + L + 1;
+         break;
+      }
+   }
+   hdr->Count_ = oldCount + count;
+   return true;
+}
+bool FixRecorderIndex::FindSent(FixSeqNum seqFrom, FixRecorderIndexRec& rec) const {
+   std::lock_guard<std::mutex> lk{this->Mutex_};
+   if (!this->Map_.IsMapped())
+      return false;
+   const Header* hdr = this->GetHeader();
+   const Rec*    recs = this->GetRecs();
+   const size_t  ifirst = static_cast<size_t>(hdr->LastRstNext_);
+   const size_t  count = static_cast<size_t>(hdr->Count_);
+   if (ifirst >= count)
+      return false;
+   const Rec& first = recs[ifirst];
+   if (seqFrom <= first.SeqNum_) {
+      rec = first;
+      return true;
+   }
+   // 同一段(RstSend 之後)的 Sent 記錄序號連續, 直接計算位置.
+   const size_t idx = ifirst + (seqFrom - first.SeqNum_);
+   if (idx < count && recs[idx].SeqNum_ == seqFrom) {
+      rec = recs[idx];
+      return true;
+   }
+   // 序號不連續(例: 索引是從舊的 FixRecorder 檔案重建), 則使用二元搜尋.
+   const Rec* pfound = std::lower_bound(recs + ifirst, recs + count, seqFrom,
+                                        [](const Rec& r, FixSeqNum seq) { return r.SeqNum_ < seq; });
+   if (pfound == recs + count)
+      return false;
+   rec = *pfound;
+   return true;
+}
+
+} } // namespaces
@@ -0,0 +1,87 @@
+﻿/// \file fon9/fix/FixRecorderIndex.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_fix_FixRecorderIndex_hpp__
+#define __fon9_fix_FixRecorderIndex_hpp__
+#include "fon9/fix/FixBase.hpp"
+#include "fon9/FileMap.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <mutex>
+fon9_AFTER_INCLUDE_STD;
+
+namespace fon9 { namespace fix {
+
+enum class FixRecorderIndexKind : uint32_t {
+   /// Pos_ = "S timestamp FIX Message" 這行的開始位置, SeqNum_ = 該筆訊息的 MsgSeqNum.
+   Sent = 'S',
+   /// Pos_ = "\x02" "RST|S=n" 這行之後的位置, SeqNum_ = n = 新的 NextSendSeq.
+   /// 送出序號不連續時才會有此記錄.
+   RstSend = 'r',
+};
+
+/// \ingroup fix
+/// FixRecorderIndex 的一筆記錄.
+struct FixRecorderIndexRec {
+   File::PosType        Pos_;
+   FixSeqNum            SeqNum_;
+   FixRecorderIndexKind Kind_;
+};
+static_assert(sizeof(FixRecorderIndexRec) == 16, "sizeof(FixRecorderIndexRec) must be 16.");
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup fix
+/// FixRecorder 的送出訊息索引檔: 固定長度的 FixRecorderIndexRec, 使用 FileMap 存取.
+/// - 依照寫入 FixRecorder 的順序記錄: 送出訊息的位置 及 送出序號的重設(RstSend).
+/// - 最後一個 RstSend 之後的 Sent 記錄, 序號必定是連續的,
+///   所以在 FindSent() 時可以直接計算出記錄的位置, 不用在 FixRecorder 的檔案裡面尋找.
+/// - 檔案格式: Header + FixRecorderIndexRec[Capacity];
+///   Header 記錄了有效的記錄數量, 空間不足時, 檔案大小加倍.
+/// - 由 FixRecorder 的 async appender 在寫入 FixRecorder 檔案之後, 才會呼叫 Append();
+///   所以 Pos_ 不會超過 FixRecorder 的檔案大小;
+///   但若異常結束(或 FixRecorder 寫檔失敗), 則可能會有超過的情況, 所以 Open() 時需要檢查.
+class fon9_API FixRecorderIndex {
+   fon9_NON_COPY_NON_MOVE(FixRecorderIndex);
+   struct Header;
+   using Rec = FixRecorderIndexRec;
+
+   mutable std::mutex   Mutex_;
+   File     File_;
+   FileMap  Map_;
+   size_t   Capacity_{0};
+
+   Header* GetHeader() const {
+      return static_cast<Header*>(this->Map_.data());
+   }
+   Rec* GetRecs() const;
+   File::Result MapFile(File::SizeType fileSize);
+   File::Result Reserve(size_t count);
+   void ResetHeader();
+
+public:
+   FixRecorderIndex() = default;
+   ~FixRecorderIndex();
+
+   /// 開啟(或建立)索引檔.
+   /// 並移除超過 dataFileSize 的記錄(異常結束時, 索引可能比 FixRecorder 的檔案多).
+   File::Result Open(std::string fileName, File::PosType dataFileSize);
+   void Close();
+   bool IsOpened() const;
+
+   /// 清除全部記錄, 用於: FixRecorder 的檔案是新建的, 或索引與 FixRecorder 的檔案不一致.
+   void Clear();
+   /// 有效的記錄數量.
+   size_t size() const;
+   /// \retval false 沒有任何記錄.
+   bool GetLast(FixRecorderIndexRec& rec) const;
+   /// 加入記錄.
+   /// \retval false 索引檔沒開啟, 或空間不足且無法擴充.
+   bool Append(const FixRecorderIndexRec* recs, size_t count);
+
+   /// 在最後一個 RstSend 之後的 Sent 記錄中, 找出第一筆 SeqNum_ >= seqFrom 的記錄.
+   /// \retval false 找不到, 或索引檔沒開啟.
+   bool FindSent(FixSeqNum seqFrom, FixRecorderIndexRec& rec) const;
+};
+fon9_WARN_POP;
+
+} } // namespaces
+#endif//__fon9_fix_FixRecorderIndex_hpp__
@@ -12,6 +12,8 @@ namespace fon9 { namespace fix {
 //   - ~FixRecorder() 關檔前.
 // - 每次從尾端往前讀取 n KB, 然後用 memrchr() 尋找 f9fix_kCHAR_HdrCtrlMsgSeqNum.
 //   - 直到找到所需的序號為止
+// - 若有索引檔(FixRecorderIndex), 則優先使用索引檔, 直接讀取所需的訊息,
+//   只有在索引檔無法使用時, 才從檔案尾端往前尋找.
 
 //--------------------------------------------------------------------------//
 // pbeg = 一行的開頭.
@@ -94,6 +96,146 @@ const char* FixRecorder::FixRevSercher::ParseFixLine_MsgSeqNum(const char* pbeg,
    return pbeg;
 }
 //--------------------------------------------------------------------------//
+/// 從記錄檔的 pos(必須是一行的開頭) 開始, 找出 "S " 及 "RST|S=" 建立索引.
+struct FixRecorder::SentIndexBuilder {
+   fon9_NON_COPY_NON_MOVE(SentIndexBuilder);
+   enum {
+      kBlockSize = kReloadSentBufferSize,
+      kFlushCount = 1024 * 4,
+   };
+   FixRecorderIndex&                SentIndex_;
+   FixParser                        FixParser_;
+   FixSeqNum                        ExpectNextSeq_{0};
+   std::vector<FixRecorderIndexRec> Recs_;
+
+   SentIndexBuilder(FixRecorder& fixRecorder, FixSeqNum expectNextSeq)
+      : SentIndex_(fixRecorder.SentIndex_)
+      , ExpectNextSeq_{expectNextSeq} {
+      this->FixParser_.ResetExpectHeader(ToStrView(fixRecorder.BeginHeader_));
+   }
+   void Flush() {
+      if (!this->Recs_.empty()) {
+         this->SentIndex_.Append(this->Recs_.data(), this->Recs_.size());
+         this->Recs_.clear();
+      }
+   }
+   /// 解析 "S timestamp FIX Message" 的 MsgSeqNum.
+   /// \retval 0 格式不正確.
+   FixSeqNum ParseSentSeq(const char* pbeg, const char* pend) {
+      if ((pbeg = SkipTimestamp(pbeg, pend)) == nullptr)
+         return 0;
+      StrView fixmsg{pbeg, pend};
+      this->FixParser_.Clear();
+      this->FixParser_.ParseFields(fixmsg, FixParser::Until::MsgSeqNum);
+      return this->FixParser_.GetMsgSeqNum();
+   }
+   /// [pbeg..pend) = 一行, 不含 '\n'; pos = pbeg 在記錄檔的位置.
+   void OnLine(const char* pbeg, const char* pend, File::PosType pos) {
+      if (pbeg == pend)
+         return;
+      if (*pbeg == f9fix_kCSTR_HdrSend[0]) {
+         if (FixSeqNum seq = this->ParseSentSeq(pbeg, pend)) {
+            this->Recs_.push_back(FixRecorderIndexRec{pos, seq, FixRecorderIndexKind::Sent});
+            this->ExpectNextSeq_ = seq + 1;
+         }
+      }
+      else if (*pbeg == f9fix_kCHAR_HdrCtrlMsgSeqNum) {
+         static const char kRstSend[] = f9fix_kCSTR_HdrRst f9fix_kCSTR_HdrNextSendSeq;
+         if (pend - pbeg <= static_cast<ptrdiff_t>(sizeof(kRstSend) - 1)
+             || memcmp(pbeg, kRstSend, sizeof(kRstSend) - 1) != 0)
+            return;
+         FixSeqNum seq = StrTo(StrView{pbeg + sizeof(kRstSend) - 1, pend}, FixSeqNum{0});
+         if (seq > 0 && seq != this->ExpectNextSeq_) {
+            this->Recs_.push_back(FixRecorderIndexRec{pos + static_cast<size_t>(pend - pbeg) + 1, seq, FixRecorderIndexKind::RstSend});
+            this->ExpectNextSeq_ = seq;
+         }
+      }
+      else
+         return;
+      if (this->Recs_.size() >= kFlushCount)
+         this->Flush();
+   }
+   /// 讀取記錄檔的 [pos..dataFileSize) 建立索引.
+   void Build(File& file, File::PosType pos, File::PosType dataFileSize) {
+      std::unique_ptr<char[]> buf{new char[kBlockSize]};
+      size_t bufSize = 0;
+      bool   isSkipLine = false; // 超過 kBlockSize 的一行: 略過到下一個 '\n'.
+      while (pos + bufSize < dataFileSize) {
+         File::SizeType rdsz = dataFileSize - pos - bufSize;
+         if (rdsz > kBlockSize - bufSize)
+            rdsz = kBlockSize - bufSize;
+         File::Result res = file.Read(pos + bufSize, buf.get() + bufSize, rdsz);
+         if (!res || res.GetResult() == 0)
+            break;
+         bufSize += static_cast<size_t>(res.GetResult());
+         const char* pbeg = buf.get();
+         const char* pend = pbeg + bufSize;
+         while (const char* peol = static_cast<const char*>(memchr(pbeg, '\n', static_cast<size_t>(pend - pbeg)))) {
+            if (isSkipLine)
+               isSkipLine = false;
+            else
+               this->OnLine(pbeg, peol, pos + static_cast<size_t>(pbeg - buf.get()));
+            pbeg = peol + 1;
+         }
+         if (pbeg == buf.get() && bufSize >= kBlockSize) {
+            isSkipLine = true;
+            pbeg = pend;
+         }
+         const size_t remain = static_cast<size_t>(pend - pbeg);
+         pos += static_cast<size_t>(pbeg - buf.get());
+         memmove(buf.get(), pbeg, remain);
+         bufSize = remain;
+      }
+      this->Flush();
+   }
+};
+void FixRecorder::InitSentIndex(std::string fileName, File::PosType dataFileSize) {
+   File::Result res = this->SentIndex_.Open(fileName, dataFileSize);
+   if (!res) {
+      this->Write(f9fix_kCSTR_HdrError, "f9fix.FixRecorder SentIndex open|fileName=", fileName, "|err=", res);
+      return;
+   }
+   if (dataFileSize == 0) // 新的記錄檔, 索引檔的內容必定無效.
+      this->SentIndex_.Clear();
+   File&               file = this->GetStorage();
+   File::PosType       scanFrom = 0;
+   FixSeqNum           expectNextSeq = 0;
+   FixRecorderIndexRec last;
+   if (this->SentIndex_.GetLast(last)) {
+      if (last.Kind_ == FixRecorderIndexKind::RstSend) {
+         scanFrom = last.Pos_;
+         expectNextSeq = last.SeqNum_;
+      }
+      else {
+         // 檢查最後一筆索引, 是否與記錄檔的內容相符.
+         char  buf[kMaxFixMsgBufferSize + 64];
+         res = file.Read(last.Pos_, buf, sizeof(buf));
+         const char* peol = (res ? static_cast<const char*>(memchr(buf, '\n', static_cast<size_t>(res.GetResult()))) : nullptr);
+         SentIndexBuilder chk{*this, 0};
+         if (peol && buf[0] == f9fix_kCSTR_HdrSend[0] && chk.ParseSentSeq(buf, peol) == last.SeqNum_) {
+            scanFrom = last.Pos_ + static_cast<size_t>(peol - buf) + 1;
+            expectNextSeq = last.SeqNum_ + 1;
+         }
+         else {
+            this->SentIndex_.Clear();
+         }
+      }
+   }
+   const size_t countBefore = this->SentIndex_.size();
+   SentIndexBuilder builder{*this, expectNextSeq};
+   builder.Build(file, scanFrom, dataFileSize);
+   if (builder.ExpectNextSeq_ != this->NextSendSeq_ && this->SentIndex_.size() > 0) {
+      FixRecorderIndexRec rst{dataFileSize, this->NextSendSeq_, FixRecorderIndexKind::RstSend};
+      this->SentIndex_.Append(&rst, 1);
+   }
+   this->IsSentIndexReady_ = true;
+   if (this->SentIndex_.size() != countBefore)
+      this->Write(f9fix_kCSTR_HdrInfo,
+                  "f9fix.FixRecorder SentIndex rebuilt"
+                  "|from=", scanFrom,
+                  "|count=", this->SentIndex_.size() - countBefore);
+}
+//--------------------------------------------------------------------------//
 LoopControl FixRecorder::LastSeqSearcher::OnFileBlock(size_t rdsz) {
    return this->RevSearchBlock(this->GetBlockPos(), '\n', rdsz);
 }
@@ -203,9 +345,36 @@ bool FixRecorder::ReloadSent::InitStart(FixRecorder& fixRecorder, FixSeqNum seqF
    fixRecorder.WaitFlushed();
    return true;
 }
+bool FixRecorder::ReloadSent::StartByIndex(FixRecorder& fixRecorder, FixSeqNum seqFrom) {
+   FixRecorderIndexRec rec;
+   if (!fixRecorder.SentIndex_.FindSent(seqFrom, rec))
+      return false;
+   File::Result res = fixRecorder.GetStorage().Read(rec.Pos_, this->Buffer_, kReloadSentBufferSize);
+   if (!res || res.GetResult() == 0 || this->Buffer_[0] != f9fix_kCSTR_HdrSend[0])
+      return false;
+   const char* const pend = this->Buffer_ + res.GetResult();
+   const char* const peol = static_cast<const char*>(memchr(this->Buffer_, '\n', static_cast<size_t>(pend - this->Buffer_)));
+   const char* const pmsg = (peol ? SkipTimestamp(this->Buffer_, peol) : nullptr);
+   if (pmsg == nullptr)
+      return false;
+   StrView fixmsg{pmsg, peol};
+   this->FixParser_.Clear();
+   this->FixParser_.ParseFields(fixmsg, FixParser::Until::MsgSeqNum);
+   if (this->FixParser_.GetMsgSeqNum() != rec.SeqNum_)
+      return false;
+   this->CurBufferPos_ = rec.Pos_;
+   this->FoundDataEnd_ = pend;
+   this->CurMsg_.Reset(pmsg, peol);
+   return true;
+}
 StrView FixRecorder::ReloadSent::Find(FixRecorder& fixRecorder, FixSeqNum seq) {
    if (!this->InitStart(fixRecorder, seq))
       return StrView{};
+   if (this->StartByIndex(fixRecorder, seq)) {
+      if (this->FixParser_.GetMsgSeqNum() == seq)
+         return this->CurMsg_;
+      return this->CurMsg_ = nullptr;
+   }
    SentMessageSearcher  searcher{*this};
    File::Result         res = searcher.Start(*this, seq, fixRecorder.GetStorage());
    if (fon9_LIKELY(res && !searcher.FoundLine_.empty())) {
@@ -217,6 +386,15 @@ StrView FixRecorder::ReloadSent::Find(FixRecorder& fixRecorder, FixSeqNum seq) {
 StrView FixRecorder::ReloadSent::Start(FixRecorder& fixRecorder, FixSeqNum seqFrom) {
    if (!this->InitStart(fixRecorder, seqFrom))
       return StrView{};
+   if (this->StartByIndex(fixRecorder, seqFrom)) {
+      fixRecorder.Write(f9fix_kCSTR_HdrInfo,
+                        "ReloadSent:"
+                        "|seq=", seqFrom,
+                        "|foundAt=", this->CurBufferPos_ + static_cast<size_t>(this->CurMsg_.begin() - this->Buffer_),
+                        "|foundSeq=", this->FixParser_.GetMsgSeqNum(),
+                        "|by=SentIndex");
+      return this->CurMsg_;
+   }
    SentMessageSearcher  searcher{*this};
    File::Result         res = searcher.Start(*this, seqFrom, fixRecorder.GetStorage());
    if (!res)
@@ -317,4 +495,123 @@ bool FixRecorder::ReloadSent::IsErrOrEOF(FixRecorder& fixRecorder, FixRecorder::
    return (this->CurBufferPos_ + (this->FoundDataEnd_ - this->Buffer_)) >= res.GetResult();
 }
 
+//--------------------------------------------------------------------------//
+bool FixRecorder::ReplayReader::MapFrom(FixRecorder& fixRecorder, PosType pos, size_t minSize) {
+   File&        file = fixRecorder.GetStorage();
+   File::Result res = file.GetFileSize();
+   if (!res || res.GetResult() <= pos)
+      return false;
+   size_t msz = (minSize > kMapWindowSize ? minSize : static_cast<size_t>(kMapWindowSize));
+   if (msz > res.GetResult() - pos)
+      msz = static_cast<size_t>(res.GetResult() - pos);
+   this->IsMapFailed_ = !this->Map_.Map(file, pos, msz, false);
+   if (this->IsMapFailed_)
+      return false;
+   this->Map_.AdviseSequential();
+   this->MapPos_ = pos;
+   this->NextLine_ = this->Map_.begin();
+   return true;
+}
+bool FixRecorder::ReplayReader::Remap(FixRecorder& fixRecorder) {
+   fixRecorder.WaitFlushed();
+   File::Result res = fixRecorder.GetStorage().GetFileSize();
+   if (!res) {
+      this->CurMsg_.Reset(nullptr);
+      return false;
+   }
+   if (res.GetResult() <= this->MapPos_ + this->Map_.size())
+      return false;
+   // 若整個映射範圍內沒有完整的一行(超過 kMapWindowSize 的單行資料), 則需要映射更大的範圍.
+   const size_t minSize = (this->NextLine_ == this->Map_.begin() ? this->Map_.size() * 2 : 0);
+   if (!this->MapFrom(fixRecorder, this->MapPos_ + static_cast<PosType>(this->NextLine_ - this->Map_.begin()), minSize)) {
+      this->CurMsg_.Reset(nullptr);
+      return false;
+   }
+   return true;
+}
+StrView FixRecorder::ReplayReader::StartByIndex(FixRecorder& fixRecorder, FixSeqNum seqFrom) {
+   FixRecorderIndexRec rec;
+   if (!fixRecorder.SentIndex_.FindSent(seqFrom, rec) || !this->MapFrom(fixRecorder, rec.Pos_))
+      return StrView{};
+   const char* const pbeg = this->Map_.begin();
+   const char* const peol = static_cast<const char*>(memchr(pbeg, '\n', this->Map_.size()));
+   const char* const pmsg = ((peol && *pbeg == f9fix_kCSTR_HdrSend[0]) ? SkipTimestamp(pbeg, peol) : nullptr);
+   if (pmsg == nullptr)
+      return StrView{};
+   StrView fixmsg{pmsg, peol};
+   this->FixParser_.Clear();
+   this->FixParser_.ParseFields(fixmsg, FixParser::Until::MsgSeqNum);
+   if (this->FixParser_.GetMsgSeqNum() != rec.SeqNum_)
+      return StrView{};
+   this->NextLine_ = peol + 1;
+   return this->CurMsg_ = StrView{pmsg, peol};
+}
+StrView FixRecorder::ReplayReader::Start(FixRecorder& fixRecorder, FixSeqNum seqFrom) {
+   this->FixParser_.ResetExpectHeader(ToStrView(fixRecorder.BeginHeader_));
+   this->Map_.Unmap();
+   this->NextLine_ = nullptr;
+   this->CurMsg_.Reset(nullptr);
+   this->IsMapFailed_ = false;
+   if (seqFrom <= 0 || fixRecorder.NextSendSeq_ <= seqFrom) // 未送出的訊息序號, 必定找不到!
+      return StrView{};
+   fixRecorder.WaitFlushed();
+   if (!this->StartByIndex(fixRecorder, seqFrom).IsNull()) {
+      fixRecorder.Write(f9fix_kCSTR_HdrInfo,
+                        "ReplayReader:"
+                        "|seq=", seqFrom,
+                        "|foundAt=", this->MapPos_ + static_cast<PosType>(this->CurMsg_.begin() - this->Map_.begin()),
+                        "|foundSeq=", this->FixParser_.GetMsgSeqNum(),
+                        "|by=SentIndex");
+      return this->CurMsg_;
+   }
+   // 索引檔無法使用: 透過 ReloadSent 找到開始位置, 然後從該位置開始映射.
+   // ReloadSent 的緩衝區很大, 所以不放在 stack.
+   this->CurMsg_.Reset(nullptr);
+   std::unique_ptr<ReloadSent> reloader{new ReloadSent};
+   StrView fixmsg = reloader->Start(fixRecorder, seqFrom);
+   if (fixmsg.empty() || !this->MapFrom(fixRecorder, reloader->GetCurMsgPos(), fixmsg.size() + 1))
+      return StrView{};
+   this->CurMsg_.Reset(this->Map_.begin(), this->Map_.begin() + fixmsg.size());
+   this->NextLine_ = this->CurMsg_.end();
+   if (this->NextLine_ < this->Map_.end())
+      ++this->NextLine_; // 跳過 '\n'.
+   fixmsg = this->CurMsg_;
+   this->FixParser_.Clear();
+   this->FixParser_.ParseFields(fixmsg, FixParser::Until::MsgSeqNum);
+   return this->CurMsg_;
+}
+StrView FixRecorder::ReplayReader::FindNext(FixRecorder& fixRecorder) {
+   if (this->CurMsg_.IsNull())
+      return this->CurMsg_;
+   for (;;) {
+      const char* const pend = this->Map_.end();
+      while (this->NextLine_ < pend) {
+         const char* pbeg = this->NextLine_;
+         const char* peol = static_cast<const char*>(memchr(pbeg, '\n', static_cast<size_t>(pend - pbeg)));
+         if (peol == nullptr)
+            break;
+         this->NextLine_ = peol + 1;
+         if (*pbeg == f9fix_kCSTR_HdrSend[0]) {
+            if ((pbeg = SkipTimestamp(pbeg, peol)) != nullptr)
+               return this->CurMsg_ = StrView{pbeg, peol};
+         }
+      }
+      if (!this->Remap(fixRecorder)) {
+         if (this->CurMsg_.IsNull())
+            return this->CurMsg_;
+         // 已到檔尾: 保留 NextLine_, 若之後有新增資料, 可以再呼叫 FindNext() 繼續.
+         return this->CurMsg_ = StrView{this->NextLine_, this->NextLine_};
+      }
+   }
+}
+bool FixRecorder::ReplayReader::IsErrOrEOF(FixRecorder& fixRecorder, FixRecorder::Locker&& locker) const {
+   if (this->CurMsg_.empty())
+      return true;
+   fixRecorder.WaitFlushed(std::move(locker));
+   File::Result res = fixRecorder.GetStorage().GetFileSize();
+   if (!res)
+      return true;
+   return (this->MapPos_ + this->Map_.size()) >= res.GetResult();
+}
+
 } } // namespaces
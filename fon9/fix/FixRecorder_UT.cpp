@@ -2,7 +2,7 @@
 // \author fonwinz@gmail.com
 #define _CRT_SECURE_NO_WARNINGS
 #include "fon9/TestTools.hpp"
-#include "fon9/fix/FixRecorder.hpp"
+#include "fon9/fix/FixRecorder_Searcher.hpp"
 #include "fon9/fix/FixBuilder.hpp"
 #include "fon9/Timer.hpp"
 #include "fon9/DefaultThreadPool.hpp"
@@ -51,8 +51,8 @@ void CheckFixMessage(fon9::StrView fixmsg, f9fix::FixSeqNum expectSeqNum) {
       abort();
    }
 }
-void CheckReloadSent(f9fix::FixRecorder& fixr, f9fix::FixSeqNum seqFrom, f9fix::FixSeqNum count) {
-   f9fix::FixRecorder::ReloadSent reloader;
+template <class Reloader>
+void CheckReload(Reloader& reloader, f9fix::FixRecorder& fixr, f9fix::FixSeqNum seqFrom, f9fix::FixSeqNum count) {
    CheckFixMessage(reloader.Start(fixr, seqFrom), seqFrom);
    while (count > 1) {
       CheckFixMessage(reloader.FindNext(fixr), ++seqFrom);
@@ -63,6 +63,26 @@ void CheckReloadSent(f9fix::FixRecorder& fixr, f9fix::FixSeqNum seqFrom, f9fix::
       abort();
    }
 }
+void CheckReloadSent(f9fix::FixRecorder& fixr, f9fix::FixSeqNum seqFrom, f9fix::FixSeqNum count) {
+   f9fix::FixRecorder::ReloadSent reloader;
+   CheckReload(reloader, fixr, seqFrom, count);
+   // ReplayReader 必須取得與 ReloadSent 相同的結果.
+   f9fix::FixRecorder::ReplayReader replayer;
+   CheckReload(replayer, fixr, seqFrom, count);
+}
+void ReopenFixRecorder(f9fix::FixRecorderSP& fixr, const f9fix::CompIDs& compIds, const char* fixrFileName) {
+   fixr.reset(new f9fix::FixRecorder(f9fix_BEGIN_HEADER_V42, f9fix::CompIDs{compIds}));
+   int count = 100;
+   fon9::File::Result res;
+   while (!(res = fixr->Initialize(fixrFileName))) {
+      if (--count <= 0) {
+         std::cout << "Reopen FixRecorder|fileName=" << fixrFileName
+            << "|err=" << fon9::RevPrintTo<std::string>(res) << std::endl;
+         abort();
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds{10});
+   }
+}
 //--------------------------------------------------------------------------//
 
 int main(int argc, char** argv) {
@@ -78,7 +98,9 @@ int main(int argc, char** argv) {
    f9fix::CompIDs       compIds{"SenderCoId", "SenderSubId", "TargetCoId", "TargetSubId"};
    f9fix::FixRecorderSP fixr{new f9fix::FixRecorder(f9fix_BEGIN_HEADER_V42, f9fix::CompIDs{compIds})};
    const char           fixrFileName[] = "FixRecorder_UT.log";
+   const std::string    fixrIndexName = std::string{fixrFileName} + f9fix_kCSTR_SentIndexFileExt;
    remove(fixrFileName);
+   remove(fixrIndexName.c_str());
    auto res = fixr->Initialize(fixrFileName);
    if (!res) {
       std::cout << "Open FixRecorder|fileName=" << fixrFileName
@@ -112,16 +134,7 @@ int main(int argc, char** argv) {
    BuildTestMessage(fixb, ToStrView(fixr->CompIDs_.Header_), kTimes + 1, fixr->GetNextRecvSeq());
    fixr->WriteInputConform(fon9::ToStrView(fon9::BufferTo<std::string>(fixb.Final(ToStrView(fixr->BeginHeader_)))));
    fixr->WaitFlushed();
-   fixr.reset(new f9fix::FixRecorder(f9fix_BEGIN_HEADER_V42, f9fix::CompIDs{compIds}));
-   int count = 100;
-   do {
-      if (--count <= 0) {
-         std::cout << "Reopen FixRecorder|fileName=" << fixrFileName
-            << "|err=" << fon9::RevPrintTo<std::string>(res) << std::endl;
-         abort();
-      }
-      std::this_thread::sleep_for(std::chrono::milliseconds{10});
-   } while (!fixr->Initialize(fixrFileName));
+   ReopenFixRecorder(fixr, compIds, fixrFileName);
    if (fixr->GetNextRecvSeq() != kTimes + 2 || fixr->GetNextSendSeq(fixr->Lock()) != kTimes + 1) {
       std::cout << "Reopen FixRecorder|fileName=" << fixrFileName
          << "|err=Unexpected NextSeq|expectNextRecvSeq=" << kTimes + 2
@@ -132,8 +145,43 @@ int main(int argc, char** argv) {
       abort();
    }
 
+   // Test: 重新開啟後, 使用之前建立的索引檔.
+   std::cout << "[TEST ] Reload sent after reopen.";
+   CheckReloadSent(*fixr, 1, kTimes);
+   CheckReloadSent(*fixr, kTimes / 2, kTimes - kTimes / 2 + 1);
+   std::cout << "\r" "[OK   ]" << std::endl;
+
+   // Test: "RST|S=1" 之後, 只能找到 RST 之後送出的訊息.
+   std::cout << "[TEST ] Reload sent after RST.";
+   fon9::RevBufferList rbuf{128};
+   fon9::RevPrint(rbuf, f9fix_kCSTR_HdrRst f9fix_kCSTR_HdrNextSendSeq, 1u, '\n');
+   fixr->WriteAfterSend(fixr->Lock(), std::move(rbuf), 1);
+   const unsigned kTimesAfterRst = 10;
+   TestFixRecorder(*fixr, kTimesAfterRst);
+   CheckReloadSent(*fixr, 1, kTimesAfterRst);
+   CheckReloadSent(*fixr, kTimesAfterRst / 2, kTimesAfterRst - kTimesAfterRst / 2 + 1);
+   std::cout << "\r" "[OK   ]" << std::endl;
+
+   // Test: 沒有索引檔(或索引檔與記錄檔不一致), 重新開啟時, 從記錄檔重建索引.
+   std::cout << "[TEST ] Rebuild sent index.";
+   fixr->WaitFlushed();
+   fixr.reset();
+   fon9::WaitRemoveFile(fixrIndexName.c_str());
+   ReopenFixRecorder(fixr, compIds, fixrFileName);
+   if (fixr->GetNextSendSeq(fixr->Lock()) != kTimesAfterRst + 1) {
+      std::cout << "|err=Unexpected NextSendSeq|expect=" << kTimesAfterRst + 1
+         << "|nextSendSeq=" << fixr->GetNextSendSeq(fixr->Lock())
+         << "\r" "[ERROR]" << std::endl;
+      abort();
+   }
+   CheckReloadSent(*fixr, 1, kTimesAfterRst);
+   CheckReloadSent(*fixr, kTimesAfterRst / 2, kTimesAfterRst - kTimesAfterRst / 2 + 1);
+   std::cout << "\r" "[OK   ]" << std::endl;
+
    // 結束前刪除測試檔.
    fixr.reset();
-   if (!fon9::IsKeepTestFiles(argc, argv))
+   if (!fon9::IsKeepTestFiles(argc, argv)) {
       fon9::WaitRemoveFile(fixrFileName);
+      fon9::WaitRemoveFile(fixrIndexName.c_str());
+   }
 }
@@ -0,0 +1,199 @@
+﻿// \file fon9/fix/FixScan.cpp
+// \author fonwinz@gmail.com
+#include "fon9/fix/FixScan.hpp"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define fon9_FixScan_X86
+fon9_BEFORE_INCLUDE_STD;
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+fon9_AFTER_INCLUDE_STD;
+#endif
+
+#if defined(fon9_FixScan_X86) && !defined(_MSC_VER)
+#define fon9_FixScan_TARGET_AVX2    __attribute__((target("avx2")))
+#else
+#define fon9_FixScan_TARGET_AVX2
+#endif
+
+namespace fon9 { namespace fix {
+
+static byte FixCheckSum_Scalar(const byte* pbeg, size_t size, byte init) {
+   uint32_t sum = init;
+   for (const byte* pend = pbeg + size; pbeg != pend; ++pbeg)
+      sum += *pbeg;
+   return static_cast<byte>(sum);
+}
+static void FixScanSpl_Scalar(const char* beg, size_t size, uint64_t* bitmap) {
+   memset(bitmap, 0, FixScanSplBitmapWords(size) * sizeof(*bitmap));
+   for (size_t idx = 0; idx < size; ++idx) {
+      if (beg[idx] == f9fix_kCHAR_SPL)
+         bitmap[idx / 64] |= (static_cast<uint64_t>(1) << (idx % 64));
+   }
+}
+/// 從 bitmap 的 idx 開始(idx 必須是 64 的倍數), 處理剩餘不足一個 stride 的資料.
+static void FixScanSpl_Tail(const char* beg, size_t idx, size_t size, uint64_t* bitmap) {
+   if (idx >= size)
+      return;
+   uint64_t* pword = bitmap + idx / 64;
+   uint64_t  word = 0;
+   for (unsigned bit = 0; idx < size; ++idx, ++bit) {
+      if (bit == 64) {
+         *pword++ = word;
+         word = 0;
+         bit = 0;
+      }
+      if (beg[idx] == f9fix_kCHAR_SPL)
+         word |= (static_cast<uint64_t>(1) << bit);
+   }
+   *pword = word;
+}
+
+#ifdef fon9_FixScan_X86
+fon9_GCC_WARN_DISABLE("-Wold-style-cast"); // intrinsic macros.
+static byte FixCheckSum_Sse2(const byte* pbeg, size_t size, byte init) {
+   const __m128i  zero = _mm_setzero_si128();
+   __m128i        acc = zero;
+   const byte*    pend = pbeg + (size & ~static_cast<size_t>(15));
+   for (; pbeg != pend; pbeg += 16) {
+      // _mm_sad_epu8(v, 0): 每 8 bytes 的總和, 放在 2 個 64 bits 裡面.
+      acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pbeg)), zero));
+   }
+   uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc))
+                + static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc)));
+   return FixCheckSum_Scalar(pbeg, size & 15, static_cast<byte>(sum + init));
+}
+static void FixScanSpl_Sse2(const char* beg, size_t size, uint64_t* bitmap) {
+   const __m128i  spl = _mm_set1_epi8(f9fix_kCHAR_SPL);
+   const size_t   fullsz = size & ~static_cast<size_t>(63);
+   size_t         idx = 0;
+   for (; idx < fullsz; idx += 64) {
+      const __m128i* p = reinterpret_cast<const __m128i*>(beg + idx);
+      const uint64_t m0 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 0), spl)));
+      const uint64_t m1 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 1), spl)));
+      const uint64_t m2 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), spl)));
+      const uint64_t m3 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p + 3), spl)));
+      bitmap[idx / 64] = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+   }
+   FixScanSpl_Tail(beg, idx, size, bitmap);
+}
+
+fon9_FixScan_TARGET_AVX2
+static byte FixCheckSum_Avx2(const byte* pbeg, size_t size, byte init) {
+   const __m256i  zero = _mm256_setzero_si256();
+   __m256i        acc = zero;
+   const byte*    pend = pbeg + (size & ~static_cast<size_t>(31));
+   for (; pbeg != pend; pbeg += 32)
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pbeg)), zero));
+   __m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+   uint32_t sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc128))
+                + static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc128, acc128)));
+   return FixCheckSum_Scalar(pbeg, size & 31, static_cast<byte>(sum + init));
+}
+fon9_FixScan_TARGET_AVX2
+static void FixScanSpl_Avx2(const char* beg, size_t size, uint64_t* bitmap) {
+   const __m256i  spl = _mm256_set1_epi8(f9fix_kCHAR_SPL);
+   const size_t   fullsz = size & ~static_cast<size_t>(63);
+   size_t         idx = 0;
+   for (; idx < fullsz; idx += 64) {
+      const __m256i* p = reinterpret_cast<const __m256i*>(beg + idx);
+      const uint64_t m0 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 0), spl)));
+      const uint64_t m1 = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), spl)));
+      bitmap[idx / 64] = m0 | (m1 << 32);
+   }
+   FixScanSpl_Tail(beg, idx, size, bitmap);
+}
+fon9_GCC_WARN_POP;
+
+static bool IsCpuSupportsAvx2() {
+#ifdef _MSC_VER
+   int info[4];
+   __cpuid(info, 0);
+   if (info[0] < 7)
+      return false;
+   __cpuid(info, 1);
+   // OSXSAVE && AVX: 作業系統必須有保存 ymm 暫存器.
+   if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+      return false;
+   if ((_xgetbv(0) & 6) != 6)
+      return false;
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#else
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif // fon9_FixScan_X86
+
+//--------------------------------------------------------------------------//
+struct FixScanFuncs {
+   FixScanImpl Impl_;
+   byte (*FnCheckSum_)(const byte* pbeg, size_t size, byte init);
+   void (*FnScanSpl_)(const char* beg, size_t size, uint64_t* bitmap);
+};
+static const FixScanFuncs  FixScanFuncs_Scalar{FixScanImpl::Scalar, &FixCheckSum_Scalar, &FixScanSpl_Scalar};
+#ifdef fon9_FixScan_X86
+static const FixScanFuncs  FixScanFuncs_Sse2{FixScanImpl::Sse2, &FixCheckSum_Sse2, &FixScanSpl_Sse2};
+static const FixScanFuncs  FixScanFuncs_Avx2{FixScanImpl::Avx2, &FixCheckSum_Avx2, &FixScanSpl_Avx2};
+#endif
+
+static const FixScanFuncs* GetFixScanFuncs(FixScanImpl impl) {
+   switch (impl) {
+   case FixScanImpl::Scalar:
+      return &FixScanFuncs_Scalar;
+#ifdef fon9_FixScan_X86
+   case FixScanImpl::Sse2:
+      return &FixScanFuncs_Sse2;
+   case FixScanImpl::Avx2:
+      return IsCpuSupportsAvx2() ? &FixScanFuncs_Avx2 : nullptr;
+#else
+   case FixScanImpl::Sse2:
+   case FixScanImpl::Avx2:
+      break;
+#endif
+   }
+   return nullptr;
+}
+static const FixScanFuncs* GetBestFixScanFuncs() {
+   if (const FixScanFuncs* fns = GetFixScanFuncs(FixScanImpl::Avx2))
+      return fns;
+   if (const FixScanFuncs* fns = GetFixScanFuncs(FixScanImpl::Sse2))
+      return fns;
+   return &FixScanFuncs_Scalar;
+}
+// 先用 Scalar(靜態初始化), 避免其他的 static 物件初始化時, 使用到尚未設定的 FixScanFuncs_;
+// 然後在 FixScanFuncs_Init_ 初始化時, 改成 CPU 支援的最佳實作.
+static const FixScanFuncs* FixScanFuncs_ = &FixScanFuncs_Scalar;
+static const bool          FixScanFuncs_Init_ = (FixScanFuncs_ = GetBestFixScanFuncs()) != nullptr;
+
+//--------------------------------------------------------------------------//
+FixScanImpl FixScan_GetImpl() {
+   return FixScanFuncs_->Impl_;
+}
+bool FixScan_SetImpl(FixScanImpl impl) {
+   if (const FixScanFuncs* fns = GetFixScanFuncs(impl)) {
+      FixScanFuncs_ = fns;
+      return true;
+   }
+   return false;
+}
+const char* FixScan_ImplName(FixScanImpl impl) {
+   switch (impl) {
+   case FixScanImpl::Scalar:  return "Scalar";
+   case FixScanImpl::Sse2:    return "SSE2";
+   case FixScanImpl::Avx2:    return "AVX2";
+   }
+   return "Unknown";
+}
+byte FixCheckSum(const void* beg, size_t size, byte init) {
+   return FixScanFuncs_->FnCheckSum_(reinterpret_cast<const byte*>(beg), size, init);
+}
+void FixScanSpl(const char* beg, size_t size, uint64_t* bitmap) {
+   FixScanFuncs_->FnScanSpl_(beg, size, bitmap);
+}
+
+} } // namespaces
@@ -0,0 +1,46 @@
+﻿/// \file fon9/fix/FixScan.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_fix_FixScan_hpp__
+#define __fon9_fix_FixScan_hpp__
+#include "fon9/fix/FixBase.hpp"
+#include "fon9/sys/Config.hpp"
+
+namespace fon9 { namespace fix {
+
+/// \ingroup fix
+/// FixScan 使用的實作方式.
+/// - 程式啟動時, 依照 CPU 的支援, 自動選擇最快的方式.
+/// - Sse2: x86-64 必定支援.
+/// - Avx2: 每次處理 32 bytes.
+enum class FixScanImpl {
+   Scalar,
+   Sse2,
+   Avx2,
+};
+
+/// \ingroup fix
+/// 取得目前 FixCheckSum(), FixScanSpl() 使用的實作方式.
+fon9_API FixScanImpl FixScan_GetImpl();
+/// 強制使用指定的實作方式, 通常用於測試或比較效率.
+/// - 非 thread safe: 必須在尚未使用 FIX 之前設定.
+/// \retval false CPU 不支援 impl, 不改變目前的實作方式.
+fon9_API bool FixScan_SetImpl(FixScanImpl impl);
+fon9_API const char* FixScan_ImplName(FixScanImpl impl);
+
+/// \ingroup fix
+/// 計算 [beg, beg + size) 的 FIX CheckSum: (init + 所有 bytes 的總和) % 256.
+fon9_API byte FixCheckSum(const void* beg, size_t size, byte init = 0);
+
+/// \ingroup fix
+/// 一次找出 [beg, beg + size) 所有的 f9fix_kCHAR_SPL 的位置.
+/// - bitmap 必須有 FixScanSplBitmapWords(size) 個 uint64_t;
+/// - 若 beg[i] == f9fix_kCHAR_SPL, 則 (bitmap[i / 64] & (1 << (i % 64))) != 0;
+/// - 超過 size 的 bits 必定為 0;
+fon9_API void FixScanSpl(const char* beg, size_t size, uint64_t* bitmap);
+
+constexpr size_t FixScanSplBitmapWords(size_t size) {
+   return (size + 63) / 64;
+}
+
+} } // namespaces
+#endif//__fon9_fix_FixScan_hpp__
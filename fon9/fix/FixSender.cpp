@@ -4,6 +4,7 @@
 #include "fon9/fix/FixRecorder_Searcher.hpp"
 #include "fon9/fix/FixAdminDef.hpp"
 #include "fon9/fix/FixConfig.hpp"
+#include "fon9/fix/FixScan.hpp"
 #include "fon9/FwdPrint.hpp"
 
 namespace fon9 { namespace fix {
@@ -15,13 +16,13 @@ void FixSender::Send(Locker&&       locker,
                      FixBuilder&&   fixmsgBuilder,
                      FixSeqNum      nextSeqNum,
                      RevBufferList* fixmsgDupOut) {
-   // CompIDs
-   RevBuffer& msgRBuf = fixmsgBuilder.GetBuffer();
-   RevPrint(msgRBuf, this->CompIDs_.Header_);
-   // SendingTime.
-   fixmsgBuilder.PutUtcNow();
-   TimeStamp now = this->LastSentTime_ = fixmsgBuilder.GetUtcNow();
-   RevPrint(msgRBuf, f9fix_SPLTAGEQ(SendingTime));
+   // SendingTime + CompIDs: 使用預建的樣板, 同一毫秒內不用重新格式化時間, 也不用重算這段的 CheckSum.
+   // 若 AP 已填入時間(e.g. TransactTime), 則 SendingTime 使用相同時間.
+   if (fon9_UNLIKELY(this->SendHeader_.empty()))
+      this->SendHeader_.Reset(ToStrView(this->CompIDs_.Header_));
+   TimeStamp now = this->LastSentTime_ = (fixmsgBuilder.HasUtcTime() ? fixmsgBuilder.GetUtcNow() : UtcNow());
+   this->SendHeader_.SetSendingTime(now);
+   this->SendHeader_.RevPutTo(fixmsgBuilder);
 
    // MsgType: ** ALWAYS THIRD FIELD IN MESSAGE. (Always unencrypted) **
    // 底下的欄位順序不可改變, 因為 Replayer::Rebuild() 依賴此順序重建要 replay 的訊息.
@@ -29,7 +30,7 @@ void FixSender::Send(Locker&&       locker,
    //               \________/                            \_ replay時插入額外欄位.
    //
    FixSeqNum msgSeqNum = this->GetNextSendSeq(locker);
-   RevPrint(msgRBuf, fldMsgType, f9fix_SPLTAGEQ(MsgSeqNum), msgSeqNum);
+   RevPrint(fixmsgBuilder.GetBuffer(), fldMsgType, f9fix_SPLTAGEQ(MsgSeqNum), msgSeqNum);
 
    // 產出 FIX Message.
    BufferList  fixmsg{fixmsgBuilder.Final(ToStrView(this->BeginHeader_))};
@@ -98,12 +99,15 @@ struct FixSender::Replayer {
    const FixConfig*  FixConfig_;
    FixSeqNum         BeginSeqNo_;
    const FixSeqNum   EndSeqNo_;
+   /// 下一個要從 Recorder 取得的序號, 若 ReplayReader 映射失敗, 改用 ReloadSent 從此序號繼續.
+   FixSeqNum         NextReadSeqNo_;
 
    Replayer(FixRecorder& fixRecorder, const FixConfig* fixConfig, FixSeqNum beginSeqNo, FixSeqNum endSeqNo)
       : FixRecorder_(fixRecorder)
       , FixConfig_(fixConfig)
       , BeginSeqNo_{beginSeqNo}
-      , EndSeqNo_{endSeqNo} {
+      , EndSeqNo_{endSeqNo}
+      , NextReadSeqNo_{beginSeqNo} {
       memcpy(this->ReFlds_ + kDateTimeStrWidth_FIXMS, REFLDS_kCSTR + kDateTimeStrWidth_FIXMS, kReFldsWidth - kDateTimeStrWidth_FIXMS);
       ToStrRev_FIXMS(ReFlds_ + kDateTimeStrWidth_FIXMS, UtcNow());
    }
@@ -130,11 +134,8 @@ struct FixSender::Replayer {
       pout = PutFwd(pout, this->ReFlds_, kReFldsWidth);
       pout = PutFwd(pout, pvalSendingTime, pendCurMsg - kFixTailWidth);
       // 重算 CheckSum.
-      byte* pbegCKS = pbegNode;
-      byte  cks = f9fix_kCHAR_SPL;
-      while (pbegCKS < pout)
-         cks = static_cast<byte>(cks + *pbegCKS++);
-      FixBuilder::PutCheckSumField(reinterpret_cast<char*>(pbegCKS), cks);
+      FixBuilder::PutCheckSumField(reinterpret_cast<char*>(pout),
+                                   FixCheckSum(pbegNode, static_cast<size_t>(pout - pbegNode), f9fix_kCHAR_SPL));
       *(pout += kFixTailWidth) = '\n';
       // 填入準備傳送的 FIX Message buffer.
       FwdPutMem(this->SendBuf_, pbegNode, pout);
@@ -168,7 +169,8 @@ struct FixSender::Replayer {
       this->SeqReset(true, oldSeqNo, newSeqNo, logbuf);
    }
 
-   void Reload(FixRecorder::ReloadSent& reloader, FwdBufferList& logbuf) {
+   template <class Reloader>
+   void Reload(Reloader& reloader, FwdBufferList& logbuf) {
       while (!this->CurMsg_.empty()) {
          reloader.FixParser_.Clear();
          StrView           strpr{this->CurMsg_};
@@ -195,42 +197,73 @@ struct FixSender::Replayer {
                   }
                }
             }
+            this->NextReadSeqNo_ = curSeqNo + 1;
             if (this->EndSeqNo_ != 0 && this->EndSeqNo_ == curSeqNo)
                break;
          }
          this->CurMsg_ = reloader.FindNext(this->FixRecorder_);
       }
    }
-   FixRecorder::Locker Run(FwdBufferList& logbuf) {
-      FixRecorder::ReloadSent reloader;
-      this->CurMsg_ = reloader.Start(this->FixRecorder_, this->BeginSeqNo_);
+   static bool IsMapFailed(const FixRecorder::ReplayReader& reloader) {
+      return reloader.IsMapFailed();
+   }
+   static bool IsMapFailed(const FixRecorder::ReloadSent&) {
+      return false;
+   }
+   /// 載入全部要求的訊息, 返回時 locker 為鎖定狀態.
+   /// \retval false 映射記錄檔失敗, 此時 locker 沒有鎖定.
+   template <class Reloader>
+   bool ReloadAll(Reloader& reloader, FwdBufferList& logbuf, FixRecorder::Locker& locker) {
       for (;;) {
          this->Reload(reloader, logbuf);
-         FixRecorder::Locker locker{this->FixRecorder_.Lock()};
+         if (this->CurMsg_.IsNull() && IsMapFailed(reloader))
+            return false;
+         FixRecorder::Locker lk{this->FixRecorder_.Lock()};
          if (this->EndSeqNo_ == 0) { // 檢查是否還有沒載入的資料.
-            if (!reloader.IsErrOrEOF(this->FixRecorder_, std::move(locker)))
+            if (!reloader.IsErrOrEOF(this->FixRecorder_, std::move(lk)))
                continue;
-            assert(locker.owns_lock());
-            FixSeqNum nextSendSeq = this->FixRecorder_.GetNextSendSeq(locker);
-            if (this->BeginSeqNo_ != nextSendSeq) {
-               // 已經檢查過 IsErrOrEOF() => 確定已經讀到檔尾.
-               // 如果有此情況(this->BeginSeqNo_ != nextSendSeq):
-               // 應該是另一 thread 重設了新的序號.
-               // 所以要送 SeqReset 給對方!
-               bool isGapFill = (this->BeginSeqNo_ < nextSendSeq);
-               this->SeqReset(isGapFill, this->BeginSeqNo_, nextSendSeq, logbuf);
-               if (isGapFill)
-                  FwdPrint(logbuf, f9fix_kCSTR_HdrInfo "Replay.End.GapFill|NewSeqNo=");
-               else
-                  FwdPrint(logbuf, f9fix_kCSTR_HdrInfo "Replay.End.SequenceReset|NewSeqNo=");
-               FwdPrint(logbuf, nextSendSeq, '\n');
-            }
+            assert(lk.owns_lock());
          }
-         else if (this->BeginSeqNo_ < this->EndSeqNo_) {
-            this->GapFill(this->BeginSeqNo_, this->EndSeqNo_ + 1, logbuf);
+         locker = std::move(lk);
+         return true;
+      }
+   }
+   FixRecorder::Locker Run(FwdBufferList& logbuf) {
+      FixRecorder::Locker locker;
+      bool isReloaded;
+      {  // 使用 ReplayReader: 訊息直接從記錄檔的映射取得, 不用經過 Read() 複製到緩衝區.
+         FixRecorder::ReplayReader reloader;
+         this->CurMsg_ = reloader.Start(this->FixRecorder_, this->BeginSeqNo_);
+         isReloaded = this->ReloadAll(reloader, logbuf, locker);
+      }
+      if (!isReloaded) {
+         // 映射記錄檔失敗(例: 位址空間不足), 改用 ReloadSent 從尚未取得的序號繼續.
+         FwdPrint(logbuf, f9fix_kCSTR_HdrInfo "Replay.MapFailed|NextSeqNo=", this->NextReadSeqNo_, '\n');
+         // ReloadSent 的緩衝區很大, 所以不放在 stack.
+         std::unique_ptr<FixRecorder::ReloadSent> reloader{new FixRecorder::ReloadSent};
+         this->CurMsg_ = reloader->Start(this->FixRecorder_, this->NextReadSeqNo_);
+         this->ReloadAll(*reloader, logbuf, locker);
+      }
+      if (this->EndSeqNo_ == 0) {
+         FixSeqNum nextSendSeq = this->FixRecorder_.GetNextSendSeq(locker);
+         if (this->BeginSeqNo_ != nextSendSeq) {
+            // 已經檢查過 IsErrOrEOF() => 確定已經讀到檔尾.
+            // 如果有此情況(this->BeginSeqNo_ != nextSendSeq):
+            // 應該是另一 thread 重設了新的序號.
+            // 所以要送 SeqReset 給對方!
+            bool isGapFill = (this->BeginSeqNo_ < nextSendSeq);
+            this->SeqReset(isGapFill, this->BeginSeqNo_, nextSendSeq, logbuf);
+            if (isGapFill)
+               FwdPrint(logbuf, f9fix_kCSTR_HdrInfo "Replay.End.GapFill|NewSeqNo=");
+            else
+               FwdPrint(logbuf, f9fix_kCSTR_HdrInfo "Replay.End.SequenceReset|NewSeqNo=");
+            FwdPrint(logbuf, nextSendSeq, '\n');
          }
-         return locker;
       }
+      else if (this->BeginSeqNo_ < this->EndSeqNo_) {
+         this->GapFill(this->BeginSeqNo_, this->EndSeqNo_ + 1, logbuf);
+      }
+      return locker;
    }
 };
 fon9_WARN_POP;
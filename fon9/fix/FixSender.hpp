@@ -23,8 +23,10 @@ class fon9_API FixSender : protected FixRecorder {
       intrusive_ptr_release(static_cast<const FixRecorder*>(p));
    }
 
-   bool       IsReplayingAll_{false};
-   TimeStamp  LastSentTime_;
+   bool              IsReplayingAll_{false};
+   TimeStamp         LastSentTime_;
+   /// "|52=SendingTime|CompIDs" 樣板, 在 Lock() 狀態下使用.
+   FixHeaderTemplate SendHeader_;
    struct Replayer;
    void Send(Locker&&       locker,
              StrView        fldMsgType,
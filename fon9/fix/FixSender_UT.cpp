@@ -55,8 +55,10 @@ int main(int argc, char** argv) {
    fon9::GetDefaultThreadPool();
    std::this_thread::sleep_for(std::chrono::milliseconds{10});
 
-   const char  fixrFileName[] = "FixSender_UT.log";
+   const char        fixrFileName[] = "FixSender_UT.log";
+   const std::string fixrIndexName = std::string{fixrFileName} + f9fix_kCSTR_SentIndexFileExt;
    remove(fixrFileName);
+   remove(fixrIndexName.c_str());
 
    struct FixSender : public f9fix::FixSender {
       fon9_NON_COPY_NON_MOVE(FixSender);
@@ -191,7 +193,9 @@ int main(int argc, char** argv) {
 
    // 結束前刪除測試檔.
    fixSender.reset();
-   if (!fon9::IsKeepTestFiles(argc, argv))
+   if (!fon9::IsKeepTestFiles(argc, argv)) {
       fon9::WaitRemoveFile(fixrFileName);
+      fon9::WaitRemoveFile(fixrIndexName.c_str());
+   }
 }
 fon9_WARN_POP;
@@ -0,0 +1,107 @@
+﻿/// \file fon9/framework/FdrThreadTree.cpp
+/// \author fonwinz@gmail.com
+#include "fon9/framework/FdrThreadTree.hpp"
+#include "fon9/seed/FieldMaker.hpp"
+#include "fon9/seed/PodOp.hpp"
+#ifdef fon9_POSIX
+#include "fon9/io/FdrService.hpp"
+#endif
+
+namespace fon9 {
+#ifdef fon9_POSIX
+using FdrThreadLoad = io::FdrThreadLoad;
+using FdrThreadLoads = io::FdrThreadLoads;
+static FdrThreadLoads GetFdrThreadLoads() {
+   return io::FdrService::GetFdrThreadLoads();
+}
+#else
+// 沒有 FdrService 的環境(Windows), 提供空的 tree.
+struct FdrThreadLoad {
+   std::string Name_;
+   uint32_t    ThreadIndex_;
+   int         CpuAffinity_;
+   uint32_t    HandlerCount_;
+   uint64_t    RxBytes_;
+   uint64_t    TxBytes_;
+   uint64_t    TxCalls_;
+   uint64_t    TxBytesPerCall_;
+   uint64_t    BytesPerSec_;
+};
+using FdrThreadLoads = std::vector<FdrThreadLoad>;
+static FdrThreadLoads GetFdrThreadLoads() {
+   return FdrThreadLoads{};
+}
+#endif
+
+seed::LayoutSP FdrThreadTree::MakeLayout() {
+   using namespace seed;
+   Fields fields;
+   fields.Add(fon9_MakeField2(FdrThreadLoad, Name));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, ThreadIndex));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, CpuAffinity));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, HandlerCount));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, RxBytes));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, TxBytes));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, TxCalls));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, TxBytesPerCall));
+   fields.Add(fon9_MakeField2(FdrThreadLoad, BytesPerSec));
+   // key = "Name/ThreadIndex", 沒有對應的 Field;
+   // 此處的 key 欄位僅用來描述 layout, GridView、Get 都直接輸出 key, 不會透過 key 欄位存取.
+   return new Layout1(FieldSP{new FieldCharVector(Named{"Id"}, 0)},
+                      new Tab{Named{"FdrThread"}, std::move(fields)});
+}
+
+class FdrThreadTree::TreeOp : public seed::TreeOp {
+   fon9_NON_COPY_NON_MOVE(TreeOp);
+   using base = seed::TreeOp;
+   FdrThreadLoads Loads_;
+
+   static void RevPrintKey(RevBuffer& rbuf, const FdrThreadLoad& ld) {
+      RevPrint(rbuf, ld.Name_, '/', ld.ThreadIndex_);
+   }
+   /// 傳回 key 的位置, 若找不到則傳回 Loads_.size();
+   size_t Find(StrView strKeyText) const {
+      if (strKeyText.begin() == seed::kStrKeyText_Begin_)
+         return 0;
+      if (strKeyText.begin() == seed::kStrKeyText_End_)
+         return this->Loads_.size();
+      size_t idx = 0;
+      for (const FdrThreadLoad& ld : this->Loads_) {
+         if (strKeyText == ToStrView(RevPrintTo<std::string>(ld.Name_, '/', ld.ThreadIndex_)))
+            break;
+         ++idx;
+      }
+      return idx;
+   }
+public:
+   TreeOp(FdrThreadTree& tree) : base(tree), Loads_{GetFdrThreadLoads()} {
+   }
+   void GridView(const seed::GridViewRequest& req, seed::FnGridViewOp fnCallback) override {
+      seed::GridViewResult res{this->Tree_, req.Tab_};
+      seed::MakeGridViewArrayRange(this->Find(req.OrigKey_), this->Loads_.size(), req, res,
+                                   [this](size_t idx, seed::Tab* tab, RevBuffer& rbuf) {
+         const FdrThreadLoad& ld = this->Loads_[idx];
+         if (tab)
+            FieldsCellRevPrint(tab->Fields_, seed::SimpleRawRd{ld}, rbuf, seed::GridViewResult::kCellSplitter);
+         RevPrintKey(rbuf, ld);
+         return true;
+      });
+      fnCallback(res);
+   }
+   void Get(StrView strKeyText, seed::FnPodOp fnCallback) override {
+      const size_t idx = this->Find(strKeyText);
+      if (idx < this->Loads_.size()) {
+         seed::PodOpReadonly<FdrThreadLoad> op{this->Loads_[idx], this->Tree_, strKeyText};
+         fnCallback(op, &op);
+      }
+      else
+         fnCallback(seed::PodOpResult{this->Tree_, seed::OpResult::not_found_key, strKeyText}, nullptr);
+   }
+};
+
+void FdrThreadTree::OnTreeOp(seed::FnTreeOp fnCallback) {
+   TreeOp op{*this};
+   fnCallback(seed::TreeOpResult{this, seed::OpResult::no_error}, &op);
+}
+
+} // namespaces
@@ -0,0 +1,35 @@
+﻿/// \file fon9/framework/FdrThreadTree.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_framework_FdrThreadTree_hpp__
+#define __fon9_framework_FdrThreadTree_hpp__
+#include "fon9/seed/MaTree.hpp"
+
+namespace fon9 {
+
+/// \ingroup fon9_framework
+/// 唯讀的 FdrThread 負載資訊, 每個 FdrService 的每個 FdrThread 一筆, key = "ServiceName/ThreadIndex";
+/// - 每次查詢時透過 io::FdrService::GetFdrThreadLoads() 取得最新的資訊.
+/// - 可用來觀察 IoServiceArgs "ThreadAlloc=" 的分配結果, 或決定 Device 的 "IoThread=n" 設定.
+/// - 欄位說明請參考 fon9/io/FdrService.hpp: FdrThreadLoad.
+class fon9_API FdrThreadTree : public seed::Tree {
+   fon9_NON_COPY_NON_MOVE(FdrThreadTree);
+   using base = seed::Tree;
+   static seed::LayoutSP MakeLayout();
+   class TreeOp;
+
+public:
+   FdrThreadTree() : base{MakeLayout()} {
+   }
+
+   virtual void OnTreeOp(seed::FnTreeOp fnCallback) override;
+
+   #define fon9_kCSTR_FdrThreadTree_DefaultName  "FdrThreads"
+   /// 在 maTree 上面種一個 FdrThreadTree.
+   /// \retval false seedName已存在.
+   static bool Plant(seed::MaTree& maTree, std::string seedName = fon9_kCSTR_FdrThreadTree_DefaultName) {
+      return maTree.Add(new seed::NamedSapling(new FdrThreadTree, std::move(seedName)), "FdrThreadTree.Plant");
+   }
+};
+
+} // namespaces
+#endif//__fon9_framework_FdrThreadTree_hpp__
@@ -2,6 +2,9 @@
 // \author fonwinz@gmail.com
 #include "fon9/framework/Framework.hpp"
 #include "fon9/seed/SysEnv.hpp"
+#include "fon9/seed/MemBlockTree.hpp"
+#include "fon9/seed/LogModuleTree.hpp"
+#include "fon9/framework/FdrThreadTree.hpp"
 #include "fon9/ConfigLoader.hpp"
 #include "fon9/InnSyncerFile.hpp"
 #include "fon9/FilePath.hpp"
@@ -9,6 +12,7 @@
 #include "fon9/Log.hpp"
 #include "fon9/HostId.hpp"
 #include "fon9/DefaultThreadPool.hpp"
+#include "fon9/WorkStealingPool.hpp"
 
 #if !defined(fon9_WINDOWS)
 #include <sys/mman.h> // mlockall()
@@ -50,6 +54,9 @@ void Framework::Initialize(int argc, char** argv) {
    this->Root_.reset(new seed::MaTree{"Services"});
 
    auto sysEnv = seed::SysEnv::Plant(this->Root_);
+   seed::MemBlockTree::Plant(*this->Root_);
+   seed::LogModuleTree::Plant(*this->Root_);
+   FdrThreadTree::Plant(*this->Root_);
    static const CmdArgDef  argConfigPath{
       StrView{fon9_kCSTR_SysEnvItem_ConfigPath}, //Name
       StrView{"fon9cfg"}, //DefaultValue
@@ -170,6 +177,7 @@ void Framework::Initialize(int argc, char** argv) {
 
 void Framework::Start() {
    GetDefaultThreadPool();
+   GetDefaultWorkPool();
    GetDefaultTimerThread();
    this->MaAuth_->Storage_->LoadAll();
    if (this->Syncer_)
@@ -186,6 +194,7 @@ void Framework::Dispose() {
 
 void Framework::DisposeForAppQuit() {
    this->Dispose();
+   WaitWorkPoolQuit(GetDefaultWorkPool());
    WaitDefaultThreadPoolQuit(GetDefaultThreadPool());
    // TODO: GetDefaultTimerThread(); 如何結束?
 }
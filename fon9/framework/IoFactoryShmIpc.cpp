@@ -0,0 +1,52 @@
+﻿/// \file fon9/framework/IoFactoryShmIpc.cpp
+///
+/// - 同一台主機上的 process 之間, 使用 shared memory 通訊.
+///
+/// - ShmIpc factory plugin:
+///   - EntryName: ShmIpc
+///   - 參數設定 Args: "Name=ShmIpc|AddTo=..."
+///     - Name=  若沒提供 Name 則預設為 "ShmIpc"
+///     - AddTo= 或 DeviceFactoryPark= 加入到哪個 device factory park.
+///     - IoMgr= 或 IoManager= 加入到哪個 IoManager 所參考的 device factory park.
+///
+/// - ShmIpc device:
+///   - 參數設定 DeviceArgs: 請參考 "fon9/io/ShmIpc.hpp"
+///   - 例: Server: "Name=gw1|Role=Server|RingSize=4M|Wait=Busy|Cpus=3"
+///         Client: "Name=gw1|Wait=Busy|Cpus=5"
+///
+/// \author fonwinz@gmail.com
+#include "fon9/framework/IoManager.hpp"
+#include "fon9/io/ShmIpc.hpp"
+
+#ifdef __linux__
+namespace fon9 {
+
+fon9_API DeviceFactorySP MakeIoFactoryShmIpc(std::string name) {
+   struct Factory : public DeviceFactory {
+      fon9_NON_COPY_NON_MOVE(Factory);
+      Factory(std::string name) : DeviceFactory(std::move(name)) {
+      }
+      io::DeviceSP CreateDevice(IoManagerSP mgr, SessionFactory& sesFactory, const IoConfigItem& cfg, std::string& errReason) override {
+         if (auto ses = sesFactory.CreateSession(*mgr, cfg, errReason))
+            return new fon9::io::ShmIpc(std::move(ses), std::move(mgr));
+         return io::DeviceSP{};
+      }
+   };
+   return new Factory(name);
+}
+static bool DevShmIpc_Start(seed::PluginsHolder& holder, StrView args) {
+   struct ArgsParser : public DeviceFactoryConfigParser {
+      ArgsParser() : DeviceFactoryConfigParser{"ShmIpc"} {}
+      DeviceFactorySP CreateDeviceFactory() override {
+         return MakeIoFactoryShmIpc(this->Name_);
+      }
+   };
+   return ArgsParser{}.Parse(holder, args);
+}
+
+} // namespaces
+
+extern "C" fon9_API fon9::seed::PluginsDesc f9p_ShmIpc;
+static fon9::seed::PluginsPark f9pRegister{"ShmIpc", &f9p_ShmIpc};
+fon9::seed::PluginsDesc f9p_ShmIpc{"", &fon9::DevShmIpc_Start, nullptr, nullptr,};
+#endif//__linux__
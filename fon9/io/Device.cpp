@@ -2,7 +2,7 @@
 /// \author fonwinz@gmail.com
 #include "fon9/io/Device.hpp"
 #include "fon9/TimeStamp.hpp"
-#include "fon9/DefaultThreadPool.hpp"
+#include "fon9/WorkStealingPool.hpp"
 
 namespace fon9 { namespace io {
 
@@ -28,7 +28,7 @@ void Device::Initialize() {
 
 void Device::MakeCallForWork() {
    DeviceSP pthis{this};
-   GetDefaultThreadPool().EmplaceMessage([pthis]() {
+   GetDefaultWorkPool().AddTask([pthis]() {
       pthis->OpQueue_.TakeCall();
    });
 }
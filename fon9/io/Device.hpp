@@ -193,7 +193,7 @@ protected:
 
    friend struct DeviceAsyncOpInvoker;
 
-   /// 預設使用 GetDefaultThreadPool() 執行 OpQueue_.
+   /// 預設使用 GetDefaultWorkPool() 執行 OpQueue_.
    virtual void MakeCallForWork();
 
    // OpThr 或 OpImpl 開頭的函式, 都必須在 OpQueue_ thread 裡面呼叫:
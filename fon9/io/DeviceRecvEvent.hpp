@@ -3,7 +3,7 @@
 #ifndef __fon9_io_DeviceRecvEvent_hpp__
 #define __fon9_io_DeviceRecvEvent_hpp__
 #include "fon9/io/RecvBuffer.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 
@@ -79,7 +79,7 @@ __UNLOCK_FOR_NO_LINK:
    aux.DisableReadableEvent(rbuf);
    fon9_GCC_WARN_DISABLE("-Wshadow");
    rlocker.GetALocker().AddAsyncTask(DeviceAsyncOp{[&rxbuf, aux](Device& dev) {
-      fon9_LOG_DEBUG("Async.DeviceRecvBufferReady");
+      fon9_LOGM_DEBUG(LogModule_Io, "Async.DeviceRecvBufferReady");
       RecvBuffer& rbuf = RecvBuffer::StaticCast(rxbuf);
       if (dev.OpImpl_GetState() == State::LinkReady && aux.IsRecvBufferAlive(dev, rbuf)) {
          RecvBufferSize contRecvSize = dev.Session_->OnDevice_Recv(dev, rxbuf);
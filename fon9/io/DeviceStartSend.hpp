@@ -3,7 +3,7 @@
 #ifndef __fon9_io_DeviceStartSend_hpp__
 #define __fon9_io_DeviceStartSend_hpp__
 #include "fon9/io/SendBuffer.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 
@@ -66,6 +66,9 @@ struct SendAuxMem {
    void PushTo(BufferList& buf) {
       AppendToBuffer(buf, this->Src_, this->Size_);
    }
+   void PushToQueue(SendBuffer&, BufferList& queue) {
+      this->PushTo(queue);
+   }
 };
 
 struct SendAuxBuf {
@@ -78,6 +81,9 @@ struct SendAuxBuf {
    void PushTo(BufferList& buf) {
       buf.push_back(std::move(*this->Src_));
    }
+   void PushToQueue(SendBuffer&, BufferList& queue) {
+      this->PushTo(queue);
+   }
 };
 
 /// \ingroup io
@@ -114,6 +120,12 @@ struct SendAuxBuf {
 ///   // (2) 把要送出的資料填入 buf, 移到 op thread 傳送.
 ///   void PushTo(BufferList& buf);
 ///
+///   // 上述 (1) 的情況: queue = sc.GetQueueForPush(sbuf);
+///   // SendAuxMem, SendAuxBuf 的預設: this->PushTo(queue);
+///   // 若衍生者有覆寫 PushTo(), 則也必須覆寫 PushToQueue();
+///   // 衍生者可在此累計 queue 的資料量, 例: FdrSocket 的 SendBuffered 合併送出.
+///   void PushToQueue(SendBuffer& sbuf, BufferList& queue);
+///
 ///   // 把 pbuf 移到 op thread 傳送.
 ///   void AsyncSend(DeviceT& dev, StartSendChecker& sc, ObjHolderPtr<BufferList>&& pbuf);
 /// };
@@ -125,7 +137,7 @@ Device::SendResult DeviceStartSend(DeviceT& dev, Aux& aux) {
          auto&  sbuf = aux.GetSendBufferAtLocked(dev);
          if (DcQueueList* toSend = sc.ToSendingAndUnlock(sbuf))
             return aux.StartToSend(sc, *toSend);
-         aux.PushTo(sc.GetQueueForPush(sbuf));
+         aux.PushToQueue(sbuf, sc.GetQueueForPush(sbuf));
       }
       else { // 移到 op thread 傳送.
          auto pbuf{MakeObjHolder<BufferList>()};
@@ -252,7 +264,7 @@ void DeviceContinueSend(DeviceT& dev, SendBuffer& sbuf, Aux& aux) {
    fon9_GCC_WARN_DISABLE_NO_PUSH("-Wshadow");
    aux.DisableWritableEvent(sbuf);
    sc.GetALocker().AddAsyncTask(DeviceAsyncOp{[&sbuf, aux](Device& dev) {
-      fon9_LOG_DEBUG("Async.DeviceContinueSend|dev=", ToPtr{&dev});
+      fon9_LOGM_DEBUG(LogModule_Io, "Async.DeviceContinueSend|dev=", ToPtr{&dev});
       if (fon9_LIKELY(IsAllowContinueSend(dev.OpImpl_GetState()))
           && fon9_LIKELY(aux.IsSendBufferAlive(dev, sbuf))) {
              {
@@ -282,7 +294,7 @@ SendDirectResult DeviceSendDirect(RecvDirectArgs& e, SendBuffer& sbuf, Aux& aux)
             aux.StartToSend(e.OpLocker_, *toSend);
             return SendDirectResult::Sent;
          }
-         aux.PushTo(sbuf.GetQueueForPush(e.OpLocker_.GetALocker()));
+         aux.PushToQueue(sbuf, sbuf.GetQueueForPush(e.OpLocker_.GetALocker()));
          return SendDirectResult::Queue;
       }
       return SendDirectResult::NeedsAsync;
@@ -1,6 +1,7 @@
 ﻿/// \file fon9/io/DgramBase.cpp
 /// \author fonwinz@gmail.com
 #include "fon9/io/DgramBase.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 //
@@ -29,6 +30,10 @@ namespace fon9 { namespace io {
 //       Loopback=Y or N
 //       TTL=hops    必須有提供 Loopback 選項.
 //
+// 收: 額外選項:
+//    RecvBatch=n    一次 syscall(recvmmsg) 最多接收 n 個 datagrams, 請參考 DgramBase::GetRecvBatch();
+//                   datagram 若超過接收區塊大小會被截斷, 請參考 DgramBase::OnRecvTruncated();
+//
 
 bool DgramBase::CreateSocket(Socket& so, const SocketAddress& addr, SocketResult& soRes) {
    this->Config_.Options_.TCP_NODELAY_ = 0;
@@ -82,6 +87,7 @@ void DgramBase::OpImpl_Open(std::string cfgstr) {
    this->Interface_.Addr_.sa_family = AF_UNSPEC;
    this->TTL_ = 0;
    this->Loopback_ = -1;
+   this->RecvBatch_ = 0;
    base::OpImpl_Open(std::move(cfgstr));
 }
 ConfigParser::Result DgramBase::OpImpl_SetProperty(StrView tag, StrView& value) {
@@ -99,12 +105,28 @@ ConfigParser::Result DgramBase::OpImpl_SetProperty(StrView tag, StrView& value)
       this->TTL_ = StrTo(value, this->TTL_);
       return ConfigParser::Result::Success;
    }
+   if (iequals(tag, "RecvBatch")) {
+      const unsigned n = StrTo(value, 0u);
+      this->RecvBatch_ = static_cast<uint8_t>(n > kMaxRecvBatch ? static_cast<unsigned>(kMaxRecvBatch) : n);
+      return ConfigParser::Result::Success;
+   }
    if (iequals(tag, "Loopback")) {
       this->Loopback_ = (toupper(value.Get1st()) == 'Y');
       return ConfigParser::Result::Success;
    }
    return base::OpImpl_SetProperty(tag, value);
 }
+void DgramBase::OpImpl_AppendDeviceInfo(std::string& info) {
+   base::OpImpl_AppendDeviceInfo(info);
+   if (const uint64_t count = this->GetRecvTruncatedCount())
+      RevPrintAppendTo(info, "|RecvTruncated=", count);
+}
+void DgramBase::OnRecvTruncated(size_t blockSize) {
+   if (this->RecvTruncatedCount_.fetch_add(1, std::memory_order_relaxed) == 0)
+      fon9_LOGM_WARN(LogModule_Io, "Dgram.RecvTruncated|dev=", ToPtr{this},
+                     "|blockSize=", blockSize,
+                     "|info=Datagram larger than recv block, check RecvBufferSize from OnDevice_Recv().");
+}
 
 static inline const SocketAddress* GetAddrOrNull(const SocketAddress& addr) {
    return addr.GetPort() == 0 ? nullptr : &addr;
@@ -19,10 +19,13 @@ class fon9_API DgramBase : public SocketClientDevice {
    SocketAddress  Interface_;
    int            Loopback_;
    uint8_t        TTL_;
+   uint8_t        RecvBatch_;
+   std::atomic<uint64_t>   RecvTruncatedCount_{0};
 
 protected:
    void OpImpl_Open(std::string cfgstr) override;
    ConfigParser::Result OpImpl_SetProperty(StrView tag, StrView& value) override;
+   void OpImpl_AppendDeviceInfo(std::string& info) override;
    bool CreateSocket(Socket& so, const SocketAddress& addr, SocketResult& soRes) override;
    void OpImpl_Connected(Socket::socket_t so);
    void OpImpl_OnAddrListEmpty() override;
@@ -31,6 +34,27 @@ public:
    DgramBase(SessionSP ses, ManagerSP mgr)
       : base(std::move(ses), std::move(mgr), Style::Client) {
    }
+
+   /// 一次 syscall 最多接收的 datagram 數量上限.
+   enum : uint8_t {
+      kMaxRecvBatch = 64,
+   };
+   /// 設定 "RecvBatch=n" (n > 1) 時, 一次 syscall(recvmmsg) 最多接收 n 個 datagrams,
+   /// 並「一次」透過 Session::OnDevice_Recv() 通知, 此時 rxbuf 可能包含多個 datagrams,
+   /// 因此僅適用於可自行切割封包的 Session, 例: 使用 PkReceiver 解析的行情接收.
+   /// 預設為 0: 每次只接收一個 datagram.
+   unsigned GetRecvBatch() const {
+      return this->RecvBatch_;
+   }
+
+   /// 批次接收時, 每個 datagram 使用一個接收區塊(預設 4K, 可由 OnDevice_Recv() 的返回值指定),
+   /// 若 datagram 超過區塊大小, 超過的部分會被丟棄(MSG_TRUNC).
+   /// 由 FdrDgramImpl 在 fdr thread 呼叫: 累計被截斷的數量, 第一次發生時記錄 log.
+   void OnRecvTruncated(size_t blockSize);
+   /// 累計被截斷的 datagram 數量, 也會在 WaitGetDeviceInfo() 的 "|RecvTruncated=n" 顯示.
+   uint64_t GetRecvTruncatedCount() const {
+      return this->RecvTruncatedCount_.load(std::memory_order_relaxed);
+   }
 };
 fon9_WARN_POP;
 
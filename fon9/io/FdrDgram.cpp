@@ -3,6 +3,7 @@
 #include "fon9/sys/Config.h"
 #ifdef fon9_POSIX
 #include "fon9/io/FdrDgram.hpp"
+#include "fon9/buffer/FwdBufferList.hpp"
 
 namespace fon9 { namespace io {
 
@@ -20,6 +21,131 @@ bool FdrDgramImpl::OpImpl_ConnectTo(const SocketAddress& addr, SocketResult& soR
    return true;
 }
 
+bool FdrDgramImpl::CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf)) {
+   const unsigned batch = this->Owner_->GetRecvBatch();
+   if (batch <= 1 || this->RecvSize_ < RecvBufferSize::Default)
+      return base::CheckRead(dev, fnIsRecvBufferAlive);
+
+   const size_t   blockSize = (this->RecvSize_ == RecvBufferSize::Default
+                               ? 1024 * 4
+                               : static_cast<size_t>(this->RecvSize_));
+   struct iovec   bufv[DgramBase::kMaxRecvBatch];
+   struct mmsghdr msgs[DgramBase::kMaxRecvBatch];
+   size_t         rxszs[DgramBase::kMaxRecvBatch];
+   size_t         totrd = 0;
+   union {
+      struct cmsghdr Align_;
+      char           Buf_[kRxTimestampCtrlSize];
+   }  ctrl;
+   for (;;) {
+      this->RecvBuffer_.GetRecvBlocks(bufv, batch, blockSize);
+      memset(msgs, 0, sizeof(msgs[0]) * batch);
+      for (unsigned L = 0; L < batch; ++L) {
+         msgs[L].msg_hdr.msg_iov = bufv + L;
+         msgs[L].msg_hdr.msg_iovlen = 1;
+      }
+      if (fon9_UNLIKELY(this->IsRxTimestamping_)) {
+         // 只取該批第一個 datagram 的接收時間.
+         msgs[0].msg_hdr.msg_control = ctrl.Buf_;
+         msgs[0].msg_hdr.msg_controllen = sizeof(ctrl.Buf_);
+      }
+      const int count = recvmmsg(this->GetFD(), msgs, batch, MSG_DONTWAIT, nullptr);
+      if (fon9_UNLIKELY(count < 0)) {
+         if (int eno = ErrorCannotRetry(errno)) {
+            this->SocketError("Recvmmsg", eno);
+            return false;
+         }
+         return true;
+      }
+      size_t bytesTransfered = 0;
+      for (int L = 0; L < count; ++L) {
+         bytesTransfered += (rxszs[L] = msgs[L].msg_len);
+         // msg_len 為實際放入區塊的大小, 超過的部分已被丟棄.
+         if (fon9_UNLIKELY(msgs[L].msg_hdr.msg_flags & MSG_TRUNC))
+            this->Owner_->OnRecvTruncated(bufv[L].iov_len);
+      }
+      if (fon9_LIKELY(bytesTransfered > 0)) {
+         this->AddRxBytes(bytesTransfered);
+         if (fon9_UNLIKELY(this->IsRxTimestamping_))
+            this->RecvBuffer_.SetRxTime(GetCmsgRxTime(msgs[0].msg_hdr));
+         DcQueueList&   rxbuf = this->RecvBuffer_.SetBlocksReceived(rxszs, static_cast<size_t>(count));
+         CheckReadAux   aux{fnIsRecvBufferAlive};
+         DeviceRecvBufferReady(dev, rxbuf, aux);
+         // 底下的結束條件與 FdrSocket::CheckRead() 相同.
+         if ((totrd += bytesTransfered) > 1024 * 256 || fon9_UNLIKELY(aux.IsNeedsUpdateFdrEvent_)) {
+            this->CheckRetriggerFdrEvent(FdrEventFlag::Readable);
+            return true;
+         }
+         if (fon9_UNLIKELY(this->RecvSize_ < RecvBufferSize::Default))
+            return base::CheckRead(dev, fnIsRecvBufferAlive);
+      }
+      // 取出的數量比要求的少 => 資料已全部取出.
+      if (static_cast<unsigned>(count) < batch)
+         return true;
+   }
+}
+
+//--------------------------------------------------------------------------//
+
+BufferNode* FdrDgramImpl::MakeDgramNode(const void* src, size_t size) {
+   FwdBufferNode* node = FwdBufferNode::Alloc(size);
+   memcpy(node->GetDataEnd(), src, size);
+   node->SetDataEnd(node->GetDataEnd() + size);
+   return node;
+}
+BufferList FdrDgramImpl::MakeDgramNode(BufferList&& src) {
+   if (src.size() <= 1)
+      return std::move(src);
+   // 一次 Send() 的資料分散在多個節點, 必須合併成一個節點, 才能確保成為一個 datagram.
+   DcQueueList    dcq{std::move(src)};
+   const size_t   size = dcq.CalcSize();
+   FwdBufferNode* node = FwdBufferNode::Alloc(size);
+   dcq.Read(node->GetDataEnd(), size);
+   node->SetDataEnd(node->GetDataEnd() + size);
+   BufferList     retval;
+   retval.push_back(node);
+   return retval;
+}
+
+int FdrDgramImpl::Sendmmsg(DeviceOpLocker& sc, DcQueueList& toSend) {
+   enum { kMaxSendBatch = 64 };
+   struct iovec   bufv[kMaxSendBatch];
+   const size_t   bufCount = toSend.PeekBlockVector(bufv);
+   if (bufCount <= 1)
+      return this->Sendv(sc, toSend);
+   struct mmsghdr msgs[kMaxSendBatch];
+   memset(msgs, 0, sizeof(msgs[0]) * bufCount);
+   for (size_t L = 0; L < bufCount; ++L) {
+      msgs[L].msg_hdr.msg_iov = bufv + L;
+      msgs[L].msg_hdr.msg_iovlen = 1;
+   }
+   const int count = sendmmsg(this->GetFD(), msgs, static_cast<unsigned>(bufCount), 0);
+   if (fon9_LIKELY(count >= 0)) {
+      size_t wrsz = 0;
+      for (int L = 0; L < count; ++L)
+         wrsz += bufv[L].iov_len;
+      this->AddTxBytes(wrsz);
+      toSend.PopConsumed(wrsz);
+      if (fon9_LIKELY(toSend.empty()))
+         this->CheckSendQueueEmpty(sc);
+      else {
+         // 全部送出(受限於 kMaxSendBatch), 不會有新的 Writable 通知.
+         if (static_cast<size_t>(count) == bufCount)
+            this->CheckRetriggerFdrEvent(FdrEventFlag::Writable);
+         this->EnableEventBit(FdrEventFlag::Writable);
+      }
+      return 0;
+   }
+   if (int eno = ErrorCannotRetry(errno)) {
+      this->SocketError("Sendmmsg", eno);
+      return eno;
+   }
+   this->EnableEventBit(FdrEventFlag::Writable);
+   return 0;
+}
+
+//--------------------------------------------------------------------------//
+
 void FdrDgramImpl::OnFdrEvent_Handling(FdrEventFlag evs) {
    FdrEventProcessor(this, *this->Owner_, evs);
 }
@@ -15,23 +15,113 @@ struct FdrDgramImpl : public FdrSocketClientImpl {
    virtual void OnFdrSocket_Error(std::string errmsg) override;
    virtual void SocketError(StrView fnName, int eno) override;
 
+   /// 傳送 toSend 裡面的資料, 每個 BufferNode 為一個 datagram.
+   /// 若有多個 datagrams, 則使用 sendmmsg() 一次送出.
+   /// 返回值與 FdrSocket::Sendv() 相同.
+   int Sendmmsg(DeviceOpLocker& sc, DcQueueList& toSend);
+
+   /// 一次 Send() 的資料, 必須放在同一個 BufferNode, 才能保持 datagram 的邊界.
+   static BufferNode* MakeDgramNode(const void* src, size_t size);
+   static BufferList MakeDgramNode(BufferList&& src);
+
 public:
    using OwnerDevice = DgramT<FdrServiceSP, FdrDgramImpl>;
    using OwnerDeviceSP = intrusive_ptr<OwnerDevice>;
    const OwnerDeviceSP  Owner_;
 
    FdrDgramImpl(OwnerDevice* owner, Socket&& so, SocketResult&)
-      : base{*owner->IoService_, std::move(so)}
+      : base{owner->IoService_->AllocFdrThread(so.GetSocketHandle(), owner->OpImpl_GetOptions().IoThreadIndex_),
+             std::move(so)}
       , Owner_{owner} {
+      // 使用 recvmmsg(), sendmmsg() 保持 datagram 的邊界, 所以不使用 fdr thread 的 completion 型收送.
+      this->IsFdrCompletionAllowed_ = false;
+      this->SetSendCoalesce(owner->OpImpl_GetOptions());
    }
    bool OpImpl_ConnectTo(const SocketAddress& addr, SocketResult& soRes);
+
+   /// 若 Owner_->GetRecvBatch() > 1, 則使用 recvmmsg() 批次接收;
+   /// 否則使用 FdrSocket::CheckRead();
+   /// FdrEventProcessor() 透過 impl->CheckRead() 呼叫到這裡.
+   bool CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf));
+
+   //--------------------------------------------------------------------------//
+   // 排隊中的 datagrams: 每個 BufferNode 為一個 datagram, 在 fdr thread 透過 sendmmsg() 批次送出.
+   // 例: 使用 SendASAP=N 設定的 Device 轉發行情, 在大量資料時可減少 syscall 的次數.
+
+   struct ContinueSendAux : public FdrSocket::ContinueSendAux {
+      void ContinueToSend(ContinueSendChecker& sc, DcQueueList& toSend) const {
+         sc.GetALocker().UnlockForInplace();
+         SendBuffer& sbuf = SendBuffer::StaticCast(toSend);
+         static_cast<FdrDgramImpl&>(ContainerOf(sbuf, &FdrDgramImpl::SendBuffer_)).Sendmmsg(sc, toSend);
+      }
+   };
+   struct SendASAP_AuxMem : public FdrSocket::SendASAP_AuxMem {
+      using FdrSocket::SendASAP_AuxMem::SendASAP_AuxMem;
+      void PushTo(BufferList& buf) {
+         buf.push_back(MakeDgramNode(this->Src_, this->Size_));
+      }
+      void PushToQueue(SendBuffer&, BufferList& queue) {
+         this->PushTo(queue);
+      }
+   };
+   struct SendASAP_AuxBuf : public SendAuxBuf {
+      using SendAuxBuf::SendAuxBuf;
+      void PushTo(BufferList& buf) {
+         buf.push_back(MakeDgramNode(std::move(*this->Src_)));
+      }
+      void PushToQueue(SendBuffer&, BufferList& queue) {
+         this->PushTo(queue);
+      }
+      Device::SendResult StartToSend(DeviceOpLocker& sc, DcQueueList& toSend) {
+         FdrSocket& impl = ContainerOf(SendBuffer::StaticCast(toSend), &FdrDgramImpl::SendBuffer_);
+         toSend.push_back(MakeDgramNode(std::move(*this->Src_)));
+         if (int eno = static_cast<FdrDgramImpl&>(impl).Sendmmsg(sc, toSend))
+            return GetSysErrC(eno);
+         return Device::SendResult{0};
+      }
+   };
+   struct SendBuffered_AuxMem : public SendAuxMem {
+      using SendAuxMem::SendAuxMem;
+      void PushTo(BufferList& buf) {
+         buf.push_back(MakeDgramNode(this->Src_, this->Size_));
+      }
+      Device::SendResult StartToSend(DeviceOpLocker&, DcQueueList& toSend) {
+         bool isFirst = toSend.empty();
+         toSend.push_back(MakeDgramNode(this->Src_, this->Size_));
+         ContainerOf(SendBuffer::StaticCast(toSend), &FdrDgramImpl::SendBuffer_).OnSendBuffered(isFirst, this->Size_);
+         return Device::SendResult{0};
+      }
+      void PushToQueue(SendBuffer& sbuf, BufferList& queue) {
+         this->PushTo(queue);
+         ContainerOf(sbuf, &FdrDgramImpl::SendBuffer_).OnSendBufferedQueued(this->Size_);
+      }
+   };
+   struct SendBuffered_AuxBuf : public SendAuxBuf {
+      using SendAuxBuf::SendAuxBuf;
+      void PushTo(BufferList& buf) {
+         buf.push_back(MakeDgramNode(std::move(*this->Src_)));
+      }
+      Device::SendResult StartToSend(DeviceOpLocker&, DcQueueList& toSend) {
+         bool   isFirst = toSend.empty();
+         size_t srcSize = CalcDataSize(this->Src_->cfront());
+         toSend.push_back(MakeDgramNode(std::move(*this->Src_)));
+         ContainerOf(SendBuffer::StaticCast(toSend), &FdrDgramImpl::SendBuffer_).OnSendBuffered(isFirst, srcSize);
+         return Device::SendResult{0};
+      }
+      void PushToQueue(SendBuffer& sbuf, BufferList& queue) {
+         FdrSocket&  impl = ContainerOf(sbuf, &FdrDgramImpl::SendBuffer_);
+         size_t      srcSize = impl.IsSendCoalescing() ? CalcDataSize(this->Src_->cfront()) : 0;
+         this->PushTo(queue);
+         impl.OnSendBufferedQueued(srcSize);
+      }
+   };
 };
 
 //--------------------------------------------------------------------------//
 
 /// \ingroup io
 /// 使用 fd 的實作的 Dgram.
-using FdrDgram = DeviceImpl_DeviceStartSend<FdrDgramImpl::OwnerDevice, FdrSocket>;
+using FdrDgram = DeviceImpl_DeviceStartSend<FdrDgramImpl::OwnerDevice, FdrDgramImpl>;
 
 } } // namespaces
 #endif//__fon9_io_FdrDgram_hpp__
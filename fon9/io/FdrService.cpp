@@ -3,21 +3,127 @@
 #include "fon9/sys/Config.h"
 #ifdef fon9_POSIX
 #include "fon9/io/FdrService.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <algorithm>
+fon9_AFTER_INCLUDE_STD;
 
 namespace fon9 { namespace io {
 
+// 提供 FdrService::GetFdrThreadLoads() 列出全部的 FdrService.
+using FdrServiceList = MustLock<std::vector<FdrService*>>;
+static FdrServiceList& GetFdrServiceList() {
+   static FdrServiceList list;
+   return list;
+}
+
 FdrService::FdrService(FdrThreads thrs, const IoServiceArgs& ioArgs, const std::string& thrName)
-   : FdrThreads_{std::move(thrs)} {
+   : FdrThreads_{std::move(thrs)}
+   , Name_{thrName}
+   , ThreadAlloc_{ioArgs.ThreadAlloc_} {
    assert(!this->FdrThreads_.empty());
    size_t L = 0;
-   for (auto& thr : this->FdrThreads_)
-      thr->Thread_ = std::thread(&FdrThread::ThrRun, thr.get(), ServiceThreadArgs{ioArgs, thrName, L++});
+   for (auto& thr : this->FdrThreads_) {
+      ServiceThreadArgs args{ioArgs, thrName, L++};
+      thr->CpuAffinity_ = args.CpuAffinity_;
+      thr->Thread_ = std::thread(&FdrThread::ThrRun, thr.get(), std::move(args));
+   }
+   GetFdrServiceList().Lock()->push_back(this);
 }
 FdrService::~FdrService() {
+   FdrServiceList::Locker list{GetFdrServiceList()};
+   auto ifind = std::find(list->begin(), list->end(), this);
+   if (ifind != list->end())
+      list->erase(ifind);
 }
 FdrThreadSP FdrService::AllocFdrThread(Fdr::fdr_t fd) {
-   return this->FdrThreads_[static_cast<size_t>(fd) % this->FdrThreads_.size()];
+   const size_t   count = this->FdrThreads_.size();
+   size_t         idx = static_cast<size_t>(fd) % count;
+   switch (this->ThreadAlloc_) {
+   case IoThreadAlloc::Default:
+      break;
+   case IoThreadAlloc::LeastConn:
+      // 從 [fd % count] 開始找, 避免數量相同時都集中在第一個 thread.
+      for (size_t L = 1; L < count; ++L) {
+         size_t i = (idx + L) % count;
+         if (this->FdrThreads_[i]->GetHandlerCount() < this->FdrThreads_[idx]->GetHandlerCount())
+            idx = i;
+      }
+      break;
+   case IoThreadAlloc::LeastBytes:
+      {
+         std::lock_guard<std::mutex> lk{this->SampleMutex_};
+         this->SampleLoads(UtcNow());
+         // BytesPerSec_ 大約每秒才取樣一次, 取樣之後分配的連線, 使用每個 handler 的平均收送量預估,
+         // 避免在同一個取樣區間內, 全部的新連線都分配到同一個 thread.
+         uint64_t totalBytes = 0, totalHandlers = 0;
+         for (auto& thr : this->FdrThreads_) {
+            totalBytes += thr->BytesPerSec_;
+            totalHandlers += thr->GetHandlerCount();
+         }
+         uint64_t bytesPerHandler = (totalHandlers ? totalBytes / totalHandlers : totalBytes);
+         if (bytesPerHandler == 0)
+            bytesPerHandler = 1;
+         auto estimate = [bytesPerHandler](const FdrThread& thr) {
+            return thr.BytesPerSec_ + thr.AllocCount_ * bytesPerHandler;
+         };
+         for (size_t L = 1; L < count; ++L) {
+            size_t         i = (idx + L) % count;
+            const uint64_t est = estimate(*this->FdrThreads_[i]);
+            const uint64_t cur = estimate(*this->FdrThreads_[idx]);
+            if (est < cur || (est == cur && this->FdrThreads_[i]->GetHandlerCount() < this->FdrThreads_[idx]->GetHandlerCount()))
+               idx = i;
+         }
+         ++this->FdrThreads_[idx]->AllocCount_;
+      }
+      break;
+   }
+   return this->FdrThreads_[idx];
+}
+FdrThreadSP FdrService::AllocFdrThread(Fdr::fdr_t fd, int32_t pinIndex) {
+   if (pinIndex < 0)
+      return this->AllocFdrThread(fd);
+   return this->FdrThreads_[static_cast<size_t>(pinIndex) % this->FdrThreads_.size()];
+}
+void FdrService::SampleLoads(TimeStamp now) {
+   const TimeInterval elapsed = now - this->SampleTime_;
+   if (!this->SampleTime_.IsNull() && elapsed < TimeInterval_Second(1))
+      return;
+   const double secs = elapsed.To<double>();
+   for (auto& thr : this->FdrThreads_) {
+      const uint64_t bytes = thr->GetRxBytes() + thr->GetTxBytes();
+      thr->BytesPerSec_ = (this->SampleTime_.IsNull() || secs <= 0)
+         ? 0 : static_cast<uint64_t>(static_cast<double>(bytes - thr->SampledBytes_) / secs);
+      thr->SampledBytes_ = bytes;
+      thr->AllocCount_ = 0;
+   }
+   this->SampleTime_ = now;
+}
+void FdrService::AppendLoads(FdrThreadLoads& loads) {
+   std::lock_guard<std::mutex> lk{this->SampleMutex_};
+   this->SampleLoads(UtcNow());
+   uint32_t idx = 0;
+   for (auto& thr : this->FdrThreads_) {
+      loads.emplace_back();
+      FdrThreadLoad& ld = loads.back();
+      ld.Name_ = this->Name_;
+      ld.ThreadIndex_ = idx++;
+      ld.CpuAffinity_ = thr->GetCpuAffinity();
+      ld.HandlerCount_ = thr->GetHandlerCount();
+      ld.RxBytes_ = thr->GetRxBytes();
+      ld.TxBytes_ = thr->GetTxBytes();
+      ld.TxCalls_ = thr->GetTxCalls();
+      ld.TxBytesPerCall_ = (ld.TxCalls_ ? ld.TxBytes_ / ld.TxCalls_ : 0);
+      ld.BytesPerSec_ = thr->BytesPerSec_;
+   }
+}
+FdrThreadLoads FdrService::GetFdrThreadLoads() {
+   FdrThreadLoads          loads;
+   FdrServiceList::Locker  list{GetFdrServiceList()};
+   for (FdrService* iosv : *list)
+      iosv->AppendLoads(loads);
+   return loads;
 }
 
 //--------------------------------------------------------------------------//
@@ -41,12 +147,15 @@ void FdrThread::ThrRun(ServiceThreadArgs args) {
    this->ThrRunImpl(args);
    if (this->use_count() != 0) {
       // select(), poll(), epoll_wait()... error.
-      fon9_LOG_FATAL("FdrThread.ThrRun.CancelMode|name=", args.Name_);
+      fon9_LOGM_FATAL(LogModule_Io, "FdrThread.ThrRun.CancelMode|name=", args.Name_);
       while (this->use_count() > 0) {
          // 拒絕全部的要求, 直到沒有任何人擁有 this 的 FdrThreadSP 為止.
          this->CancelReqs(MoveOutPendingImpl(this->PendingSends_));
+         this->CancelDelayedSends();
          this->CancelReqs(MoveOutPendingImpl(this->PendingUpdates_));
          MoveOutPendingImpl(this->PendingRemoves_);
+         PendingMigrates::Locker{this->PendingMigrates_}->clear();
+         PendingRetriggers::Locker{this->PendingRetriggers_}->clear();
          std::this_thread::yield();
       }
    }
@@ -54,10 +163,149 @@ void FdrThread::ThrRun(ServiceThreadArgs args) {
    fon9_LOG_ThrRun("FdrThread.ThrRun.End|name=", args.Name_);
    delete this;
 }
+void FdrThread::CancelDelayedSends() {
+   DelayedSendsImpl reqs = std::move(*PendingDelayedSends::Locker{this->PendingDelayedSends_});
+   reqs.insert(reqs.end(), this->DelayedSends_.begin(), this->DelayedSends_.end());
+   this->DelayedSends_.clear();
+   for (DelayedSend& r : reqs)
+      r.Handler_->OnFdrEvent_Handling(FdrEventFlag::OperationCanceled);
+}
 void FdrThread::ProcessPendingSends() {
    PendingReqsImpl reqs = this->MoveOutPendingImpl(this->PendingSends_);
-   for (FdrEventHandlerSP& sender : reqs)
-      sender->OnFdrEvent_StartSend();
+   for (FdrEventHandlerSP& sender : reqs) {
+      if (fon9_LIKELY(this->IsFdrThreadOwner(sender.get())))
+         sender->OnFdrEvent_StartSend();
+      else // 已轉移到其他 FdrThread.
+         sender->StartSendInFdrThread();
+   }
+   PendingDelayedSends::Locker lk{this->PendingDelayedSends_};
+   if (!lk->empty()) {
+      if (this->DelayedSends_.empty())
+         this->DelayedSends_.swap(*lk);
+      else {
+         this->DelayedSends_.insert(this->DelayedSends_.end(),
+                                    std::make_move_iterator(lk->begin()),
+                                    std::make_move_iterator(lk->end()));
+         lk->clear();
+      }
+   }
+}
+int64_t FdrThread::CheckDelayedSends() {
+   const DelayedClock::time_point now = DelayedClock::now();
+   DelayedClock::time_point       nearest = DelayedClock::time_point::max();
+   // 到期的 handler 在 OnFdrEvent_StartSend() 裡面, 可能會再加入 PendingDelayedSends_,
+   // 但不會直接改變 DelayedSends_, 所以可以安全的在此移除.
+   auto iend = std::partition(this->DelayedSends_.begin(), this->DelayedSends_.end(),
+                              [now, &nearest](const DelayedSend& r) {
+      if (r.Deadline_ <= now)
+         return false;
+      if (r.Deadline_ < nearest)
+         nearest = r.Deadline_;
+      return true;
+   });
+   if (iend != this->DelayedSends_.end()) {
+      DelayedSendsImpl expired{std::make_move_iterator(iend),
+                               std::make_move_iterator(this->DelayedSends_.end())};
+      this->DelayedSends_.erase(iend, this->DelayedSends_.end());
+      for (DelayedSend& r : expired) {
+         if (fon9_LIKELY(this->IsFdrThreadOwner(r.Handler_.get())))
+            r.Handler_->OnFdrEvent_StartSend();
+         else // 已轉移到其他 FdrThread, 由新的 FdrThread 立即送出.
+            r.Handler_->StartSendInFdrThread();
+      }
+   }
+   if (this->WakeupRequests_.load(std::memory_order_relaxed) != 0)
+      return 0;
+   if (this->DelayedSends_.empty())
+      return -1;
+   const int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(nearest - now).count();
+   return us > 0 ? us : 1;
+}
+bool FdrThread::IsFdrHandlerIdle(const FdrEventHandler* handler) {
+   auto isDelayed = [handler](const DelayedSend& r) { return r.Handler_.get() == handler; };
+   if (std::any_of(this->DelayedSends_.begin(), this->DelayedSends_.end(), isDelayed))
+      return false;
+   {
+      PendingDelayedSends::Locker lk{this->PendingDelayedSends_};
+      if (std::any_of(lk->begin(), lk->end(), isDelayed))
+         return false;
+   }
+   PendingRetriggers::Locker lk{this->PendingRetriggers_};
+   return std::none_of(lk->begin(), lk->end(), [handler](const RetriggerReq& r) {
+      return r.Handler_.get() == handler;
+   });
+}
+void FdrThread::PrepareMigrates() {
+   PendingMigratesImpl reqs = std::move(*PendingMigrates::Locker{this->PendingMigrates_});
+   for (MigrateReq& req : reqs) {
+      FdrEventHandler* hdr = req.Handler_.get();
+      if (!this->IsFdrThreadOwner(hdr)) {
+         // 已被轉移到其他 FdrThread, 則由新的 FdrThread 轉移.
+         hdr->MigrateFdrThread(std::move(req.To_));
+         continue;
+      }
+      if (req.To_.get() == this)
+         continue;
+      if (!this->IsFdrHandlerIdle(hdr)) {
+         // 若在此時移除, 進行中的收送結果會被丟棄(例: uring 的 recv 資料), 所以放棄轉移.
+         fon9_LOGM_WARN(LogModule_Io, "FdrThread.Migrate|fd=", hdr->GetFD(), "|hdr=", ToPtr{hdr}, "|err=Handler busy");
+         continue;
+      }
+      // 必須先移除, 再轉移: 接下來衍生者會處理 PendingRemoves_, 然後呼叫 ProcessPendingMigrates();
+      PendingReqs::Locker removes{this->PendingRemoves_};
+      if (std::find(removes->begin(), removes->end(), req.Handler_) != removes->end())
+         continue; // 已要求移除, 不需要轉移.
+      removes->emplace_back(req.Handler_);
+      removes.unlock();
+      this->MigratingReqs_.emplace_back(std::move(req));
+   }
+}
+void FdrThread::ProcessPendingMigrates() {
+   PendingMigratesImpl reqs;
+   reqs.swap(this->MigratingReqs_);
+   for (MigrateReq& req : reqs) {
+      FdrEventHandler* hdr = req.Handler_.get();
+      assert(this->IsFdrThreadOwner(hdr) && hdr->GetFdrEventHandlerBookmark() == 0);
+      FdrThread* to = req.To_.detach();
+      to->HandlerCount_.fetch_add(1, std::memory_order_relaxed);
+      this->HandlerCount_.fetch_sub(1, std::memory_order_relaxed);
+      hdr->FdrThread_.store(to, std::memory_order_release);
+      // hdr 擁有的 this 參考計數.
+      intrusive_ptr_release(this);
+      // 由新的 FdrThread 重新設定事件; 如果 hdr 不需要事件, 則新的 FdrThread 會略過.
+      to->UpdateFdrEvent(hdr);
+   }
+   if (this->MigratingReqs_.empty()) { // 保留 capacity, 避免每次重新配置.
+      reqs.clear();
+      this->MigratingReqs_.swap(reqs);
+   }
+}
+void FdrThread::MigrateFdrThread(FdrEventHandlerSP handler, FdrThreadSP to) {
+   {
+      PendingMigrates::Locker lk{this->PendingMigrates_};
+      lk->push_back(MigrateReq{std::move(handler), std::move(to)});
+   }
+   this->WakeupThread();
+}
+void FdrThread::StartSendInFdrThread(FdrEventHandlerSP handler, uint32_t delayUS) {
+   DelayedSend req{std::move(handler), DelayedClock::now() + std::chrono::microseconds{delayUS}};
+   {
+      PendingDelayedSends::Locker lk{this->PendingDelayedSends_};
+      lk->emplace_back(std::move(req));
+   }
+   // 必須喚醒 fdr thread, 才能讓它知道新的到期時間.
+   this->WakeupThread();
+}
+void FdrThread::RetriggerFdrEvent(FdrEventHandlerSP handler, FdrEventFlag evs) {
+   {
+      PendingRetriggers::Locker lk{this->PendingRetriggers_};
+      lk->push_back(RetriggerReq{std::move(handler), evs});
+   }
+   this->WakeupThread();
+}
+bool FdrThread::SubmitSend(FdrEventHandler* handler, const struct msghdr& msg) {
+   (void)handler; (void)msg;
+   return false;
 }
 void FdrThread::PushToPendingReqs(PendingReqs& reqs, FdrEventHandlerSP&& handler) {
    {
@@ -75,6 +323,9 @@ void FdrThread::WakeupThread() {
 //--------------------------------------------------------------------------//
 
 FdrEventHandler::~FdrEventHandler() {
+   FdrThread* thr = this->FdrThread_.load(std::memory_order_acquire);
+   thr->HandlerCount_.fetch_sub(1, std::memory_order_relaxed);
+   intrusive_ptr_release(thr);
 }
 
 } } // namespaces
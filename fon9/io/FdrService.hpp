@@ -7,15 +7,22 @@
 #include "fon9/FdrNotify.hpp"
 #include "fon9/MustLock.hpp"
 #include "fon9/ThreadId.hpp"
+#include "fon9/TimeStamp.hpp"
 
 #include <thread>
 #include <vector>
+#include <mutex>
+#include <chrono>
+
+struct msghdr;
 
 namespace fon9 { namespace io {
 
 class FdrService;
 class FdrEventHandler;
 using FdrEventHandlerSP = intrusive_ptr<FdrEventHandler>;
+class FdrThread;
+using FdrThreadSP = intrusive_ptr<FdrThread>;
 
 enum class FdrEventFlag {
    /// 沒有要關心的事件.
@@ -33,6 +40,16 @@ enum class FdrEventFlag {
 };
 fon9_ENABLE_ENUM_BITWISE_OP(FdrEventFlag);
 
+/// \ingroup io
+/// completion 型的 FdrThread(例: FdrThreadUring 的 multishot recv), 代替 FdrEventHandler 從 fd 讀入的結果.
+/// - 在觸發 FdrEventFlag::Readable 期間有效, 由 FdrEventHandler::GetFdrRxCompleted() 取得.
+struct FdrRxCompleted {
+   const void* Data_;
+   /// ErrNo_ == 0 && Size_ == 0: 對方已關閉.
+   size_t      Size_;
+   int         ErrNo_;
+};
+
 //--------------------------------------------------------------------------//
 
 /// \ingroup io
@@ -52,6 +69,41 @@ protected:
    ThreadId::IdType  ThreadId_;
    std::atomic_uint_fast32_t  WakeupRequests_{0};
 
+   struct MigrateReq {
+      FdrEventHandlerSP Handler_;
+      FdrThreadSP       To_;
+   };
+   using PendingMigratesImpl = std::vector<MigrateReq>;
+   using PendingMigrates = MustLock<PendingMigratesImpl>;
+   PendingMigrates   PendingMigrates_;
+   /// 只在 fdr thread 使用: 已通過檢查, 等候從 this 移除後, 再轉移到新的 FdrThread.
+   PendingMigratesImpl  MigratingReqs_;
+
+   /// 延遲送出(SendBuffered 的合併送出)使用 steady_clock, 避免調整系統時間造成的影響.
+   using DelayedClock = std::chrono::steady_clock;
+   struct DelayedSend {
+      FdrEventHandlerSP       Handler_;
+      DelayedClock::time_point Deadline_;
+   };
+   using DelayedSendsImpl = std::vector<DelayedSend>;
+   using PendingDelayedSends = MustLock<DelayedSendsImpl>;
+   PendingDelayedSends  PendingDelayedSends_;
+   /// 只在 fdr thread 裡面使用: 在 ProcessPendingSends() 時, 從 PendingDelayedSends_ 移入.
+   DelayedSendsImpl     DelayedSends_;
+
+   /// edge-triggered 時, 由 FdrEventHandler::RetriggerFdrEvent() 加入, 由衍生者在 ProcessPendings 時處理.
+   struct RetriggerReq {
+      FdrEventHandlerSP Handler_;
+      FdrEventFlag      Events_;
+   };
+   using PendingRetriggersImpl = std::vector<RetriggerReq>;
+   using PendingRetriggers = MustLock<PendingRetriggersImpl>;
+   PendingRetriggers    PendingRetriggers_;
+   /// 由衍生者在建構時設定: 是否使用 edge-triggered 的事件通知.
+   bool                 IsEdgeTriggered_{false};
+   /// 由衍生者在建構時設定: 是否支援 SubmitSend().
+   bool                 IsSendSubmittable_{false};
+
    void ClearWakeup() {
       assert(this->IsThisThread());
       this->WakeupFdr_.ClearWakeup();
@@ -59,6 +111,11 @@ protected:
    }
 
    static void OnFdrEvent_Emit(FdrEventFlag evs, FdrEventHandler* handler);
+   static bool OnFdrEvent_ErrQueue(FdrEventHandler* handler);
+   /// 設定 handler 的 GetFdrRxCompleted() 之後, 觸發 FdrEventFlag::Readable.
+   static void OnFdrEvent_EmitRx(const FdrRxCompleted& rx, FdrEventHandler* handler);
+   static bool OnFdrEvent_SendDone(ssize_t res, FdrEventHandler* handler);
+   static bool IsFdrRxCompletionAllowed(const FdrEventHandler* handler);
    static void SetFdrEventHandlerBookmark(FdrEventHandler* handler, uint64_t bookmark);
 
    static PendingReqsImpl MoveOutPendingImpl(PendingReqs& impl) {
@@ -67,6 +124,24 @@ protected:
    }
 
    void ProcessPendingSends();
+   /// 由衍生者在每次等候事件之前呼叫(若 !DelayedSends_.empty()):
+   /// 對已到期的 handler 觸發 OnFdrEvent_StartSend();
+   /// \retval <0  已沒有延遲中的 handler.
+   /// \retval 0   已有新的 WakeupRequests_, 不應等候.
+   /// \retval >0  距離最近一個到期的時間(us), 衍生者應以此作為等候事件的逾時.
+   int64_t CheckDelayedSends();
+   /// 由衍生者在處理 PendingRemoves_ 之前呼叫:
+   /// 檢查要轉移的 handler 是否閒置(IsFdrHandlerIdle()), 閒置者放入 PendingRemoves_ 及 MigratingReqs_;
+   /// 忙碌者放棄轉移(記錄 log), 繼續由 this 服務.
+   void PrepareMigrates();
+   /// 由衍生者在處理完 PendingRemoves_ 之後, 處理 PendingUpdates_ 之前呼叫: 完成 MigratingReqs_ 的轉移.
+   void ProcessPendingMigrates();
+   /// 只會在 fdr thread 裡面呼叫: handler 是否閒置, 可以轉移到其他 FdrThread.
+   /// 預設: 沒有延遲送出(DelayedSends_, PendingDelayedSends_), 也沒有 PendingRetriggers_;
+   /// completion 型的 FdrThread(例: FdrThreadUring) 應再檢查是否有進行中的收送要求.
+   virtual bool IsFdrHandlerIdle(const FdrEventHandler* handler);
+   /// 在 ProcessPendings 時, 若 handler 已轉移到其他 FdrThread, 則應將要求轉給新的 FdrThread 處理.
+   bool IsFdrThreadOwner(const FdrEventHandler* handler) const;
 
 public:
    virtual ~FdrThread();
@@ -74,9 +149,47 @@ public:
    bool IsThisThread() const {
       return this->ThreadId_ == ThisThread_.ThreadId_;
    }
+   bool IsEdgeTriggered() const {
+      return this->IsEdgeTriggered_;
+   }
+   bool IsSendSubmittable() const {
+      return this->IsSendSubmittable_;
+   }
+   /// 此 thread 綁定的 cpu, 若沒有綁定則為 -1.
+   int GetCpuAffinity() const {
+      return this->CpuAffinity_;
+   }
+   /// 目前由此 thread 服務的 FdrEventHandler 數量.
+   uint32_t GetHandlerCount() const {
+      return this->HandlerCount_.load(std::memory_order_relaxed);
+   }
+   /// 累計收到的資料量, 由 FdrEventHandler::AddRxBytes() 累加.
+   uint64_t GetRxBytes() const {
+      return this->RxBytes_.load(std::memory_order_relaxed);
+   }
+   /// 累計送出的資料量, 由 FdrEventHandler::AddTxBytes() 累加.
+   uint64_t GetTxBytes() const {
+      return this->TxBytes_.load(std::memory_order_relaxed);
+   }
+   /// 累計呼叫 send 系列 syscall 的次數, 每次 FdrEventHandler::AddTxBytes() 加 1;
+   /// GetTxBytes() / GetTxCalls() 可得知每次 syscall 平均送出的資料量.
+   uint64_t GetTxCalls() const {
+      return this->TxCalls_.load(std::memory_order_relaxed);
+   }
 
 private:
    std::thread Thread_;
+   int         CpuAffinity_{-1};
+   std::atomic<uint32_t>   HandlerCount_{0};
+   std::atomic<uint64_t>   RxBytes_{0};
+   std::atomic<uint64_t>   TxBytes_{0};
+   std::atomic<uint64_t>   TxCalls_{0};
+   // 由 FdrService 取樣(在 FdrService 的 lock 保護下處理).
+   uint64_t                SampledBytes_{0};
+   uint64_t                BytesPerSec_{0};
+   /// 從上次取樣之後, 由 IoThreadAlloc::LeastBytes 分配到此 thread 的次數;
+   /// 新分配的連線尚未反映在 BytesPerSec_, 所以分配時需要加上這些連線的預估量.
+   uint32_t                AllocCount_{0};
    /// FdrThread 的自我保護措施: 在 ThrRun() 結束時才會 delete.
    friend void intrusive_ptr_deleter(const FdrThread* p);
 
@@ -90,6 +203,7 @@ private:
    virtual void ThrRunImpl(const ServiceThreadArgs& args) = 0;
    void ThrRun(ServiceThreadArgs args);
    void CancelReqs(PendingReqsImpl);
+   void CancelDelayedSends();
 
    friend class FdrEventHandler;
    void WakeupThread();
@@ -103,15 +217,40 @@ private:
    void StartSendInFdrThread(FdrEventHandlerSP handler) {
       this->PushToPendingReqs(this->PendingSends_, std::move(handler));
    }
+   void StartSendInFdrThread(FdrEventHandlerSP handler, uint32_t delayUS);
+   void RetriggerFdrEvent(FdrEventHandlerSP handler, FdrEventFlag evs);
+   void MigrateFdrThread(FdrEventHandlerSP handler, FdrThreadSP to);
+   /// 只會在 fdr thread 裡面呼叫, 由 completion 型的 FdrThread(例: FdrThreadUring) 實作:
+   /// 將送出要求放入佇列, 在下次等候事件時一併送出, 完成後透過 handler->OnFdrEvent_SendDone() 通知.
+   /// 預設傳回 false: 不支援, 由 handler 自行送出.
+   virtual bool SubmitSend(FdrEventHandler* handler, const struct msghdr& msg);
 };
-using FdrThreadSP = intrusive_ptr<FdrThread>;
 extern void intrusive_ptr_deleter(const FdrThread* p);
 
 //--------------------------------------------------------------------------//
 
+/// \ingroup io
+/// FdrThread 的負載資訊快照, 提供給管理介面(e.g. seed tree)顯示.
+struct FdrThreadLoad {
+   std::string Name_;
+   uint32_t    ThreadIndex_;
+   int         CpuAffinity_;
+   uint32_t    HandlerCount_;
+   uint64_t    RxBytes_;
+   uint64_t    TxBytes_;
+   /// 呼叫 send 系列 syscall 的次數.
+   uint64_t    TxCalls_;
+   /// TxBytes_ / TxCalls_: 每次 syscall 平均送出量, 可用來評估合併送出(CoalesceUS)的效果.
+   uint64_t    TxBytesPerCall_;
+   /// 最近一次取樣區間(約1秒)的每秒收送量.
+   uint64_t    BytesPerSec_;
+};
+using FdrThreadLoads = std::vector<FdrThreadLoad>;
+
 /// \ingroup io
 /// 負責管理 FdrThread, 決定 FdrEventHandler 要使用哪個 FdrThread.
 class FdrService : public intrusive_ref_counter<FdrService> {
+   fon9_NON_COPY_NON_MOVE(FdrService);
 public:
    using FdrThreads = std::vector<FdrThreadSP>;
 
@@ -120,16 +259,45 @@ public:
 
    virtual ~FdrService();
 
-   /// 預設使用 [fd % thrCount] 決定使用哪個 fdr thread.
+   /// 依照 IoServiceArgs::ThreadAlloc_ 決定使用哪個 fdr thread:
+   /// - IoThreadAlloc::Default: 使用 [fd % thrCount].
+   /// - IoThreadAlloc::LeastConn: FdrEventHandler 數量最少的 thread.
+   /// - IoThreadAlloc::LeastBytes: 最近取樣區間每秒收送量最少的 thread;
+   ///   取樣之後已分配的連線, 以每個 handler 的平均收送量預估.
    virtual FdrThreadSP AllocFdrThread(Fdr::fdr_t fd);
+   /// 若 pinIndex >= 0 則使用 FdrThreads_[pinIndex % thrCount], 否則使用 AllocFdrThread(fd);
+   /// 通常 pinIndex 來自 DeviceOptions::IoThreadIndex_;
+   FdrThreadSP AllocFdrThread(Fdr::fdr_t fd, int32_t pinIndex);
+
+   /// 例如: 需要為每個 FdrThread 建立一個 listener 時使用.
+   const FdrThreads& GetFdrThreads() const {
+      return this->FdrThreads_;
+   }
+   const std::string& GetName() const {
+      return this->Name_;
+   }
+
+   /// 取得目前全部 FdrService 的 FdrThread 負載資訊.
+   static FdrThreadLoads GetFdrThreadLoads();
 
 private:
-   const FdrThreads  FdrThreads_;
+   const FdrThreads     FdrThreads_;
+   const std::string    Name_;
+   const IoThreadAlloc  ThreadAlloc_;
+   // 保護 FdrThread 的取樣資料.
+   std::mutex           SampleMutex_;
+   TimeStamp            SampleTime_;
+
+   /// 距離上次取樣超過1秒, 才會重新計算每個 FdrThread 的 BytesPerSec_;
+   /// 必須在 SampleMutex_ 保護下呼叫.
+   void SampleLoads(TimeStamp now);
+   void AppendLoads(FdrThreadLoads& loads);
 };
 using FdrServiceSP = intrusive_ptr<FdrService>;
 
 /// \ingroup io
 /// 各個 OS 有它自己的預設 FdrService: 例如 Linux = FdrServiceEpoll.
+/// Linux 可透過 ioArgs.Engine_ = IoEngine::Uring 選用 FdrServiceUring, 若系統不支援則仍使用 FdrServiceEpoll.
 fon9_API FdrServiceSP MakeDefaultFdrService(const IoServiceArgs& ioArgs, const std::string& thrName, Result2& err);
 
 //--------------------------------------------------------------------------//
@@ -142,8 +310,14 @@ class fon9_API FdrEventHandler {
 public:
    /// 建構時由 iosv 分配 FdrThread.
    FdrEventHandler(FdrService& iosv, FdrAuto&& fd)
-      : FdrThread_{iosv.AllocFdrThread(fd.GetFD())}
+      : FdrEventHandler{iosv.AllocFdrThread(fd.GetFD()), std::move(fd)} {
+   }
+   /// 建構時直接指定 FdrThread.
+   FdrEventHandler(FdrThreadSP thr, FdrAuto&& fd)
+      : FdrThread_{thr.detach()}
       , Fdr_{std::move(fd)} {
+      assert(this->FdrThread_ != nullptr);
+      this->FdrThread_.load(std::memory_order_relaxed)->HandlerCount_.fetch_add(1, std::memory_order_relaxed);
    }
 
    virtual ~FdrEventHandler();
@@ -155,7 +329,7 @@ public:
    ///   - 當不再需要事件時, 應呼叫 RemoveFdrEvent() 移除事件通知,
    ///   - 無法在解構時處理 (因為尚未移除前, fdr service 會擁有 this SP, 不可能造成解構).
    void UpdateFdrEvent() {
-      this->FdrThread_->UpdateFdrEvent(this);
+      this->CurrFdrThread()->UpdateFdrEvent(this);
    }
 
    /// 從 fdr thread 移除事件處理者.
@@ -165,17 +339,61 @@ public:
    ///      - 所以返回後仍有可能收到 FdrEvent() 事件.
    /// - 一旦移除, 就不會再收到任何事件, 即使再呼叫 UpdateFdrEvent() 也不會有任何作用.
    void RemoveFdrEvent() {
-      this->FdrThread_->RemoveFdrEvent(this);
+      this->CurrFdrThread()->RemoveFdrEvent(this);
    }
 
    /// 通常在 SendBuffered() 時使用:
    /// 到 fdr thread 送出: 透過 this->OnFdrEvent_StartSend();
    void StartSendInFdrThread() {
-      this->FdrThread_->StartSendInFdrThread(this);
+      this->CurrFdrThread()->StartSendInFdrThread(this);
+   }
+   /// 延遲 delayUS 之後, 才到 fdr thread 送出, 用於合併送出(corking):
+   /// 在延遲期間加入的資料, 可以在一次 syscall 送出.
+   /// - 延遲期間若有呼叫 StartSendInFdrThread(), 則會提早送出, 到期時再觸發 OnFdrEvent_StartSend();
+   ///   因此衍生者的 OnFdrEvent_StartSend() 必須能處理「沒有資料可送」的情況.
+   void StartSendInFdrThread(uint32_t delayUS) {
+      this->CurrFdrThread()->StartSendInFdrThread(this, delayUS);
+   }
+
+   /// 將 this 轉移到另一個 FdrThread 服務, 例如: 負載平衡.
+   /// - to 必須與目前的 FdrThread 屬於同一個 FdrService.
+   /// - 實際的轉移在目前的 fdr thread 處理: 先移除事件通知, 再到 to 重新設定事件.
+   /// - 只會轉移閒置的 handler: 沒有進行中的 completion 收送(例: uring 的 recv, sendmsg),
+   ///   沒有延遲送出, 沒有等候中的 RetriggerFdrEvent();
+   ///   若不是閒置, 則放棄轉移(記錄 log), 仍由目前的 FdrThread 服務, 可透過 GetFdrThread() 得知結果.
+   /// - 轉移期間的事件會在 to 重新設定後觸發.
+   void MigrateFdrThread(FdrThreadSP to) {
+      this->CurrFdrThread()->MigrateFdrThread(this, std::move(to));
+   }
+
+   /// 是否使用 edge-triggered 的事件通知, 例: FdrThreadEpoll + IoServiceArgs::IsEdgeTriggered_;
+   bool IsFdrEdgeTriggered() const {
+      return this->CurrFdrThread()->IsEdgeTriggered();
+   }
+   /// edge-triggered 時, 只有在狀態改變(e.g. 有新資料到達, 送出緩衝區從滿變成有空間)時才會觸發事件;
+   /// 所以處理事件時, 若尚未讀寫到 EAGAIN 就先結束(例: 避免占用太久, 轉到 op thread 處理, writev 的 IOV_MAX 限制),
+   /// 則必須透過此處告知 fdr thread: 在 evs 仍需要時, 再次觸發 evs 事件.
+   /// - 可在任意 thread 呼叫, 實際的處理會到 fdr thread.
+   /// - level-triggered 時, 不需要呼叫.
+   void RetriggerFdrEvent(FdrEventFlag evs) {
+      this->CurrFdrThread()->RetriggerFdrEvent(this, evs);
    }
 
    bool InFdrThread() const {
-      return this->FdrThread_->IsThisThread();
+      return this->CurrFdrThread()->IsThisThread();
+   }
+   FdrThreadSP GetFdrThread() const {
+      return this->CurrFdrThread();
+   }
+   /// 提供給衍生者累計收送的資料量, 作為 FdrThread 的負載資訊.
+   void AddRxBytes(size_t bytes) {
+      this->CurrFdrThread()->RxBytes_.fetch_add(bytes, std::memory_order_relaxed);
+   }
+   /// 每次呼叫 send 系列 syscall 之後呼叫一次(包含送出 0 bytes 的情況).
+   void AddTxBytes(size_t bytes) {
+      FdrThread* thr = this->CurrFdrThread();
+      thr->TxBytes_.fetch_add(bytes, std::memory_order_relaxed);
+      thr->TxCalls_.fetch_add(1, std::memory_order_relaxed);
    }
    uint64_t GetFdrEventHandlerBookmark() const {
       return this->FdrThreadBookmark_;
@@ -183,18 +401,46 @@ public:
    Fdr::fdr_t GetFD() const {
       return this->Fdr_.GetFD();
    }
+   /// 在 FdrEventFlag::Readable 事件裡面呼叫:
+   /// 若 fdr thread 已代替 this 從 fd 讀入資料(例: FdrThreadUring 的 multishot recv), 則傳回讀入的結果;
+   /// 否則傳回 nullptr, 由 this 自行讀取.
+   const FdrRxCompleted* GetFdrRxCompleted() const {
+      return this->FdrRxCompleted_;
+   }
+   /// fdr thread 是否支援 SubmitFdrSend(), 例: FdrThreadUring;
+   bool IsFdrSendSubmittable() const {
+      return this->CurrFdrThread()->IsSendSubmittable();
+   }
+   /// 只能在 fdr thread 呼叫: 若 fdr thread 支援 completion 型的送出(例: FdrThreadUring 的 IORING_OP_SENDMSG),
+   /// 則將 msg 放入送出佇列, 與其他 handler 的送出要求在下次等候事件時一併送出.
+   /// - 傳回 true: msg 及其指向的資料, 必須保留到 OnFdrEvent_SendDone() 為止.
+   /// - 傳回 false: 不支援, 應自行送出.
+   bool SubmitFdrSend(const struct msghdr& msg) {
+      return this->CurrFdrThread()->SubmitSend(this, msg);
+   }
+
    /// 取得需要哪些事件.
    /// - 一般而言只會在 fdr thread 呼叫.
    /// - FdrEventFlag::None 僅表示現在不須要事件,
    ///   但是沒有從 fdr thread 移除, 若要移除, 應使用 RemoveFdrEvent();
    virtual FdrEventFlag GetRequiredFdrEventFlag() const = 0;
 
+protected:
+   /// 只能在衍生者解構時呼叫(此時已從 fdr thread 移除):
+   /// 需要在釋放其他資源之前先關閉 fd, 例: FdrSocket 尚未完成的 MSG_ZEROCOPY.
+   void CloseFdrAtDestruct() {
+      this->Fdr_.Close();
+   }
+
 private:
    friend class FdrThread;
-   // 在建構時就決定了要使用哪個 FdrThread & 處理哪個 fd 的事件.
-   const FdrThreadSP FdrThread_;
-   const FdrAuto     Fdr_;
+   // 在建構時決定要使用哪個 FdrThread, 之後可透過 MigrateFdrThread() 轉移.
+   // 擁有 FdrThread 的一個參考計數, 在解構時釋放;
+   // 只會在 fdr thread 裡面改變, 因為 FdrService 擁有全部的 FdrThread, 所以可安全的使用取出的指標.
+   std::atomic<FdrThread*> FdrThread_;
+   FdrAuto           Fdr_;
    uint64_t          FdrThreadBookmark_{0};
+   const FdrRxCompleted*   FdrRxCompleted_{nullptr};
 
    /// 可能同時有多種事件通知.
    /// 只會在 fdr thread 裡面呼叫.
@@ -203,9 +449,34 @@ private:
    /// 透過 StartSendInFdrThread() 啟動在 fdr thread 的傳送.
    virtual void OnFdrEvent_StartSend() = 0;
 
+   /// 在 fdr thread 收到 error 事件(EPOLLERR, POLLERR), 觸發 FdrEventFlag::Error 之前呼叫.
+   /// - 若 error 事件是因為 error queue 有資料(例: MSG_ZEROCOPY 的完成通知), 則衍生者應在此取出處理;
+   ///   處理後若 fd 沒有其他錯誤, 則傳回 true, 此時不會觸發 FdrEventFlag::Error.
+   /// - 預設傳回 false.
+   virtual bool OnFdrEvent_ErrQueue() {
+      return false;
+   }
+
+   /// completion 型的 fdr thread 詢問: 是否允許由 fdr thread 代替 this 從 fd 讀取資料.
+   /// 若傳回 true, 則觸發 FdrEventFlag::Readable 時, 可能已透過 GetFdrRxCompleted() 提供讀入的結果.
+   /// 預設傳回 false: 使用 readiness 通知.
+   virtual bool IsFdrRxCompletionAllowed() const {
+      return false;
+   }
+   /// 透過 SubmitFdrSend() 的送出要求已完成, res = 送出的資料量 或 -errno.
+   /// 傳回 true 表示需要繼續送出: fdr thread 會觸發 FdrEventFlag::Writable.
+   virtual bool OnFdrEvent_SendDone(ssize_t res) {
+      (void)res;
+      return false;
+   }
+
    virtual void OnFdrEvent_AddRef() = 0;
    virtual void OnFdrEvent_ReleaseRef() = 0;
 
+   FdrThread* CurrFdrThread() const {
+      return this->FdrThread_.load(std::memory_order_acquire);
+   }
+
    inline friend void intrusive_ptr_add_ref(const FdrEventHandler* p) {
       const_cast<FdrEventHandler*>(p)->OnFdrEvent_AddRef();
    }
@@ -219,9 +490,26 @@ private:
 inline void FdrThread::OnFdrEvent_Emit(FdrEventFlag evs, FdrEventHandler* handler) {
    handler->OnFdrEvent_Handling(evs);
 }
+inline bool FdrThread::OnFdrEvent_ErrQueue(FdrEventHandler* handler) {
+   return handler->OnFdrEvent_ErrQueue();
+}
+inline void FdrThread::OnFdrEvent_EmitRx(const FdrRxCompleted& rx, FdrEventHandler* handler) {
+   handler->FdrRxCompleted_ = &rx;
+   handler->OnFdrEvent_Handling(FdrEventFlag::Readable);
+   handler->FdrRxCompleted_ = nullptr;
+}
+inline bool FdrThread::OnFdrEvent_SendDone(ssize_t res, FdrEventHandler* handler) {
+   return handler->OnFdrEvent_SendDone(res);
+}
+inline bool FdrThread::IsFdrRxCompletionAllowed(const FdrEventHandler* handler) {
+   return handler->IsFdrRxCompletionAllowed();
+}
 inline void FdrThread::SetFdrEventHandlerBookmark(FdrEventHandler* handler, uint64_t bookmark) {
    handler->FdrThreadBookmark_ = bookmark;
 }
+inline bool FdrThread::IsFdrThreadOwner(const FdrEventHandler* handler) const {
+   return handler->CurrFdrThread() == this;
+}
 
 } } // namespaces
 #endif//__fon9_io_FdrService_hpp__
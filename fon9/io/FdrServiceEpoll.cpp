@@ -2,12 +2,23 @@
 /// \author fonwinz@gmail.com
 #ifdef __linux__
 #include "fon9/io/FdrServiceEpoll.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/io/FdrServiceUring.hpp"
+#include "fon9/LogModule.hpp"
 #include <sys/epoll.h>
+#include <sys/syscall.h>
+#ifdef __NR_epoll_pwait2
+#include <linux/time_types.h>
+#endif
 
 namespace fon9 { namespace io {
 
 fon9_API FdrServiceSP MakeDefaultFdrService(const IoServiceArgs& ioArgs, const std::string& thrName, Result2& err) {
+   if (ioArgs.Engine_ == IoEngine::Uring) {
+      if (FdrServiceSP retval = FdrServiceUring::MakeService(ioArgs, thrName, err))
+         return retval;
+      fon9_LOGM_WARN(LogModule_Io, "MakeDefaultFdrService|name=", thrName, "|Engine=uring|err=", err, "|info=Use epoll");
+      err = Result2{};
+   }
    return FdrServiceEpoll::MakeService(ioArgs, thrName, err);
 }
 FdrServiceSP FdrServiceEpoll::MakeService(const IoServiceArgs& ioArgs, const std::string& thrName, MakeResult& err) {
@@ -16,7 +27,7 @@ FdrServiceSP FdrServiceEpoll::MakeService(const IoServiceArgs& ioArgs, const std
       thrCount = 1;
    FdrService::FdrThreads thrs(thrCount);
    for (size_t L = 0; L < thrCount; ++L) {
-      thrs[L].reset(new FdrThreadEpoll{err});
+      thrs[L].reset(new FdrThreadEpoll{ioArgs, err});
       if (err.IsError())
          return FdrServiceSP{};
    }
@@ -26,9 +37,10 @@ FdrServiceSP FdrServiceEpoll::MakeService(const IoServiceArgs& ioArgs, const std
 
 //--------------------------------------------------------------------------//
 
-FdrThreadEpoll::FdrThreadEpoll(FdrServiceEpoll::MakeResult& res)
+FdrThreadEpoll::FdrThreadEpoll(const IoServiceArgs& ioArgs, FdrServiceEpoll::MakeResult& res)
    : FdrEpoll_{::epoll_create1(EPOLL_CLOEXEC)} {
    using Result = FdrServiceEpoll::MakeResult;
+   this->IsEdgeTriggered_ = ioArgs.IsEdgeTriggered_;
    if (!this->FdrEpoll_.IsReadyFD()) {
       res = Result{"epoll_create1", GetSysErrC()};
       return;
@@ -53,28 +65,90 @@ FdrThreadEpoll::~FdrThreadEpoll() {
 
 //--------------------------------------------------------------------------//
 
+int FdrThreadEpoll::EpollWait(Fdr::fdr_t epFdr, struct epoll_event* events, int maxEvents, int64_t waitUS) {
+   if (waitUS <= 0)
+      return epoll_wait(epFdr, events, maxEvents, waitUS < 0 ? -1 : 0);
+#ifdef __NR_epoll_pwait2
+   if (fon9_LIKELY(this->IsPwait2Supported_)) {
+      struct __kernel_timespec ts;
+      ts.tv_sec = waitUS / 1000000;
+      ts.tv_nsec = (waitUS % 1000000) * 1000;
+      const int res = static_cast<int>(syscall(__NR_epoll_pwait2, epFdr, events, maxEvents, &ts, nullptr, 0));
+      if (fon9_LIKELY(res >= 0 || errno != ENOSYS))
+         return res;
+      this->IsPwait2Supported_ = false;
+   }
+#endif
+   return epoll_wait(epFdr, events, maxEvents, static_cast<int>((waitUS + 999) / 1000));
+}
+
+/// 依照 epoll_wait() 取得的事件數量, 調整 epEvents 的大小:
+/// - 若 epEvents 不足以容納一次的事件數量 => 擴充容量, 若瞬間有大量事件, 則可以減少 epoll_wait() 的呼叫次數.
+/// - 若連續多次取得的事件數量都很少 => 縮小容量, 減少閒置時的記憶體(cache)占用.
+///   只計算「有取得事件」或「有實際等候」的 epoll_wait();
+///   Busy/Yield 模式沒有事件時的 epoll_wait(,0) 每秒可能數百萬次, 若也計入, 則任何短暫的低量都會立即縮小容量,
+///   之後遇到大量事件又要再擴充, 造成反覆的 resize.
+template <class EpollEvents>
+static void AdaptEpollEvents(EpollEvents& epEvents, size_t used, unsigned& lowUsedCount) {
+   enum : size_t {
+      kMinEpollEvents = 16,
+      kShrinkAfterCount = 1024,
+   };
+   if (fon9_UNLIKELY(used == epEvents.size())) {
+      epEvents.resize(used * 2);
+      epEvents.resize(epEvents.capacity());
+      lowUsedCount = 0;
+   }
+   else if (epEvents.size() > kMinEpollEvents && used < epEvents.size() / 4) {
+      if (fon9_UNLIKELY(++lowUsedCount >= kShrinkAfterCount)) {
+         epEvents.resize(epEvents.size() / 2);
+         epEvents.shrink_to_fit();
+         lowUsedCount = 0;
+      }
+   }
+   else
+      lowUsedCount = 0;
+}
+
+void FdrThreadEpoll::EmitReady(EvHandler& evh) {
+   FdrEventHandler*   hdr = evh.get();
+   const FdrEventFlag evs = evh.Ready_ & hdr->GetRequiredFdrEventFlag();
+   if (evs != FdrEventFlag::None) {
+      evh.Ready_ -= evs;
+      this->OnFdrEvent_Emit(evs, hdr);
+   }
+}
+
 void FdrThreadEpoll::ThrRunImpl(const ServiceThreadArgs& args) {
    using EpollEvents = std::vector<struct epoll_event>;
-   EpollEvents epEvents{16};
-   EvHandlers  evHandlers{args.Capacity_};
-   Fdr::fdr_t  epFdr = this->FdrEpoll_.GetFD();
-   const int   kEpollWaitMS = (IsBlockWait(args.HowWait_) ? -1 : 0);
+   EpollEvents    epEvents{16};
+   unsigned       lowUsedCount = 0;
+   EvHandlers     evHandlers{args.Capacity_};
+   Fdr::fdr_t     epFdr = this->FdrEpoll_.GetFD();
+   const int64_t  kEpollWaitUS = (IsBlockWait(args.HowWait_) ? -1 : 0);
+   const bool     isEdgeTriggered = this->IsEdgeTriggered_;
    while (this->use_count() > 0) {
       // 再次進入 epoll_wait() 之前, 必須先將 Pending Removes, Updates 處理完,
       // 因為: 在 OnFdrEvent_Emit() 裡面關閉 readable, writable 偵測, 必須確實執行.
       // 避免: 當 Device 必須回到 op thread 觸發 OnDevice_Recv() 或 執行 send,
       //       如果沒有確實禁止 readable, writable, 則可能會發生非預期的結果.
-      int msWait = kEpollWaitMS;
+      int64_t usWait = kEpollWaitUS;
       if (fon9_UNLIKELY(this->WakeupRequests_.load(std::memory_order_relaxed) != 0)) {
          this->ClearWakeup();
          this->ProcessPendings(epFdr, evHandlers);
          // 如果在 ProcessPendings() 時有再增加 Wakeup,
          // 則 epoll_wait() 應在偵測新進 ev 之後立即結束, 然後處理 ProcessPendings().
          if (this->WakeupRequests_.load(std::memory_order_relaxed) != 0)
-            msWait = 0;
+            usWait = 0;
+      }
+      if (fon9_UNLIKELY(!this->DelayedSends_.empty())) {
+         // Block 模式: 等候到最近一個延遲送出到期; 非 Block 模式則每次迴圈都會檢查.
+         const int64_t us = this->CheckDelayedSends();
+         if (us >= 0 && usWait != 0)
+            usWait = us;
       }
       struct epoll_event* pEvBeg = &*epEvents.begin();
-      int epRes = epoll_wait(epFdr, pEvBeg, static_cast<int>(epEvents.size()), msWait);
+      int epRes = this->EpollWait(epFdr, pEvBeg, static_cast<int>(epEvents.size()), usWait);
       if (fon9_LIKELY(epRes > 0)) {
          for (int L = 0; L < epRes; ++L, ++pEvBeg) {
             if (FdrEventHandler* hdr = static_cast<FdrEventHandler*>(pEvBeg->data.ptr)) {
@@ -84,9 +158,25 @@ void FdrThreadEpoll::ThrRunImpl(const ServiceThreadArgs& args) {
                   if (eflags & (EPOLLIN | EPOLLPRI | EPOLLRDHUP))
                      evs |= FdrEventFlag::Readable;
                   if (fon9_UNLIKELY(eflags & (EPOLLHUP | EPOLLERR))) {
-                     evs |= FdrEventFlag::Error;
-                     // 避免 hdr 處理 error 期間, 這裡會一直觸發 error, 所以一旦 error, 就移除 handler.
-                     hdr->RemoveFdrEvent();
+                     if ((eflags & EPOLLHUP) || !this->OnFdrEvent_ErrQueue(hdr)) {
+                        evs |= FdrEventFlag::Error;
+                        // 避免 hdr 處理 error 期間, 這裡會一直觸發 error, 所以一旦 error, 就移除 handler.
+                        hdr->RemoveFdrEvent();
+                     }
+                     else if (evs == FdrEventFlag::None) // 只有 error queue 的通知, 已處理完畢.
+                        continue;
+                  }
+                  if (isEdgeTriggered) {
+                     // handler 目前不需要的事件, 保留在 Ready_, 等到 handler 需要時再觸發;
+                     // 因為 edge-triggered 在狀態沒有改變前, 不會再通知.
+                     const FdrEventFlag notRequired = (evs & (FdrEventFlag::Readable | FdrEventFlag::Writable))
+                                                    - hdr->GetRequiredFdrEventFlag();
+                     if (notRequired != FdrEventFlag::None) {
+                        if (EvHandler* evh = evHandlers.GetObjPtr(hdr->GetFdrEventHandlerBookmark() - 1))
+                           evh->Ready_ |= notRequired;
+                        if ((evs -= notRequired) == FdrEventFlag::None)
+                           continue;
+                     }
                   }
                   this->OnFdrEvent_Emit(evs, hdr);
                }
@@ -94,46 +184,54 @@ void FdrThreadEpoll::ThrRunImpl(const ServiceThreadArgs& args) {
             else
                this->WakeupRequests_.store(1, std::memory_order_relaxed);
          }
-         if (fon9_UNLIKELY(static_cast<size_t>(epRes) == epEvents.size())) {
-            // epEvents 可能不足以容納一次的事件數量 => 擴充容量,
-            // 若瞬間有大量事件,則可以減少 epoll_wait() 的呼叫次數.
-            epEvents.resize(epRes * 2);
-            epEvents.resize(epEvents.capacity());
-         }
+         AdaptEpollEvents(epEvents, static_cast<size_t>(epRes), lowUsedCount);
       }
       else if (fon9_LIKELY(epRes == 0)) { // 如果 !Block, 則 epRes==0 是常態!
+         if (usWait != 0) // 只有實際等候(Block 或 DelayedSends 逾時)才計入; 詳見 AdaptEpollEvents() 的說明.
+            AdaptEpollEvents(epEvents, 0u, lowUsedCount);
          if (args.HowWait_ == HowWait::Yield)
             std::this_thread::yield();
       }
       else if (epRes < 0) {
          if (int eno = ErrorCannotRetry(errno))
-            fon9_LOG_FATAL("FdrThreadEpoll.ThrRun|fn=epoll_wait|err=", GetSysErrC(eno));
+            fon9_LOGM_FATAL(LogModule_Io, "FdrThreadEpoll.ThrRun|fn=epoll_wait|err=", GetSysErrC(eno));
       }
    }
 }
 
 void FdrThreadEpoll::ProcessPendings(Fdr::fdr_t epFdr, EvHandlers& evHandlers) {
    this->ProcessPendingSends();
+   this->PrepareMigrates();
 
    struct epoll_event evc;
    PendingReqsImpl reqs = this->MoveOutPendingImpl(this->PendingRemoves_);
    for (FdrEventHandlerSP& spRemove : reqs) {
       FdrEventHandler* hdr = spRemove.get();
+      if (fon9_UNLIKELY(!this->IsFdrThreadOwner(hdr))) {
+         // 已轉移到其他 FdrThread, 由新的 FdrThread 處理.
+         hdr->RemoveFdrEvent();
+         continue;
+      }
       auto idx1 = hdr->GetFdrEventHandlerBookmark();
       if (fon9_UNLIKELY(idx1 <= 0))
          continue;
       if (!evHandlers.RemoveObj(idx1 - 1, hdr))
-         fon9_LOG_ERROR("FdrServiceEpoll.Remove|fd=", hdr->GetFD(), "|idx=", idx1, "|hdr=", ToPtr{hdr}, "|err=Not found");
+         fon9_LOGM_ERROR(LogModule_Io, "FdrServiceEpoll.Remove|fd=", hdr->GetFD(), "|idx=", idx1, "|hdr=", ToPtr{hdr}, "|err=Not found");
       if (fon9_UNLIKELY(epoll_ctl(epFdr, EPOLL_CTL_DEL, hdr->GetFD(), &evc) < 0)) {
          int eno = errno; // 必須先將 errno 取出, 否則進入 fon9_LOG_ERROR() 可能會破壞 errno 的值.
-         fon9_LOG_ERROR("FdrServiceEpoll.DEL|fd=", hdr->GetFD(), "|err=", GetSysErrC(eno));
+         fon9_LOGM_ERROR(LogModule_Io, "FdrServiceEpoll.DEL|fd=", hdr->GetFD(), "|err=", GetSysErrC(eno));
       }
-      // fon9_LOG_TRACE("FdrServiceEpoll.Remove|fd=", hdr->GetFD(), "|idx=", idx1, "|hdr=", ToPtr{hdr});
+      // fon9_LOGM_TRACE(LogModule_Io, "FdrServiceEpoll.Remove|fd=", hdr->GetFD(), "|idx=", idx1, "|hdr=", ToPtr{hdr});
       this->SetFdrEventHandlerBookmark(hdr, 0);
    }
+   this->ProcessPendingMigrates();
    reqs = this->MoveOutPendingImpl(this->PendingUpdates_);
    for (FdrEventHandlerSP& sp : reqs) {
       FdrEventHandler* hdr = sp.get();
+      if (fon9_UNLIKELY(!this->IsFdrThreadOwner(hdr))) {
+         hdr->UpdateFdrEvent();
+         continue;
+      }
       auto idx1 = hdr->GetFdrEventHandlerBookmark();
       int  op;
       FdrEventFlag evs = hdr->GetRequiredFdrEventFlag();
@@ -141,7 +239,17 @@ void FdrThreadEpoll::ProcessPendings(Fdr::fdr_t epFdr, EvHandlers& evHandlers) {
          EvHandler*  pEvObj = evHandlers.GetObjPtr(idx1 - 1);
          if (fon9_UNLIKELY(pEvObj == nullptr))
             continue;
-         if (pEvObj->get() != hdr || pEvObj->Events_ == evs)
+         if (pEvObj->get() != hdr)
+            continue;
+         if (this->IsEdgeTriggered_) {
+            // 加入時已註冊全部的事件, 不需要 epoll_ctl(MOD);
+            // 只需觸發「之前已發生, 但當時 handler 不需要」的事件.
+            // 即使 pEvObj->Events_ == evs 也要檢查: 可能是在處理 PendingUpdates_ 之前, 已關閉又重新啟用.
+            pEvObj->Events_ = evs;
+            this->EmitReady(*pEvObj);
+            continue;
+         }
+         if (pEvObj->Events_ == evs)
             continue;
          pEvObj->Events_ = evs;
          op = EPOLL_CTL_MOD;
@@ -154,19 +262,25 @@ void FdrThreadEpoll::ProcessPendings(Fdr::fdr_t epFdr, EvHandlers& evHandlers) {
          this->SetFdrEventHandlerBookmark(hdr, idx1 = evHandlers.Add(evh) + 1);
          op = EPOLL_CTL_ADD;
       }
-      // EPOLLET 有其他問題? 莫名的斷線: 收到 events=0x2019? 0x19 = EPOLLHUP(0x10) + EPOLLERR(0x08) + EPOLLIN(0x01)
-      evc.events = IsEnumContains(evs, FdrEventFlag::Readable)
-         ? (EPOLLIN | EPOLLPRI | EPOLLRDHUP)
-         : 0;
-      if (IsEnumContains(evs, FdrEventFlag::Writable))
-         evc.events |= EPOLLOUT;
+      // 早期嘗試 EPOLLET 時, 曾發生莫名的斷線: 收到 events=0x2019 = EPOLLRDHUP + EPOLLHUP + EPOLLERR + EPOLLIN;
+      // 推測原因: handler 沒有讀到 EAGAIN 就結束, 之後不會再有通知, 造成對方逾時斷線.
+      // 現在 edge-triggered 時, 由 Ready_ 保留 handler 當時不需要的事件, 並由 handler 透過 RetriggerFdrEvent() 告知尚未處理完.
+      if (this->IsEdgeTriggered_)
+         evc.events = EPOLLIN | EPOLLPRI | EPOLLRDHUP | EPOLLOUT | EPOLLET;
+      else {
+         evc.events = IsEnumContains(evs, FdrEventFlag::Readable)
+            ? (EPOLLIN | EPOLLPRI | EPOLLRDHUP)
+            : 0;
+         if (IsEnumContains(evs, FdrEventFlag::Writable))
+            evc.events |= EPOLLOUT;
+      }
       // if (IsEnumContains(evs, FdrEventFlag::Error))
       // 不論是否設定 FdrEventFlag::Error, 都要偵測錯誤事件.
          evc.events |= (EPOLLHUP | EPOLLERR);
       evc.data.ptr = hdr;
       if (epoll_ctl(epFdr, op, hdr->GetFD(), &evc) < 0) {
          int eno = errno; // 必須先將 errno 取出, 否則進入 fon9_LOG_ERROR() 可能會破壞 errno 的值.
-         fon9_LOG_ERROR(op == EPOLL_CTL_ADD
+         fon9_LOGM_ERROR(LogModule_Io, op == EPOLL_CTL_ADD
                         ? StrView{"FdrServiceEpoll.ADD|fd="}
                         : StrView{"FdrServiceEpoll.MOD|fd="},
                         hdr->GetFD(),
@@ -174,6 +288,24 @@ void FdrThreadEpoll::ProcessPendings(Fdr::fdr_t epFdr, EvHandlers& evHandlers) {
                         "|err=", GetSysErrC(eno));
       }
    }
+   if (this->IsEdgeTriggered_) {
+      PendingRetriggersImpl retriggers = std::move(*PendingRetriggers::Locker{this->PendingRetriggers_});
+      for (RetriggerReq& req : retriggers) {
+         FdrEventHandler* hdr = req.Handler_.get();
+         if (fon9_UNLIKELY(!this->IsFdrThreadOwner(hdr))) {
+            hdr->RetriggerFdrEvent(req.Events_);
+            continue;
+         }
+         auto idx1 = hdr->GetFdrEventHandlerBookmark();
+         if (fon9_UNLIKELY(idx1 <= 0))
+            continue;
+         EvHandler* pEvObj = evHandlers.GetObjPtr(idx1 - 1);
+         if (fon9_UNLIKELY(pEvObj == nullptr || pEvObj->get() != hdr))
+            continue;
+         pEvObj->Ready_ |= (req.Events_ & (FdrEventFlag::Readable | FdrEventFlag::Writable));
+         this->EmitReady(*pEvObj);
+      }
+   }
 }
 
 } } // namespaces
@@ -6,6 +6,8 @@
 #include "fon9/io/FdrService.hpp"
 #include "fon9/ObjPool.hpp"
 
+struct epoll_event;
+
 namespace fon9 { namespace io {
 
 struct FdrServiceEpoll {
@@ -15,19 +17,33 @@ struct FdrServiceEpoll {
 
 /// \ingroup io
 /// 提供使用 epoll 處理 non-blocking fd 讀寫事件服務.
+/// - 預設使用 level-triggered: 每次 handler 需要的事件改變(e.g. Writable 的啟用/關閉), 都需要 epoll_ctl(MOD).
+/// - IoServiceArgs::IsEdgeTriggered_ 時使用 EPOLLET:
+///   - 加入時就註冊全部的事件, 之後 handler 需要的事件改變, 不再呼叫 epoll_ctl(MOD).
+///   - 事件發生時若 handler 不需要, 則保留在 EvHandler::Ready_, 等到 handler 需要時再觸發.
+///   - handler 處理事件時, 必須讀寫到 EAGAIN, 否則需要呼叫 FdrEventHandler::RetriggerFdrEvent();
 class FdrThreadEpoll : public FdrThread {
    const FdrAuto  FdrEpoll_;
    struct EvHandler : public FdrEventHandlerSP {
       using FdrEventHandlerSP::FdrEventHandlerSP;
       FdrEventFlag  Events_{FdrEventFlag::None};
+      /// edge-triggered 時: 已發生, 但因為當時 handler 不需要, 而尚未觸發的事件.
+      FdrEventFlag  Ready_{FdrEventFlag::None};
    };
    using EvHandlers = ObjPool<EvHandler>;
+   /// 若 kernel 不支援 epoll_pwait2(), 則改用 epoll_wait() 的 ms 逾時.
+   bool  IsPwait2Supported_{true};
 
    void ProcessPendings(Fdr::fdr_t epFdr, EvHandlers& evHandlers);
+   /// edge-triggered: 觸發 evh.Ready_ 之中, handler 目前需要的事件.
+   void EmitReady(EvHandler& evh);
+   /// waitUS: <0 表示無限等候, 0 表示不等候;
+   /// >0 則優先使用 epoll_pwait2() 提供 us 精確度的逾時(e.g. SendBuffered 的合併送出), 若不支援則使用 epoll_wait() 的 ms 逾時.
+   int EpollWait(Fdr::fdr_t epFdr, struct epoll_event* events, int maxEvents, int64_t waitUS);
    virtual void ThrRunImpl(const ServiceThreadArgs& args) override;
 
 public:
-   FdrThreadEpoll(FdrServiceEpoll::MakeResult& res);
+   FdrThreadEpoll(const IoServiceArgs& ioArgs, FdrServiceEpoll::MakeResult& res);
 
    virtual ~FdrThreadEpoll();
 };
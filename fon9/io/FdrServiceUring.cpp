@@ -0,0 +1,662 @@
+﻿/// \file fon9/io/FdrServiceUring.cpp
+/// \author fonwinz@gmail.com
+#ifdef __linux__
+#include "fon9/io/FdrServiceUring.hpp"
+#include "fon9/LogModule.hpp"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define fon9_HAVE_IO_URING
+#endif
+#endif
+
+#ifdef fon9_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+namespace fon9 { namespace io {
+
+#ifndef fon9_HAVE_IO_URING
+FdrServiceSP FdrServiceUring::MakeService(const IoServiceArgs&, const std::string&, MakeResult& err) {
+   err = MakeResult{"io_uring", GetSysErrC(ENOSYS)};
+   return FdrServiceSP{};
+}
+#else
+FdrServiceSP FdrServiceUring::MakeService(const IoServiceArgs& ioArgs, const std::string& thrName, MakeResult& err) {
+   size_t thrCount = ioArgs.ThreadCount_;
+   if (thrCount <= 0)
+      thrCount = 1;
+   FdrService::FdrThreads thrs(thrCount);
+   for (size_t L = 0; L < thrCount; ++L) {
+      thrs[L].reset(new FdrThreadUring{ioArgs, err});
+      if (err.IsError())
+         return FdrServiceSP{};
+   }
+   thrs.shrink_to_fit();
+   return FdrServiceSP{new FdrService{std::move(thrs), ioArgs, thrName + ".uring"}};
+}
+
+//--------------------------------------------------------------------------//
+
+// user_data 的編碼: kWakeupUserData = WakeupFdr; kCancelUserData = ASYNC_CANCEL 的結果;
+// kTimeoutUserData = 延遲送出的 IORING_OP_TIMEOUT;
+// 其餘: ((index + 1) << 32) | kind | seq;
+// - kind = kUserDataPoll, kUserDataRecv: index = EvHandlers_ 的 index, seq = 送出時的序號.
+// - kind = kUserDataSend: index = SendReqs_ 的 index.
+static const uint64_t kWakeupUserData = 0;
+static const uint64_t kCancelUserData = ~static_cast<uint64_t>(0);
+static const uint64_t kTimeoutUserData = ~static_cast<uint64_t>(1);
+static const uint32_t kUserDataPoll = 0;
+static const uint32_t kUserDataRecv = 0x40000000;
+static const uint32_t kUserDataSend = 0x80000000;
+static const uint32_t kUserDataKindMask = 0xc0000000;
+static const uint32_t kUserDataSeqMask = ~kUserDataKindMask;
+
+static inline uint64_t MakeUserData(size_t idx, uint32_t kindSeq) {
+   return (static_cast<uint64_t>(idx + 1) << 32) | kindSeq;
+}
+static inline unsigned LoadAcquire(const unsigned* p) {
+   return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void StoreRelease(unsigned* p, unsigned v) {
+   __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+FdrThreadUring::Ring::~Ring() {
+   if (this->Sqes_)
+      munmap(this->Sqes_, this->SqesSize_);
+   if (this->CqRingPtr_ && this->CqRingPtr_ != this->SqRingPtr_)
+      munmap(this->CqRingPtr_, this->CqRingSize_);
+   if (this->SqRingPtr_)
+      munmap(this->SqRingPtr_, this->SqRingSize_);
+   if (this->RingFd_ >= 0)
+      close(this->RingFd_);
+}
+int FdrThreadUring::Ring::Setup(unsigned entries) {
+   struct io_uring_params params;
+   ZeroStruct(params);
+   int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+   if (fd < 0)
+      return errno;
+   this->RingFd_ = fd;
+   // 需要 NODROP: 當 CQ 滿了, kernel 仍會保留完成事件, 避免遺失 poll 的結果.
+   if ((params.features & IORING_FEAT_NODROP) == 0)
+      return ENOSYS;
+
+   this->SqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+   this->CqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+   const bool isSingleMmap = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+   if (isSingleMmap) {
+      if (this->CqRingSize_ > this->SqRingSize_)
+         this->SqRingSize_ = this->CqRingSize_;
+      this->CqRingSize_ = this->SqRingSize_;
+   }
+   void* ptr = mmap(nullptr, this->SqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+   if (ptr == MAP_FAILED)
+      return errno;
+   this->SqRingPtr_ = ptr;
+   if (isSingleMmap)
+      this->CqRingPtr_ = ptr;
+   else {
+      ptr = mmap(nullptr, this->CqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (ptr == MAP_FAILED)
+         return errno;
+      this->CqRingPtr_ = ptr;
+   }
+   this->SqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+   ptr = mmap(nullptr, this->SqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+   if (ptr == MAP_FAILED)
+      return errno;
+   this->Sqes_ = static_cast<struct io_uring_sqe*>(ptr);
+
+   char* sq = static_cast<char*>(this->SqRingPtr_);
+   this->SqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+   this->SqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+   this->SqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+   this->SqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+   this->SqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+   this->SqLocalTail_ = *this->SqTail_;
+
+   char* cq = static_cast<char*>(this->CqRingPtr_);
+   this->CqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+   this->CqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+   this->CqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+   this->Cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+   return 0;
+}
+struct io_uring_sqe* FdrThreadUring::Ring::GetSqe() {
+   if (fon9_UNLIKELY(this->SqLocalTail_ - LoadAcquire(this->SqHead_) >= this->SqEntries_)) {
+      this->Submit(0);
+      if (this->SqLocalTail_ - LoadAcquire(this->SqHead_) >= this->SqEntries_)
+         return nullptr;
+   }
+   const unsigned idx = this->SqLocalTail_ & this->SqMask_;
+   this->SqArray_[idx] = idx;
+   ++this->SqLocalTail_;
+   ++this->ToSubmit_;
+   struct io_uring_sqe* sqe = this->Sqes_ + idx;
+   memset(sqe, 0, sizeof(*sqe));
+   return sqe;
+}
+int FdrThreadUring::Ring::Submit(unsigned minComplete) {
+   StoreRelease(this->SqTail_, this->SqLocalTail_);
+   int res = static_cast<int>(syscall(__NR_io_uring_enter, this->RingFd_, this->ToSubmit_, minComplete, IORING_ENTER_GETEVENTS, nullptr, 0));
+   if (fon9_UNLIKELY(res < 0))
+      return -errno;
+   if (static_cast<unsigned>(res) < this->ToSubmit_)
+      this->ToSubmit_ -= static_cast<unsigned>(res);
+   else
+      this->ToSubmit_ = 0;
+   return res;
+}
+
+//--------------------------------------------------------------------------//
+
+FdrThreadUring::RxBufRing::~RxBufRing() {
+   if (this->Bufs_)
+      munmap(this->Bufs_, static_cast<size_t>(kBufCount) * kBufSize);
+   if (this->BufRing_)
+      munmap(this->BufRing_, this->BufRingSize_);
+}
+int FdrThreadUring::RxBufRing::Setup(int ringFd) {
+   static_assert((kBufCount & (kBufCount - 1)) == 0, "RxBufRing::kBufCount must be a power of 2.");
+   this->BufRingSize_ = kBufCount * sizeof(struct io_uring_buf);
+   // ring 的位置必須對齊 page, 所以使用 mmap() 配置.
+   void* ptr = mmap(nullptr, this->BufRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED)
+      return errno;
+   this->BufRing_ = static_cast<struct io_uring_buf_ring*>(ptr);
+   ptr = mmap(nullptr, static_cast<size_t>(kBufCount) * kBufSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (ptr == MAP_FAILED)
+      return errno;
+   this->Bufs_ = static_cast<char*>(ptr);
+
+   struct io_uring_buf_reg reg;
+   ZeroStruct(reg);
+   reg.ring_addr = reinterpret_cast<uintptr_t>(this->BufRing_);
+   reg.ring_entries = kBufCount;
+   reg.bgid = kGroupId;
+   if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+      return errno;
+   for (unsigned bid = 0; bid < kBufCount; ++bid)
+      this->Recycle(bid);
+   this->Publish();
+   return 0;
+}
+void FdrThreadUring::RxBufRing::Recycle(unsigned bid) {
+   // 在 C++ 裡面, <linux/io_uring.h> 的 __DECLARE_FLEX_ARRAY() 會讓 bufs 的位置變成 offset 8(空的 struct 大小為 1),
+   // 與 kernel 認定的 offset 0 不同, 所以不能使用 this->BufRing_->bufs[], 必須從 ring 的開頭計算.
+   struct io_uring_buf& buf = reinterpret_cast<struct io_uring_buf*>(static_cast<void*>(this->BufRing_))[this->Tail_ & (kBufCount - 1)];
+   buf.addr = reinterpret_cast<uintptr_t>(this->GetBuf(bid));
+   buf.len = kBufSize;
+   buf.bid = static_cast<uint16_t>(bid);
+   ++this->Tail_;
+   this->IsTailChanged_ = true;
+}
+void FdrThreadUring::RxBufRing::Publish() {
+   __atomic_store_n(&this->BufRing_->tail, this->Tail_, __ATOMIC_RELEASE);
+   this->IsTailChanged_ = false;
+}
+
+//--------------------------------------------------------------------------//
+
+FdrThreadUring::FdrThreadUring(const IoServiceArgs& ioArgs, FdrServiceUring::MakeResult& res)
+   : EvHandlers_{ioArgs.Capacity_}
+   , SendReqs_{ioArgs.Capacity_} {
+   using Result = FdrServiceUring::MakeResult;
+   // SQ 滿了會先送出, 所以 SQ 不用與 Capacity 一樣大;
+   // 但若太小, 則大量異動時會增加 io_uring_enter() 的次數.
+   unsigned entries = static_cast<unsigned>(ioArgs.Capacity_ > 0 ? ioArgs.Capacity_ : 128u);
+   if (entries < 64)
+      entries = 64;
+   else if (entries > 4096)
+      entries = 4096;
+   if (int eno = this->Ring_.Setup(entries)) {
+      res = Result{"io_uring_setup", GetSysErrC(eno)};
+      return;
+   }
+   FdrNotify::Result resEvFd = this->WakeupFdr_.Open();
+   if (resEvFd.IsError()) {
+      res = Result{"WakeupFdr.Open", resEvFd.GetError()};
+      return;
+   }
+   this->IsSendSubmittable_ = true;
+   // 不支援 provided buffer ring(Linux 5.19 之前), 則 Readable 仍使用 POLL_ADD.
+   if (int eno = this->RxBufs_.Setup(this->Ring_.RingFd_))
+      fon9_LOGM_WARN(LogModule_Io, "FdrThreadUring.RxBufRing|err=", GetSysErrC(eno));
+   else
+      this->IsRxCompletionEnabled_ = true;
+}
+FdrThreadUring::~FdrThreadUring() {
+}
+
+//--------------------------------------------------------------------------//
+
+uint32_t FdrThreadUring::NextSeq() {
+   if (fon9_UNLIKELY((this->ArmSeqNo_ = (this->ArmSeqNo_ + 1) & kUserDataSeqMask) == 0))
+      this->ArmSeqNo_ = 1;
+   return this->ArmSeqNo_;
+}
+void FdrThreadUring::ArmWakeup() {
+   if (struct io_uring_sqe* sqe = this->Ring_.GetSqe()) {
+      sqe->opcode = IORING_OP_POLL_ADD;
+      sqe->fd = this->WakeupFdr_.GetReadFD();
+      sqe->poll32_events = POLLIN;
+      sqe->user_data = kWakeupUserData;
+      this->IsWakeupArmed_ = true;
+   }
+}
+void FdrThreadUring::ArmTimeout(int64_t us) {
+   static_assert(sizeof(TimeoutSpec) == sizeof(struct __kernel_timespec), "TimeoutSpec != __kernel_timespec");
+   const DelayedClock::time_point deadline = DelayedClock::now() + std::chrono::microseconds{us};
+   // 已有更早(或相同)到期的 timeout, 則不用再送出.
+   if (this->TimeoutDeadline_ <= deadline)
+      return;
+   if (struct io_uring_sqe* sqe = this->Ring_.GetSqe()) {
+      this->TimeoutSpec_.Sec_ = us / 1000000;
+      this->TimeoutSpec_.NSec_ = (us % 1000000) * 1000;
+      sqe->opcode = IORING_OP_TIMEOUT;
+      sqe->fd = -1;
+      sqe->addr = reinterpret_cast<uintptr_t>(&this->TimeoutSpec_);
+      sqe->len = 1;
+      sqe->off = 0; // 不等候 cqe 數量, 只等候時間.
+      sqe->user_data = kTimeoutUserData;
+      this->TimeoutDeadline_ = deadline;
+   }
+}
+void FdrThreadUring::ArmHandler(size_t idx, EvHandler& evh) {
+   FdrEventFlag pollEvs = evh.Events_;
+   if (evh.IsRxCompletion_) {
+      if (fon9_UNLIKELY(evh.IsRxHeld()) && IsEnumContains(pollEvs, FdrEventFlag::Readable)) {
+         this->EmitRxHeld(evh);
+         // 觸發事件後, handler 需要的事件可能已改變.
+         pollEvs = evh.Events_ = evh->GetRequiredFdrEventFlag();
+      }
+      if (IsEnumContains(pollEvs, FdrEventFlag::Readable)) {
+         pollEvs -= FdrEventFlag::Readable;
+         // 若正在取消, 則在收到 recv 的最後一個 cqe 之後, 透過 RearmList_ 重新 arm.
+         if (evh.RecvSeq_ == 0 && !evh.IsRxEnd_)
+            this->ArmRecv(idx, evh);
+      }
+      else if (evh.RecvSeq_ != 0 && !evh.IsRecvCanceling_) {
+         // 暫時不需要 Readable: 取消 recv, 讓資料留在 kernel, 保留 TCP 的流量控制.
+         this->CancelReq(MakeUserData(idx, kUserDataRecv | evh.RecvSeq_));
+         evh.IsRecvCanceling_ = true;
+      }
+   }
+   if (evh.PollSeq_ != 0) {
+      if (evh.PollEvents_ == pollEvs)
+         return;
+      this->CancelReq(MakeUserData(idx, kUserDataPoll | evh.PollSeq_));
+      // 即使 ASYNC_CANCEL 無法送出, 舊的 poll 結果也會因為 PollSeq_ 不符而被拋棄.
+      evh.PollSeq_ = 0;
+   }
+   if ((evh.PollEvents_ = pollEvs) != FdrEventFlag::None)
+      this->ArmPoll(idx, evh);
+}
+void FdrThreadUring::ArmPoll(size_t idx, EvHandler& evh) {
+   struct io_uring_sqe* sqe = this->Ring_.GetSqe();
+   if (fon9_UNLIKELY(sqe == nullptr)) {
+      // SQ 已滿, 且 io_uring_enter() 無法送出(例: CQ overflow 的 EBUSY), 下次事件迴圈再試.
+      this->RearmList_.push_back(idx);
+      return;
+   }
+   uint32_t pollEvents = (IsEnumContains(evh.PollEvents_, FdrEventFlag::Readable)
+                          ? static_cast<uint32_t>(POLLIN | POLLPRI | POLLRDHUP)
+                          : 0u);
+   if (IsEnumContains(evh.PollEvents_, FdrEventFlag::Writable))
+      pollEvents |= POLLOUT;
+   // 不論是否設定 FdrEventFlag::Error, 都要偵測錯誤事件.
+   pollEvents |= (POLLHUP | POLLERR);
+   sqe->opcode = IORING_OP_POLL_ADD;
+   sqe->fd = evh->GetFD();
+   sqe->poll32_events = pollEvents;
+   evh.PollSeq_ = this->NextSeq();
+   sqe->user_data = MakeUserData(idx, kUserDataPoll | evh.PollSeq_);
+}
+void FdrThreadUring::ArmRecv(size_t idx, EvHandler& evh) {
+   struct io_uring_sqe* sqe = this->Ring_.GetSqe();
+   if (fon9_UNLIKELY(sqe == nullptr)) {
+      this->RearmList_.push_back(idx);
+      return;
+   }
+   sqe->opcode = IORING_OP_RECV;
+   sqe->fd = evh->GetFD();
+   sqe->flags = IOSQE_BUFFER_SELECT;
+   sqe->ioprio = IORING_RECV_MULTISHOT;
+   sqe->buf_group = RxBufRing::kGroupId;
+   evh.RecvSeq_ = this->NextSeq();
+   evh.IsRecvCanceling_ = false;
+   sqe->user_data = MakeUserData(idx, kUserDataRecv | evh.RecvSeq_);
+}
+void FdrThreadUring::CancelReq(uint64_t userData) {
+   if (struct io_uring_sqe* sqe = this->Ring_.GetSqe()) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = userData;
+      sqe->user_data = kCancelUserData;
+   }
+}
+bool FdrThreadUring::SubmitSend(FdrEventHandler* handler, const struct msghdr& msg) {
+   assert(this->IsThisThread());
+   struct io_uring_sqe* sqe = this->Ring_.GetSqe();
+   if (fon9_UNLIKELY(sqe == nullptr))
+      return false;
+   const size_t ireq = this->SendReqs_.Add(FdrEventHandlerSP{handler});
+   sqe->opcode = IORING_OP_SENDMSG;
+   sqe->fd = handler->GetFD();
+   sqe->addr = reinterpret_cast<uintptr_t>(&msg);
+   sqe->len = 1;
+   sqe->msg_flags = MSG_NOSIGNAL;
+   sqe->user_data = MakeUserData(ireq, kUserDataSend);
+   const auto idx1 = handler->GetFdrEventHandlerBookmark();
+   if (idx1 > 0) {
+      EvHandler* evh = this->EvHandlers_.GetObjPtr(idx1 - 1);
+      if (evh && evh->get() == handler)
+         evh->SendReq1_ = ireq + 1;
+   }
+   return true;
+}
+void FdrThreadUring::EmitRxHeld(EvHandler& evh) {
+   std::string held;
+   held.swap(evh.RxHeld_);
+   if (!held.empty()) {
+      FdrRxCompleted rx{held.data(), held.size(), 0};
+      this->OnFdrEvent_EmitRx(rx, evh.get());
+      if (evh.RxHeldEnd_ != 0 && !IsEnumContains(evh->GetRequiredFdrEventFlag(), FdrEventFlag::Readable))
+         return; // handler 又暫停接收, 結束狀態繼續保留.
+   }
+   if (const int end = evh.RxHeldEnd_) {
+      evh.RxHeldEnd_ = 0;
+      evh.IsRxEnd_ = true;
+      FdrRxCompleted rx{nullptr, 0, end < 0 ? 0 : end};
+      this->OnFdrEvent_EmitRx(rx, evh.get());
+   }
+}
+
+//--------------------------------------------------------------------------//
+
+void FdrThreadUring::ThrRunImpl(const ServiceThreadArgs& args) {
+   const unsigned kMinComplete = (IsBlockWait(args.HowWait_) ? 1u : 0u);
+   this->ArmWakeup();
+   while (this->use_count() > 0) {
+      // 與 FdrThreadEpoll 相同: 再次等候事件之前, 必須先將 Pending Removes, Updates 處理完.
+      unsigned minComplete = kMinComplete;
+      if (fon9_UNLIKELY(this->WakeupRequests_.load(std::memory_order_relaxed) != 0)) {
+         this->ClearWakeup();
+         this->ProcessPendings();
+         if (this->WakeupRequests_.load(std::memory_order_relaxed) != 0)
+            minComplete = 0;
+      }
+      // 必須在 ClearWakeup() 之後才 arm, 否則會立即觸發.
+      if (!this->IsWakeupArmed_)
+         this->ArmWakeup();
+      if (!this->RearmList_.empty())
+         this->ProcessRearms();
+      if (fon9_UNLIKELY(!this->DelayedSends_.empty())) {
+         const int64_t us = this->CheckDelayedSends();
+         if (us == 0)
+            minComplete = 0;
+         else if (us > 0 && minComplete != 0)
+            this->ArmTimeout(us);
+      }
+      // 送出 SQ(包含這一輪產生的 IORING_OP_SENDMSG) 並等候事件: 只需要一次 syscall.
+      // 非 Block 模式也必須進入 kernel(minComplete=0), 因為 poll 的完成事件可能需要在 io_uring_enter() 時才會放入 CQ.
+      const int submitted = this->Ring_.Submit(minComplete);
+      if (fon9_UNLIKELY(submitted < 0)) {
+         // EBUSY: CQ overflow, 取出 cqe 之後再送.
+         int eno = ErrorCannotRetry(-submitted);
+         if (eno && eno != EBUSY)
+            fon9_LOGM_FATAL(LogModule_Io, "FdrThreadUring.ThrRun|fn=io_uring_enter|err=", GetSysErrC(eno));
+      }
+      unsigned       head = *this->Ring_.CqHead_;
+      const unsigned tail = LoadAcquire(this->Ring_.CqTail_);
+      if (fon9_LIKELY(head != tail)) {
+         for (; head != tail; ++head) {
+            const struct io_uring_cqe cqe = this->Ring_.Cqes_[head & this->Ring_.CqMask_];
+            StoreRelease(this->Ring_.CqHead_, head + 1);
+            this->OnCqe(cqe);
+         }
+         // 一次將這批 cqe 用完的 buffer 還給 kernel.
+         if (this->RxBufs_.IsTailChanged_)
+            this->RxBufs_.Publish();
+      }
+      else if (args.HowWait_ == HowWait::Yield)
+         std::this_thread::yield();
+   }
+}
+void FdrThreadUring::OnCqe(const struct io_uring_cqe& cqe) {
+   const uint64_t userData = cqe.user_data;
+   if (fon9_UNLIKELY(userData == kWakeupUserData)) {
+      this->IsWakeupArmed_ = false;
+      this->WakeupRequests_.store(1, std::memory_order_relaxed);
+      if (fon9_UNLIKELY(cqe.res < 0 && cqe.res != -ECANCELED))
+         fon9_LOGM_ERROR(LogModule_Io, "FdrThreadUring.Wakeup|err=", GetSysErrC(-cqe.res));
+      return;
+   }
+   if (userData == kCancelUserData)
+      return;
+   if (userData == kTimeoutUserData) {
+      // 較早送出的 timeout 已到期(-ETIME), 之後等候事件前, 會透過 CheckDelayedSends() 處理.
+      if (this->TimeoutDeadline_ <= DelayedClock::now())
+         this->TimeoutDeadline_ = DelayedClock::time_point::max();
+      return;
+   }
+   const size_t   idx = static_cast<size_t>(userData >> 32) - 1;
+   const uint32_t kindSeq = static_cast<uint32_t>(userData);
+   switch (kindSeq & kUserDataKindMask) {
+   case kUserDataRecv:
+      this->OnRecvCqe(idx, kindSeq & kUserDataSeqMask, cqe);
+      break;
+   case kUserDataSend:
+      this->OnSendCqe(idx, cqe.res);
+      break;
+   default:
+      this->OnPollCqe(idx, kindSeq & kUserDataSeqMask, cqe.res);
+      break;
+   }
+}
+void FdrThreadUring::OnPollCqe(size_t idx, uint32_t seq, int32_t res) {
+   EvHandler* evh = this->EvHandlers_.GetObjPtr(idx);
+   // 已取消, 已移除, 或已重新 arm: 拋棄過期的結果.
+   if (evh == nullptr || evh->PollSeq_ != seq)
+      return;
+   evh->PollSeq_ = 0;
+   FdrEventHandler* hdr = evh->get();
+   if (fon9_UNLIKELY(hdr == nullptr || hdr->GetFdrEventHandlerBookmark() <= 0))
+      return;
+   FdrEventFlag evs;
+   if (fon9_LIKELY(res >= 0)) {
+      const uint32_t revents = static_cast<uint32_t>(res);
+      evs = (revents & POLLOUT) ? FdrEventFlag::Writable : FdrEventFlag::None;
+      if (revents & (POLLIN | POLLPRI | POLLRDHUP))
+         evs |= FdrEventFlag::Readable;
+      if (fon9_UNLIKELY(revents & (POLLHUP | POLLERR | POLLNVAL))) {
+         if ((revents & (POLLHUP | POLLNVAL)) || !this->OnFdrEvent_ErrQueue(hdr))
+            evs |= FdrEventFlag::Error;
+      }
+   }
+   else if (res == -ECANCELED)
+      return;
+   else {
+      fon9_LOGM_ERROR(LogModule_Io, "FdrThreadUring.Poll|fd=", hdr->GetFD(), "|err=", GetSysErrC(-res));
+      evs = FdrEventFlag::Error;
+   }
+   if (fon9_UNLIKELY(IsEnumContains(evs, FdrEventFlag::Error)))
+      // 避免 hdr 處理 error 期間, 這裡會一直觸發 error, 所以一旦 error, 就移除 handler.
+      hdr->RemoveFdrEvent();
+   else // one-shot poll: 事件處理完畢後, 在下次等候事件前重新 arm.
+      this->RearmList_.push_back(idx);
+   if (fon9_LIKELY(evs != FdrEventFlag::None))
+      this->OnFdrEvent_Emit(evs, hdr);
+}
+void FdrThreadUring::OnRecvCqe(size_t idx, uint32_t seq, const struct io_uring_cqe& cqe) {
+   const bool        hasBuf = ((cqe.flags & IORING_CQE_F_BUFFER) != 0);
+   const unsigned    bid = (cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+   const int32_t     res = cqe.res;
+   EvHandler*        evh = this->EvHandlers_.GetObjPtr(idx);
+   FdrEventHandler*  hdr;
+   // 已移除: 拋棄過期的結果.
+   if (evh == nullptr || evh->RecvSeq_ != seq)
+      goto __RECYCLE_BUF;
+   if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+      // multishot recv 已結束(例: 已取消, 沒有可用的 buffer, 錯誤, 對方已關閉),
+      // 若仍需要 Readable, 則透過 ProcessRearms() 重新 arm.
+      evh->RecvSeq_ = 0;
+      evh->IsRecvCanceling_ = false;
+      if (res > 0 || res == -ENOBUFS || res == -ECANCELED)
+         this->RearmList_.push_back(idx);
+   }
+   hdr = evh->get();
+   if (fon9_UNLIKELY(hdr == nullptr || hdr->GetFdrEventHandlerBookmark() != idx + 1))
+      goto __RECYCLE_BUF;
+   if (fon9_UNLIKELY(res < 0)) {
+      switch (res) {
+      case -ENOBUFS: // provided buffer 用完了, 在 ThrRunImpl() 歸還 buffer 之後重新 arm.
+      case -ECANCELED:
+         goto __RECYCLE_BUF;
+      case -EINVAL:
+         // 不支援 multishot recv(Linux 6.0 之前), 改用 POLL_ADD.
+         if (this->IsRxCompletionEnabled_) {
+            this->IsRxCompletionEnabled_ = false;
+            fon9_LOGM_WARN(LogModule_Io, "FdrThreadUring.RecvMultishot|err=", GetSysErrC(EINVAL));
+         }
+         evh->IsRxCompletion_ = false;
+         this->RearmList_.push_back(idx);
+         goto __RECYCLE_BUF;
+      }
+   }
+   if (fon9_LIKELY(!evh->IsRxHeld() && IsEnumContains(hdr->GetRequiredFdrEventFlag(), FdrEventFlag::Readable))) {
+      FdrRxCompleted rx{hasBuf ? this->RxBufs_.GetBuf(bid) : nullptr,
+                        res > 0 ? static_cast<size_t>(res) : 0u,
+                        res < 0 ? -res : 0};
+      if (res <= 0)
+         evh->IsRxEnd_ = true;
+      // 觸發事件期間, 不會改變 EvHandlers_, 所以 evh 仍然有效.
+      this->OnFdrEvent_EmitRx(rx, hdr);
+   }
+   else if (res > 0) // handler 暫時不需要 Readable, 先保留, 等 handler 再次需要時觸發.
+      evh->RxHeld_.append(this->RxBufs_.GetBuf(bid), static_cast<size_t>(res));
+   else
+      evh->RxHeldEnd_ = (res == 0 ? -1 : -res);
+
+__RECYCLE_BUF:
+   if (hasBuf)
+      this->RxBufs_.Recycle(bid);
+}
+void FdrThreadUring::OnSendCqe(size_t ireq, int32_t res) {
+   FdrEventHandlerSP* preq = this->SendReqs_.GetObjPtr(ireq);
+   if (fon9_UNLIKELY(preq == nullptr || !*preq))
+      return;
+   FdrEventHandlerSP hdr{std::move(*preq)};
+   this->SendReqs_.RemoveObjPtr(ireq, nullptr);
+   const auto  idx1 = hdr->GetFdrEventHandlerBookmark();
+   EvHandler*  evh = (idx1 > 0 ? this->EvHandlers_.GetObjPtr(idx1 - 1) : nullptr);
+   if (evh && evh->get() == hdr.get()) {
+      if (evh->SendReq1_ == ireq + 1)
+         evh->SendReq1_ = 0;
+   }
+   else
+      evh = nullptr;
+   if (!this->OnFdrEvent_SendDone(res, hdr.get()))
+      return;
+   if (fon9_LIKELY(evh && this->IsFdrThreadOwner(hdr.get())))
+      this->OnFdrEvent_Emit(FdrEventFlag::Writable, hdr.get());
+   else // 已轉移到其他 FdrThread, 或已不在 EvHandlers_: 由 handler 的 FdrThread 繼續送出.
+      hdr->StartSendInFdrThread();
+}
+void FdrThreadUring::ProcessRearms() {
+   std::vector<size_t> rearms;
+   rearms.swap(this->RearmList_);
+   for (size_t idx : rearms) {
+      EvHandler* evh = this->EvHandlers_.GetObjPtr(idx);
+      if (evh == nullptr)
+         continue;
+      FdrEventHandler* hdr = evh->get();
+      if (hdr == nullptr || hdr->GetFdrEventHandlerBookmark() != idx + 1)
+         continue;
+      // 使用 hdr 現在需要的事件, 若有 PendingUpdates_ 則會在 ProcessPendings() 時發現已相同而略過.
+      evh->Events_ = hdr->GetRequiredFdrEventFlag();
+      this->ArmHandler(idx, *evh);
+   }
+   if (this->RearmList_.empty()) { // 保留 rearms 的 capacity, 避免每次重新配置.
+      rearms.clear();
+      this->RearmList_.swap(rearms);
+   }
+}
+bool FdrThreadUring::IsFdrHandlerIdle(const FdrEventHandler* handler) {
+   auto idx1 = handler->GetFdrEventHandlerBookmark();
+   if (idx1 > 0) {
+      // 進行中的 recv, sendmsg 在移除時會被取消, 之後的結果會被丟棄; 保留中的 rx 也尚未交給 handler.
+      const EvHandler* evh = this->EvHandlers_.GetObjPtr(idx1 - 1);
+      if (evh && evh->get() == handler && (evh->RecvSeq_ != 0 || evh->SendReq1_ != 0 || evh->IsRxHeld()))
+         return false;
+   }
+   return FdrThread::IsFdrHandlerIdle(handler);
+}
+void FdrThreadUring::ProcessPendings() {
+   this->ProcessPendingSends();
+   this->PrepareMigrates();
+
+   PendingReqsImpl reqs = this->MoveOutPendingImpl(this->PendingRemoves_);
+   for (FdrEventHandlerSP& spRemove : reqs) {
+      FdrEventHandler* hdr = spRemove.get();
+      if (fon9_UNLIKELY(!this->IsFdrThreadOwner(hdr))) {
+         // 已轉移到其他 FdrThread, 由新的 FdrThread 處理.
+         hdr->RemoveFdrEvent();
+         continue;
+      }
+      auto idx1 = hdr->GetFdrEventHandlerBookmark();
+      if (fon9_UNLIKELY(idx1 <= 0))
+         continue;
+      EvHandler* evh = this->EvHandlers_.GetObjPtr(idx1 - 1);
+      if (evh && evh->get() == hdr) {
+         if (evh->PollSeq_ != 0)
+            this->CancelReq(MakeUserData(idx1 - 1, kUserDataPoll | evh->PollSeq_));
+         if (evh->RecvSeq_ != 0 && !evh->IsRecvCanceling_)
+            this->CancelReq(MakeUserData(idx1 - 1, kUserDataRecv | evh->RecvSeq_));
+         // 送出中的資料仍在 handler 的送出緩衝, 取消後由 OnSendCqe() 決定是否繼續送出.
+         if (evh->SendReq1_ != 0)
+            this->CancelReq(MakeUserData(evh->SendReq1_ - 1, kUserDataSend));
+      }
+      if (!this->EvHandlers_.RemoveObj(idx1 - 1, hdr))
+         fon9_LOGM_ERROR(LogModule_Io, "FdrServiceUring.Remove|fd=", hdr->GetFD(), "|idx=", idx1, "|hdr=", ToPtr{hdr}, "|err=Not found");
+      this->SetFdrEventHandlerBookmark(hdr, 0);
+   }
+   this->ProcessPendingMigrates();
+   reqs = this->MoveOutPendingImpl(this->PendingUpdates_);
+   for (FdrEventHandlerSP& sp : reqs) {
+      FdrEventHandler* hdr = sp.get();
+      if (fon9_UNLIKELY(!this->IsFdrThreadOwner(hdr))) {
+         hdr->UpdateFdrEvent();
+         continue;
+      }
+      auto idx1 = hdr->GetFdrEventHandlerBookmark();
+      FdrEventFlag evs = hdr->GetRequiredFdrEventFlag();
+      EvHandler*   pEvObj;
+      if (fon9_LIKELY(idx1 > 0)) {
+         pEvObj = this->EvHandlers_.GetObjPtr(idx1 - 1);
+         if (fon9_UNLIKELY(pEvObj == nullptr))
+            continue;
+         if (pEvObj->get() != hdr || (pEvObj->Events_ == evs && !pEvObj->IsRxHeld()))
+            continue;
+      }
+      else {
+         if (fon9_UNLIKELY(evs == FdrEventFlag::None))
+            continue;
+         this->SetFdrEventHandlerBookmark(hdr, idx1 = this->EvHandlers_.Add(EvHandler{hdr}) + 1);
+         pEvObj = this->EvHandlers_.GetObjPtr(idx1 - 1);
+         pEvObj->IsRxCompletion_ = (this->IsRxCompletionEnabled_ && this->IsFdrRxCompletionAllowed(hdr));
+      }
+      pEvObj->Events_ = evs;
+      this->ArmHandler(idx1 - 1, *pEvObj);
+   }
+}
+#endif//fon9_HAVE_IO_URING
+
+} } // namespaces
+#endif//__linux__
@@ -0,0 +1,171 @@
+﻿/// \file fon9/io/FdrServiceUring.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_io_FdrServiceUring_hpp__
+#define __fon9_io_FdrServiceUring_hpp__
+#ifdef __linux__
+#include "fon9/io/FdrService.hpp"
+#include "fon9/ObjPool.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace fon9 { namespace io {
+
+struct FdrServiceUring {
+   using MakeResult = Result2;
+   /// 若系統不支援 io_uring, 則 err = ENOSYS 或 io_uring_setup() 的失敗原因, 並返回 nullptr.
+   static FdrServiceSP MakeService(const IoServiceArgs& ioArgs, const std::string& thrName, MakeResult& err);
+};
+
+/// \ingroup io
+/// 使用 io_uring 處理 non-blocking fd 讀寫事件服務.
+/// - 一般的 FdrEventHandler: 使用 IORING_OP_POLL_ADD(one-shot) 提供 readiness 通知, 事件觸發後再重新 arm,
+///   因此與 epoll(level-triggered) 的行為相同.
+/// - handler->IsFdrRxCompletionAllowed() 的 Readable(例: FdrSocket 的 TCP 連線):
+///   使用 multishot IORING_OP_RECV, 從 provided buffer ring(IORING_REGISTER_PBUF_RING) 取得緩衝區,
+///   一次 arm 可持續收到資料, 不用每次 readable 之後再 readv(); 收到的資料透過 FdrEventHandler::GetFdrRxCompleted() 提供.
+///   若 handler 暫時不需要 Readable, 則取消 recv, 取消前已收到的資料會先保留, 等到 handler 再次需要 Readable 時觸發.
+/// - 在 fdr thread 的送出(FdrEventHandler::SubmitFdrSend()): 使用 IORING_OP_SENDMSG,
+///   同一輪事件處理產生的全部送出要求, 會與 wait 一併透過「一次」io_uring_enter() 送出.
+/// - 事件的 [新增、修改、移除、重新arm] 都只是放入 SQ, 在下次等候事件時, 與 wait 一併透過「一次」io_uring_enter() 送出;
+///   相較於 epoll 每次異動都需要呼叫 epoll_ctl(), 可大幅減少 syscall 次數.
+/// - 若系統不支援 provided buffer ring 或 multishot recv, 則 Readable 仍使用 POLL_ADD.
+class FdrThreadUring : public FdrThread {
+   fon9_NON_COPY_NON_MOVE(FdrThreadUring);
+
+   struct EvHandler : public FdrEventHandlerSP {
+      using FdrEventHandlerSP::FdrEventHandlerSP;
+      /// handler 需要的事件.
+      FdrEventFlag   Events_{FdrEventFlag::None};
+      /// 已送出的 POLL_ADD 偵測的事件, 若使用 multishot recv, 則不包含 Readable.
+      FdrEventFlag   PollEvents_{FdrEventFlag::None};
+      /// 0 表示沒有已送出的 POLL_ADD; 否則為送出時的序號, 用來排除「已取消或過期」的 cqe.
+      uint32_t       PollSeq_{0};
+      /// 0 表示沒有進行中的 multishot recv; 否則為送出時的序號.
+      uint32_t       RecvSeq_{0};
+      /// 進行中的 IORING_OP_SENDMSG 在 SendReqs_ 的 index + 1, 移除 handler 時用來取消.
+      size_t         SendReq1_{0};
+      /// IsRxCompletionEnabled_ && handler->IsFdrRxCompletionAllowed();
+      bool           IsRxCompletion_{false};
+      /// 已送出取消 recv 的要求, 等候 recv 的最後一個 cqe.
+      bool           IsRecvCanceling_{false};
+      /// 已觸發對方關閉(或錯誤), 不用再 arm recv.
+      bool           IsRxEnd_{false};
+      /// 保留的結束狀態: 0=無; <0: 對方已關閉; >0: errno.
+      int            RxHeldEnd_{0};
+      /// handler 暫時不需要 Readable 時收到的資料.
+      std::string    RxHeld_;
+
+      bool IsRxHeld() const {
+         return !this->RxHeld_.empty() || this->RxHeldEnd_ != 0;
+      }
+   };
+   using EvHandlers = ObjPool<EvHandler>;
+
+   struct Ring {
+      fon9_NON_COPY_NON_MOVE(Ring);
+      Ring() = default;
+      ~Ring();
+      int               RingFd_{-1};
+      void*             SqRingPtr_{nullptr};
+      size_t            SqRingSize_{0};
+      void*             CqRingPtr_{nullptr};
+      size_t            CqRingSize_{0};
+      io_uring_sqe*     Sqes_{nullptr};
+      size_t            SqesSize_{0};
+      unsigned*         SqHead_;
+      unsigned*         SqTail_;
+      unsigned          SqMask_;
+      unsigned          SqEntries_;
+      unsigned*         SqArray_;
+      unsigned*         CqHead_;
+      unsigned*         CqTail_;
+      unsigned          CqMask_;
+      io_uring_cqe*     Cqes_;
+      /// 已填入 SQ 尚未 io_uring_enter() 的數量.
+      unsigned          ToSubmit_{0};
+      unsigned          SqLocalTail_{0};
+
+      int Setup(unsigned entries);
+      /// 取得一個可用的 sqe, 若 SQ 已滿, 則先 Submit();
+      io_uring_sqe* GetSqe();
+      /// 送出 SQ 並等候 minComplete 個 cqe.
+      /// \retval >=0 送出的數量.
+      /// \retval <0  -errno.
+      int Submit(unsigned minComplete);
+   };
+   /// multishot recv 使用的 provided buffer ring.
+   struct RxBufRing {
+      fon9_NON_COPY_NON_MOVE(RxBufRing);
+      RxBufRing() = default;
+      ~RxBufRing();
+      enum {
+         kBufCount = 256,
+         kBufSize = 1024 * 8,
+         kGroupId = 1,
+      };
+      io_uring_buf_ring*   BufRing_{nullptr};
+      size_t               BufRingSize_{0};
+      char*                Bufs_{nullptr};
+      uint16_t             Tail_{0};
+      bool                 IsTailChanged_{false};
+
+      int Setup(int ringFd);
+      const char* GetBuf(unsigned bid) const {
+         return this->Bufs_ + static_cast<size_t>(bid) * kBufSize;
+      }
+      /// 將用完的 bid 放回 ring, 在 Publish() 之後才會讓 kernel 使用.
+      void Recycle(unsigned bid);
+      void Publish();
+   };
+   // RxBufs_ 必須在 Ring_ 之前, 才能在 Ring_ 關閉之後才釋放.
+   RxBufRing      RxBufs_;
+   Ring           Ring_;
+   EvHandlers     EvHandlers_;
+   /// 送出中的 IORING_OP_SENDMSG: 在完成前, 必須保留 handler.
+   ObjPool<FdrEventHandlerSP> SendReqs_;
+   uint32_t       ArmSeqNo_{0};
+   bool           IsWakeupArmed_{false};
+   /// 系統支援 provided buffer ring & multishot recv.
+   bool           IsRxCompletionEnabled_{false};
+   /// 延遲送出(DelayedSends_)使用 IORING_OP_TIMEOUT 喚醒; 記錄已送出的 timeout 最早到期時間,
+   /// 若沒有已送出的 timeout, 則為 DelayedClock::time_point::max();
+   DelayedClock::time_point   TimeoutDeadline_{DelayedClock::time_point::max()};
+   /// IORING_OP_TIMEOUT 需要的 struct __kernel_timespec, 必須保留到 io_uring_enter() 之後.
+   struct TimeoutSpec {
+      int64_t  Sec_;
+      int64_t  NSec_;
+   };
+   TimeoutSpec    TimeoutSpec_;
+   /// 事件觸發後, 需要重新 arm 的 handler index.
+   std::vector<size_t>  RearmList_;
+
+   uint32_t NextSeq();
+   void ArmWakeup();
+   void ArmTimeout(int64_t us);
+   /// 依照 evh.Events_ 調整已送出的 POLL_ADD 及 multishot recv.
+   void ArmHandler(size_t idx, EvHandler& evh);
+   void ArmPoll(size_t idx, EvHandler& evh);
+   void ArmRecv(size_t idx, EvHandler& evh);
+   void CancelReq(uint64_t userData);
+   void EmitRxHeld(EvHandler& evh);
+   void ProcessPendings();
+   void ProcessRearms();
+   void OnCqe(const io_uring_cqe& cqe);
+   void OnPollCqe(size_t idx, uint32_t seq, int32_t res);
+   void OnRecvCqe(size_t idx, uint32_t seq, const io_uring_cqe& cqe);
+   void OnSendCqe(size_t ireq, int32_t res);
+   virtual void ThrRunImpl(const ServiceThreadArgs& args) override;
+   virtual bool SubmitSend(FdrEventHandler* handler, const struct msghdr& msg) override;
+   virtual bool IsFdrHandlerIdle(const FdrEventHandler* handler) override;
+
+public:
+   FdrThreadUring(const IoServiceArgs& ioArgs, FdrServiceUring::MakeResult& res);
+
+   virtual ~FdrThreadUring();
+};
+
+} } // namespaces
+#endif//__linux__
+#endif//__fon9_io_FdrServiceUring_hpp__
@@ -0,0 +1,815 @@
+﻿/// \file fon9/io/FdrService_UT.cpp
+/// \author fonwinz@gmail.com
+#include "fon9/io/FdrTcpServer.hpp"
+#include "fon9/io/FdrDgram.hpp"
+#include "fon9/io/FdrServiceEpoll.hpp"
+#ifdef __linux__
+#include "fon9/io/FdrServiceUring.hpp"
+#endif
+#include "fon9/io/SimpleManager.hpp"
+#include "fon9/TestTools.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <algorithm>
+
+//--------------------------------------------------------------------------//
+
+fon9_WARN_DISABLE_PADDING;
+/// 將收到的資料原封不動送回.
+class EchoSession : public fon9::io::SessionServer {
+   fon9_NON_COPY_NON_MOVE(EchoSession);
+protected:
+   virtual fon9::io::RecvBufferSize OnDevice_LinkReady(fon9::io::Device&) override {
+      return fon9::io::RecvBufferSize::Default;
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_Recv(fon9::io::Device& dev, fon9::DcQueueList& rxbuf) override {
+      if (this->IsSendBuffered_)
+         dev.SendBuffered(rxbuf.MoveOut());
+      else
+         dev.SendASAP(rxbuf.MoveOut());
+      return fon9::io::RecvBufferSize::Default;
+   }
+   virtual fon9::io::SessionSP OnDevice_Accepted(fon9::io::DeviceServer&) override {
+      return this;
+   }
+public:
+   EchoSession(bool isSendBuffered) : IsSendBuffered_{isSendBuffered} {
+   }
+   const bool IsSendBuffered_;
+};
+
+/// 每個連線的第一次 OnDevice_Recv() 會暫停 FdrThread 一段時間,
+/// 讓 client 送出的資料全部累積在 server 端的 socket 接收緩衝.
+/// 之後 FdrSocket::CheckRead() 每次最多讀 256K, 剩餘的資料不會再有新的 edge,
+/// 只能依靠 RetriggerFdrEvent() 繼續讀取.
+class StallEchoSession : public EchoSession {
+   fon9_NON_COPY_NON_MOVE(StallEchoSession);
+   using base = EchoSession;
+   std::atomic<bool> IsStalled_{false};
+
+   virtual fon9::io::RecvBufferSize OnDevice_LinkReady(fon9::io::Device& dev) override {
+      this->IsStalled_ = false;
+      return base::OnDevice_LinkReady(dev);
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_Recv(fon9::io::Device& dev, fon9::DcQueueList& rxbuf) override {
+      if (!this->IsStalled_.exchange(true))
+         std::this_thread::sleep_for(std::chrono::milliseconds{200});
+      return base::OnDevice_Recv(dev, rxbuf);
+   }
+public:
+   StallEchoSession() : base{false} {
+   }
+};
+fon9_WARN_POP;
+
+//--------------------------------------------------------------------------//
+
+static fon9::byte MakePattern(uint64_t pos, unsigned seed) {
+   return static_cast<fon9::byte>((pos * 131) + (pos >> 9) + seed);
+}
+static int ConnectTo(unsigned port) {
+   for (unsigned retry = 0; retry < 1000; ++retry) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      struct sockaddr_in addr;
+      fon9::ZeroStruct(addr);
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(static_cast<uint16_t>(port));
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+         // 避免 server 沒有送回資料時, 測試永遠卡在 recv().
+         struct timeval tv{5, 0};
+         setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+         return fd;
+      }
+      close(fd);
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   return -1;
+}
+static void CheckError(bool isError, const char* msg) {
+   if (!isError)
+      return;
+   std::cout << "\r[ERROR] " << msg << std::endl;
+   abort();
+}
+/// 送出 kTotalBytes 個位元組(每次送出的大小不固定), 並檢查送回的內容.
+static void RunEchoClient(unsigned port, unsigned seed, uint64_t totalBytes) {
+   int fd = ConnectTo(port);
+   CheckError(fd < 0, "connect");
+   std::thread writer{[fd, seed, totalBytes]() {
+      char     buf[1024 * 64];
+      uint64_t pos = 0;
+      size_t   chunk = seed + 1;
+      while (pos < totalBytes) {
+         chunk = (chunk * 7 + 13) % sizeof(buf) + 1;
+         if (chunk > totalBytes - pos)
+            chunk = static_cast<size_t>(totalBytes - pos);
+         for (size_t L = 0; L < chunk; ++L)
+            buf[L] = static_cast<char>(MakePattern(pos + L, seed));
+         const char* pbeg = buf;
+         size_t      remain = chunk;
+         while (remain > 0) {
+            ssize_t wrsz = send(fd, pbeg, remain, MSG_NOSIGNAL);
+            CheckError(wrsz <= 0, "send");
+            pbeg += wrsz;
+            remain -= static_cast<size_t>(wrsz);
+         }
+         pos += chunk;
+      }
+   }};
+   char     buf[1024 * 64];
+   uint64_t pos = 0;
+   while (pos < totalBytes) {
+      ssize_t rdsz = recv(fd, buf, sizeof(buf), 0);
+      CheckError(rdsz <= 0, "recv: peer closed or timeout.");
+      for (ssize_t L = 0; L < rdsz; ++L)
+         CheckError(static_cast<fon9::byte>(buf[L]) != MakePattern(pos + static_cast<uint64_t>(L), seed), "echo data mismatch.");
+      pos += static_cast<uint64_t>(rdsz);
+   }
+   writer.join();
+   close(fd);
+}
+static uint32_t GetHandlerCount(const std::string& name) {
+   uint32_t count = 0;
+   for (const fon9::io::FdrThreadLoad& ld : fon9::io::FdrService::GetFdrThreadLoads()) {
+      if (ld.Name_ == name)
+         count += ld.HandlerCount_;
+   }
+   return count;
+}
+
+/// 使用 iosv 建立 TcpServer, 同時連入 kClientCount 個 client 測試 echo,
+/// 最後檢查 client 關閉後, server 端的 AcceptedClient 是否有釋放.
+static void TestTcpEcho(const char* testName, fon9::io::FdrServiceSP iosv, unsigned port, bool isSendBuffered) {
+   std::cout << "[TEST ] " << testName << (isSendBuffered ? "|SendBuffered" : "|SendASAP") << std::flush;
+   static const unsigned   kClientCount = 4;
+   static const uint64_t   kTotalBytes = 1024 * 1024 * 2;
+   fon9::StopWatch         stopWatch;
+   // 註冊到 FdrThread 是非同步的, 所以在建立 TcpServer 之前取得數量, 之後 +1 為 listener.
+   const uint32_t          handlerCount = GetHandlerCount(iosv->GetName()) + 1;
+   {
+      fon9::io::ManagerCSP mgr{new fon9::io::SimpleManager{}};
+      fon9::io::DeviceSP   dev{new fon9::io::FdrTcpServer(iosv, new EchoSession{isSendBuffered}, mgr)};
+      dev->Initialize();
+      dev->AsyncOpen(fon9::RevPrintTo<std::string>(port));
+      dev->WaitGetDeviceId();
+
+      std::vector<std::thread> clients;
+      for (unsigned L = 0; L < kClientCount; ++L)
+         clients.emplace_back(&RunEchoClient, port, L, kTotalBytes);
+      for (std::thread& thr : clients)
+         thr.join();
+
+      // client 關閉後, AcceptedClient 應收到「對方已關閉」並釋放.
+      unsigned ms = 0;
+      while (GetHandlerCount(iosv->GetName()) != handlerCount) {
+         CheckError(++ms > 5000, "AcceptedClient not closed.");
+         std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+      dev->AsyncDispose("test done");
+      dev->WaitGetDeviceId();
+      while (mgr->use_count() != 2) // mgr(+1), dev->Manager_(+1)
+         std::this_thread::yield();
+      // 等 listener 從 FdrThread 移除, 避免影響下一個測試.
+      while (GetHandlerCount(iosv->GetName()) != handlerCount - 1)
+         std::this_thread::yield();
+   }
+   stopWatch.PrintResult("\r[OK   ] ", kClientCount * kTotalBytes);
+}
+
+/// EPOLLET: 一次送出大量資料(全部可放入 server 端的接收緩衝), 檢查是否能全部送回.
+/// - 若 FdrSocket 讀到 256K 就暫停, 卻沒有 RetriggerFdrEvent(), 則剩餘的資料永遠不會送回.
+static void TestEdgeTriggeredStall(const char* testName, fon9::io::FdrServiceSP iosv, unsigned port) {
+   std::cout << "[TEST ] " << testName << "|Stall" << std::flush;
+   static const uint64_t   kTotalBytes = 1024 * 1024;
+   static const unsigned   kTimes = 3;
+   fon9::StopWatch         stopWatch;
+   const uint32_t          handlerCount = GetHandlerCount(iosv->GetName()) + 1;
+   {
+      fon9::io::ManagerCSP mgr{new fon9::io::SimpleManager{}};
+      fon9::io::DeviceSP   dev{new fon9::io::FdrTcpServer(iosv, new StallEchoSession{}, mgr)};
+      dev->Initialize();
+      // 接收緩衝必須能容納 kTotalBytes, 才能確保 stall 之後不會再有新的 edge.
+      dev->AsyncOpen(fon9::RevPrintTo<std::string>(port, "|ClientOptions={RCVBUF=4000000}"));
+      dev->WaitGetDeviceId();
+      for (unsigned L = 0; L < kTimes; ++L) {
+         RunEchoClient(port, L, kTotalBytes);
+         unsigned ms = 0;
+         while (GetHandlerCount(iosv->GetName()) != handlerCount) {
+            CheckError(++ms > 5000, "AcceptedClient not closed.");
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+         }
+      }
+      dev->AsyncDispose("test done");
+      dev->WaitGetDeviceId();
+      while (mgr->use_count() != 2)
+         std::this_thread::yield();
+      while (GetHandlerCount(iosv->GetName()) != handlerCount - 1)
+         std::this_thread::yield();
+   }
+   stopWatch.PrintResult("\r[OK   ] ", kTimes * kTotalBytes);
+}
+
+//--------------------------------------------------------------------------//
+
+static fon9::io::IoServiceArgs MakeIoServiceArgs(const char* cfg) {
+   fon9::io::IoServiceArgs iosvArgs;
+   fon9::RevBufferList     rbuf{128};
+   CheckError(!fon9::ParseConfig(iosvArgs, fon9::StrView_cstr(cfg), rbuf), cfg);
+   return iosvArgs;
+}
+
+fon9_WARN_DISABLE_PADDING;
+/// 不註冊任何事件, 只用來佔用 FdrThread 的 HandlerCount, 累計收送量, 或暫停 FdrThread.
+class LoadHandler : public fon9::io::FdrEventHandler {
+   fon9_NON_COPY_NON_MOVE(LoadHandler);
+   using base = fon9::io::FdrEventHandler;
+   virtual void OnFdrEvent_Handling(fon9::io::FdrEventFlag) override {
+   }
+   virtual void OnFdrEvent_StartSend() override {
+      this->IsBlocked_ = true;
+      while (this->IsBlocking_)
+         std::this_thread::yield();
+      this->IsBlocked_ = false;
+   }
+   virtual void OnFdrEvent_AddRef() override {
+   }
+   virtual void OnFdrEvent_ReleaseRef() override {
+   }
+   std::atomic<bool> IsBlocking_{false};
+   std::atomic<bool> IsBlocked_{false};
+public:
+   using base::base;
+   /// 暫停 FdrThread: 直到 Unblock() 之前, FdrThread 都停在 OnFdrEvent_StartSend().
+   void Block() {
+      this->IsBlocking_ = true;
+      this->StartSendInFdrThread();
+      while (!this->IsBlocked_)
+         std::this_thread::yield();
+   }
+   void Unblock() {
+      this->IsBlocking_ = false;
+   }
+   virtual fon9::io::FdrEventFlag GetRequiredFdrEventFlag() const override {
+      return fon9::io::FdrEventFlag::None;
+   }
+};
+fon9_WARN_POP;
+using LoadHandlers = std::vector<std::unique_ptr<LoadHandler>>;
+
+static fon9::FdrAuto OpenDevNull() {
+   fon9::FdrAuto fd{open("/dev/null", O_RDONLY | O_CLOEXEC)};
+   CheckError(!fd.IsReadyFD(), "open(/dev/null)");
+   return fd;
+}
+
+//--------------------------------------------------------------------------//
+
+fon9_WARN_DISABLE_PADDING;
+/// 每個 datagram: [seq:4][size:4][pattern...]; size 為送出時的大小.
+class DgramSession : public fon9::io::Session {
+   fon9_NON_COPY_NON_MOVE(DgramSession);
+   virtual void OnDevice_StateChanged(fon9::io::Device&, const fon9::io::StateChangedArgs& e) override {
+      if (e.After_.State_ == fon9::io::State::LinkReady)
+         this->IsLinkReady_ = true;
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_LinkReady(fon9::io::Device&) override {
+      return fon9::io::RecvBufferSize::Default;
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_Recv(fon9::io::Device&, fon9::DcQueueList& rxbuf) override {
+      uint32_t count = 0;
+      while (!rxbuf.empty()) {
+         // 批次接收時, 每個 datagram 為一個獨立的區塊.
+         auto blk = rxbuf.PeekCurrBlock();
+         CheckError(blk.second < 8, "Dgram: datagram too small.");
+         uint32_t seq, size;
+         memcpy(&seq, blk.first, 4);
+         memcpy(&size, blk.first + 4, 4);
+         CheckError(seq != this->ExpectedSeq_, "Dgram: seq mismatch.");
+         if (size > kTruncSize) {
+            // 接收區塊至少 4K(實際大小可能較大), 超過的部分被丟棄.
+            CheckError(blk.second >= size, "Dgram: datagram not truncated.");
+            ++this->TruncatedCount_;
+         }
+         else
+            CheckError(blk.second != size, "Dgram: size mismatch.");
+         for (size_t L = 8; L < blk.second; ++L)
+            CheckError(blk.first[L] != MakePattern(L, seq), "Dgram: data mismatch.");
+         rxbuf.PopConsumed(blk.second);
+         ++this->ExpectedSeq_;
+         ++count;
+      }
+      if (this->MaxDgramPerRecv_ < count)
+         this->MaxDgramPerRecv_ = count;
+      this->DgramCount_ += count;
+      return fon9::io::RecvBufferSize::Default;
+   }
+public:
+   /// 超過此大小的 datagram, 必定超過接收區塊(預設 4K)而被截斷.
+   enum : uint32_t {
+      kTruncSize = 1024 * 32,
+   };
+   DgramSession() = default;
+   std::atomic<bool>       IsLinkReady_{false};
+   std::atomic<uint32_t>   DgramCount_{0};
+   uint32_t                ExpectedSeq_{0};
+   uint32_t                MaxDgramPerRecv_{0};
+   uint32_t                TruncatedCount_{0};
+
+   static void SendDgram(fon9::io::Device& dev, uint32_t seq, uint32_t size) {
+      std::vector<fon9::byte> buf(size);
+      memcpy(buf.data(), &seq, 4);
+      memcpy(buf.data() + 4, &size, 4);
+      for (size_t L = 8; L < size; ++L)
+         buf[L] = MakePattern(L, seq);
+      dev.SendBuffered(buf.data(), size);
+   }
+};
+fon9_WARN_POP;
+
+static uint64_t GetTxCalls(const std::string& name) {
+   uint64_t count = 0;
+   for (const fon9::io::FdrThreadLoad& ld : fon9::io::FdrService::GetFdrThreadLoads()) {
+      if (ld.Name_ == name)
+         count += ld.TxCalls_;
+   }
+   return count;
+}
+static void WaitLinkReady(DgramSession& ses) {
+   unsigned ms = 0;
+   while (!ses.IsLinkReady_) {
+      CheckError(++ms > 5000, "Dgram: LinkReady timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+}
+static void WaitDgramCount(DgramSession& ses, uint32_t expected) {
+   unsigned ms = 0;
+   while (ses.DgramCount_ != expected) {
+      CheckError(++ms > 5000, "Dgram: recv count timeout(datagram lost?).");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+}
+static void DisposeDevice(fon9::io::DeviceSP& dev) {
+   dev->AsyncDispose("test done");
+   dev->WaitGetDeviceId();
+   dev.reset();
+}
+/// loopback UDP:
+/// - 送出端: SendBuffered, 每次累積 kBurst 個 datagrams 後使用 sendmmsg() 一次送出.
+/// - 接收端: RecvBatch=16, 使用 recvmmsg() 批次接收, 檢查每個 datagram 的內容及數量;
+///   最後送出超過接收區塊大小的 datagrams, 檢查截斷(MSG_TRUNC)的計數.
+static void TestDgramBatch(unsigned port) {
+   std::cout << "[TEST ] Dgram|RecvBatch=16|sendmmsg" << std::flush;
+   static const uint32_t   kBurst = 32;
+   static const uint32_t   kBurstCount = 64;
+   static const uint32_t   kTruncCount = 3;
+   fon9::io::FdrServiceEpoll::MakeResult err;
+   fon9::io::FdrServiceSP  iosvRx = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=1"), "UT.DgRx", err);
+   fon9::io::FdrServiceSP  iosvTx = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=1"), "UT.DgTx", err);
+   CheckError(!iosvRx || !iosvTx, "Dgram: MakeService.");
+   fon9::io::ManagerCSP    mgr{new fon9::io::SimpleManager{}};
+   fon9::intrusive_ptr<DgramSession> sesRx{new DgramSession};
+   fon9::intrusive_ptr<DgramSession> sesTx{new DgramSession};
+   fon9::io::DeviceSP      devRx{new fon9::io::FdrDgram(iosvRx, sesRx, mgr)};
+   fon9::io::DeviceSP      devTx{new fon9::io::FdrDgram(iosvTx, sesTx, mgr)};
+   devRx->Initialize();
+   devTx->Initialize();
+   devTx->WaitSetProperty("SendASAP=N");
+   devRx->AsyncOpen(fon9::RevPrintTo<std::string>("Bind=", port, "|RecvBatch=16"));
+   WaitLinkReady(*sesRx);
+   devTx->AsyncOpen(fon9::RevPrintTo<std::string>("127.0.0.1:", port));
+   WaitLinkReady(*sesTx);
+
+   // 送出時先暫停送出端的 FdrThread, 讓 kBurst 個 datagrams 都排入佇列, 恢復後應使用一次 sendmmsg() 送出.
+   LoadHandler       txBlocker{iosvTx->GetFdrThreads()[0], OpenDevNull()};
+   fon9::StopWatch   stopWatch;
+   const uint64_t    txCallsBeg = GetTxCalls(iosvTx->GetName());
+   uint32_t          seq = 0;
+   for (uint32_t B = 0; B < kBurstCount; ++B) {
+      txBlocker.Block();
+      for (uint32_t L = 0; L < kBurst; ++L, ++seq)
+         DgramSession::SendDgram(*devTx, seq, 8 + (seq * 37) % 1400);
+      txBlocker.Unblock();
+      // 每批等接收端收完, 避免超過 socket 接收緩衝而遺失.
+      WaitDgramCount(*sesRx, seq);
+   }
+   CheckError(sesRx->TruncatedCount_ != 0, "Dgram: unexpected truncated.");
+
+   // 超過接收區塊的 datagram: 接收端只會收到區塊大小的資料, 並累計截斷數量.
+   txBlocker.Block();
+   for (uint32_t L = 0; L < kBurst; ++L, ++seq)
+      DgramSession::SendDgram(*devTx, seq, L < kTruncCount ? DgramSession::kTruncSize + 1000 : 100);
+   txBlocker.Unblock();
+   WaitDgramCount(*sesRx, seq);
+   const uint64_t txCalls = GetTxCalls(iosvTx->GetName()) - txCallsBeg;
+   CheckError(txCalls != kBurstCount + 1, "Dgram: sendmmsg not batched.");
+   CheckError(sesRx->MaxDgramPerRecv_ <= 1, "Dgram: recvmmsg not batched.");
+   CheckError(sesRx->TruncatedCount_ != kTruncCount, "Dgram: truncated count.");
+   CheckError(static_cast<fon9::io::DgramBase*>(devRx.get())->GetRecvTruncatedCount() != kTruncCount,
+              "Dgram: GetRecvTruncatedCount().");
+   stopWatch.PrintResult("\r[OK   ] ", seq);
+   std::cout << "        |txCalls=" << txCalls << "|maxDgramPerRecv=" << sesRx->MaxDgramPerRecv_ << std::endl;
+
+   DisposeDevice(devTx);
+   DisposeDevice(devRx);
+   while (mgr->use_count() != 1)
+      std::this_thread::yield();
+}
+
+/// SendBuffered 合併送出: CoalesceUS 設定很長的延遲, 只靠 CoalesceIov 觸發送出;
+/// 第1筆之後的 datagrams 都放入 SendBuffer 的 queue, 也必須計入 CoalesceIov.
+static void TestDgramCoalesce(unsigned port) {
+   std::cout << "[TEST ] Dgram|CoalesceIov" << std::flush;
+   static const uint32_t   kBurst = 32;
+   static const uint32_t   kBurstCount = 16;
+   fon9::io::FdrServiceEpoll::MakeResult err;
+   fon9::io::FdrServiceSP  iosvRx = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=1"), "UT.DgRx", err);
+   fon9::io::FdrServiceSP  iosvTx = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=1"), "UT.DgCo", err);
+   CheckError(!iosvRx || !iosvTx, "Dgram: MakeService.");
+   fon9::io::ManagerCSP    mgr{new fon9::io::SimpleManager{}};
+   fon9::intrusive_ptr<DgramSession> sesRx{new DgramSession};
+   fon9::intrusive_ptr<DgramSession> sesTx{new DgramSession};
+   fon9::io::DeviceSP      devRx{new fon9::io::FdrDgram(iosvRx, sesRx, mgr)};
+   fon9::io::DeviceSP      devTx{new fon9::io::FdrDgram(iosvTx, sesTx, mgr)};
+   devRx->Initialize();
+   devTx->Initialize();
+   devTx->WaitSetProperty("SendASAP=N|CoalesceUS=3000000|CoalesceIov=32");
+   devRx->AsyncOpen(fon9::RevPrintTo<std::string>("Bind=", port, "|RecvBatch=16"));
+   WaitLinkReady(*sesRx);
+   devTx->AsyncOpen(fon9::RevPrintTo<std::string>("127.0.0.1:", port));
+   WaitLinkReady(*sesTx);
+
+   fon9::StopWatch   stopWatch;
+   const uint64_t    txCallsBeg = GetTxCalls(iosvTx->GetName());
+   uint32_t          seq = 0;
+   for (uint32_t B = 0; B < kBurstCount; ++B) {
+      fon9::StopWatch waitRx;
+      for (uint32_t L = 0; L < kBurst; ++L, ++seq)
+         DgramSession::SendDgram(*devTx, seq, 8 + (seq * 37) % 1400);
+      // 若 queue 裡面的資料沒有計入 CoalesceIov, 則要等 CoalesceUS(3秒) 才會送出.
+      WaitDgramCount(*sesRx, seq);
+      CheckError(waitRx.CurrSpan() > 1, "Dgram: CoalesceIov not applied to queued data.");
+   }
+   const uint64_t txCalls = GetTxCalls(iosvTx->GetName()) - txCallsBeg;
+   CheckError(txCalls > kBurstCount * 2, "Dgram: coalesced sends not batched.");
+   stopWatch.PrintResult("\r[OK   ] ", seq);
+   std::cout << "        |txCalls=" << txCalls << std::endl;
+
+   DisposeDevice(devTx);
+   DisposeDevice(devRx);
+   while (mgr->use_count() != 1)
+      std::this_thread::yield();
+}
+
+//--------------------------------------------------------------------------//
+
+static size_t IndexOf(const fon9::io::FdrService& iosv, const fon9::io::FdrThreadSP& thr) {
+   const fon9::io::FdrService::FdrThreads& thrs = iosv.GetFdrThreads();
+   for (size_t L = 0; L < thrs.size(); ++L) {
+      if (thrs[L] == thr)
+         return L;
+   }
+   CheckError(true, "FdrThread not found.");
+   return thrs.size();
+}
+static fon9::io::FdrServiceSP MakeAllocTestService(const char* cfg) {
+   fon9::io::FdrServiceEpoll::MakeResult err;
+   fon9::io::FdrServiceSP iosv = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs(cfg), "UT.Alloc", err);
+   CheckError(!iosv, cfg);
+   std::cout << "[TEST ] ThreadAlloc|" << cfg << std::flush;
+   return iosv;
+}
+/// 檢查 IoServiceArgs::ThreadAlloc_ 的各種分配方式.
+static void TestThreadAlloc() {
+   const unsigned kThrCount = 3;
+   {  // Default: [fd % thrCount], 不受負載影響.
+      fon9::io::FdrServiceSP iosv = MakeAllocTestService("ThreadCount=3|ThreadAlloc=Fd");
+      LoadHandlers hdrs;
+      for (unsigned L = 0; L < 4; ++L)
+         hdrs.emplace_back(new LoadHandler{iosv->GetFdrThreads()[0], OpenDevNull()});
+      for (int fd = 0; fd < 10; ++fd)
+         CheckError(IndexOf(*iosv, iosv->AllocFdrThread(fd)) != static_cast<size_t>(fd) % kThrCount, "Default: fd % thrCount.");
+      // 指定 IoThread: 不論 ThreadAlloc 為何, 都使用指定的 thread.
+      CheckError(IndexOf(*iosv, iosv->AllocFdrThread(0, 2)) != 2, "Default: pinIndex.");
+      CheckError(IndexOf(*iosv, iosv->AllocFdrThread(0, 4)) != 1, "Default: pinIndex % thrCount.");
+      std::cout << "\r[OK   ]" << std::endl;
+   }
+   {  // LeastConn: 每次都分配到 handler 最少的 thread, 所以最後會平均分配.
+      fon9::io::FdrServiceSP iosv = MakeAllocTestService("ThreadCount=3|ThreadAlloc=LeastConn");
+      LoadHandlers hdrs;
+      hdrs.emplace_back(new LoadHandler{iosv->GetFdrThreads()[0], OpenDevNull()});
+      hdrs.emplace_back(new LoadHandler{iosv->GetFdrThreads()[0], OpenDevNull()});
+      // thread[0] 已有 2 個, 接下來的 4 個應分配給 thread[1], thread[2].
+      for (unsigned L = 0; L < 4; ++L) {
+         hdrs.emplace_back(new LoadHandler{*iosv, OpenDevNull()});
+         CheckError(IndexOf(*iosv, hdrs.back()->GetFdrThread()) == 0, "LeastConn: busy thread allocated.");
+      }
+      for (unsigned L = 0; L < 6; ++L)
+         hdrs.emplace_back(new LoadHandler{*iosv, OpenDevNull()});
+      for (const fon9::io::FdrThreadSP& thr : iosv->GetFdrThreads())
+         CheckError(thr->GetHandlerCount() != 4, "LeastConn: HandlerCount.");
+      // 釋放 thread[1] 的 handlers 之後, 新的 handler 應分配到 thread[1].
+      hdrs.erase(std::remove_if(hdrs.begin(), hdrs.end(), [&iosv](const std::unique_ptr<LoadHandler>& h) {
+         return h->GetFdrThread() == iosv->GetFdrThreads()[1];
+      }), hdrs.end());
+      CheckError(iosv->GetFdrThreads()[1]->GetHandlerCount() != 0, "LeastConn: HandlerCount after release.");
+      hdrs.emplace_back(new LoadHandler{*iosv, OpenDevNull()});
+      CheckError(IndexOf(*iosv, hdrs.back()->GetFdrThread()) != 1, "LeastConn: released thread.");
+      std::cout << "\r[OK   ]" << std::endl;
+   }
+   {  // LeastBytes: 最近取樣區間(約1秒)收送量最少的 thread; 收送量相同時, 選 handler 最少的.
+      fon9::io::FdrServiceSP iosv = MakeAllocTestService("ThreadCount=3|ThreadAlloc=LeastBytes");
+      const fon9::io::FdrService::FdrThreads& thrs = iosv->GetFdrThreads();
+      LoadHandlers hdrs;
+      hdrs.emplace_back(new LoadHandler{thrs[0], OpenDevNull()});
+      hdrs.emplace_back(new LoadHandler{thrs[1], OpenDevNull()});
+      // 第一次分配時開始取樣, 此時尚無收送量, 只能依 handler 數量: thread[2].
+      CheckError(IndexOf(*iosv, iosv->AllocFdrThread(0)) != 2, "LeastBytes: first sample.");
+      hdrs.emplace_back(new LoadHandler{thrs[2], OpenDevNull()});
+      hdrs[0]->AddRxBytes(1024 * 1024);
+      hdrs[1]->AddTxBytes(1024);
+      hdrs[2]->AddRxBytes(1024 * 64);
+      // 尚未到達下次取樣時間: 仍使用上次的取樣結果(全部為0), 加上已分配的 thread[2] 預估量, 再依 handler 數量(全部為1),
+      // 所以使用 [fd % thrCount].
+      CheckError(IndexOf(*iosv, iosv->AllocFdrThread(0)) != 0, "LeastBytes: before next sample.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1100});
+      // 在同一個取樣區間內分配多次: 已分配的連線以每個 handler 的平均收送量預估, 所以不會全部集中在 thread[1].
+      // 平均收送量約為 (1M + 1K + 64K) / 3 = 355K, 所以預估量: [1M, 1K + 355K, 64K + 355K].
+      static const size_t kExpected[] = {1, 2, 1};
+      for (int fd = 0; fd < 3; ++fd)
+         CheckError(IndexOf(*iosv, iosv->AllocFdrThread(fd)) != kExpected[fd], "LeastBytes: spread in sample interval.");
+      for (const fon9::io::FdrThreadLoad& ld : fon9::io::FdrService::GetFdrThreadLoads()) {
+         if (ld.Name_ == iosv->GetName() && ld.ThreadIndex_ == 0)
+            CheckError(ld.RxBytes_ != 1024 * 1024 || ld.BytesPerSec_ == 0, "LeastBytes: loads.");
+      }
+      std::cout << "\r[OK   ]" << std::endl;
+   }
+}
+
+//--------------------------------------------------------------------------//
+
+fon9_WARN_DISABLE_PADDING;
+/// 記錄 OnBufferConsumed() 是否已被呼叫.
+class ConsumedNode : public fon9::BufferNodeVirtual {
+   fon9_NON_COPY_NON_MOVE(ConsumedNode);
+   using base = fon9::BufferNodeVirtual;
+   friend class fon9::BufferNode;// for BufferNode::Alloc();
+   using base::base;
+   std::atomic<int>* Consumed_{nullptr};
+protected:
+   virtual void OnBufferConsumed() override {
+      *this->Consumed_ = 1;
+   }
+   virtual void OnBufferConsumedErr(const fon9::ErrC&) override {
+      *this->Consumed_ = -1;
+   }
+public:
+   static ConsumedNode* Alloc(std::atomic<int>& consumed) {
+      ConsumedNode* res = base::Alloc<ConsumedNode>(0, StyleFlag::AllowCrossing);
+      res->Consumed_ = &consumed;
+      return res;
+   }
+};
+/// 保留 AcceptedClient, 並記錄是否已關閉.
+class ZeroCopySession : public fon9::io::SessionServer {
+   fon9_NON_COPY_NON_MOVE(ZeroCopySession);
+   virtual fon9::io::RecvBufferSize OnDevice_LinkReady(fon9::io::Device& dev) override {
+      this->Client_.reset(&dev);
+      this->IsLinkReady_ = true;
+      return fon9::io::RecvBufferSize::Default;
+   }
+   virtual void OnDevice_StateChanged(fon9::io::Device&, const fon9::io::StateChangedArgs& e) override {
+      if (e.BeforeState_ == fon9::io::State::Lingering)
+         this->IsClosed_ = true;
+   }
+   virtual fon9::io::SessionSP OnDevice_Accepted(fon9::io::DeviceServer&) override {
+      return this;
+   }
+public:
+   ZeroCopySession() = default;
+   fon9::io::DeviceSP   Client_;
+   std::atomic<bool>    IsLinkReady_{false};
+   std::atomic<bool>    IsClosed_{false};
+};
+fon9_WARN_POP;
+
+/// ZeroCopy=Y: 送出的節點必須等 fdr thread 取得 error queue 的完成通知之後, 才能觸發 OnBufferConsumed();
+/// 在此之前, 送出緩衝視為尚未送完, 所以 LingerClose 也要等到完成通知之後才關閉.
+static void TestZeroCopy(unsigned port) {
+   std::cout << "[TEST ] TcpZeroCopy|epoll" << std::flush;
+#ifdef SO_ZEROCOPY
+   {
+      fon9::FdrAuto so{socket(AF_INET, SOCK_STREAM, 0)};
+      int           val = 1;
+      if (setsockopt(so.GetFD(), SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) != 0) {
+         std::cout << "\r[SKIP ] TcpZeroCopy|SO_ZEROCOPY not supported." << std::endl;
+         return;
+      }
+   }
+   fon9::io::FdrServiceEpoll::MakeResult err;
+   fon9::io::FdrServiceSP iosv = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=1|Wait=Block"), "UT.ZeroCopy", err);
+   CheckError(!iosv, "ZeroCopy: MakeService.");
+   fon9::intrusive_ptr<ZeroCopySession> ses{new ZeroCopySession};
+   fon9::io::ManagerCSP mgr{new fon9::io::SimpleManager{}};
+   fon9::io::DeviceSP   dev{new fon9::io::FdrTcpServer(iosv, ses, mgr)};
+   dev->Initialize();
+   dev->AsyncOpen(fon9::RevPrintTo<std::string>(port, "|ClientOptions={ZeroCopy=Y}"));
+   dev->WaitGetDeviceId();
+   fon9::FdrAuto fd{ConnectTo(port)};
+   CheckError(!fd.IsReadyFD(), "ZeroCopy: connect.");
+   for (unsigned L = 0; !ses->IsLinkReady_; ++L) {
+      CheckError(L > 5000, "ZeroCopy: wait LinkReady timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   // 暫停 fdr thread, 讓完成通知停留在 error queue.
+   LoadHandler blocker{iosv->GetFdrThreads()[0], OpenDevNull()};
+   blocker.Block();
+
+   static const size_t  kSize = 1024 * 64;
+   std::atomic<int>     consumed{0};
+   fon9::BufferList     buf;
+   std::string          data(kSize, 'z');
+   fon9::AppendToBuffer(buf, data.c_str(), data.size());
+   buf.push_back(ConsumedNode::Alloc(consumed));
+   ses->Client_->SendASAP(std::move(buf));
+   for (size_t rdsz = 0; rdsz < kSize;) {
+      ssize_t r = recv(fd.GetFD(), &data[0], kSize, 0);
+      CheckError(r <= 0, "ZeroCopy: recv.");
+      rdsz += static_cast<size_t>(r);
+   }
+   ses->Client_->AsyncLingerClose("ZeroCopy.Linger");
+   std::this_thread::sleep_for(std::chrono::milliseconds{100});
+   CheckError(consumed != 0, "ZeroCopy: OnBufferConsumed() before completion.");
+   CheckError(ses->IsClosed_, "ZeroCopy: LingerClose before completion.");
+
+   blocker.Unblock();
+   for (unsigned L = 0; consumed == 0 || !ses->IsClosed_; ++L) {
+      CheckError(L > 5000, "ZeroCopy: wait completion timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   CheckError(consumed != 1, "ZeroCopy: OnBufferConsumedErr().");
+   // 正常關閉(FIN), 而不是 RST.
+   CheckError(recv(fd.GetFD(), &data[0], kSize, 0) != 0, "ZeroCopy: expect peer closed.");
+   fd.Close();
+
+   ses->Client_.reset();
+   dev->AsyncDispose("test done");
+   dev->WaitGetDeviceId();
+   while (mgr->use_count() != 2)
+      std::this_thread::yield();
+   std::cout << "\r[OK   ]" << std::endl;
+#else
+   (void)port;
+   std::cout << "\r[SKIP ] TcpZeroCopy|SO_ZEROCOPY not supported." << std::endl;
+#endif
+}
+
+//--------------------------------------------------------------------------//
+
+fon9_WARN_DISABLE_PADDING;
+/// 使用 pipe 的讀端, 記錄在哪個 FdrThread 收到 Readable 事件.
+class PipeReader : public fon9::io::FdrEventHandler {
+   fon9_NON_COPY_NON_MOVE(PipeReader);
+   using base = fon9::io::FdrEventHandler;
+   virtual void OnFdrEvent_Handling(fon9::io::FdrEventFlag evs) override {
+      if (!IsEnumContains(evs, fon9::io::FdrEventFlag::Readable))
+         return;
+      char buf[64];
+      while (read(this->GetFD(), buf, sizeof(buf)) > 0) {
+      }
+      this->LastThread_ = this->GetFdrThread().get();
+      ++this->ReadableCount_;
+   }
+   virtual void OnFdrEvent_StartSend() override {
+   }
+   virtual void OnFdrEvent_AddRef() override {
+      ++this->RefCount_;
+   }
+   virtual void OnFdrEvent_ReleaseRef() override {
+      --this->RefCount_;
+   }
+public:
+   std::atomic<uint32_t> RefCount_{0};
+   std::atomic<uint32_t> ReadableCount_{0};
+   std::atomic<fon9::io::FdrThread*> LastThread_{nullptr};
+   using base::base;
+   virtual fon9::io::FdrEventFlag GetRequiredFdrEventFlag() const override {
+      return fon9::io::FdrEventFlag::Readable;
+   }
+};
+fon9_WARN_POP;
+
+static void WaitReadable(PipeReader& rd, int wfd, uint32_t expected) {
+   CheckError(write(wfd, "x", 1) != 1, "Migrate: write(pipe).");
+   for (unsigned L = 0; rd.ReadableCount_ < expected; ++L) {
+      CheckError(L > 5000, "Migrate: wait Readable timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+}
+/// 轉移閒置的 handler 到其他 FdrThread; 忙碌(有延遲送出)時應放棄轉移.
+static void TestMigrate(const char* testName, fon9::io::FdrServiceSP iosv) {
+   std::cout << "[TEST ] Migrate|" << testName << std::flush;
+   const fon9::io::FdrService::FdrThreads& thrs = iosv->GetFdrThreads();
+   int fds[2];
+   CheckError(pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0, "Migrate: pipe2().");
+   fon9::FdrAuto wfd{fds[1]};
+   std::unique_ptr<PipeReader> rd{new PipeReader{thrs[0], fon9::FdrAuto{fds[0]}}};
+   rd->UpdateFdrEvent();
+   WaitReadable(*rd, wfd.GetFD(), 1);
+   CheckError(rd->LastThread_ != thrs[0].get(), "Migrate: Readable thread before migrate.");
+
+   const uint32_t hc0 = thrs[0]->GetHandlerCount();
+   const uint32_t hc1 = thrs[1]->GetHandlerCount();
+   rd->MigrateFdrThread(thrs[1]);
+   for (unsigned L = 0; rd->GetFdrThread() != thrs[1]; ++L) {
+      CheckError(L > 5000, "Migrate: wait migrate timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   CheckError(thrs[0]->GetHandlerCount() != hc0 - 1 || thrs[1]->GetHandlerCount() != hc1 + 1, "Migrate: HandlerCount.");
+   WaitReadable(*rd, wfd.GetFD(), 2);
+   CheckError(rd->LastThread_ != thrs[1].get(), "Migrate: Readable thread after migrate.");
+
+   // 有延遲送出時, 不是閒置狀態, 必須放棄轉移.
+   const auto lvBak = fon9::LogLevel_;
+   fon9::LogLevel_ = fon9::LogLevel::Fatal; // 略過 "Handler busy" 的 log.
+   rd->StartSendInFdrThread(300 * 1000);
+   rd->MigrateFdrThread(thrs[0]);
+   std::this_thread::sleep_for(std::chrono::milliseconds{100});
+   fon9::LogLevel_ = lvBak;
+   CheckError(rd->GetFdrThread() != thrs[1], "Migrate: busy handler migrated.");
+   WaitReadable(*rd, wfd.GetFD(), 3);
+   CheckError(rd->LastThread_ != thrs[1].get(), "Migrate: Readable thread after busy.");
+
+   rd->RemoveFdrEvent();
+   for (unsigned L = 0; rd->RefCount_ != 0; ++L) {
+      CheckError(L > 5000, "Migrate: wait remove timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   rd.reset();
+   CheckError(thrs[0]->GetHandlerCount() != hc0 - 1 || thrs[1]->GetHandlerCount() != hc1, "Migrate: HandlerCount after release.");
+   std::cout << "\r[OK   ]" << std::endl;
+}
+
+int main() {
+   fon9::AutoPrintTestInfo utinfo("FdrService");
+   fon9::LogLevel_ = fon9::LogLevel::Error;
+
+   TestThreadAlloc();
+   utinfo.PrintSplitter();
+
+   const unsigned kPortBase = 19700;
+   TestDgramBatch(kPortBase + 30);
+   TestDgramCoalesce(kPortBase + 31);
+   TestZeroCopy(kPortBase + 32);
+   utinfo.PrintSplitter();
+   fon9::io::FdrServiceSP iosv;
+   {
+      fon9::io::FdrServiceEpoll::MakeResult err;
+      iosv = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs("ThreadCount=2|Wait=Block"), "UT", err);
+      CheckError(!iosv, "FdrServiceEpoll.MakeService");
+      TestTcpEcho("TcpEcho|epoll", iosv, kPortBase + 0, false);
+      TestTcpEcho("TcpEcho|epoll", iosv, kPortBase + 1, true);
+      TestMigrate("epoll", iosv);
+   }
+   utinfo.PrintSplitter();
+
+   const char* const etCfgs[] = {
+      "ThreadCount=2|Wait=Block|EdgeTrigger=Y",
+      "ThreadCount=1|Wait=Busy|EdgeTrigger=Y",
+   };
+   unsigned port = kPortBase + 2;
+   for (const char* cfg : etCfgs) {
+      fon9::io::FdrServiceEpoll::MakeResult err;
+      iosv = fon9::io::FdrServiceEpoll::MakeService(MakeIoServiceArgs(cfg), "UT", err);
+      CheckError(!iosv, cfg);
+      std::string testName = std::string{"TcpEcho|"} + cfg;
+      TestTcpEcho(testName.c_str(), iosv, port++, false);
+      TestTcpEcho(testName.c_str(), iosv, port++, true);
+      TestEdgeTriggeredStall(testName.c_str(), iosv, port++);
+   }
+#ifdef __linux__
+   utinfo.PrintSplitter();
+
+   const char* const uringCfgs[] = {
+      "ThreadCount=2|Wait=Block|Engine=uring",
+      "ThreadCount=1|Wait=Busy|Engine=uring",
+   };
+   port = kPortBase + 10;
+   for (const char* cfg : uringCfgs) {
+      fon9::io::FdrServiceUring::MakeResult err;
+      iosv = fon9::io::FdrServiceUring::MakeService(MakeIoServiceArgs(cfg), "UT", err);
+      if (!iosv) {
+         std::cout << "[SKIP ] io_uring not supported|err=" << fon9::RevPrintTo<std::string>(err) << std::endl;
+         break;
+      }
+      std::string testName = std::string{"TcpEcho|"} + cfg;
+      TestTcpEcho(testName.c_str(), iosv, port++, false);
+      TestTcpEcho(testName.c_str(), iosv, port++, true);
+      if (iosv->GetFdrThreads().size() > 1)
+         TestMigrate(cfg, iosv);
+   }
+#endif
+   iosv.reset();
+}
@@ -4,8 +4,167 @@
 #ifdef fon9_POSIX
 #include "fon9/io/FdrSocket.hpp"
 
+fon9_BEFORE_INCLUDE_STD;
+#include <poll.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+fon9_AFTER_INCLUDE_STD;
+
 namespace fon9 { namespace io {
 
+FdrSocket::~FdrSocket() {
+   if (fon9_LIKELY(ZeroCopyPinnedList::Locker{this->ZeroCopyPinned_}->Pinned_.empty()))
+      return;
+   // 先取出已到達的完成通知, 已完成的節點正常釋放.
+   FdrSocket::OnFdrEvent_ErrQueue();
+   ZeroCopyPinnedList::Locker zc{this->ZeroCopyPinned_};
+   if (zc->Pinned_.empty())
+      return;
+   // kernel 仍可能參考剩餘節點的 pages(例: 尚未送出, 或等候重送),
+   // 所以先強制關閉(RST): 讓 kernel 丟棄尚未送出的資料, 之後不會再使用這些 pages, 然後才能釋放.
+   struct linger lg;
+   lg.l_onoff = 1;
+   lg.l_linger = 0;
+   setsockopt(this->GetFD(), SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+   this->CloseFdrAtDestruct();
+   for (ZeroCopyPinned& pinned : zc->Pinned_)
+      BufferListConsumeErr(std::move(pinned.Nodes_), std::errc::operation_canceled);
+}
+
+bool FdrSocket::IsRxTimestampingEnabled(Fdr::fdr_t fd) {
+#ifdef SO_TIMESTAMPING
+   int         tsflags = 0;
+   socklen_t   len = sizeof(tsflags);
+   return getsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &tsflags, &len) == 0 && tsflags != 0;
+#else
+   (void)fd;
+   return false;
+#endif
+}
+
+bool FdrSocket::IsZeroCopyEnabled(Fdr::fdr_t fd) {
+#if defined(SO_ZEROCOPY) && defined(__linux__)
+   int         val = 0;
+   socklen_t   len = sizeof(val);
+   return getsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &val, &len) == 0 && val != 0;
+#else
+   (void)fd;
+   return false;
+#endif
+}
+bool FdrSocket::OnFdrEvent_ErrQueue() {
+#if defined(SO_ZEROCOPY) && defined(__linux__)
+   if (!this->IsZeroCopy_)
+      return false;
+   BufferList  done;
+   bool        isDrained = false;
+   for (;;) {
+      union {
+         struct cmsghdr Align_;
+         char           Buf_[kRxTimestampCtrlSize];
+      }  ctrl;
+      struct msghdr msg;
+      ZeroStruct(msg);
+      msg.msg_control = ctrl.Buf_;
+      msg.msg_controllen = sizeof(ctrl.Buf_);
+      if (recvmsg(this->GetFD(), &msg, MSG_ERRQUEUE) < 0)
+         break; // EAGAIN: error queue 已取完.
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+         if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+               || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            continue;
+         struct sock_extended_err serr;
+         memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+         if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            continue;
+         // [ee_info..ee_data] 的 send 已完成; TCP 的完成通知會依序送達, 所以移除 <= ee_data 的全部節點.
+         ZeroCopyPinnedList::Locker zc{this->ZeroCopyPinned_};
+         while (!zc->Pinned_.empty()
+                && static_cast<int32_t>(zc->Pinned_.front().Id_ - serr.ee_data) <= 0) {
+            done.push_back(std::move(zc->Pinned_.front().Nodes_));
+            zc->Pinned_.pop_front();
+         }
+         isDrained = zc->Pinned_.empty();
+      }
+   }
+   if (!done.empty()) {
+      // 釋放已完成的節點, 此時才觸發 OnBufferConsumed();
+      DcQueueList dcq{std::move(done)};
+      dcq.PopConsumed(dcq.CalcSize());
+      if (isDrained)
+         this->OnFdrSocket_ZeroCopyDrained();
+   }
+   // error queue 已取完, 若仍有 POLLERR, 則表示 socket 有其他錯誤.
+   struct pollfd pfd;
+   pfd.fd = this->GetFD();
+   pfd.events = 0;
+   pfd.revents = 0;
+   return poll(&pfd, 1, 0) >= 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) == 0;
+#else
+   return false;
+#endif
+}
+
+void FdrSocket::OnFdrSocket_ZeroCopyDrained() {
+}
+bool FdrSocket::IsZeroCopyPending() {
+   return this->IsZeroCopy_ && !ZeroCopyPinnedList::Locker{this->ZeroCopyPinned_}->Pinned_.empty();
+}
+
+TimeStamp FdrSocket::GetCmsgRxTime(const struct msghdr& msg) {
+#ifdef SCM_TIMESTAMPING
+   for (const struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), const_cast<struct cmsghdr*>(cmsg))) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING) {
+         // ts[0]: software timestamp; ts[2]: hardware timestamp.
+         struct timespec ts;
+         memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+         if (ts.tv_sec || ts.tv_nsec)
+            return ToTimeStamp(ts);
+      }
+   }
+#else
+   (void)msg;
+#endif
+   return TimeStamp::Null();
+}
+
+bool FdrSocket::IsFdrRxCompletionAllowed() const {
+   return this->IsFdrCompletionAllowed_ && !this->IsRxTimestamping_;
+}
+bool FdrSocket::SubmitSendv(DcQueueList& toSend) {
+   if (!this->IsFdrSendSubmittable())
+      return false;
+   if (!this->SubmitSendReq_)
+      this->SubmitSendReq_.reset(new SubmitSendReq);
+   SubmitSendReq& req = *this->SubmitSendReq_;
+   ZeroStruct(req.Msg_);
+   req.Msg_.msg_iov = req.Iov_;
+   req.Msg_.msg_iovlen = toSend.PeekBlockVector(req.Iov_);
+   if (req.Msg_.msg_iovlen <= 0)
+      return false;
+   this->IsSubmitSending_.store(true, std::memory_order_relaxed);
+   if (this->SubmitFdrSend(req.Msg_))
+      return true;
+   this->IsSubmitSending_.store(false, std::memory_order_relaxed);
+   return false;
+}
+bool FdrSocket::OnFdrEvent_SendDone(ssize_t res) {
+   if (fon9_LIKELY(res >= 0)) {
+      this->AddTxBytes(static_cast<size_t>(res));
+      this->SubmitSentBytes_.fetch_add(static_cast<size_t>(res), std::memory_order_relaxed);
+   }
+   this->IsSubmitSending_.store(false, std::memory_order_release);
+   if (fon9_LIKELY(res >= 0))
+      return true;
+   int eno = ErrorCannotRetry(static_cast<int>(-res));
+   // ECANCELED: fdr thread 移除 this 時取消的送出(例: 正在關閉), 不是 socket 的錯誤.
+   if (eno == 0 || eno == ECANCELED)
+      return true;
+   this->SocketError("Sendv", eno);
+   return false;
+}
+
 FdrEventFlag FdrSocket::GetRequiredFdrEventFlag() const {
    return static_cast<FdrEventFlag>(this->EnabledEvents_.load(std::memory_order_relaxed));
 }
@@ -22,16 +181,71 @@ void FdrSocket::SocketError(StrView fnName, int eno) {
    this->OnFdrSocket_Error(std::move(errmsg));
 }
 
+static size_t CalcIovSize(const struct iovec* bufv, size_t bufCount) {
+   size_t bufsz = 0;
+   for (size_t L = 0; L < bufCount; ++L)
+      bufsz += bufv[L].iov_len;
+   return bufsz;
+}
+
+ssize_t FdrSocket::SendZeroCopy(DcQueueList& toSend, struct iovec* bufv, size_t bufCount) {
+#if defined(SO_ZEROCOPY) && defined(__linux__)
+   if (CalcIovSize(bufv, bufCount) >= kZeroCopyMinSize) {
+      struct msghdr msg;
+      ZeroStruct(msg);
+      msg.msg_iov = bufv;
+      msg.msg_iovlen = bufCount;
+      // 必須在 lock 狀態下送出, 才能確保 Id_ 與 kernel 的編號一致.
+      ZeroCopyPinnedList::Locker zc{this->ZeroCopyPinned_};
+      ssize_t wrsz = sendmsg(this->GetFD(), &msg, MSG_ZEROCOPY);
+      if (fon9_LIKELY(wrsz > 0)) {
+         zc->Pinned_.push_back(ZeroCopyPinned{zc->NextId_++, toSend.MoveOutConsumed(static_cast<size_t>(wrsz))});
+         return wrsz;
+      }
+      // ENOBUFS: 超過 optmem 限制, 無法 pin 住更多 pages, 改用一般的 writev();
+      if (wrsz == 0 || errno != ENOBUFS)
+         return wrsz;
+   }
+#endif
+   ssize_t wrsz = writev(this->GetFD(), bufv, static_cast<int>(bufCount));
+   if (fon9_LIKELY(wrsz > 0))
+      toSend.PopConsumed(static_cast<size_t>(wrsz));
+   return wrsz;
+}
 int FdrSocket::Sendv(DeviceOpLocker& sc, DcQueueList& toSend) {
+   if (fon9_UNLIKELY(this->IsSubmitSending_.load(std::memory_order_acquire)))
+      return 0;
+   if (fon9_UNLIKELY(this->SubmitSentBytes_.load(std::memory_order_relaxed) != 0)) {
+      toSend.PopConsumed(this->SubmitSentBytes_.exchange(0, std::memory_order_relaxed));
+      if (toSend.empty()) {
+         this->CheckSendQueueEmpty(sc);
+         return 0;
+      }
+   }
+   if (this->IsFdrCompletionAllowed_ && !this->IsZeroCopy_ && this->InFdrThread()) {
+      if (this->SubmitSendv(toSend))
+         return 0;
+   }
    struct iovec   bufv[IOV_MAX];
    size_t         bufCount = toSend.PeekBlockVector(bufv);
-   ssize_t        wrsz = writev(this->GetFD(), bufv, static_cast<int>(bufCount));
+   ssize_t        wrsz;
+   if (fon9_LIKELY(!this->IsZeroCopy_)) {
+      wrsz = writev(this->GetFD(), bufv, static_cast<int>(bufCount));
+      if (fon9_LIKELY(wrsz > 0))
+         toSend.PopConsumed(static_cast<size_t>(wrsz));
+   }
+   else
+      wrsz = this->SendZeroCopy(toSend, bufv, bufCount);
    if (fon9_LIKELY(wrsz >= 0)) {
-      toSend.PopConsumed(static_cast<size_t>(wrsz));
+      this->AddTxBytes(static_cast<size_t>(wrsz));
       if (fon9_LIKELY(toSend.empty()))
          this->CheckSendQueueEmpty(sc);
-      else
+      else {
+         // 送出的資料量與要求的相同(受限於 IOV_MAX), 表示送出緩衝區仍有空間, 不會有新的 Writable 通知.
+         if (static_cast<size_t>(wrsz) == CalcIovSize(bufv, bufCount))
+            this->CheckRetriggerFdrEvent(FdrEventFlag::Writable);
          this->EnableEventBit(FdrEventFlag::Writable);
+      }
       return 0;
    }
    if (int eno = ErrorCannotRetry(errno)) {
@@ -46,7 +260,9 @@ void FdrSocket::CheckSendQueueEmpty(DeviceOpLocker& sc) {
    auto& alocker = sc.GetALocker();
    alocker.Relock();
    if (fon9_LIKELY(!this->SendBuffer_.OpImpl_CheckSendQueue())) {
-      sc.GetDevice().AsyncCheckLingerClose(alocker);
+      // MSG_ZEROCOPY 尚未完成的資料仍是送出中, 等 OnFdrSocket_ZeroCopyDrained() 再檢查.
+      if (fon9_LIKELY(!this->IsZeroCopyPending()))
+         sc.GetDevice().AsyncCheckLingerClose(alocker);
       // 雖然返回後會 sc 就會死亡, 但是因為已經 Relock(),
       // 所以會有許多 call stack 的 local variables 也在 lock 的範圍內.
       // 會造成 unlock() 時 memory barrier 的負擔, 因此在這兒就先將 sc.Destroy(), 可以加快一些速度.
@@ -64,7 +280,42 @@ void FdrSocket::CheckSendQueueEmpty(DeviceOpLocker& sc) {
    this->StartSendInFdrThread();
 }
 
+bool FdrSocket::CheckRxCompleted(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf), const FdrRxCompleted& rx) {
+   if (fon9_UNLIKELY(rx.ErrNo_ != 0)) {
+      if (int eno = ErrorCannotRetry(rx.ErrNo_)) {
+         this->SocketError("Recv", eno);
+         return false;
+      }
+      return true;
+   }
+   if (fon9_UNLIKELY(rx.Size_ == 0)) {
+      this->SocketError("Recv", 0);
+      return false;
+   }
+   this->AddRxBytes(rx.Size_);
+   if (fon9_UNLIKELY(this->RecvSize_ < RecvBufferSize::Default)) {
+      // Session 決定不要再處理 OnDevice_Recv() 事件, 所以拋棄收到的資料.
+      this->RecvBuffer_.Clear();
+      return true;
+   }
+   struct iovec   bufv[2];
+   const size_t   bufCount = this->RecvBuffer_.GetRecvBlockVector(bufv, rx.Size_);
+   const char*    src = static_cast<const char*>(rx.Data_);
+   size_t         remain = rx.Size_;
+   for (size_t L = 0; L < bufCount && remain > 0; ++L) {
+      const size_t sz = (bufv[L].iov_len < remain ? bufv[L].iov_len : remain);
+      memcpy(bufv[L].iov_base, src, sz);
+      src += sz;
+      remain -= sz;
+   }
+   assert(remain == 0);
+   CheckReadAux aux{fnIsRecvBufferAlive};
+   DeviceRecvBufferReady(dev, this->RecvBuffer_.SetDataReceived(rx.Size_), aux);
+   return true;
+}
 bool FdrSocket::CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf)) {
+   if (const FdrRxCompleted* rx = this->GetFdrRxCompleted())
+      return this->CheckRxCompleted(dev, fnIsRecvBufferAlive, *rx);
    size_t   totrd = 0;
    if (fon9_LIKELY(this->RecvSize_ >= RecvBufferSize::Default)) {
       for (;;) {
@@ -78,18 +329,28 @@ bool FdrSocket::CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev,
          bufv[1].iov_len = 0;
 
          size_t   bufCount = this->RecvBuffer_.GetRecvBlockVector(bufv, expectSize);
-         ssize_t  bytesTransfered = readv(this->GetFD(), bufv, static_cast<int>(bufCount));
+         ssize_t  bytesTransfered;
+         if (fon9_LIKELY(!this->IsRxTimestamping_))
+            bytesTransfered = readv(this->GetFD(), bufv, static_cast<int>(bufCount));
+         else {
+            union {
+               struct cmsghdr Align_;
+               char           Buf_[kRxTimestampCtrlSize];
+            }  ctrl;
+            struct msghdr msg;
+            ZeroStruct(msg);
+            msg.msg_iov = bufv;
+            msg.msg_iovlen = bufCount;
+            msg.msg_control = ctrl.Buf_;
+            msg.msg_controllen = sizeof(ctrl.Buf_);
+            if ((bytesTransfered = recvmsg(this->GetFD(), &msg, 0)) > 0)
+               this->RecvBuffer_.SetRxTime(GetCmsgRxTime(msg));
+         }
          if (fon9_LIKELY(bytesTransfered > 0)) {
+            this->AddRxBytes(static_cast<size_t>(bytesTransfered));
             DcQueueList&   rxbuf = this->RecvBuffer_.SetDataReceived(bytesTransfered);
 
-            struct RecvAux : public FdrRecvAux {
-               bool (*FnIsRecvBufferAlive_)(Device& dev, RecvBuffer& rbuf);
-               bool IsRecvBufferAlive(Device& dev, RecvBuffer& rbuf) const {
-                  return this->FnIsRecvBufferAlive_ == nullptr || this->FnIsRecvBufferAlive_(dev, rbuf);
-               }
-            };
-            RecvAux aux;
-            aux.FnIsRecvBufferAlive_ = fnIsRecvBufferAlive;
+            CheckReadAux   aux{fnIsRecvBufferAlive};
             DeviceRecvBufferReady(dev, rxbuf, aux);
 
             // 實際取出的資料量, 比要求取出的少 => 資料已全部取出, 所以結束 Recv.
@@ -97,13 +358,17 @@ bool FdrSocket::CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev,
                return true;
 
             // 避免一次占用太久, 所以先結束.
-            if ((totrd += bytesTransfered) > 1024 * 256)
+            if ((totrd += bytesTransfered) > 1024 * 256) {
+               this->CheckRetriggerFdrEvent(FdrEventFlag::Readable);
                return true;
+            }
 
             // 關閉 readable 偵測: 需要到 op thread 處理 Recv 事件, 所以結束 Recv.
             // 再根據 OnDevice_Recv() 事件處理結果, 決定是否重新啟用 readable 偵測.
-            if (fon9_UNLIKELY(aux.IsNeedsUpdateFdrEvent_))
+            if (fon9_UNLIKELY(aux.IsNeedsUpdateFdrEvent_)) {
+               this->CheckRetriggerFdrEvent(FdrEventFlag::Readable);
                return true;
+            }
 
             // Session 決定不要再處理 OnDevice_Recv() 事件, 所以拋棄全部已收到的資料.
             if (fon9_UNLIKELY(this->RecvSize_ < RecvBufferSize::Default))
@@ -125,6 +390,7 @@ bool FdrSocket::CheckRead(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev,
             goto __READ_ERROR;
          if (rdsz == 0)
             break;
+         this->AddRxBytes(static_cast<size_t>(rdsz));
          totrd += rdsz;
       }
    }
@@ -153,6 +419,7 @@ SendDirectResult FdrSocket::FdrRecvAux::SendDirect(RecvDirectArgs& e, BufferList
       size_t         bufCount = toSend.PeekBlockVector(bufv);
       ssize_t        wrsz = writev(so.GetFD(), bufv, static_cast<int>(bufCount));
       if (fon9_LIKELY(wrsz >= 0)) {
+         so.AddTxBytes(static_cast<size_t>(wrsz));
          toSend.PopConsumed(static_cast<size_t>(wrsz));
          if (fon9_LIKELY(toSend.empty()))
             return SendDirectResult::Sent;
@@ -7,6 +7,11 @@
 #include "fon9/io/DeviceRecvEvent.hpp"
 #include "fon9/io/Socket.hpp"
 
+fon9_BEFORE_INCLUDE_STD;
+#include <deque>
+#include <memory>
+fon9_AFTER_INCLUDE_STD;
+
 namespace fon9 { namespace io {
 
 class FdrSocket : public FdrEventHandler {
@@ -16,6 +21,70 @@ protected:
    RecvBufferSize             RecvSize_;
    RecvBuffer                 RecvBuffer_;
    SendBuffer                 SendBuffer_;
+   /// 建構時檢查 socket 是否有啟用 SO_TIMESTAMPING(RxTimestamp=Y),
+   /// 若有, 則使用 recvmsg() 取得 kernel 的接收時間, 存入 RecvBuffer_.SetRxTime();
+   bool                       IsRxTimestamping_;
+
+   /// 若 IsRxTimestamping_ 則需要額外提供給 recvmsg() 的 control buffer 大小.
+   enum { kRxTimestampCtrlSize = 128 };
+   /// 從 recvmsg() 的 control message 取出 SCM_TIMESTAMPING 的 software 時間.
+   /// 若沒有則傳回 TimeStamp::Null();
+   static TimeStamp GetCmsgRxTime(const struct msghdr& msg);
+   static bool IsRxTimestampingEnabled(Fdr::fdr_t fd);
+
+   /// 建構時檢查 socket 是否有啟用 SO_ZEROCOPY(ZeroCopy=Y),
+   /// 若有, 則 Sendv() 在一次送出的資料量 >= kZeroCopyMinSize 時, 使用 sendmsg(MSG_ZEROCOPY);
+   bool                       IsZeroCopy_;
+   /// 資料量太小時, MSG_ZEROCOPY 的額外負擔(page pinning, 完成通知)會超過 memcpy 的成本.
+   enum { kZeroCopyMinSize = 1024 * 16 };
+   struct ZeroCopyPinned {
+      /// kernel 為每次成功的 MSG_ZEROCOPY send 依序編號(從0開始).
+      uint32_t    Id_;
+      BufferList  Nodes_;
+   };
+   struct ZeroCopyImpl {
+      uint32_t                   NextId_{0};
+      std::deque<ZeroCopyPinned> Pinned_;
+   };
+   /// Sendv() 在 op safe 狀態下加入, OnFdrEvent_ErrQueue() 在 fdr thread 移除, 所以需要 lock.
+   using ZeroCopyPinnedList = MustLock<ZeroCopyImpl>;
+   ZeroCopyPinnedList         ZeroCopyPinned_;
+   static bool IsZeroCopyEnabled(Fdr::fdr_t fd);
+   /// 取出 error queue 裡面 MSG_ZEROCOPY 的完成通知, 釋放已完成的 BufferNode.
+   /// 若 fd 沒有其他錯誤, 則傳回 true.
+   virtual bool OnFdrEvent_ErrQueue() override;
+   /// 在 fdr thread 的 OnFdrEvent_ErrQueue() 呼叫: MSG_ZEROCOPY 送出的資料已全部完成(ZeroCopyPinned_ 已清空).
+   /// 送出緩衝在此之前可能已空, 所以衍生者應在此透過 CheckDeviceLingerClose() 檢查是否可以結束 Lingering.
+   virtual void OnFdrSocket_ZeroCopyDrained();
+   static void CheckDeviceLingerClose(Device& dev) {
+      DeviceOpQueue::ALockerForAsyncTask alocker{dev.OpQueue_, AQueueTaskKind::Send};
+      dev.AsyncCheckLingerClose(alocker);
+   }
+
+   /// 是否允許使用 fdr thread 提供的 completion 型收送(例: FdrThreadUring 的 multishot recv, IORING_OP_SENDMSG);
+   /// 衍生者若需要自行處理收送(例: FdrDgramImpl 的 recvmmsg, sendmmsg), 則應在建構時設為 false.
+   bool                       IsFdrCompletionAllowed_{true};
+   /// 若有 IsRxTimestamping_, 則需要 recvmsg() 的 control message, 所以不使用 completion 型的接收.
+   virtual bool IsFdrRxCompletionAllowed() const override;
+
+   /// 透過 SubmitFdrSend() 送出中的要求, 必須保留到 OnFdrEvent_SendDone() 為止.
+   enum { kSubmitIovMax = 64 };
+   struct SubmitSendReq {
+      struct msghdr  Msg_;
+      struct iovec   Iov_[kSubmitIovMax];
+   };
+   std::unique_ptr<SubmitSendReq>   SubmitSendReq_;
+   /// 在 Sendv() 送出要求時設定, 在 OnFdrEvent_SendDone() 清除;
+   /// 送出中, Sendv() 不會再送出, 等完成後由 fdr thread 觸發 FdrEventFlag::Writable 繼續送出.
+   std::atomic<bool>          IsSubmitSending_{false};
+   /// OnFdrEvent_SendDone() 的送出量, 在下次 Sendv() 時從 toSend 移除.
+   std::atomic<size_t>        SubmitSentBytes_{0};
+   /// 在 fdr thread 透過 SubmitFdrSend() 送出.
+   /// \retval false 不支援, 應自行送出.
+   bool SubmitSendv(DcQueueList& toSend);
+   virtual bool OnFdrEvent_SendDone(ssize_t res) override;
+   /// 由 CheckRead() 處理 fdr thread 已讀入的資料(GetFdrRxCompleted()).
+   bool CheckRxCompleted(Device& dev, bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf), const FdrRxCompleted& rx);
 
    /// 建立錯誤訊息字串, 觸發事件:
    /// `this->OnFdrSocket_Error("fnName:" + GetSocketErrC(eno));`
@@ -24,6 +93,12 @@ protected:
 
    virtual FdrEventFlag GetRequiredFdrEventFlag() const override;
 
+   /// edge-triggered 時, 在讀寫到 EAGAIN 之前就結束事件處理, 則需要呼叫此處, 要求 fdr thread 再次觸發 evs.
+   void CheckRetriggerFdrEvent(FdrEventFlag evs) {
+      if (fon9_UNLIKELY(this->IsFdrEdgeTriggered()))
+         this->RetriggerFdrEvent(evs);
+   }
+
    void CheckSocketErrorOrCanceled(FdrEventFlag evs) {
       if (IsEnumContains(evs, FdrEventFlag::Error)) {
          this->SocketError("Event", Socket::LoadSocketErrno(this->GetFD()));
@@ -33,18 +108,57 @@ protected:
       }
    }
 
+   /// 若在 fdr thread 且 fdr thread 支援 SubmitFdrSend(), 則透過 SubmitFdrSend() 送出, 完成後再繼續.
    /// \retval 0     success;  返回前, 若已無資料則: CheckSendQueueEmpty(); 若仍有資料則: 啟動 writable 偵測.
    /// \retval else  errno;    返回前, 已先呼叫 this->OnFdrSocket_Error("fn=Sendv|err=", retval);
    int Sendv(DeviceOpLocker& sc, DcQueueList& toSend);
+   /// IsZeroCopy_ 時, 由 Sendv() 呼叫: 傳回值與 writev() 相同, 返回前已將送出的資料從 toSend 移除;
+   /// 若使用 MSG_ZEROCOPY 送出, 則送出的節點移到 ZeroCopyPinned_, 等候完成通知.
+   ssize_t SendZeroCopy(DcQueueList& toSend, struct iovec* bufv, size_t bufCount);
    
+   /// SendBuffered() 的合併送出設定, 來自 DeviceOptions: CoalesceUS_, CoalesceBytes_, CoalesceIov_;
+   uint32_t                   CoalesceUS_{0};
+   uint32_t                   CoalesceBytes_{0};
+   uint32_t                   CoalesceIov_{0};
+   /// 從 toSend 為空開始, 累計加入的資料量及 SendBuffered() 次數;
+   /// 在 StartToSend() 加入 toSend(unlocked inplace), 也會在 PushToQueue() 加入 queue(locked), 所以使用 atomic.
+   std::atomic<size_t>        CoalescedBytes_{0};
+   std::atomic<uint32_t>      CoalescedCount_{0};
+   /// 本次合併已達上限, 已要求 fdr thread 立即送出.
+   std::atomic<bool>          IsCoalesceFlushed_{false};
+   /// 累計本次合併的資料量, 若已達上限, 則要求 fdr thread 立即送出(每次合併只要求一次).
+   /// \retval true 已達上限.
+   bool AddCoalesced(size_t appendedSize) {
+      const size_t   bytes = this->CoalescedBytes_.fetch_add(appendedSize, std::memory_order_relaxed) + appendedSize;
+      const uint32_t count = this->CoalescedCount_.fetch_add(1, std::memory_order_relaxed) + 1;
+      if ((this->CoalesceBytes_ > 0 && bytes >= this->CoalesceBytes_)
+          || (this->CoalesceIov_ > 0 && count >= this->CoalesceIov_)) {
+         if (!this->IsCoalesceFlushed_.exchange(true, std::memory_order_relaxed))
+            this->StartSendInFdrThread();
+         return true;
+      }
+      return false;
+   }
+
    bool SetDisableEventBit(FdrEventFlag ev) {
       return (this->EnabledEvents_.fetch_and(~static_cast<FdrEventFlagU>(ev), std::memory_order_relaxed)
               & static_cast<FdrEventFlagU>(ev)) != 0;
    }
 
 public:
-   FdrSocket(FdrService& iosv, Socket&& so) : FdrEventHandler{iosv, so.MoveOut()} {
+   FdrSocket(FdrService& iosv, Socket&& so)
+      : FdrEventHandler{iosv, so.MoveOut()}
+      , IsRxTimestamping_{IsRxTimestampingEnabled(this->GetFD())}
+      , IsZeroCopy_{IsZeroCopyEnabled(this->GetFD())} {
    }
+   FdrSocket(FdrThreadSP thr, Socket&& so)
+      : FdrEventHandler{std::move(thr), so.MoveOut()}
+      , IsRxTimestamping_{IsRxTimestampingEnabled(this->GetFD())}
+      , IsZeroCopy_{IsZeroCopyEnabled(this->GetFD())} {
+   }
+   /// 尚未收到完成通知的 MSG_ZEROCOPY BufferNode:
+   /// kernel 可能仍在使用, 所以先用 SO_LINGER{1,0} 強制關閉 socket(RST), 再用 operation_canceled 釋放.
+   ~FdrSocket();
 
    void EnableEventBit(FdrEventFlag ev) {
       if ((this->EnabledEvents_.fetch_or(static_cast<FdrEventFlagU>(ev), std::memory_order_relaxed)
@@ -99,6 +213,16 @@ public:
       }
       static SendDirectResult SendDirect(RecvDirectArgs& e, BufferList&& txbuf);
    };
+   /// CheckRead() 收到資料後, 透過 DeviceRecvBufferReady(dev, rxbuf, aux) 通知 Device 時使用.
+   struct CheckReadAux : public FdrRecvAux {
+      bool (*FnIsRecvBufferAlive_)(Device& dev, RecvBuffer& rbuf);
+      CheckReadAux(bool (*fnIsRecvBufferAlive)(Device& dev, RecvBuffer& rbuf))
+         : FnIsRecvBufferAlive_{fnIsRecvBufferAlive} {
+      }
+      bool IsRecvBufferAlive(Device& dev, RecvBuffer& rbuf) const {
+         return this->FnIsRecvBufferAlive_ == nullptr || this->FnIsRecvBufferAlive_(dev, rbuf);
+      }
+   };
 
    /// \retval true  成功完成 read.
    /// \retval false read 失敗, 返回前已呼叫 OnFdrSocket_Error();
@@ -109,6 +233,47 @@ public:
    SendBuffer& GetSendBuffer() {
       return this->SendBuffer_;
    }
+   /// 是否有 MSG_ZEROCOPY 送出, 但尚未收到完成通知的資料.
+   bool IsZeroCopyPending();
+   /// 送出緩衝已空, 且沒有尚未完成的 MSG_ZEROCOPY 資料, 提供給 Device::IsSendBufferEmpty() 使用.
+   bool IsSendCompleted() {
+      return this->SendBuffer_.IsEmpty() && !this->IsZeroCopyPending();
+   }
+   /// 由衍生者在建構時設定 SendBuffered() 的合併送出參數, 通常來自 Device 的 OpImpl_GetOptions();
+   void SetSendCoalesce(const DeviceOptions& opts) {
+      this->CoalesceUS_ = opts.CoalesceUS_;
+      this->CoalesceBytes_ = opts.CoalesceBytes_;
+      this->CoalesceIov_ = opts.CoalesceIov_;
+   }
+   /// 由 SendBuffered_Aux*::StartToSend() 將資料加入 toSend 之後呼叫, 決定何時到 fdr thread 送出:
+   /// - 沒有設定 CoalesceUS_: 與原本相同, 在加入第一筆時, 立即 StartSendInFdrThread();
+   /// - 有設定 CoalesceUS_: 在加入第一筆時, 延遲 CoalesceUS_ 之後送出;
+   ///   延遲期間(包含 OnSendBufferedQueued() 加入 queue 的資料)
+   ///   若累計的資料量 >= CoalesceBytes_, 或 SendBuffered() 次數 >= CoalesceIov_, 則立即送出.
+   void OnSendBuffered(bool isFirst, size_t appendedSize) {
+      if (fon9_LIKELY(this->CoalesceUS_ == 0)) {
+         if (isFirst)
+            this->StartSendInFdrThread();
+         return;
+      }
+      if (isFirst) {
+         this->CoalescedBytes_.store(0, std::memory_order_relaxed);
+         this->CoalescedCount_.store(0, std::memory_order_relaxed);
+         this->IsCoalesceFlushed_.store(false, std::memory_order_relaxed);
+      }
+      else if (this->IsCoalesceFlushed_.load(std::memory_order_relaxed))
+         return;
+      if (!this->AddCoalesced(appendedSize) && isFirst)
+         this->StartSendInFdrThread(this->CoalesceUS_);
+   }
+   /// 合併期間, 其他 thread 的 SendBuffered() 無法取得 toSend, 資料放入 SendBuffer 的 queue 之後呼叫.
+   void OnSendBufferedQueued(size_t appendedSize) {
+      if (this->CoalesceUS_ != 0 && !this->IsCoalesceFlushed_.load(std::memory_order_relaxed))
+         this->AddCoalesced(appendedSize);
+   }
+   bool IsSendCoalescing() const {
+      return this->CoalesceUS_ != 0;
+   }
    void CheckSendQueueEmpty(DeviceOpLocker& sc);
 
    struct ContinueSendAux : public FdrEventAux {
@@ -142,6 +307,7 @@ public:
             }
             wrsz = 0;
          }
+         impl.AddTxBytes(static_cast<size_t>(wrsz));
 
          if (fon9_LIKELY(static_cast<size_t>(wrsz) >= this->Size_))
             impl.CheckSendQueueEmpty(sc);
@@ -169,28 +335,35 @@ public:
       using SendAuxMem::SendAuxMem;
 
       Device::SendResult StartToSend(DeviceOpLocker&, DcQueueList& toSend) {
-         bool doNeedsNotify = toSend.empty();
+         bool isFirst = toSend.empty();
          toSend.Append(this->Src_, this->Size_);
-         if (doNeedsNotify) {
-            FdrSocket&  impl = ContainerOf(SendBuffer::StaticCast(toSend), &FdrSocket::SendBuffer_);
-            impl.StartSendInFdrThread();
-         }
+         FdrSocket&  impl = ContainerOf(SendBuffer::StaticCast(toSend), &FdrSocket::SendBuffer_);
+         impl.OnSendBuffered(isFirst, this->Size_);
          return Device::SendResult{0};
       }
+      void PushToQueue(SendBuffer& sbuf, BufferList& queue) {
+         this->PushTo(queue);
+         ContainerOf(sbuf, &FdrSocket::SendBuffer_).OnSendBufferedQueued(this->Size_);
+      }
    };
 
    struct SendBuffered_AuxBuf : public SendAuxBuf {
       using SendAuxBuf::SendAuxBuf;
 
       Device::SendResult StartToSend(DeviceOpLocker&, DcQueueList& toSend) {
-         bool doNeedsNotify = toSend.empty();
+         bool   isFirst = toSend.empty();
+         size_t srcSize = CalcDataSize(this->Src_->cfront());
          toSend.push_back(std::move(*this->Src_));
-         if (doNeedsNotify) {
-            FdrSocket&  impl = ContainerOf(SendBuffer::StaticCast(toSend), &FdrSocket::SendBuffer_);
-            impl.StartSendInFdrThread();
-         }
+         FdrSocket&  impl = ContainerOf(SendBuffer::StaticCast(toSend), &FdrSocket::SendBuffer_);
+         impl.OnSendBuffered(isFirst, srcSize);
          return Device::SendResult{0};
       }
+      void PushToQueue(SendBuffer& sbuf, BufferList& queue) {
+         FdrSocket&  impl = ContainerOf(sbuf, &FdrSocket::SendBuffer_);
+         size_t      srcSize = impl.IsSendCoalescing() ? CalcDataSize(this->Src_->cfront()) : 0;
+         this->PushTo(queue);
+         impl.OnSendBufferedQueued(srcSize);
+      }
    };
 };
 
@@ -58,6 +58,9 @@ public:
    FdrSocketClientImpl(FdrService& iosv, Socket&& so)
       : FdrSocket{iosv, std::move(so)} {
    }
+   FdrSocketClientImpl(FdrThreadSP thr, Socket&& so)
+      : FdrSocket{std::move(thr), std::move(so)} {
+   }
    bool IsClosing() const {
       return this->State_ == State::Closing;
    }
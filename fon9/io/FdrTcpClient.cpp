@@ -25,6 +25,9 @@ bool FdrTcpClientImpl::OpImpl_ConnectTo(const SocketAddress& addr, SocketResult&
 void FdrTcpClientImpl::OnFdrSocket_Error(std::string errmsg) {
    this->Owner_->OnSocketError(this, std::move(errmsg));
 }
+void FdrTcpClientImpl::OnFdrSocket_ZeroCopyDrained() {
+   CheckDeviceLingerClose(*this->Owner_);
+}
 void FdrTcpClientImpl::OnFdrEvent_Handling(FdrEventFlag evs) {
    FdrEventProcessor(this, *this->Owner_, evs);
 }
@@ -13,6 +13,7 @@ struct FdrTcpClientImpl : public FdrSocketClientImpl {
    virtual void OnFdrEvent_Handling(FdrEventFlag evs) override;
    virtual void OnFdrEvent_StartSend() override;
    virtual void OnFdrSocket_Error(std::string errmsg) override;
+   virtual void OnFdrSocket_ZeroCopyDrained() override;
 
 public:
    using OwnerDevice = TcpClientT<FdrServiceSP, FdrTcpClientImpl>;
@@ -20,8 +21,10 @@ public:
    const OwnerDeviceSP  Owner_;
 
    FdrTcpClientImpl(OwnerDevice* owner, Socket&& so, SocketResult&)
-      : base{*owner->IoService_, std::move(so)}
+      : base{owner->IoService_->AllocFdrThread(so.GetSocketHandle(), owner->OpImpl_GetOptions().IoThreadIndex_),
+             std::move(so)}
       , Owner_{owner} {
+      this->SetSendCoalesce(owner->OpImpl_GetOptions());
    }
    bool OpImpl_ConnectTo(const SocketAddress& addr, SocketResult& soRes);
 };
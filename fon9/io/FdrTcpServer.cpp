@@ -3,6 +3,7 @@
 #include "fon9/sys/Config.h"
 #ifdef fon9_POSIX
 #include "fon9/io/FdrTcpServer.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 fon9_WARN_DISABLE_PADDING;
@@ -42,6 +43,9 @@ class FdrTcpListener::AcceptedClient : public DeviceAcceptedClient, public FdrSo
    virtual void OnFdrSocket_Error(std::string errmsg) override {
       this->AsyncDispose(errmsg);
    }
+   virtual void OnFdrSocket_ZeroCopyDrained() override {
+      CheckDeviceLingerClose(*this);
+   }
 
    virtual void OpImpl_StartRecv(RecvBufferSize preallocSize) override {
       this->StartRecv(preallocSize);
@@ -52,9 +56,10 @@ class FdrTcpListener::AcceptedClient : public DeviceAcceptedClient, public FdrSo
    }
 
 public:
-   AcceptedClient(FdrTcpListener& owner, Socket soAccepted, SessionSP ses, ManagerSP mgr, const DeviceOptions& optsDefault)
+   AcceptedClient(FdrTcpListener& owner, FdrThreadSP thr, Socket soAccepted, SessionSP ses, ManagerSP mgr, const DeviceOptions& optsDefault)
       : base(&owner, std::move(ses), std::move(mgr), &optsDefault)
-      , FdrSocket(*owner.IoServiceSP_, std::move(soAccepted)) {
+      , FdrSocket(std::move(thr), std::move(soAccepted)) {
+      this->SetSendCoalesce(optsDefault);
    }
 
    using Impl = DeviceImpl_DeviceStartSend<DeviceAcceptedClientWithSend<AcceptedClient>, FdrSocket>;
@@ -62,11 +67,55 @@ public:
 
 //--------------------------------------------------------------------------//
 
-FdrTcpListener::FdrTcpListener(FdrServiceSP iosv, FdrTcpServerSP&& server, Socket&& soListen)
-   : FdrEventHandler{*iosv, soListen.MoveOut()}
+class FdrTcpListener::SubListener : public FdrEventHandler {
+   fon9_NON_COPY_NON_MOVE(SubListener);
+   FdrTcpListener& Owner_;
+
+   virtual FdrEventFlag GetRequiredFdrEventFlag() const override {
+      return FdrEventFlag::Readable;
+   }
+   virtual void OnFdrEvent_Handling(FdrEventFlag evs) override {
+      this->Owner_.OnListenerEvent(*this, evs);
+   }
+   // SubListener 由 Owner_ 擁有, 所以使用 Owner_ 的參考計數.
+   virtual void OnFdrEvent_AddRef() override {
+      intrusive_ptr_add_ref(static_cast<baseCounter*>(&this->Owner_));
+   }
+   virtual void OnFdrEvent_ReleaseRef() override {
+      intrusive_ptr_release(static_cast<baseCounter*>(&this->Owner_));
+   }
+   virtual void OnFdrEvent_StartSend() override {
+   }
+
+public:
+   SubListener(FdrTcpListener& owner, FdrThreadSP thr, Socket&& soListen)
+      : FdrEventHandler{std::move(thr), soListen.MoveOut()}
+      , Owner_(owner) {
+   }
+};
+
+//--------------------------------------------------------------------------//
+
+FdrTcpListener::FdrTcpListener(FdrServiceSP iosv, FdrThreadSP thr, FdrTcpServerSP&& server, Socket&& soListen)
+   : FdrEventHandler{std::move(thr), soListen.MoveOut()}
    , IoServiceSP_{std::move(iosv)}
    , Server_{std::move(server)} {
 }
+FdrTcpListener::~FdrTcpListener() {
+}
+
+/// ListenPerThread: 若沒有指定 IncomingCpu, 則使用 thr 綁定的 cpu.
+static void SetListenerIncomingCpu(const SocketServerConfig& cfg, Fdr::fdr_t fd, const FdrThread& thr) {
+#ifdef SO_INCOMING_CPU
+   int cpu = thr.GetCpuAffinity();
+   if (cfg.ListenConfig_.Options_.SO_INCOMING_CPU_ >= 0 || cpu < 0)
+      return;
+   if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) != 0)
+      fon9_LOGM_WARN(LogModule_Io, "FdrTcpListener.IncomingCpu|cpu=", cpu, "|err=", GetSocketErrC());
+#else
+   (void)cfg; (void)fd; (void)thr;
+#endif
+}
 
 DeviceListenerSP FdrTcpListener::CreateListener(FdrTcpServerSP server, SocketResult& soRes) {
    const SocketServerConfig& cfg = server->Config_;
@@ -88,10 +137,33 @@ DeviceListenerSP FdrTcpListener::CreateListener(FdrTcpServerSP server, SocketRes
          return DeviceListenerSP{};
    }
 
+   FdrThreadSP thr;
+   if (!cfg.IsListenPerThread_)
+      thr = iosv->AllocFdrThread(soListen.GetSocketHandle());
+   else {
+      thr = iosv->GetFdrThreads()[0];
+      SetListenerIncomingCpu(cfg, soListen.GetSocketHandle(), *thr);
+   }
    FdrTcpListener*  fdrListener;
-   DeviceListenerSP retval{fdrListener = new FdrTcpListener{std::move(iosv), std::move(server), std::move(soListen)}};
+   DeviceListenerSP retval{fdrListener = new FdrTcpListener{iosv, std::move(thr), std::move(server), std::move(soListen)}};
+   if (cfg.IsListenPerThread_) {
+      const FdrService::FdrThreads& thrs = iosv->GetFdrThreads();
+      // 若 Bind 的 port 為 0, 則其餘的 listener 必須使用第一個 listener 實際綁定的 port.
+      SocketServerConfig subcfg = cfg;
+      socklen_t          addrLen = sizeof(subcfg.ListenConfig_.AddrBind_);
+      getsockname(fdrListener->GetFD(), &subcfg.ListenConfig_.AddrBind_.Addr_, &addrLen);
+      fdrListener->SubListeners_.reserve(thrs.size() - 1);
+      for (size_t L = 1; L < thrs.size(); ++L) {
+         if (!subcfg.CreateListenSocket(soListen, soRes))
+            return DeviceListenerSP{};
+         SetListenerIncomingCpu(cfg, soListen.GetSocketHandle(), *thrs[L]);
+         fdrListener->SubListeners_.emplace_back(new SubListener{*fdrListener, thrs[L], std::move(soListen)});
+      }
+   }
    fdrListener->SetAcceptedClientsReserved(capAcceptedClients);
    fdrListener->UpdateFdrEvent();
+   for (SubListenerUP& sub : fdrListener->SubListeners_)
+      sub->UpdateFdrEvent();
    return retval;
 }
 
@@ -109,14 +181,18 @@ FdrEventFlag FdrTcpListener::GetRequiredFdrEventFlag() const {
    return FdrEventFlag::Readable;
 }
 void FdrTcpListener::OnFdrEvent_Handling(FdrEventFlag evs) {
+   this->OnListenerEvent(*this, evs);
+}
+void FdrTcpListener::OnListenerEvent(FdrEventHandler& listener, FdrEventFlag evs) {
    if (this->IsDisposing())
       return;
 
    FdrTcpServer&  server = *this->Server_;
    if (IsEnumContains(evs, FdrEventFlag::Error)) {
-      server.OpQueue_.AddTask(DeviceAsyncTask{[this](Device& dev) {
+      const Fdr::fdr_t listenFD = listener.GetFD();
+      server.OpQueue_.AddTask(DeviceAsyncTask{[this, listenFD](Device& dev) {
          if (static_cast<FdrTcpServer*>(&dev)->Listener_ == this)
-            FdrTcpServer::OpThr_SetBrokenState(dev, RevPrintTo<std::string>("FdrTcpListener.OnFdrEvent|err=", Socket::LoadSocketErrC(this->GetFD())));
+            FdrTcpServer::OpThr_SetBrokenState(dev, RevPrintTo<std::string>("FdrTcpListener.OnFdrEvent|err=", Socket::LoadSocketErrC(listenFD)));
       }});
       return;
    }
@@ -125,16 +201,23 @@ void FdrTcpListener::OnFdrEvent_Handling(FdrEventFlag evs) {
       SocketAddress  addrRemote;
       socklen_t      addrLen = sizeof(addrRemote);
       ZeroStruct(addrRemote);
-      Socket   soAccepted(::accept(this->GetFD(), &addrRemote.Addr_, &addrLen));
+   #ifdef SOCK_NONBLOCK
+      // accept4(): 直接設定 nonblock, 可省去 SetNonBlock() 的 syscall.
+      Socket   soAccepted(::accept4(listener.GetFD(), &addrRemote.Addr_, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC));
+   #else
+      Socket   soAccepted(::accept(listener.GetFD(), &addrRemote.Addr_, &addrLen));
+   #endif
       if (fon9_UNLIKELY(!soAccepted.IsSocketReady())) {
          if (int eno = ErrorCannotRetry(errno))
-            fon9_LOG_FATAL("FdrTcpListener.accepted|err=", GetSocketErrC(eno));
+            fon9_LOGM_FATAL(LogModule_Io, "FdrTcpListener.accepted|err=", GetSocketErrC(eno));
          return;
       }
+   #ifndef SOCK_NONBLOCK
       if (fon9_UNLIKELY(!soAccepted.SetNonBlock())) {
-         fon9_LOG_FATAL("FdrTcpListener.SetNonBlock|soAccepted=", soAccepted.GetSocketHandle(), "|err=", GetSocketErrC());
+         fon9_LOGM_FATAL(LogModule_Io, "FdrTcpListener.SetNonBlock|soAccepted=", soAccepted.GetSocketHandle(), "|err=", GetSocketErrC());
          return;
       }
+   #endif
       SocketAddress  addrLocal;
       char           bufConnUID[kMaxTcpConnectionUID];
       addrLen = sizeof(addrLocal);
@@ -149,7 +232,13 @@ void FdrTcpListener::OnFdrEvent_Handling(FdrEventFlag evs) {
          soRes = SocketResult{"OverMaxConnections", std::errc::too_many_files_open};
       else if (soAccepted.SetSocketOptions(cfg.AcceptedSocketOptions_, soRes)) {
          if (SessionSP sesAccepted = server.OnDevice_Accepted()) {
+            // ListenPerThread: 連線使用與 listener 相同的 FdrThread.
+            FdrThreadSP thr = (cfg.IsListenPerThread_
+                               ? listener.GetFdrThread()
+                               : this->IoServiceSP_->AllocFdrThread(soAccepted.GetSocketHandle(),
+                                                                    cfg.AcceptedClientOptions_.IoThreadIndex_));
             DeviceSP dev{devAccepted = new AcceptedClient::Impl(*this,
+                                                                std::move(thr),
                                                                 std::move(soAccepted),
                                                                 std::move(sesAccepted),
                                                                 server.Manager_,
@@ -160,12 +249,15 @@ void FdrTcpListener::OnFdrEvent_Handling(FdrEventFlag evs) {
             soRes = SocketResult{"CreateSession", std::errc::operation_not_supported};
       }
       if (soRes.IsError() || devAccepted == nullptr) {
-         fon9_LOG_ERROR("TcpServer.Accepted"
+         fon9_LOGM_ERROR(LogModule_Io, "TcpServer.Accepted"
                         "|dev=", ToHex{devAccepted},
                         "|err=", soRes, '|', strConnUID);
+         // edge-triggered: 尚未 accept 到 EAGAIN, 要求再次觸發.
+         if (listener.IsFdrEdgeTriggered())
+            listener.RetriggerFdrEvent(FdrEventFlag::Readable);
          break;
       }
-      fon9_LOG_INFO("TcpServer.Accepted"
+      fon9_LOGM_INFO(LogModule_Io, "TcpServer.Accepted"
                     "|dev=", ToHex{devAccepted},
                     "|seq=", devAccepted->GetAcceptedClientSeq(),
                     '|', strConnUID);
@@ -174,6 +266,8 @@ void FdrTcpListener::OnFdrEvent_Handling(FdrEventFlag evs) {
 
 void FdrTcpListener::OnListener_Dispose() {
    this->RemoveFdrEvent();
+   for (SubListenerUP& sub : this->SubListeners_)
+      sub->RemoveFdrEvent();
 }
 fon9_WARN_POP;
 
@@ -5,6 +5,11 @@
 #include "fon9/io/FdrSocket.hpp"
 #include "fon9/io/TcpServerBase.hpp"
 
+fon9_BEFORE_INCLUDE_STD;
+#include <memory>
+#include <vector>
+fon9_AFTER_INCLUDE_STD;
+
 namespace fon9 { namespace io {
 
 class FdrTcpListener;
@@ -18,10 +23,17 @@ class fon9_API FdrTcpListener : public DeviceListener, public FdrEventHandler {
    fon9_NON_COPY_NON_MOVE(FdrTcpListener);
    using baseCounter = DeviceListener;
    class AcceptedClient;
+   /// ListenPerThread=Y 時, 在其他 FdrThread 上的 listener.
+   class SubListener;
+   using SubListenerUP = std::unique_ptr<SubListener>;
+   std::vector<SubListenerUP> SubListeners_;
 
-   FdrTcpListener(FdrServiceSP iosv, FdrTcpServerSP&& server, Socket&& soListen);
+   FdrTcpListener(FdrServiceSP iosv, FdrThreadSP thr, FdrTcpServerSP&& server, Socket&& soListen);
    virtual void OnListener_Dispose() override;
 
+   /// 處理 this 或 SubListeners_ 的 accept 事件.
+   void OnListenerEvent(FdrEventHandler& listener, FdrEventFlag evs);
+
    virtual FdrEventFlag GetRequiredFdrEventFlag() const override;
    virtual void OnFdrEvent_Handling(FdrEventFlag evs) override;
    virtual void OnFdrEvent_AddRef() override;
@@ -33,6 +45,8 @@ class fon9_API FdrTcpListener : public DeviceListener, public FdrEventHandler {
    friend FdrTcpServer;
 
 public:
+   ~FdrTcpListener();
+
    const FdrServiceSP   IoServiceSP_;
    const FdrTcpServerSP Server_;
    static DeviceListenerSP CreateListener(FdrTcpServerSP server, SocketResult& soRes);
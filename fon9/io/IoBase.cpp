@@ -78,6 +78,22 @@ ConfigParser::Result DeviceOptions::OnTagValue(StrView tag, StrView& value) {
       return ParseTimeIntervalToMS(value, this->LinkBrokenReopenInterval_);
    if (tag == "ClosedReopen")
       return ParseTimeIntervalToMS(value, this->ClosedReopenInterval_);
+   if (tag == "IoThread") {
+      this->IoThreadIndex_ = StrTo(value, int32_t{-1});
+      return ConfigParser::Result::Success;
+   }
+   if (tag == "CoalesceUS") {
+      this->CoalesceUS_ = StrTo(value, 0u);
+      return ConfigParser::Result::Success;
+   }
+   if (tag == "CoalesceBytes") {
+      this->CoalesceBytes_ = StrTo(value, 0u);
+      return ConfigParser::Result::Success;
+   }
+   if (tag == "CoalesceIov") {
+      this->CoalesceIov_ = StrTo(value, 0u);
+      return ConfigParser::Result::Success;
+   }
    return ConfigParser::Result::EUnknownTag;
 }
 
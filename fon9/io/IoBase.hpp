@@ -172,6 +172,14 @@ struct DeviceOptions {
    uint32_t    LinkBrokenReopenInterval_{3000};
    // 單位:ms, 0 表示進入 Closed 狀態後不用 reopen; 預設為 0.
    uint32_t    ClosedReopenInterval_{0};
+   // 指定使用 io service 的第幾個 thread, -1 表示由 io service 決定; 預設為 -1.
+   int32_t     IoThreadIndex_{-1};
+   // SendBuffered() 的合併送出(corking)延遲, 單位:us, 0 表示不延遲(立即喚醒 io thread 送出); 預設為 0.
+   uint32_t    CoalesceUS_{0};
+   // 合併送出時, 累積的資料量 >= CoalesceBytes_ 就立即送出, 0 表示不限制.
+   uint32_t    CoalesceBytes_{0};
+   // 合併送出時, 累積的 SendBuffered() 次數(約等於 writev 的 iovec 數量) >= CoalesceIov_ 就立即送出, 0 表示不限制.
+   uint32_t    CoalesceIov_{0};
 
    /// 設定屬性參數:
    /// - SendASAP=N        預設值為 'Y'，只要不是 'N' 就會設定成 Yes(若未設定，初始值為 Yes)。
@@ -181,6 +189,13 @@ struct DeviceOptions {
    ///   使用 TimeInterval 格式設定, 延遲最小單位為 ms, e.g.
    ///   "RetryInterval=3"    表示連線失敗後, 延遲  3 秒後重新連線.
    ///   "ReopenInterval=0.5" 表示斷線後, 延遲  0.5 秒後重新連線.
+   /// - IoThread=n        指定使用 io service 的第 n 個 thread(從0開始), 預設由 io service 決定.
+   ///   例如: 將流量大的行情連線固定在不同的 thread; 在下次建立連線時生效.
+   /// - CoalesceUS=n      SendBuffered() 合併送出的最長等候時間(us), 預設為 0=不等候.
+   /// - CoalesceBytes=n   累積資料量達到 n bytes 時, 不再等候, 立即送出.
+   /// - CoalesceIov=n     累積 SendBuffered() 次數達到 n 時, 不再等候, 立即送出.
+   ///   例如: "CoalesceUS=50|CoalesceBytes=16384|CoalesceIov=64"
+   ///   用在重視吞吐量的連線, 用幾十 us 的延遲, 換取較少的 send syscall; 在下次建立連線時生效.
    ConfigParser::Result OnTagValue(StrView tag, StrView& value);
 };
 fon9_WARN_POP;
@@ -41,6 +41,29 @@ ConfigParser::Result IoServiceArgs::OnTagValue(StrView tag, StrView& value) {
          this->CpuAffinity_.push_back(static_cast<uint32_t>(n));
       }
    }
+   else if (tag == "Engine") {
+      if (value == "epoll")
+         this->Engine_ = IoEngine::Epoll;
+      else if (value == "uring")
+         this->Engine_ = IoEngine::Uring;
+      else {
+         this->Engine_ = IoEngine::Default;
+         return ConfigParser::Result::EInvalidValue;
+      }
+   }
+   else if (tag == "ThreadAlloc") {
+      if (value == "LeastConn")
+         this->ThreadAlloc_ = IoThreadAlloc::LeastConn;
+      else if (value == "LeastBytes")
+         this->ThreadAlloc_ = IoThreadAlloc::LeastBytes;
+      else {
+         this->ThreadAlloc_ = IoThreadAlloc::Default;
+         if (value != "Fd")
+            return ConfigParser::Result::EInvalidValue;
+      }
+   }
+   else if (tag == "EdgeTrigger")
+      this->IsEdgeTriggered_ = (toupper(static_cast<unsigned char>(value.Get1st())) == 'Y');
    else
       return ConfigParser::Result::EUnknownTag;
    return ConfigParser::Result::Success;
@@ -13,7 +13,29 @@ fon9_AFTER_INCLUDE_STD;
 namespace fon9 { namespace io {
 
 /// \ingroup io
-/// args: "ThreadCount=n|Wait=Policy|Cpus=List|Capacity=0"
+/// io service 使用的底層事件機制.
+/// 目前僅 Linux 有選擇: Default = Epoll; 其他 OS 忽略此設定.
+enum class IoEngine : uint8_t {
+   Default,
+   Epoll,
+   /// 使用 io_uring, 若系統不支援(e.g. kernel 太舊, 或被 seccomp 禁止), 則改用 epoll.
+   Uring,
+};
+
+/// \ingroup io
+/// 建立新的 fd 事件處理者時, 如何選擇 io service thread.
+/// 目前僅 FdrService 支援; 若 Device 有設定 "IoThread=n", 則直接使用指定的 thread.
+enum class IoThreadAlloc : uint8_t {
+   /// 使用 [fd % ThreadCount] 決定.
+   Default,
+   /// 選擇目前 fd 事件處理者數量最少的 thread.
+   LeastConn,
+   /// 選擇最近一個取樣區間(約1秒)收送資料量最少的 thread.
+   LeastBytes,
+};
+
+/// \ingroup io
+/// args: "ThreadCount=n|Wait=Policy|Cpus=List|Capacity=0|Engine=epoll|ThreadAlloc=LeastConn|EdgeTrigger=N"
 /// Policy: Block(default)
 struct fon9_API IoServiceArgs {
    /// 若有設定 CpuAffinity, 則每個 io service thread 會綁定一個固定的 cpu, 而不是所有的 thread 共用這裡設定的 cpu.
@@ -30,6 +52,14 @@ struct fon9_API IoServiceArgs {
    /// 0 = 由 io service 自行決定最佳值.
    size_t   Capacity_{0};
 
+   IoEngine Engine_{IoEngine::Default};
+
+   IoThreadAlloc  ThreadAlloc_{IoThreadAlloc::Default};
+
+   /// 使用 edge-triggered 的事件通知, 目前僅 epoll 支援; 其他 engine 忽略此設定.
+   /// 可減少 Writable 啟用/關閉時的 epoll_ctl(MOD) 呼叫.
+   bool     IsEdgeTriggered_{false};
+
    IoServiceArgs() = default;
 
    int GetCpuAffinity(size_t threadPoolIndex) const {
@@ -45,6 +75,9 @@ struct fon9_API IoServiceArgs {
    /// Capacity    | >= 0
    /// Wait        | "Block" or "Busy" or "Yield"
    /// Cpus        | c0, c1, c2 ... 根據 thread pool index 依序選擇 c0 或 c1 或 c2...
+   /// Engine      | "epoll" or "uring"
+   /// ThreadAlloc | "Fd" or "LeastConn" or "LeastBytes"
+   /// EdgeTrigger | "Y" or "N"
    ConfigParser::Result OnTagValue(StrView tag, StrView& value);
 };
 
@@ -11,6 +11,12 @@ void RecvBuffer::Clear() {
       FreeNode(this->NodeReserve_);
       this->NodeReserve_ = nullptr;
    }
+   for (FwdBufferNode* node : this->BatchNodes_) {
+      if (node)
+         FreeNode(node);
+   }
+   this->BatchNodes_.clear();
+   this->RxTime_.AssignNull();
    this->Queue_.MoveOut();
 }
 
@@ -27,6 +33,36 @@ FwdBufferNode* RecvBuffer::AllocReserve(size_t expectSize) {
    return this->NodeReserve_;
 }
 
+FwdBufferNode* const* RecvBuffer::AllocBatchNodes(size_t count, size_t blockSize) {
+   if (this->BatchNodes_.size() < count)
+      this->BatchNodes_.resize(count, nullptr);
+   for (size_t L = 0; L < count; ++L) {
+      FwdBufferNode*& node = this->BatchNodes_[L];
+      if (node) {
+         assert(node->GetDataSize() == 0);
+         if (node->GetRemainSize() >= blockSize)
+            continue;
+         FreeNode(node);
+      }
+      node = FwdBufferNode::Alloc(blockSize);
+   }
+   return this->BatchNodes_.data();
+}
+DcQueueList& RecvBuffer::SetBlocksReceived(const size_t* rxszs, size_t count) {
+   assert(this->State_ == RecvBufferState::NotInUse && count <= this->BatchNodes_.size());
+   this->State_ = RecvBufferState::InvokingEvent;
+   for (size_t L = 0; L < count; ++L) {
+      if (rxszs[L] <= 0)
+         continue;
+      FwdBufferNode* node = this->BatchNodes_[L];
+      assert(rxszs[L] <= node->GetRemainSize());
+      node->SetDataEnd(node->GetDataEnd() + rxszs[L]);
+      this->Queue_.push_back(node);
+      this->BatchNodes_[L] = nullptr;
+   }
+   return this->Queue_;
+}
+
 //-------------------------------------------------------------------//
 
 static size_t SetNodeDataReceived(FwdBufferNode* node, const size_t rxsz) {
@@ -5,6 +5,11 @@
 #include "fon9/io/IoBase.hpp"
 #include "fon9/buffer/DcQueueList.hpp"
 #include "fon9/buffer/FwdBufferList.hpp"
+#include "fon9/TimeStamp.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <vector>
+fon9_AFTER_INCLUDE_STD;
 
 namespace fon9 { namespace io {
 
@@ -32,8 +37,13 @@ class fon9_API RecvBuffer {
    FwdBufferNode*    NodeBack_{nullptr};
    FwdBufferNode*    NodeReserve_{nullptr};
    RecvBufferState   State_{RecvBufferState::NotInUse};
+   /// 批次接收(e.g. recvmmsg)使用的區塊, 未收到資料的區塊會保留給下次使用;
+   /// 已移入 Queue_ 的區塊為 nullptr, 下次 AllocBatchNodes() 時補上.
+   std::vector<FwdBufferNode*>   BatchNodes_;
+   TimeStamp         RxTime_{TimeStamp::Null()};
 
    FwdBufferNode* AllocReserve(size_t expectSize);
+   FwdBufferNode* const* AllocBatchNodes(size_t count, size_t blockSize);
 
 public:
    RecvBuffer() {
@@ -85,6 +95,21 @@ public:
       return static_cast<size_t>(piov - vect);
    }
 
+   /// 批次接收(例: recvmmsg()): 取得 count 個各自獨立的空白資料區塊, 每個區塊的可用容量必定 >= blockSize.
+   /// - 每個區塊用來接收一個 datagram.
+   /// - 不改變狀態, 收到資料後透過 SetBlocksReceived() 進入 RecvBufferState::InvokingEvent 狀態.
+   template <typename T>
+   void GetRecvBlocks(T* vect, size_t count, size_t blockSize) {
+      assert(this->State_ == RecvBufferState::NotInUse);
+      FwdBufferNode* const* nodes = this->AllocBatchNodes(count, blockSize);
+      for (size_t L = 0; L < count; ++L)
+         fon9_PutIoVectorElement(vect + L, nodes[L]->GetDataEnd(), nodes[L]->GetRemainSize());
+   }
+   /// 批次接收完成: rxszs[i] 為 GetRecvBlocks() 第 i 個區塊收到的資料量.
+   /// 有收到資料的區塊, 依序移入接收佇列, 然後進入 RecvBufferState::InvokingEvent 狀態.
+   /// \return 存放接收資料的 DcQueueList.
+   DcQueueList& SetBlocksReceived(const size_t* rxszs, size_t count);
+
    /// 當資料接收完成, 透過這裡設定接收到的資料量, 然後進入 RecvBufferState::InvokingEvent 狀態.
    /// \return 存放接收資料的 DcQueueList.
    DcQueueList& SetDataReceived(size_t rxsz);
@@ -100,6 +125,17 @@ public:
       this->State_ = RecvBufferState::WaitingEventInvoke;
    }
 
+   /// 若 socket 有啟用 RxTimestamp(SO_TIMESTAMPING), 則為 kernel 收到「最後一次接收的資料」的時間.
+   /// 批次接收(recvmmsg)時, 為該批第一個 datagram 的時間.
+   /// 未啟用則為 TimeStamp::Null();
+   /// 在 Session::OnDevice_Recv(dev, rxbuf) 裡面可透過 RecvBuffer::StaticCast(rxbuf).GetRxTime(); 取得.
+   TimeStamp GetRxTime() const {
+      return this->RxTime_;
+   }
+   void SetRxTime(TimeStamp rxTime) {
+      this->RxTime_ = rxTime;
+   }
+
    bool IsInvokingEvent() const {
       return(this->State_ >= RecvBufferState::InvokingEvent);
    }
@@ -123,6 +123,9 @@ public:
    /// \retval ==RecvBufferSize::Default     由 Device 自行決定如何處理緩衝區大小.
    /// \retval ==RecvBufferSize::NoRecvEvent 不用再收任何資料.
    /// \retval ==RecvBufferSize::CloseRecv   關閉接收端.
+   ///
+   /// 若 socket 有設定 "RxTimestamp=Y", 則可透過 `RecvBuffer::StaticCast(rxbuf).GetRxTime()`
+   /// 取得 kernel 收到資料的時間, 用來計算 wire-to-handler 的延遲.
    virtual RecvBufferSize OnDevice_Recv(Device& dev, DcQueueList& rxbuf);
 
    /// 在 LinkReady 之後, 或 f9io_State_Initialized(在 OnDevice_BeforeOpen() 通知時),
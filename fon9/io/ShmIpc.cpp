@@ -0,0 +1,675 @@
+﻿/// \file fon9/io/ShmIpc.cpp
+/// \author fonwinz@gmail.com
+#ifdef __linux__
+#include "fon9/io/ShmIpc.hpp"
+#include "fon9/io/DeviceRecvEvent.hpp"
+#include "fon9/io/DeviceStartSend.hpp"
+#include "fon9/SleepPolicy.hpp"
+#include "fon9/RevPrint.hpp"
+#include "fon9/StrTo.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <climits>
+#include <new>
+
+namespace fon9 { namespace io {
+
+#define fon9_ShmIpc_Magic        0x66394950 // "f9IP"
+#define fon9_ShmIpc_Version      1
+#define fon9_ShmIpc_DataAlign    4096
+#define fon9_ShmIpc_MinRingSize  4096
+#define fon9_ShmIpc_DefRingSize  (1024 * 1024)
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "ShmIpc: std::atomic<> 必須是 lock free, 才能在 process 之間共用.");
+
+/// 放在 shm 裡面, 每端一個.
+struct ShmIpcSide {
+   /// 喚醒此端 thread 用的 futex.
+   alignas(64) std::atomic<uint32_t> Doorbell_;
+   /// 此端 thread 是否正在(或即將)睡眠; 若是, 則對方必須透過 Doorbell_ 喚醒.
+   std::atomic<uint32_t> IsWaiting_;
+   /// 此端的 ring 已滿, 尚有資料等候傳送: 對方取出資料後, 需要喚醒此端.
+   std::atomic<uint32_t> IsTxPending_;
+   /// 此端已關閉.
+   std::atomic<uint32_t> IsClosed_;
+   /// 此端的 process id, 0 表示尚未連入.
+   std::atomic<int32_t>  Pid_;
+};
+struct ShmIpcRing {
+   /// 寫入端(producer)已寫入的總量.
+   alignas(64) std::atomic<uint64_t> Head_;
+   /// 讀取端(consumer)已取出的總量.
+   alignas(64) std::atomic<uint64_t> Tail_;
+};
+struct ShmIpcHeader {
+   uint32_t    Magic_;
+   uint32_t    Version_;
+   uint64_t    RingSize_;
+   /// Server 設定好全部的內容後, 才設定此旗標, Client 才能連入.
+   std::atomic<uint32_t>   IsReady_;
+   /// [0] = Server; [1] = Client;
+   ShmIpcSide  Sides_[2];
+   /// [0] = Server->Client; [1] = Client->Server;
+   ShmIpcRing  Rings_[2];
+
+   static constexpr size_t DataOffset() {
+      return (sizeof(ShmIpcHeader) + fon9_ShmIpc_DataAlign - 1) / fon9_ShmIpc_DataAlign * fon9_ShmIpc_DataAlign;
+   }
+   static size_t CalcMapSize(uint64_t ringSize) {
+      return DataOffset() + static_cast<size_t>(ringSize * 2);
+   }
+   byte* GetRingData(unsigned idx) {
+      return reinterpret_cast<byte*>(this) + DataOffset() + this->RingSize_ * idx;
+   }
+};
+
+static void FutexWait(std::atomic<uint32_t>& word, uint32_t val, const struct timespec* ts) {
+   // shm 的 futex 必須在 process 之間共用, 所以不能用 FUTEX_WAIT_PRIVATE;
+   // word != val 時會立即返回(EAGAIN), 所以不會遺漏 RingDoorbell().
+   syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, val, ts, nullptr, 0);
+}
+static void RingDoorbell(ShmIpcSide& side) {
+   side.Doorbell_.fetch_add(1, std::memory_order_release);
+   syscall(SYS_futex, reinterpret_cast<uint32_t*>(&side.Doorbell_), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+static bool IsProcessAlive(int32_t pid) {
+   return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+static std::string ErrnoToMsg(StrView head) {
+   return RevPrintTo<std::string>(head, "|err=", GetSysErrC());
+}
+/// 檢查已存在的 shm 是否仍被其他 Server 使用.
+/// \retval 0  shm 不存在, 或為殘留(Server 已關閉或已結束)的 shm, 可以移除.
+/// \retval >0 仍在使用中的 Server pid.
+static int32_t GetAliveServerPid(const std::string& shmName) {
+   int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+   if (fd < 0)
+      return 0;
+   int32_t     svrpid = 0;
+   struct stat st;
+   if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= sizeof(ShmIpcHeader)) {
+      void* addr = mmap(nullptr, sizeof(ShmIpcHeader), PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+         const ShmIpcHeader* hdr = reinterpret_cast<const ShmIpcHeader*>(addr);
+         if (hdr->Magic_ == fon9_ShmIpc_Magic
+             && hdr->Sides_[0].IsClosed_.load(std::memory_order_acquire) == 0) {
+            svrpid = hdr->Sides_[0].Pid_.load(std::memory_order_acquire);
+            if (!IsProcessAlive(svrpid))
+               svrpid = 0;
+         }
+         munmap(addr, sizeof(ShmIpcHeader));
+      }
+   }
+   close(fd);
+   return svrpid;
+}
+
+//--------------------------------------------------------------------------//
+ShmIpc::Config::Config() : RingSize_{fon9_ShmIpc_DefRingSize} {
+}
+ShmIpc::Impl::Impl(ShmIpc& owner, const Config& cfg)
+   : Owner_{&owner}
+   , ShmName_{"/fon9shm." + cfg.Name_}
+   , Role_{cfg.Role_}
+   , HowWait_{cfg.SvcArgs_.HowWait_} {
+}
+ShmIpc::Impl::~Impl() {
+   assert(!this->Thread_.joinable());
+   if (this->MapAddr_)
+      munmap(this->MapAddr_, this->MapSize_);
+}
+bool ShmIpc::Impl::Map(const Config& cfg, std::string& errmsg) {
+   int      fd;
+   uint64_t ringSize = 0;
+   if (this->Role_ == Role::Server) {
+      // 移除上次(可能因 crash)殘留的 shm; 但若 Server 仍在執行中, 則不可移除.
+      if (const int32_t svrpid = GetAliveServerPid(this->ShmName_)) {
+         errmsg = RevPrintTo<std::string>("Server exists|pid=", svrpid);
+         return false;
+      }
+      shm_unlink(this->ShmName_.c_str());
+      if ((fd = shm_open(this->ShmName_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600)) < 0) {
+         errmsg = ErrnoToMsg("shm_open");
+         return false;
+      }
+      ringSize = fon9_ShmIpc_MinRingSize;
+      while (ringSize < cfg.RingSize_)
+         ringSize <<= 1;
+      this->MapSize_ = ShmIpcHeader::CalcMapSize(ringSize);
+      if (ftruncate(fd, static_cast<off_t>(this->MapSize_)) != 0) {
+         errmsg = ErrnoToMsg("ftruncate");
+         close(fd);
+         shm_unlink(this->ShmName_.c_str());
+         return false;
+      }
+   }
+   else {
+      if ((fd = shm_open(this->ShmName_.c_str(), O_RDWR, 0)) < 0) {
+         errmsg = ErrnoToMsg("shm_open");
+         return false;
+      }
+      struct stat st;
+      if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < ShmIpcHeader::DataOffset()) {
+         errmsg = "Bad shm size";
+         close(fd);
+         return false;
+      }
+      this->MapSize_ = static_cast<size_t>(st.st_size);
+   }
+   this->MapAddr_ = mmap(nullptr, this->MapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (this->MapAddr_ == MAP_FAILED) {
+      this->MapAddr_ = nullptr;
+      errmsg = ErrnoToMsg("mmap");
+      if (this->Role_ == Role::Server)
+         shm_unlink(this->ShmName_.c_str());
+      return false;
+   }
+   ShmIpcHeader* hdr;
+   const int32_t mypid = static_cast<int32_t>(getpid());
+   if (this->Role_ == Role::Server) {
+      // ftruncate() 之後的內容全為 0, 所以只需設定非 0 的欄位.
+      hdr = new (this->MapAddr_) ShmIpcHeader;
+      hdr->Magic_ = fon9_ShmIpc_Magic;
+      hdr->Version_ = fon9_ShmIpc_Version;
+      hdr->RingSize_ = ringSize;
+      hdr->Sides_[0].Pid_.store(mypid, std::memory_order_relaxed);
+      hdr->IsReady_.store(1, std::memory_order_release);
+   }
+   else {
+      hdr = reinterpret_cast<ShmIpcHeader*>(this->MapAddr_);
+      if (hdr->IsReady_.load(std::memory_order_acquire) == 0
+          || hdr->Magic_ != fon9_ShmIpc_Magic
+          || hdr->Version_ != fon9_ShmIpc_Version) {
+         errmsg = "Server not ready";
+         return false;
+      }
+      ringSize = hdr->RingSize_;
+      if (this->MapSize_ < ShmIpcHeader::CalcMapSize(ringSize)) {
+         errmsg = "Bad shm size";
+         return false;
+      }
+      const int32_t svrpid = hdr->Sides_[0].Pid_.load(std::memory_order_acquire);
+      if (hdr->Sides_[0].IsClosed_.load(std::memory_order_acquire) || !IsProcessAlive(svrpid)) {
+         errmsg = "Server closed";
+         return false;
+      }
+      // 每個 shm 只允許一個 Client 連入, 斷線後必須等 Server 重建 shm,
+      // 避免新的 Client 收到前一個 Client 殘留在 ring 裡面的資料.
+      int32_t expected = 0;
+      if (!hdr->Sides_[1].Pid_.compare_exchange_strong(expected, mypid, std::memory_order_acq_rel)) {
+         errmsg = RevPrintTo<std::string>("Client exists|pid=", expected);
+         return false;
+      }
+      this->PeerPid_ = svrpid;
+   }
+   const unsigned myIdx = static_cast<unsigned>(this->Role_);
+   this->Header_ = hdr;
+   this->MySide_ = &hdr->Sides_[myIdx];
+   this->PeerSide_ = &hdr->Sides_[myIdx ^ 1];
+   this->TxRing_ = &hdr->Rings_[myIdx];
+   this->RxRing_ = &hdr->Rings_[myIdx ^ 1];
+   this->TxData_ = hdr->GetRingData(myIdx);
+   this->RxData_ = hdr->GetRingData(myIdx ^ 1);
+   this->RingMask_ = ringSize - 1;
+   if (this->Role_ == Role::Client)
+      RingDoorbell(*this->PeerSide_); // 通知 Server: Client 已連入.
+   return true;
+}
+void ShmIpc::Impl::MarkClosed() {
+   if (this->MySide_ == nullptr)
+      return;
+   this->MySide_->IsClosed_.store(1, std::memory_order_release);
+   RingDoorbell(*this->PeerSide_);
+   if (this->Role_ == Role::Server)
+      shm_unlink(this->ShmName_.c_str());
+}
+void ShmIpc::Impl::StartThread(const Config& cfg) {
+   ServiceThreadArgs args{cfg.SvcArgs_, "ShmIpc." + cfg.Name_, 0};
+   this->Thread_ = std::thread(&Impl::ThrRun, ImplSP{this}, std::move(args));
+}
+void ShmIpc::Impl::StopThread() {
+   this->IsStopping_.store(true, std::memory_order_release);
+   this->WakeupSelf();
+   if (!this->Thread_.joinable())
+      return;
+   if (this->Thread_.get_id() == std::this_thread::get_id())
+      this->Thread_.detach();
+   else
+      this->Thread_.join();
+}
+void ShmIpc::Impl::AsyncSetBroken(std::string cause) {
+   ImplSP impl{this};
+   this->Owner_->OpQueue_.AddTask(DeviceAsyncOp{[impl, cause](Device& dev) {
+      if (static_cast<ShmIpc*>(&dev)->ImplSP_ == impl)
+         OpThr_SetBrokenState(dev, cause);
+   }});
+}
+//--------------------------------------------------------------------------//
+void ShmIpc::Impl::WakeupSelf() {
+   if (this->MySide_ == nullptr)
+      return;
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (this->MySide_->IsWaiting_.load(std::memory_order_relaxed))
+      RingDoorbell(*this->MySide_);
+}
+void ShmIpc::Impl::NotifyPeer() {
+   // 與 ThrRun() 睡眠前的 fence 配對:
+   // 對方必定能看到此端寫入的 Head_; 或此端必定能看到對方的 IsWaiting_.
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (fon9_UNLIKELY(this->PeerSide_->IsWaiting_.load(std::memory_order_relaxed)))
+      RingDoorbell(*this->PeerSide_);
+}
+void ShmIpc::Impl::NotifyPeerTxFreed() {
+   // 只有在對方有資料等候傳送時, 才需要喚醒;
+   // 與 FlushPendingTxLocked() 設定 IsTxPending_ 之後的 fence 配對.
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (fon9_UNLIKELY(this->PeerSide_->IsTxPending_.load(std::memory_order_relaxed)
+                     && this->PeerSide_->IsWaiting_.load(std::memory_order_relaxed)))
+      RingDoorbell(*this->PeerSide_);
+}
+size_t ShmIpc::Impl::GetTxFree() const {
+   const uint64_t head = this->TxRing_->Head_.load(std::memory_order_relaxed);
+   const uint64_t tail = this->TxRing_->Tail_.load(std::memory_order_acquire);
+   return static_cast<size_t>(this->RingMask_ + 1 - (head - tail));
+}
+size_t ShmIpc::Impl::WriteRing(const void* src, size_t size) {
+   const uint64_t head = this->TxRing_->Head_.load(std::memory_order_relaxed);
+   const uint64_t tail = this->TxRing_->Tail_.load(std::memory_order_acquire);
+   const size_t   szFree = static_cast<size_t>(this->RingMask_ + 1 - (head - tail));
+   if (size > szFree)
+      size = szFree;
+   if (size <= 0)
+      return 0;
+   const size_t pos = static_cast<size_t>(head & this->RingMask_);
+   const size_t sz1 = static_cast<size_t>(this->RingMask_ + 1 - pos);
+   if (fon9_LIKELY(size <= sz1))
+      memcpy(this->TxData_ + pos, src, size);
+   else {
+      memcpy(this->TxData_ + pos, src, sz1);
+      memcpy(this->TxData_, reinterpret_cast<const byte*>(src) + sz1, size - sz1);
+   }
+   this->TxRing_->Head_.store(head + size, std::memory_order_release);
+   return size;
+}
+bool ShmIpc::Impl::FlushPendingTxLocked() {
+   bool isWritten = false;
+   for (;;) {
+      while (!this->PendingTx_.empty()) {
+         auto   blk = this->PendingTx_.PeekCurrBlock();
+         size_t wrsz = this->WriteRing(blk.first, blk.second);
+         if (wrsz <= 0)
+            break;
+         isWritten = true;
+         this->PendingTx_.PopConsumed(wrsz);
+      }
+      if (this->PendingTx_.empty()) {
+         if (this->MySide_->IsTxPending_.load(std::memory_order_relaxed))
+            this->MySide_->IsTxPending_.store(0, std::memory_order_relaxed);
+         break;
+      }
+      // 設定 IsTxPending_ 之後再檢查一次 ring 的剩餘空間:
+      // 避免對方在設定 IsTxPending_ 之前取走資料, 因而沒有喚醒此端.
+      this->MySide_->IsTxPending_.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (this->GetTxFree() <= 0)
+         break;
+   }
+   if (isWritten)
+      this->NotifyPeer();
+   return isWritten;
+}
+void ShmIpc::Impl::SendLocked(const void* src, size_t size) {
+   size_t wrsz = 0;
+   if (fon9_LIKELY(this->PendingTx_.empty())) {
+      wrsz = this->WriteRing(src, size);
+      if (fon9_LIKELY(wrsz == size)) {
+         this->NotifyPeer();
+         return;
+      }
+      src = reinterpret_cast<const byte*>(src) + wrsz;
+      size -= wrsz;
+   }
+   FwdBufferList buf{0};
+   memcpy(buf.AllocBuffer(size), src, size);
+   this->PendingTx_.push_back(buf.MoveOut());
+   // ring 已滿時 FlushPendingTxLocked() 不會寫入, 也就不會喚醒對方;
+   // 此時若已寫入部分資料, 仍要喚醒對方, 否則對方要等到 futex timeout 才會取出.
+   if (!this->FlushPendingTxLocked() && wrsz > 0)
+      this->NotifyPeer();
+}
+void ShmIpc::Impl::SendLocked(DcQueueList& txbuf) {
+   this->PendingTx_.push_back(txbuf.MoveOut());
+   this->FlushPendingTxLocked();
+}
+bool ShmIpc::Impl::FlushPendingTx() {
+   if (fon9_LIKELY(this->MySide_->IsTxPending_.load(std::memory_order_relaxed) == 0))
+      return false;
+   std::lock_guard<std::mutex> lk{this->TxMutex_};
+   return this->FlushPendingTxLocked();
+}
+//--------------------------------------------------------------------------//
+void ShmIpc::Impl::ContinueRecv(RecvBufferSize expectSize, bool isReEnable) {
+   this->RecvSize_.store(expectSize, std::memory_order_relaxed);
+   if (isReEnable) {
+      this->IsRecvPaused_.store(false, std::memory_order_release);
+      this->WakeupSelf();
+   }
+}
+bool ShmIpc::Impl::CheckRecv() {
+   if (this->IsRecvPaused_.load(std::memory_order_acquire))
+      return false;
+   const uint64_t head = this->RxRing_->Head_.load(std::memory_order_acquire);
+   uint64_t       tail = this->RxRing_->Tail_.load(std::memory_order_relaxed);
+   if (head == tail)
+      return false;
+   const RecvBufferSize rsz = this->RecvSize_.load(std::memory_order_relaxed);
+   if (fon9_UNLIKELY(rsz < RecvBufferSize::Default)) {
+      // Session 不接收資料(NoRecvEvent...), 直接丟棄, 避免對方的 ring 塞滿.
+      this->RxRing_->Tail_.store(head, std::memory_order_release);
+      this->NotifyPeerTxFreed();
+      return true;
+   }
+   size_t szAvail = static_cast<size_t>(head - tail);
+   size_t expsz = (rsz > RecvBufferSize::Default ? static_cast<size_t>(rsz) : 1024);
+   if (expsz < szAvail)
+      expsz = (szAvail < 1024 * 64 ? szAvail : 1024 * 64);
+   iovec  blks[2];
+   size_t blkc = this->RxBuffer_.GetRecvBlockVector(blks, expsz);
+   size_t rxsz = 0;
+   for (size_t L = 0; L < blkc && szAvail > 0; ++L) {
+      byte*  dst = reinterpret_cast<byte*>(blks[L].iov_base);
+      size_t dstsz = (blks[L].iov_len < szAvail ? blks[L].iov_len : szAvail);
+      szAvail -= dstsz;
+      rxsz += dstsz;
+      while (dstsz > 0) {
+         const size_t pos = static_cast<size_t>(tail & this->RingMask_);
+         size_t       sz1 = static_cast<size_t>(this->RingMask_ + 1 - pos);
+         if (sz1 > dstsz)
+            sz1 = dstsz;
+         memcpy(dst, this->RxData_ + pos, sz1);
+         dst += sz1;
+         dstsz -= sz1;
+         tail += sz1;
+      }
+   }
+   this->RxRing_->Tail_.store(tail, std::memory_order_release);
+   this->NotifyPeerTxFreed();
+
+   struct Aux {
+      /// 若 DeviceRecvBufferReady() 沒有呼叫 ContinueRecv() 或 DisableReadableEvent(),
+      /// 表示已經斷線(NoLink), 此時應暫停接收.
+      mutable bool IsHandled_{false};
+      static Impl& GetImpl(RecvBuffer& rbuf) {
+         return ContainerOf(rbuf, &Impl::RxBuffer_);
+      }
+      bool IsRecvBufferAlive(Device& dev, RecvBuffer& rbuf) const {
+         return static_cast<ShmIpc*>(&dev)->ImplSP_.get() == &GetImpl(rbuf);
+      }
+      void ContinueRecv(RecvBuffer& rbuf, RecvBufferSize expectSize, bool isReEnableReadable) const {
+         this->IsHandled_ = true;
+         GetImpl(rbuf).ContinueRecv(expectSize, isReEnableReadable);
+      }
+      void DisableReadableEvent(RecvBuffer& rbuf) {
+         this->IsHandled_ = true;
+         // OnDevice_Recv() 移到 op thread 處理, 在處理完畢(ContinueRecv(isReEnable=true))之前, 暫停接收.
+         GetImpl(rbuf).IsRecvPaused_.store(true, std::memory_order_relaxed);
+      }
+      SendDirectResult SendDirect(RecvDirectArgs& e, BufferList&& txbuf) {
+         Impl&       impl = GetImpl(RecvBuffer::StaticCast(e.RecvBuffer_));
+         DcQueueList dcq{std::move(txbuf)};
+         std::lock_guard<std::mutex> lk{impl.TxMutex_};
+         impl.SendLocked(dcq);
+         return SendDirectResult::Sent;
+      }
+   };
+   Aux aux;
+   DeviceRecvBufferReady(*this->Owner_, this->RxBuffer_.SetDataReceived(rxsz), aux);
+   if (!aux.IsHandled_)
+      this->IsRecvPaused_.store(true, std::memory_order_relaxed);
+   return true;
+}
+//--------------------------------------------------------------------------//
+bool ShmIpc::Impl::CheckPeerAlive() {
+   const TimeStamp now = UtcNow();
+   if (now - this->LastAliveCheck_ < TimeInterval_Second(1))
+      return true;
+   this->LastAliveCheck_ = now;
+   if (this->PeerPid_ == 0 || IsProcessAlive(this->PeerPid_))
+      return true;
+   this->AsyncSetBroken(RevPrintTo<std::string>("ShmIpc.PeerGone|pid=", this->PeerPid_));
+   return false;
+}
+bool ShmIpc::Impl::CheckPeer() {
+   if (fon9_UNLIKELY(this->PeerPid_ == 0)) {
+      // Server 等候 Client 連入.
+      const int32_t pid = this->PeerSide_->Pid_.load(std::memory_order_acquire);
+      if (pid == 0)
+         return true;
+      this->PeerPid_ = pid;
+      ImplSP impl{this};
+      this->Owner_->OpQueue_.AddTask(DeviceAsyncOp{[impl](Device& dev) {
+         if (static_cast<ShmIpc*>(&dev)->ImplSP_ == impl)
+            OpThr_SetLinkReady(dev, std::string{});
+      }});
+   }
+   if (fon9_LIKELY(this->PeerSide_->IsClosed_.load(std::memory_order_acquire) == 0))
+      return true;
+   this->AsyncSetBroken("ShmIpc.PeerClosed");
+   return false;
+}
+bool ShmIpc::Impl::IsIdle() const {
+   if (this->IsStopping_.load(std::memory_order_relaxed))
+      return false;
+   if (this->PeerSide_->IsClosed_.load(std::memory_order_relaxed))
+      return false;
+   if (this->PeerPid_ == 0 && this->PeerSide_->Pid_.load(std::memory_order_relaxed) != 0)
+      return false;
+   if (this->MySide_->IsTxPending_.load(std::memory_order_relaxed) && this->GetTxFree() > 0)
+      return false;
+   if (this->IsRecvPaused_.load(std::memory_order_relaxed))
+      return true;
+   return this->RxRing_->Head_.load(std::memory_order_relaxed) == this->RxRing_->Tail_.load(std::memory_order_relaxed);
+}
+void ShmIpc::Impl::ThrRun(ServiceThreadArgs args) {
+   args.OnThrRunBegin("ShmIpc");
+   enum : unsigned {
+      /// Block 模式: 睡眠前先讓出 cpu 幾次, 避免對方每次送出資料都要喚醒此端.
+      kSpinCount = 16,
+      /// Busy, Yield 模式: 閒置一段時間後, 才檢查對方的 process 是否還在.
+      kCheckAliveCount = 1024 * 16,
+   };
+   unsigned idleCount = 0;
+   while (!this->IsStopping_.load(std::memory_order_acquire)) {
+      if (!this->CheckPeer())
+         break;
+      const bool isTx = this->FlushPendingTx();
+      if (this->CheckRecv() || isTx) {
+         idleCount = 0;
+         continue;
+      }
+      ++idleCount;
+      switch (this->HowWait_) {
+      case HowWait::Busy:
+      case HowWait::Yield:
+         if (this->HowWait_ == HowWait::Yield)
+            YieldSleepPolicy::Sleep();
+         if (idleCount % kCheckAliveCount == 0 && !this->CheckPeerAlive())
+            goto __THR_END;
+         break;
+      default:
+         if (idleCount < kSpinCount) {
+            std::this_thread::yield();
+            break;
+         }
+         const uint32_t bell = this->MySide_->Doorbell_.load(std::memory_order_acquire);
+         this->MySide_->IsWaiting_.store(1, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (this->IsIdle()) {
+            static const struct timespec kWaitTimeout{1, 0};
+            FutexWait(this->MySide_->Doorbell_, bell, &kWaitTimeout);
+         }
+         this->MySide_->IsWaiting_.store(0, std::memory_order_relaxed);
+         if (!this->CheckPeerAlive())
+            goto __THR_END;
+         break;
+      }
+   }
+__THR_END:
+   fon9_LOG_ThrRun("ShmIpc.ThrRun.End|name=", args.Name_);
+}
+//--------------------------------------------------------------------------//
+void ShmIpc::OpImpl_AppendDeviceInfo(std::string& info) {
+   if (this->OpImpl_GetState() != State::LinkReady)
+      return;
+   if (auto impl = this->ImplSP_.get()) {
+      RevPrintAppendTo(info,
+                       "RingSize=", impl->RingMask_ + 1,
+                       "|Tx=", impl->TxRing_->Head_.load(std::memory_order_relaxed),
+                       "|Rx=", impl->RxRing_->Tail_.load(std::memory_order_relaxed),
+                       "|PeerPid=", impl->PeerPid_);
+      if (impl->MySide_->IsTxPending_.load(std::memory_order_relaxed))
+         info.append("|TxPending");
+   }
+}
+void ShmIpc::OpImpl_StartRecv(RecvBufferSize preallocSize) {
+   assert(this->ImplSP_);
+   this->ImplSP_->ContinueRecv(preallocSize, true);
+}
+void ShmIpc::OpImpl_StopRunning() {
+   if (auto impl = this->ImplSP_.get()) {
+      impl->MarkClosed();
+      impl->StopThread();
+      this->ImplSP_.reset();
+   }
+}
+void ShmIpc::OpImpl_Close(std::string cause) {
+   this->OpImpl_StopRunning();
+   this->OpImpl_SetState(State::Closed, &cause);
+}
+void ShmIpc::OpImpl_Reopen() {
+   this->OpImpl_StopRunning();
+   this->OpenImpl();
+}
+void ShmIpc::OpImpl_Open(const std::string cfgstr) {
+   this->OpImpl_StopRunning();
+   Config  cfg;
+   StrView cfgpr{&cfgstr};
+   StrView tag, value;
+   while (StrFetchTagValue(cfgpr, tag, value)) {
+      if (tag == "Name")
+         cfg.Name_ = value.ToString();
+      else if (tag == "Role") {
+         if (value == "Server")
+            cfg.Role_ = Role::Server;
+         else if (value == "Client")
+            cfg.Role_ = Role::Client;
+         else {
+            this->OpImpl_SetState(State::ConfigError, ToStrView(RevPrintTo<std::string>(
+               "Unknown Role=", value
+               )));
+            return;
+         }
+      }
+      else if (tag == "RingSize")
+         cfg.RingSize_ = StrTo(value, cfg.RingSize_);
+      else if (cfg.SvcArgs_.OnTagValue(tag, value) != ConfigParser::Result::Success) {
+         this->OpImpl_SetState(State::ConfigError, ToStrView(RevPrintTo<std::string>(
+            "Unknown '", tag, '=', value, '\''
+            )));
+         return;
+      }
+   }
+   if (cfg.Name_.empty() || cfg.Name_.find('/') != std::string::npos) {
+      this->OpImpl_SetState(State::ConfigError, "ShmIpc.Open|err=Invalid Name.");
+      return;
+   }
+   OpThr_SetDeviceId(*this, cfg.Name_ + (cfg.Role_ == Role::Server ? "|Server" : "|Client"));
+   this->Config_ = std::move(cfg);
+   this->OpImpl_SetState(State::Opening, &cfgstr);
+   this->OpenImpl();
+}
+void ShmIpc::OpenImpl() {
+   assert(this->ImplSP_.get() == nullptr);
+   ImplSP      impl{new Impl{*this, this->Config_}};
+   std::string errmsg;
+   if (!impl->Map(this->Config_, errmsg)) {
+      this->OpImpl_SetState(State::LinkError, ToStrView(RevPrintTo<std::string>(
+         "ShmIpc.Open|name=", impl->ShmName_, '|', errmsg
+         )));
+      return;
+   }
+   this->ImplSP_ = impl;
+   impl->StartThread(this->Config_);
+   if (impl->Role_ == Role::Server)
+      this->OpImpl_SetState(State::WaitingLinkIn, ToStrView(impl->ShmName_));
+   else
+      OpThr_SetLinkReady(*this, std::string{});
+}
+//--------------------------------------------------------------------------//
+bool ShmIpc::IsSendBufferEmpty() const {
+   bool res;
+   this->OpQueue_.InplaceOrWait(AQueueTaskKind::Send, DeviceAsyncOp{[&res](Device& dev) {
+      if (auto impl = static_cast<ShmIpc*>(&dev)->ImplSP_.get()) {
+         std::lock_guard<std::mutex> lk{impl->TxMutex_};
+         res = impl->PendingTx_.empty() && impl->GetTxFree() == impl->RingMask_ + 1;
+      }
+      else
+         res = true;
+   }});
+   return res;
+}
+// 寫入 ring 就相當於送出, 沒有 system call 的負擔, 所以 SendBuffered() 與 SendASAP() 相同.
+ShmIpc::SendResult ShmIpc::SendBuffered(const void* src, size_t size) {
+   return this->SendASAP(src, size);
+}
+ShmIpc::SendResult ShmIpc::SendBuffered(BufferList&& src) {
+   return this->SendASAP(std::move(src));
+}
+ShmIpc::SendResult ShmIpc::SendASAP(const void* src, size_t size) {
+   if (size <= 0)
+      return SendResult{0};
+   StartSendChecker sc;
+   if (fon9_LIKELY(sc.IsLinkReady(*this))) {
+      if (fon9_LIKELY(sc.IsAllowInplace())) {
+         assert(this->ImplSP_);
+         std::lock_guard<std::mutex> lk{this->ImplSP_->TxMutex_};
+         this->ImplSP_->SendLocked(src, size);
+      }
+      else {
+         FwdBufferList buf{0};
+         memcpy(buf.AllocBuffer(size), src, size);
+         sc.AsyncSend(MakeObjHolder<BufferList>(buf.MoveOut()));
+      }
+      return SendResult{0};
+   }
+   return SendResult{std::errc::no_link};
+}
+ShmIpc::SendResult ShmIpc::SendASAP(BufferList&& src) {
+   if (src.empty())
+      return SendResult{0};
+   StartSendChecker sc;
+   if (fon9_LIKELY(sc.IsLinkReady(*this))) {
+      if (fon9_LIKELY(sc.IsAllowInplace())) {
+         assert(this->ImplSP_);
+         DcQueueList dcq{std::move(src)};
+         std::lock_guard<std::mutex> lk{this->ImplSP_->TxMutex_};
+         this->ImplSP_->SendLocked(dcq);
+      }
+      else {
+         sc.AsyncSend(MakeObjHolder<BufferList>(std::move(src)));
+      }
+      return SendResult{0};
+   }
+   BufferListConsumeErr(std::move(src), std::errc::no_link);
+   return SendResult{std::errc::no_link};
+}
+
+} } // namespaces
+#endif//__linux__
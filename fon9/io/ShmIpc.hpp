@@ -0,0 +1,167 @@
+﻿/// \file fon9/io/ShmIpc.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_io_ShmIpc_hpp__
+#define __fon9_io_ShmIpc_hpp__
+#include "fon9/io/Device.hpp"
+#include "fon9/io/RecvBuffer.hpp"
+#include "fon9/io/IoServiceArgs.hpp"
+#include "fon9/buffer/DcQueueList.hpp"
+#include "fon9/TimeStamp.hpp"
+
+#ifdef __linux__
+fon9_BEFORE_INCLUDE_STD;
+#include <atomic>
+#include <mutex>
+#include <thread>
+fon9_AFTER_INCLUDE_STD;
+
+namespace fon9 { namespace io {
+
+struct ShmIpcHeader;
+struct ShmIpcSide;
+struct ShmIpcRing;
+
+fon9_WARN_DISABLE_PADDING;
+/// \ingroup io
+/// 使用 shared memory 與同一台主機上的另一個 process 通訊.
+/// - 一個 shm 區塊內有 2 個 SPSC ring(Server->Client, Client->Server), 以 byte stream 方式傳送資料,
+///   所以 Session 的使用方式與 TcpClient 相同(FIX, Rc, f9twf Tmp... 都不用修改).
+/// - 每個 ShmIpc device 有一個自己的 thread: 負責接收資料, 及 ring 滿了之後的後續傳送.
+///   - 若 ring 有足夠的空間, SendASAP(), SendBuffered() 會直接寫入 ring, 不經過 thread 切換.
+///   - 等候方式依照 "Wait=" 設定:
+///     - Block(預設): 使用放在 shm 裡面的 futex 喚醒.
+///       只有在對方 thread 進入睡眠時, 才需要 system call 喚醒.
+///     - Busy, Yield: 不睡眠, 對方不用喚醒.
+/// - 設定參數:
+///   - Name=     shm 名稱, 實際使用 shm_open("/fon9shm.Name");
+///   - Role=     Server(建立 shm 並等候 Client 連入) 或 Client(連上已存在的 shm), 預設為 Client;
+///   - RingSize= 每個 ring 的大小(bytes), 僅 Server 端有效, 會調整為 2 的 n 次方, 預設為 1M;
+///   - Wait=, Cpus= 參考 IoServiceArgs::OnTagValue();
+/// - 連線狀態:
+///   - Server: 建立 shm 之後進入 State::WaitingLinkIn, 等 Client 連入後 LinkReady.
+///   - Client: 找到 Server 建立的 shm(且 Server 還活著), 則立即 LinkReady.
+///   - 任一方 Close, 或對方的 process 已結束, 則另一方進入 State::LinkBroken.
+///     Client 端重新開啟時, 若 Server 尚未重建 shm, 則會進入 State::LinkError,
+///     所以 Client 端的 "RetryInterval=" 應設定較短的時間.
+/// - DeviceId: "Name|Role"
+class fon9_API ShmIpc : public Device {
+   fon9_NON_COPY_NON_MOVE(ShmIpc);
+   using base = Device;
+public:
+   ShmIpc(SessionSP ses, ManagerSP mgr, const DeviceOptions* optsDefault = nullptr)
+      : base(std::move(ses), std::move(mgr), Style::Client, optsDefault) {
+   }
+
+   bool IsSendBufferEmpty() const override;
+   SendResult SendASAP(const void* src, size_t size) override;
+   SendResult SendASAP(BufferList&& src) override;
+   SendResult SendBuffered(const void* src, size_t size) override;
+   SendResult SendBuffered(BufferList&& src) override;
+
+protected:
+   void OpImpl_Open(std::string cfgstr) override;
+   void OpImpl_Reopen() override;
+   void OpImpl_Close(std::string cause) override;
+   void OpImpl_AppendDeviceInfo(std::string& info) override;
+   void OpImpl_StartRecv(RecvBufferSize preallocSize) override;
+
+private:
+   enum class Role : uint8_t {
+      Server = 0,
+      Client = 1,
+   };
+   struct Config {
+      std::string    Name_;
+      Role           Role_{Role::Client};
+      uint32_t       RingSize_;
+      IoServiceArgs  SvcArgs_;
+      Config();
+   };
+   Config   Config_;
+
+   using ShmIpcSP = intrusive_ptr<ShmIpc>;
+   struct Impl;
+   using ImplSP = intrusive_ptr<Impl>;
+   struct Impl : public intrusive_ref_counter<Impl> {
+      fon9_NON_COPY_NON_MOVE(Impl);
+      const ShmIpcSP    Owner_;
+      const std::string ShmName_;
+      const Role        Role_;
+      const HowWait     HowWait_;
+      void*          MapAddr_{nullptr};
+      size_t         MapSize_{0};
+      ShmIpcHeader*  Header_{nullptr};
+      ShmIpcSide*    MySide_{nullptr};
+      ShmIpcSide*    PeerSide_{nullptr};
+      ShmIpcRing*    TxRing_{nullptr};
+      ShmIpcRing*    RxRing_{nullptr};
+      byte*          TxData_{nullptr};
+      const byte*    RxData_{nullptr};
+      uint64_t       RingMask_{0};
+      /// 連線成功時, 對方的 pid; 0 表示尚未連線(Server 等候 Client 連入).
+      int32_t        PeerPid_{0};
+      /// 上次用 kill(PeerPid_, 0) 檢查對方 process 是否存在的時間.
+      TimeStamp      LastAliveCheck_;
+      std::thread    Thread_;
+      std::atomic<bool> IsStopping_{false};
+
+      // 接收相關: 由 Thread_ 處理, 但 ContinueRecv() 可能在 op thread 呼叫.
+      RecvBuffer     RxBuffer_;
+      std::atomic<RecvBufferSize> RecvSize_{RecvBufferSize::Default};
+      /// OpImpl_StartRecv() 之前, 或 OnDevice_Recv() 事件移到 op thread 處理時, 暫停接收.
+      std::atomic<bool> IsRecvPaused_{true};
+
+      /// 保護 TxRing_ 的寫入端 及 PendingTx_.
+      mutable std::mutex   TxMutex_;
+      /// ring 空間不足時, 剩餘的資料放在這裡, 等對方取出資料後繼續傳送.
+      DcQueueList    PendingTx_;
+
+      Impl(ShmIpc& owner, const Config& cfg);
+      /// 在此才 munmap(), 因為 Thread_ 可能在 MarkClosed() 之後(detach)仍在執行.
+      ~Impl();
+
+      /// \retval true  成功建立(Server) 或 連上(Client) shm.
+      /// \retval false 失敗原因填入 errmsg.
+      bool Map(const Config& cfg, std::string& errmsg);
+      /// 通知對方: 此端已關閉; Server 端會移除 shm 名稱, 但實際的記憶體在 ~Impl() 才釋放.
+      void MarkClosed();
+      void StartThread(const Config& cfg);
+      /// 若在 Thread_ 裡面呼叫(例: 在 OnDevice_Recv() 裡面關閉 device), 則改用 detach().
+      void StopThread();
+
+      void ThrRun(ServiceThreadArgs args);
+      /// \retval false 對方已斷線, 已呼叫 AsyncSetBroken();
+      bool CheckPeer();
+      /// 對方的 process 是否還在? 每秒最多檢查一次.
+      bool CheckPeerAlive();
+      void AsyncSetBroken(std::string cause);
+      /// \retval true 有處理資料.
+      bool CheckRecv();
+      bool FlushPendingTx();
+      bool IsIdle() const;
+      size_t GetTxFree() const;
+
+      /// 以下必須在 TxMutex_ 保護下呼叫.
+      size_t WriteRing(const void* src, size_t size);
+      bool FlushPendingTxLocked();
+      void SendLocked(DcQueueList& txbuf);
+      void SendLocked(const void* src, size_t size);
+
+      /// 寫入資料後: 若對方正在睡眠, 則喚醒.
+      void NotifyPeer();
+      /// 取出資料後: 若對方正在睡眠, 且有資料等候傳送, 則喚醒.
+      void NotifyPeerTxFreed();
+      /// 若 Thread_ 正在睡眠, 則喚醒.
+      void WakeupSelf();
+      void ContinueRecv(RecvBufferSize expectSize, bool isReEnable);
+   };
+   ImplSP   ImplSP_;
+
+   void OpImpl_StopRunning();
+   void OpenImpl();
+};
+fon9_WARN_POP;
+
+} } // namespaces
+#endif//__linux__
+#endif//__fon9_io_ShmIpc_hpp__
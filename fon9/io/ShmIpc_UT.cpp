@@ -0,0 +1,269 @@
+﻿/// \file fon9/io/ShmIpc_UT.cpp
+/// \author fonwinz@gmail.com
+#include "fon9/io/ShmIpc.hpp"
+#include "fon9/io/SimpleManager.hpp"
+#include "fon9/TestTools.hpp"
+
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+//--------------------------------------------------------------------------//
+
+static void CheckError(bool isError, const char* msg) {
+   if (!isError)
+      return;
+   std::cout << "\r[ERROR] " << msg << std::endl;
+   abort();
+}
+static fon9::byte MakePattern(uint64_t pos) {
+   return static_cast<fon9::byte>((pos * 131) + (pos >> 9));
+}
+/// ring 只有 4096 bytes, 測試資料量遠大於 ring, 兩個方向都會繞回 ring 開頭, 也都會用到 PendingTx_.
+static const uint32_t   kRingSize = 4096;
+
+fon9_WARN_DISABLE_PADDING;
+/// - Server: 將收到的資料送回.
+/// - Client: 檢查收到的資料(MakePattern()), 若收到的資料量達到 CloseAtBytes_, 則在 recv thread 關閉 device.
+class TestSession : public fon9::io::Session {
+   fon9_NON_COPY_NON_MOVE(TestSession);
+   virtual void OnDevice_StateChanged(fon9::io::Device&, const fon9::io::StateChangedArgs& e) override {
+      switch (e.After_.State_) {
+      case fon9::io::State::LinkReady:
+         ++this->LinkReadyCount_;
+         break;
+      case fon9::io::State::LinkBroken:
+         ++this->LinkBrokenCount_;
+         break;
+      case fon9::io::State::LinkError:
+         ++this->LinkErrorCount_;
+         break;
+      case fon9::io::State::Closed:
+         ++this->ClosedCount_;
+         break;
+      default:
+         break;
+      }
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_LinkReady(fon9::io::Device&) override {
+      this->RxPos_ = 0;
+      return fon9::io::RecvBufferSize::Default;
+   }
+   virtual fon9::io::RecvBufferSize OnDevice_Recv(fon9::io::Device& dev, fon9::DcQueueList& rxbuf) override {
+      if (this->IsEcho_) {
+         dev.SendASAP(rxbuf.MoveOut());
+         return fon9::io::RecvBufferSize::Default;
+      }
+      while (!rxbuf.empty()) {
+         auto blk = rxbuf.PeekCurrBlock();
+         for (size_t L = 0; L < blk.second; ++L) {
+            if (blk.first[L] != MakePattern(this->RxPos_ + L))
+               this->IsRxError_ = true;
+         }
+         this->RxPos_ += blk.second;
+         rxbuf.PopConsumed(blk.second);
+      }
+      this->RxBytes_.store(this->RxPos_, std::memory_order_release);
+      if (this->CloseAtBytes_ && this->RxPos_ >= this->CloseAtBytes_) {
+         this->CloseAtBytes_ = 0;
+         dev.AsyncClose("CloseInRecv");
+      }
+      return fon9::io::RecvBufferSize::Default;
+   }
+   uint64_t RxPos_{0};
+public:
+   TestSession(bool isEcho) : IsEcho_{isEcho} {
+   }
+   const bool              IsEcho_;
+   bool                    IsRxError_{false};
+   std::atomic<uint64_t>   RxBytes_{0};
+   std::atomic<unsigned>   LinkReadyCount_{0};
+   std::atomic<unsigned>   LinkBrokenCount_{0};
+   std::atomic<unsigned>   LinkErrorCount_{0};
+   std::atomic<unsigned>   ClosedCount_{0};
+   uint64_t                CloseAtBytes_{0};
+};
+using TestSessionSP = fon9::intrusive_ptr<TestSession>;
+
+struct TestDevice {
+   fon9_NON_COPY_NON_MOVE(TestDevice);
+   fon9::io::ManagerCSP Mgr_{new fon9::io::SimpleManager{}};
+   TestSessionSP        Ses_;
+   fon9::io::DeviceSP   Dev_;
+   TestDevice(bool isEcho) : Ses_{new TestSession{isEcho}}, Dev_{new fon9::io::ShmIpc(Ses_, Mgr_)} {
+      this->Dev_->Initialize();
+      // 斷線後盡快 reopen(Server 重建 shm); Client 在 Server 重建之前 reopen 會 LinkError, 也要盡快 retry.
+      this->Dev_->WaitSetProperty("ReopenInterval=0.01|RetryInterval=0.01");
+   }
+   ~TestDevice() {
+      this->Dev_->AsyncDispose("test done");
+      this->Dev_->WaitGetDeviceId();
+      while (this->Mgr_->use_count() != 2) // Mgr_(+1), Dev_->Manager_(+1)
+         std::this_thread::yield();
+   }
+};
+fon9_WARN_POP;
+
+static void WaitCount(const std::atomic<unsigned>& count, unsigned expected, const char* errmsg) {
+   unsigned ms = 0;
+   while (count.load(std::memory_order_acquire) < expected) {
+      CheckError(++ms > 10000, errmsg);
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+}
+static std::string MakeCfg(const std::string& name, const char* role, const char* wait) {
+   return "Name=" + name + "|Role=" + role + "|RingSize=" + fon9::RevPrintTo<std::string>(kRingSize) + "|Wait=" + wait;
+}
+
+/// 從 Client 送出 [txPos, txPos + size), 每次送出的大小不固定(可能超過 ring 大小), 等候 Server 全部送回.
+/// \return 從送出到全部收回的時間.
+static double StreamEcho(TestDevice& cli, uint64_t& txPos, uint64_t size) {
+   fon9::StopWatch stopWatch;
+   const uint64_t  txEnd = txPos + size;
+   fon9::byte      buf[kRingSize * 3];
+   size_t          chunk = static_cast<size_t>(txPos % sizeof(buf)) + 1;
+   while (txPos < txEnd) {
+      chunk = (chunk * 7 + 13) % sizeof(buf) + 1;
+      if (chunk > txEnd - txPos)
+         chunk = static_cast<size_t>(txEnd - txPos);
+      for (size_t L = 0; L < chunk; ++L)
+         buf[L] = MakePattern(txPos + L);
+      CheckError(cli.Dev_->SendASAP(buf, chunk).IsError(), "Client.SendASAP");
+      txPos += chunk;
+   }
+   unsigned ms = 0;
+   while (cli.Ses_->RxBytes_.load(std::memory_order_acquire) < txEnd) {
+      CheckError(++ms > 10000, "Echo timeout.");
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+   }
+   CheckError(cli.Ses_->RxBytes_ != txEnd, "Echo size mismatch.");
+   CheckError(cli.Ses_->IsRxError_, "Echo data mismatch.");
+   return stopWatch.StopTimer();
+}
+
+//--------------------------------------------------------------------------//
+
+static void TestShmIpc(const std::string& name, const char* wait) {
+   const bool  isBlock = (strcmp(wait, "Block") == 0);
+   std::string testName = std::string{"|Wait="} + wait;
+   TestDevice  svr{true};
+   svr.Dev_->AsyncOpen(MakeCfg(name, "Server", wait));
+   {
+      std::cout << "[TEST ] Stream" << testName << std::flush;
+      TestDevice cli{false};
+      cli.Dev_->AsyncOpen(MakeCfg(name, "Client", wait));
+      WaitCount(cli.Ses_->LinkReadyCount_, 1, "Client.LinkReady");
+      WaitCount(svr.Ses_->LinkReadyCount_, 1, "Server.LinkReady");
+      uint64_t txPos = 0;
+      StreamEcho(cli, txPos, kRingSize * 256);
+      std::cout << "\r[OK   ] " << std::endl;
+
+      if (isBlock) {
+         // 每次送出前先等對方進入 futex 睡眠, 若喚醒失敗, 則只能等 1 秒的 futex timeout 才能收到.
+         std::cout << "[TEST ] FutexWakeup" << testName << std::flush;
+         for (unsigned L = 0; L < 20; ++L) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{20});
+            CheckError(StreamEcho(cli, txPos, (L % 2) ? 100 : kRingSize * 3) > 0.5, "Futex wakeup too slow.");
+         }
+         std::cout << "\r[OK   ] " << std::endl;
+      }
+
+      std::cout << "[TEST ] PeerClose" << testName << std::flush;
+      cli.Dev_->AsyncClose("test PeerClose");
+      WaitCount(svr.Ses_->LinkBrokenCount_, 1, "Server.LinkBroken(PeerClosed)");
+      std::cout << "\r[OK   ] " << std::endl;
+
+      // Client 重新連入: Server 尚未重建 shm 之前, Client 會 LinkError(Client exists 或 Server closed), 之後 retry.
+      std::cout << "[TEST ] ClientReattach" << testName << std::flush;
+      cli.Dev_->AsyncOpen(MakeCfg(name, "Client", wait));
+      WaitCount(cli.Ses_->LinkReadyCount_, 2, "Client.Reattach");
+      WaitCount(svr.Ses_->LinkReadyCount_, 2, "Server.LinkReady(Reattach)");
+      txPos = 0;
+      cli.Ses_->RxBytes_ = 0;
+      StreamEcho(cli, txPos, kRingSize * 16);
+      std::cout << "\r[OK   ] " << std::endl;
+
+      std::cout << "[TEST ] CloseInRecv" << testName << std::flush;
+      cli.Ses_->CloseAtBytes_ = txPos + kRingSize * 8;
+      // 送出更多的資料: Client 在收到 CloseAtBytes_ 之後關閉, Server 可能仍有 PendingTx_.
+      fon9::byte buf[kRingSize];
+      for (unsigned L = 0; L < 64; ++L) {
+         for (size_t i = 0; i < sizeof(buf); ++i)
+            buf[i] = MakePattern(txPos + i);
+         if (cli.Dev_->SendASAP(buf, sizeof(buf)).IsError())
+            break;
+         txPos += sizeof(buf);
+      }
+      WaitCount(cli.Ses_->ClosedCount_, 1, "Client.Closed(CloseInRecv)");
+      WaitCount(svr.Ses_->LinkBrokenCount_, 2, "Server.LinkBroken(CloseInRecv)");
+      CheckError(cli.Ses_->IsRxError_, "CloseInRecv: data mismatch.");
+      // 關閉時會結束 recv thread, 之後不應再有 OnDevice_Recv() 事件.
+      const uint64_t rxBytes = cli.Ses_->RxBytes_;
+      std::this_thread::sleep_for(std::chrono::milliseconds{20});
+      CheckError(cli.Ses_->RxBytes_ != rxBytes, "CloseInRecv: Recv after closed.");
+      std::cout << "\r[OK   ] " << std::endl;
+   }
+
+   // 對方的 process 沒有正常關閉就結束, 只能透過 kill(pid, 0) 偵測.
+   std::cout << "[TEST ] PeerKilled" << testName << std::flush;
+   WaitCount(svr.Ses_->LinkReadyCount_, 2, "Server.LinkReady");
+   const unsigned linkReadyCount = svr.Ses_->LinkReadyCount_ + 1;
+   const unsigned linkBrokenCount = svr.Ses_->LinkBrokenCount_ + 1;
+   const pid_t    pid = fork();
+   CheckError(pid < 0, "fork");
+   if (pid == 0) {
+      execl("/proc/self/exe", "ShmIpc_UT", "--crash-client", name.c_str(), wait, nullptr);
+      _exit(127);
+   }
+   WaitCount(svr.Ses_->LinkReadyCount_, linkReadyCount, "Server.LinkReady(crash-client)");
+   // 必須先 waitpid(), 否則 zombie 仍可通過 kill(pid, 0) 的檢查.
+   int wstatus = 0;
+   waitpid(pid, &wstatus, 0);
+   CheckError(!WIFSIGNALED(wstatus) || WTERMSIG(wstatus) != SIGKILL, "crash-client: not killed.");
+   WaitCount(svr.Ses_->LinkBrokenCount_, linkBrokenCount, "Server.LinkBroken(PeerGone)");
+   std::cout << "\r[OK   ] " << std::endl;
+
+   // 同名的 Server 仍在執行中: 不可移除對方的 shm, 必須 LinkError.
+   std::cout << "[TEST ] ServerExists" << testName << std::flush;
+   {
+      TestDevice svr2{true};
+      svr2.Dev_->AsyncOpen(MakeCfg(name, "Server", wait));
+      WaitCount(svr2.Ses_->LinkErrorCount_, 1, "Server2.LinkError");
+      CheckError(svr2.Ses_->LinkReadyCount_ != 0, "Server2: LinkReady.");
+   }
+   std::cout << "\r[OK   ] " << std::endl;
+
+   std::cout << "[TEST ] ReattachAfterKilled" << testName << std::flush;
+   {
+      TestDevice cli{false};
+      cli.Dev_->AsyncOpen(MakeCfg(name, "Client", wait));
+      WaitCount(cli.Ses_->LinkReadyCount_, 1, "Client.LinkReady(after killed)");
+      uint64_t txPos = 0;
+      StreamEcho(cli, txPos, kRingSize * 16);
+   }
+   std::cout << "\r[OK   ] " << std::endl;
+}
+
+/// 在子行程: 連上 Server, 送出一些資料後, 不關閉 device 直接結束(SIGKILL).
+static int RunCrashClient(const char* name, const char* wait) {
+   TestDevice cli{false};
+   cli.Dev_->AsyncOpen(MakeCfg(name, "Client", wait));
+   WaitCount(cli.Ses_->LinkReadyCount_, 1, "crash-client.LinkReady");
+   uint64_t txPos = 0;
+   StreamEcho(cli, txPos, kRingSize * 4);
+   kill(getpid(), SIGKILL);
+   return 0;
+}
+
+int main(int argc, const char* argv[]) {
+   if (argc == 4 && strcmp(argv[1], "--crash-client") == 0)
+      return RunCrashClient(argv[2], argv[3]);
+
+   fon9::AutoPrintTestInfo utinfo("ShmIpc");
+   fon9::LogLevel_ = fon9::LogLevel::Error;
+
+   const std::string name = "ShmIpc_UT." + fon9::RevPrintTo<std::string>(getpid());
+   TestShmIpc(name, "Block");
+   utinfo.PrintSplitter();
+   TestShmIpc(name, "Busy");
+}
@@ -10,6 +10,9 @@ fon9_BEFORE_INCLUDE_STD;
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 #include <signal.h>
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#endif
 /// 將 size_t size 轉成 static_cast<socklen_t>(size) 避免警告.
 #define inet_ntop(af,src,dst,size)  inet_ntop(af, src, dst, static_cast<socklen_t>(size))
 #endif
@@ -152,6 +155,24 @@ bool Socket::SetSocketOptions(const SocketOptions& opts, SocketResult& soRes) co
 #endif
    if (opts.Linger_.l_onoff || opts.Linger_.l_linger)
       SetOpt(so, SOL_SOCKET, SO_LINGER, opts.Linger_, "Linger", soRes);
+#ifdef SO_BUSY_POLL
+   if (opts.SO_BUSY_POLL_ > 0)
+      SetOpt(so, SOL_SOCKET, SO_BUSY_POLL, opts.SO_BUSY_POLL_, "BusyPoll", soRes);
+#endif
+#ifdef SO_INCOMING_CPU
+   if (opts.SO_INCOMING_CPU_ >= 0)
+      SetOpt(so, SOL_SOCKET, SO_INCOMING_CPU, opts.SO_INCOMING_CPU_, "IncomingCpu", soRes);
+#endif
+#if defined(SO_TIMESTAMPING) && defined(__linux__)
+   if (opts.SO_TIMESTAMPING_) {
+      int tsflags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+      SetOpt(so, SOL_SOCKET, SO_TIMESTAMPING, tsflags, "RxTimestamp", soRes);
+   }
+#endif
+#ifdef SO_ZEROCOPY
+   if (opts.SO_ZEROCOPY_)
+      SetOpt(so, SOL_SOCKET, SO_ZEROCOPY, opts.SO_ZEROCOPY_, "ZeroCopy", soRes);
+#endif
 
    if (opts.KeepAliveInterval_) {
       if (opts.KeepAliveInterval_ == 1)
@@ -3,9 +3,18 @@
 #include "fon9/io/SocketAddressDN.hpp"
 #include "fon9/io/Socket.hpp"
 #include "fon9/StrTools.hpp"
-#include "fon9/DefaultThreadPool.hpp"
-#include "fon9/Worker.hpp"
+#include "fon9/MessageQueue.hpp"
+#include "fon9/MustLock.hpp"
 #include "fon9/ThreadId.hpp"
+#include "fon9/TimeStamp.hpp"
+#include "fon9/RevPrint.hpp"
+
+fon9_BEFORE_INCLUDE_STD;
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <unordered_map>
+fon9_AFTER_INCLUDE_STD;
 
 namespace fon9 { namespace io {
 
@@ -17,8 +26,199 @@ void DomainNameParser::Reset(std::string dn, port_t defaultPortNo) {
    StrTrim(&this->DnParser_);
 }
 
-void DomainNameParser::Parse(StrView dnPort, DomainNameParseResult& res) {
-   StrView dn1; // 把 dn1:port 分開.
+namespace impl {
+fon9_WARN_DISABLE_PADDING;
+/// AsyncDnQuery() 的要求, 解析過程的狀態都放在這裡,
+/// 所以遇到正在查詢中的 dn 時, 可以放到該 dn 的等候佇列, 不用佔用 thread 等候.
+struct DnAsyncReq {
+   fon9_NON_COPY_NON_MOVE(DnAsyncReq);
+   const DnQueryReqId      Id_;
+   DomainNameParser        DnParser_;
+   DomainNameParseResult   DnResult_;
+   /// 放到等候佇列時, 正在等候查詢結果的 dn1:port, 指向 DnParser_.DomainNames_ 的內容.
+   StrView                 PendingDn_;
+   StrView                 PendingPort_;
+   /// 解析 "[ipv6]" 會改變 ai_family, 取得結果後必須還原.
+   int                     OldFamily_;
+
+   DnAsyncReq(DnQueryReqId id, std::string&& dn, SocketAddress::port_t defaultPortNo) : Id_{id} {
+      this->DnParser_.Reset(std::move(dn), defaultPortNo);
+   }
+   /// 在 DnQuery 的 thread 解析全部的 dn, 完畢後觸發結果事件.
+   /// 若遇到正在查詢中的 dn, 則 req 移到該 dn 的等候佇列後返回.
+   static void Run(std::unique_ptr<DnAsyncReq>&& req);
+   /// 在查詢的 thread, 取得等候的結果.
+   void OnResolved(int eno, SocketAddressList addrList) {
+      this->DnParser_.OnResolved(this->PendingDn_, this->PendingPort_, eno, addrList, this->DnResult_);
+      this->DnParser_.AddrHints_.ai_family = this->OldFamily_;
+   }
+};
+using DnAsyncReqSP = std::unique_ptr<DnAsyncReq>;
+/// 將已取得等候結果的 req, 放回 DnQuery 的 thread pool, 繼續解析剩餘的 dn.
+static void ResumeDnAsyncReq(DnAsyncReqSP&& req);
+
+struct DnCacheEntry {
+   /// getaddrinfo() 的錯誤碼, 0 = 成功.
+   int               Eno_{0};
+   /// 正在查詢中, 其他查詢相同 dn 的 thread 應等候查詢結果.
+   bool              IsResolving_{true};
+   TimeStamp         Expire_;
+   /// getaddrinfo() 取得的 address, port 尚未調整(可能為 0).
+   SocketAddressList AddrList_;
+   /// 正在查詢中, 等候查詢結果的 AsyncDnQuery() 要求, 由查詢的 thread 提供結果.
+   std::vector<DnAsyncReqSP>  AsyncWaiters_;
+};
+struct DnCacheContent {
+   using Map = std::unordered_map<std::string, DnCacheEntry>;
+   Map            Map_;
+   DnQueryConfig  Config_;
+   DnQueryStats   Stats_;
+};
+fon9_WARN_POP;
+
+/// 保留 dn 的查詢結果, 並讓同時查詢相同 dn 的 threads, 共用一次 getaddrinfo() 的結果.
+class DnCache : public MustLock<DnCacheContent> {
+   fon9_NON_COPY_NON_MOVE(DnCache);
+   std::condition_variable Resolved_;
+   /// 超過此數量, 加入新的 dn 之前, 先移除已過期的.
+   enum : size_t { kSweepSize = 1024 };
+
+   static int GetAddrInfo(const struct addrinfo& hints, const char* dn, const char* port, SocketAddressList& addrList) {
+      struct addrinfo* gaiRes;
+      if (int eno = getaddrinfo(dn, port, &hints, &gaiRes)) {
+      #ifdef fon9_WINDOWS
+         eno = WSAGetLastError();
+      #endif
+         return eno;
+      }
+      SocketAddress     sAddr;
+      struct addrinfo*  pAddrPrev = nullptr;
+      for (struct addrinfo* pAddr = gaiRes; pAddr != nullptr; pAddr = (pAddrPrev = pAddr)->ai_next) {
+         size_t addrSize;
+         if (pAddr->ai_family == AF_INET)
+            addrSize = sizeof(sAddr.Addr4_);
+         else if (pAddr->ai_family == AF_INET6)
+            addrSize = sizeof(sAddr.Addr6_);
+         else
+            continue;
+         if (pAddr->ai_addrlen != addrSize)
+            continue;
+         if (pAddrPrev && pAddrPrev->ai_addrlen == pAddr->ai_addrlen
+             && memcmp(pAddrPrev->ai_addr, pAddr->ai_addr, addrSize) == 0) {
+            // 可能取得相同的 ip:port?
+            // Linux 4.4.0-87-generic #110-Ubuntu SMP Tue Jul 18 12:55:35 UTC 2017 x86_64 x86_64 x86_64 GNU/Linux
+            // 使用 localhost 會取得 2 次 127.0.0.1 ??
+            continue;
+         }
+         memcpy(&sAddr.Addr_, pAddr->ai_addr, addrSize);
+         addrList.push_back(sAddr);
+      }
+      freeaddrinfo(gaiRes);
+      return 0;
+   }
+   static void SweepExpired(DnCacheContent::Map& map, TimeStamp now) {
+      for (auto i = map.begin(); i != map.end();) {
+         if (!i->second.IsResolving_ && i->second.Expire_ <= now)
+            i = map.erase(i);
+         else
+            ++i;
+      }
+   }
+
+public:
+   DnCache() = default;
+
+   /// - 若 asyncReq != nullptr, 且相同的 dn 正在其他 thread 查詢中:
+   ///   則將 *asyncReq 移到等候佇列(返回時 *asyncReq 為 nullptr), 不等候查詢結果.
+   /// \retval 0  成功, 查詢結果加入 addrList.
+   /// \retval !0 getaddrinfo() 的錯誤碼(Windows: WSAGetLastError()).
+   int Resolve(const struct addrinfo& hints, const char* dn, const char* port, SocketAddressList& addrList,
+               DnAsyncReqSP* asyncReq = nullptr) {
+      std::string key = RevPrintTo<std::string>(hints.ai_family, ',', hints.ai_socktype, ',',
+                                                hints.ai_protocol, ',', hints.ai_flags, '|', dn, '|', port);
+      Locker      cache{*this};
+      bool        isWaited = false;
+      auto        ifind = cache->Map_.find(key);
+      while (ifind != cache->Map_.end()) {
+         DnCacheEntry& entry = ifind->second;
+         if (entry.IsResolving_) {
+            if (!isWaited)
+               ++cache->Stats_.WaitCount_;
+            if (asyncReq) {
+               entry.AsyncWaiters_.push_back(std::move(*asyncReq));
+               return 0;
+            }
+            this->Resolved_.wait(cache);
+            isWaited = true;
+            ifind = cache->Map_.find(key);
+            continue;
+         }
+         // 等候別人查詢的結果, 即使 TTL=0 也直接使用.
+         if (isWaited || UtcNow() < entry.Expire_) {
+            ++cache->Stats_.CacheHitCount_;
+            addrList.insert(addrList.end(), entry.AddrList_.begin(), entry.AddrList_.end());
+            return entry.Eno_;
+         }
+         entry.IsResolving_ = true;
+         break;
+      }
+      if (ifind == cache->Map_.end()) {
+         if (cache->Map_.size() >= kSweepSize)
+            SweepExpired(cache->Map_, UtcNow());
+         cache->Map_.emplace(key, DnCacheEntry{});
+      }
+      ++cache->Stats_.ResolveCount_;
+      cache.unlock();
+      // 花時間的工作, 放在 unlock 之後.
+      SocketAddressList res;
+      const int         eno = GetAddrInfo(hints, dn, port, res);
+      cache.lock();
+      DnCacheEntry& entry = cache->Map_[key];
+      entry.IsResolving_ = false;
+      entry.Eno_ = eno;
+      entry.Expire_ = UtcNow() + (eno ? cache->Config_.NegativeTTL_ : cache->Config_.CacheTTL_);
+      entry.AddrList_ = res;
+      std::vector<DnAsyncReqSP> waiters{std::move(entry.AsyncWaiters_)};
+      entry.AsyncWaiters_.clear();
+      cache->Stats_.CacheHitCount_ += waiters.size();
+      cache.unlock();
+      this->Resolved_.notify_all();
+      for (DnAsyncReqSP& req : waiters) {
+         req->OnResolved(eno, res);
+         ResumeDnAsyncReq(std::move(req));
+      }
+      addrList.insert(addrList.end(), res.begin(), res.end());
+      return eno;
+   }
+};
+static DnCache& GetDnCache() {
+   static DnCache DnCache_;
+   return DnCache_;
+}
+} // namespace impl
+
+void DnQuery_SetConfig(const DnQueryConfig& cfg) {
+   impl::GetDnCache().Lock()->Config_ = cfg;
+}
+DnQueryConfig DnQuery_GetConfig() {
+   return impl::GetDnCache().Lock()->Config_;
+}
+DnQueryStats DnQuery_GetStats() {
+   return impl::GetDnCache().Lock()->Stats_;
+}
+void DnQuery_ClearCache() {
+   auto  cache{impl::GetDnCache().Lock()};
+   auto& map = cache->Map_;
+   for (auto i = map.begin(); i != map.end();) {
+      if (i->second.IsResolving_)
+         ++i;
+      else
+         i = map.erase(i);
+   }
+}
+//--------------------------------------------------------------------------//
+bool DomainNameParser::FetchDnPort(StrView& dnPort, StrView& dn1) {
+   // 把 dn1:port 分開.
    if (dnPort.Get1st() == '[') { // "[ipv6]:port"
       this->AddrHints_.ai_family = AF_INET6;
       dn1 = SbrFetchInsideNoTrim(dnPort);//取出 "[dn1]" 裡面的 "dn1"
@@ -32,82 +232,51 @@ void DomainNameParser::Parse(StrView dnPort, DomainNameParseResult& res) {
 
    *const_cast<char*>(dn1.end()) = '\0';
    *const_cast<char*>(dnPort.end()) = '\0';
-   if (*dn1.begin() || *dnPort.begin()) {
-      struct addrinfo* gaiRes;
-      if (int eno = getaddrinfo(dn1.begin(), dnPort.begin(), &this->AddrHints_, &gaiRes)) {
-         // "(dn1:dnPort=eno:message)"
-      #ifdef fon9_WINDOWS
-         eno = WSAGetLastError();
-      #endif
-         if (res.ErrMsg_.empty())
-            res.ErrMsg_.push_back('(');
-         else
-            res.ErrMsg_.append(",(", 2);
-         if (this->AddrHints_.ai_family == AF_INET6)
-            res.ErrMsg_.push_back('[');
-         dn1.AppendTo(res.ErrMsg_);
-         if (this->AddrHints_.ai_family == AF_INET6)
-            res.ErrMsg_.push_back(']');
-         if (!dnPort.empty()) {
-            res.ErrMsg_.push_back(':');
-            dnPort.AppendTo(res.ErrMsg_);
-         }
-         res.ErrMsg_.push_back('=');
-         NumOutBuf nbuf;
-         res.ErrMsg_.append(SIntToStrRev(nbuf.end(), eno), nbuf.end());
+   return (*dn1.begin() || *dnPort.begin());
+}
+void DomainNameParser::Parse(StrView dnPort, DomainNameParseResult& res) {
+   StrView dn1;
+   if (this->FetchDnPort(dnPort, dn1)) {
+      SocketAddressList addrList;
+      const int         eno = impl::GetDnCache().Resolve(this->AddrHints_, dn1.begin(), dnPort.begin(), addrList);
+      this->OnResolved(dn1, dnPort, eno, addrList, res);
+   }
+}
+void DomainNameParser::OnResolved(StrView dn1, StrView dnPort, int eno, SocketAddressList& addrList, DomainNameParseResult& res) {
+   if (eno) {
+      // "(dn1:dnPort=eno:message)"
+      if (res.ErrMsg_.empty())
+         res.ErrMsg_.push_back('(');
+      else
+         res.ErrMsg_.append(",(", 2);
+      if (this->AddrHints_.ai_family == AF_INET6)
+         res.ErrMsg_.push_back('[');
+      dn1.AppendTo(res.ErrMsg_);
+      if (this->AddrHints_.ai_family == AF_INET6)
+         res.ErrMsg_.push_back(']');
+      if (!dnPort.empty()) {
          res.ErrMsg_.push_back(':');
-      #ifdef fon9_WINDOWS
-         res.ErrMsg_.append(GetSocketErrC(eno).message());
-      #else
-         res.ErrMsg_.append(gai_strerror(eno));
-      #endif
-         res.ErrMsg_.push_back(')');
+         dnPort.AppendTo(res.ErrMsg_);
       }
-      else {
-         //printf("%s:%s\n", dn1.begin(), dnPort.begin());
-         port_t*           sPortPtr;
-         SocketAddress     sAddr;
-         struct addrinfo*  pAddrPrev = nullptr;
-         for (struct addrinfo* pAddr = gaiRes; pAddr != nullptr; pAddr = (pAddrPrev = pAddr)->ai_next) {
-            size_t addrSize;
-            if (pAddr->ai_family == AF_INET) {
-               addrSize = sizeof(sAddr.Addr4_);
-               sPortPtr = &sAddr.Addr4_.sin_port;
-            }
-            else if (pAddr->ai_family == AF_INET6) {
-               addrSize = sizeof(sAddr.Addr6_);
-               sPortPtr = &sAddr.Addr6_.sin6_port;
-            }
-            else {
-               continue;
-            }
-            if (pAddr->ai_addrlen != addrSize)
-               continue;
-
-            if (pAddrPrev && pAddrPrev->ai_addrlen == pAddr->ai_addrlen
-                && memcmp(pAddrPrev->ai_addr, pAddr->ai_addr, addrSize) == 0) {
-               // 可能取得相同的 ip:port?
-               // Linux 4.4.0-87-generic #110-Ubuntu SMP Tue Jul 18 12:55:35 UTC 2017 x86_64 x86_64 x86_64 GNU/Linux
-               // 使用 localhost 會取得 2 次 127.0.0.1 ??
-               continue;
-            }
-            memcpy(&sAddr.Addr_, pAddr->ai_addr, addrSize);
-            if (*sPortPtr == 0)
-               *sPortPtr = this->DefaultPortNo_ ? this->DefaultPortNo_ : this->LastPortNo_;
-            else
-               this->LastPortNo_ = *sPortPtr;
-            res.AddressList_.push_back(sAddr);
-
-         #if 0
-            printf("    ");
-            for (const byte* p = reinterpret_cast<const byte*>(&addr.Addr_); addrSize > 0; --addrSize)
-               printf("%02x ", *p++);
-            char ip[fon9::io::SocketAddress::kMaxAddrPortStrSize];
-            addr.ToAddrPortStr(ip);
-            printf("/// %s\n", ip);
-         #endif
-         }
-         freeaddrinfo(gaiRes);
+      res.ErrMsg_.push_back('=');
+      NumOutBuf nbuf;
+      res.ErrMsg_.append(SIntToStrRev(nbuf.end(), eno), nbuf.end());
+      res.ErrMsg_.push_back(':');
+   #ifdef fon9_WINDOWS
+      res.ErrMsg_.append(GetSocketErrC(eno).message());
+   #else
+      res.ErrMsg_.append(gai_strerror(eno));
+   #endif
+      res.ErrMsg_.push_back(')');
+   }
+   else {
+      for (SocketAddress& sAddr : addrList) {
+         port_t& portRef = (sAddr.Addr_.sa_family == AF_INET6 ? sAddr.Addr6_.sin6_port : sAddr.Addr4_.sin_port);
+         if (portRef == 0)
+            portRef = this->DefaultPortNo_ ? this->DefaultPortNo_ : this->LastPortNo_;
+         else
+            this->LastPortNo_ = portRef;
+         res.AddressList_.push_back(sAddr);
       }
    }
 }
@@ -124,6 +293,10 @@ bool DomainNameParser::Parse(DomainNameParseResult& res) {
          break;
       }
    }
+   this->OnParseEnd(res);
+   return false;
+}
+void DomainNameParser::OnParseEnd(DomainNameParseResult& res) {
    if (this->LastPortNo_ && this->DefaultPortNo_ == 0) {
       for (SocketAddress& addr : res.AddressList_) {
          port_t& portRef = (addr.Addr_.sa_family == AF_INET6 ? addr.Addr6_.sin6_port : addr.Addr4_.sin_port);
@@ -132,106 +305,91 @@ bool DomainNameParser::Parse(DomainNameParseResult& res) {
          portRef = this->LastPortNo_;
       }
    }
-   return false;
 }
 
 //--------------------------------------------------------------------------//
 
 namespace impl {
 fon9_WARN_DISABLE_PADDING;
-struct DnRequest {
-   std::string             DomainName_;
-   SocketAddress::port_t   DefaultPortNo_;
-   FnOnSocketAddressList   FnOnReady_;
-   DnRequest() = default;
-   DnRequest(std::string&& dn, SocketAddress::port_t defaultPortNo, FnOnSocketAddressList&& fnOnReady)
-      : DomainName_{std::move(dn)}
-      , DefaultPortNo_{defaultPortNo}
-      , FnOnReady_{std::move(fnOnReady)} {
-   }
-};
+using DnRequest = DnAsyncReqSP;
+
+struct DnTaskHandler;
+using DnThreadPool = MessageQueue<DnTaskHandler, DnRequest>;
 
-struct DnWorkContent : public WorkContentBase {
-   fon9_NON_COPY_NON_MOVE(DnWorkContent);
-   DnWorkContent() = default;
-   using DnRequests = std::deque<DnRequest>;
-   DnRequests        DnRequests_;
-   DnQueryReqId      FrontId_{1}; // DnRequests_[0] 的 Id.
-   DnQueryReqId      EmittingId_{};
+struct DnWorkContent {
+   DnQueryReqId   NextId_{1};
+   /// 尚未觸發結果事件的要求, 取消時從這裡移除.
+   std::unordered_map<DnQueryReqId, FnOnSocketAddressList>  Waiting_;
+   /// 正在觸發結果事件的要求.
+   struct Emitting {
+      DnQueryReqId      Id_;
+      ThreadId::IdType  ThreadId_;
+   };
+   std::vector<Emitting>   Emitting_;
 };
 fon9_WARN_POP;
 
-class DnWorkController : public MustLock<DnWorkContent> {
-   fon9_NON_COPY_NON_MOVE(DnWorkController);
-   DomainNameParser        DnParser_;
-   DomainNameParseResult   DnResult_;
-public:
-   DnWorkController() = default;
-   using DnWorkerBase = Worker<DnWorkController>;
+class DnWorker : public MustLock<DnWorkContent> {
+   fon9_NON_COPY_NON_MOVE(DnWorker);
+   DnThreadPool   ThreadPool_;
 
-   void Dispose(Locker&& ctx) {
-      // 程式即將結束? 不用處理 dn 解析了!
-      ctx->SetWorkerState(WorkerState::Disposed);
-      auto reqs{std::move(ctx->DnRequests_)};
-      ctx.unlock();
-      reqs.clear();
-      ctx.lock();
+   std::vector<DnWorkContent::Emitting>::iterator FindEmitting(const Locker& ctx, DnQueryReqId id) {
+      auto& emitting = ctx->Emitting_;
+      return std::find_if(emitting.begin(), emitting.end(),
+                          [id](const DnWorkContent::Emitting& e) { return e.Id_ == id; });
+   }
+public:
+   DnWorker() {
+      // 使用專用的 threads, 避免緩慢的 DNS 佔用 DefaultThreadPool;
+      // 且多個要求可同時查詢, 不會因其中一個緩慢的 dn 而全部卡住.
+      uint32_t threadCount = DnQuery_GetConfig().ThreadCount_;
+      this->ThreadPool_.StartThread(threadCount ? threadCount : 1, "fon9.DnQuery");
    }
 
-   fon9::WorkerState TakeCall(Locker&& ctx) {
-      DnRequest&  req = ctx->DnRequests_[0];
-      this->DnParser_.Reset(req.DomainName_, req.DefaultPortNo_);
-      this->DnResult_.Clear();
-      while (req.FnOnReady_) { // 若 !req.FnOnReady_ 表示: 已被 DnWorker::Cancel(); 清除, 此次要求已被取消.
-         ctx.unlock();
-         // 花時間的工作, 放在 unlock 之後.
-         bool isDone = !this->DnParser_.Parse(this->DnResult_);
-
-         ctx.lock();
-         if (ctx->GetWorkerState() >= WorkerState::Disposing) {
-            this->Dispose(std::move(ctx));
-            return WorkerState::Disposed;
-         }
-         if (isDone) {
-            if (FnOnSocketAddressList fnOnReady = std::move(req.FnOnReady_)) {
-               DnQueryReqId id = ctx->EmittingId_ = ctx->FrontId_;
-               ctx.unlock(); // 觸發結果事件, 在 unlock 之後.
-               fnOnReady(id, this->DnResult_);
-               ctx.lock();
-            }
-            break;
-         }
-      }
-      ++ctx->FrontId_;
-      ctx->DnRequests_.pop_front();
-      return ctx->DnRequests_.empty() ? WorkerState::Sleeping : WorkerState::Working;
+   bool IsWaiting(DnQueryReqId id) {
+      return this->Lock()->Waiting_.count(id) != 0;
    }
 
-   void AddWork(Locker&& lk, DnQueryReqId& id, std::string&& dn, SocketAddress::port_t defaultPortNo, FnOnSocketAddressList&& fnOnReady) {
-      id = lk->FrontId_ + lk->DnRequests_.size();
-      lk->DnRequests_.emplace_back(std::move(dn), defaultPortNo, std::move(fnOnReady));
-      if (lk->SetToRinging()) {
-         lk.unlock();
-         GetDefaultThreadPool().EmplaceMessage(std::bind(&DnWorkerBase::TakeCall, &DnWorkerBase::StaticCast(*this)));
+   void AddWork(DnQueryReqId& id, std::string&& dn, SocketAddress::port_t defaultPortNo, FnOnSocketAddressList&& fnOnReady) {
+      {
+         Locker ctx{*this};
+         id = ctx->NextId_++;
+         ctx->Waiting_.emplace(id, std::move(fnOnReady));
       }
+      this->ThreadPool_.EmplaceMessage(DnAsyncReqSP{new DnAsyncReq{id, std::move(dn), defaultPortNo}});
+   }
+   void Resume(DnAsyncReqSP&& req) {
+      this->ThreadPool_.EmplaceMessage(std::move(req));
    }
-};
 
-struct DnWorker : public DnWorkController::DnWorkerBase {
-   fon9_NON_COPY_NON_MOVE(DnWorker);
-   DnWorker() = default;
+   void OnDone(DnQueryReqId id, DomainNameParseResult& res) {
+      Locker ctx{*this};
+      auto   ifind = ctx->Waiting_.find(id);
+      if (ifind == ctx->Waiting_.end()) // 已被取消.
+         return;
+      FnOnSocketAddressList fnOnReady = std::move(ifind->second);
+      ctx->Waiting_.erase(ifind);
+      ctx->Emitting_.push_back(DnWorkContent::Emitting{id, GetThisThreadId().ThreadId_});
+      ctx.unlock(); // 觸發結果事件, 在 unlock 之後.
+      fnOnReady(id, res);
+      ctx.lock();
+      ctx->Emitting_.erase(this->FindEmitting(ctx, id));
+   }
 
    void Cancel(DnQueryReqId id) {
       if (id > 0)
-         this->Cancel(this->Lock(), id);
+         this->Lock()->Waiting_.erase(id);
    }
    void CancelAndWait(DnQueryReqId* id) {
       if (id && *id > 0) {
-         ContentLocker ctx{this->Lock()};
-         this->Cancel(ctx, *id);
-         if (ctx->InTakingCallThread())
-            return;
-         while (ctx->EmittingId_ == *id && ctx->FrontId_ <= *id) {
+         Locker ctx{*this};
+         ctx->Waiting_.erase(*id);
+         for (;;) {
+            auto iemit = this->FindEmitting(ctx, *id);
+            if (iemit == ctx->Emitting_.end())
+               break;
+            if (iemit->ThreadId_ == GetThisThreadId().ThreadId_)
+               return; // 在 fnOnReady() 裡面取消自己.
             ctx.unlock();
             std::this_thread::yield();
             ctx.lock();
@@ -239,29 +397,67 @@ struct DnWorker : public DnWorkController::DnWorkerBase {
          *id = 0;
       }
    }
-public:
-   void Cancel(const ContentLocker& ctx, DnQueryReqId id) {
-      size_t dnIndex = id - ctx->FrontId_;
-      if (dnIndex < ctx->DnRequests_.size())
-         ctx->DnRequests_[dnIndex] = DnRequest{};
-   }
 };
-} // namespace impl
-using DnWorker = impl::DnWorker;
 
 static DnWorker& GetDefaultDnWorker() {
    static DnWorker   DnWorker_;
    return DnWorker_;
 }
 
+static void ResumeDnAsyncReq(DnAsyncReqSP&& req) {
+   GetDefaultDnWorker().Resume(std::move(req));
+}
+void DnAsyncReq::Run(DnAsyncReqSP&& req) {
+   DnWorker&         worker = GetDefaultDnWorker();
+   DomainNameParser& parser = req->DnParser_;
+   for (;;) {
+      if (!worker.IsWaiting(req->Id_)) // 已被取消, 不用再解析了.
+         return;
+      if (parser.DnParser_.empty())
+         break;
+      StrView dnPort = StrFetchTrim(parser.DnParser_, ',');
+      if (dnPort.empty())
+         continue;
+      req->OldFamily_ = parser.AddrHints_.ai_family;
+      StrView dn1;
+      if (parser.FetchDnPort(dnPort, dn1)) {
+         req->PendingDn_ = dn1;
+         req->PendingPort_ = dnPort;
+         SocketAddressList addrList;
+         const int         eno = GetDnCache().Resolve(parser.AddrHints_, dn1.begin(), dnPort.begin(), addrList, &req);
+         if (!req) // 相同的 dn 正在查詢中, 已移到等候佇列, 由查詢的 thread 提供結果後, 再繼續.
+            return;
+         parser.OnResolved(dn1, dnPort, eno, addrList, req->DnResult_);
+      }
+      parser.AddrHints_.ai_family = req->OldFamily_;
+   }
+   parser.OnParseEnd(req->DnResult_);
+   worker.OnDone(req->Id_, req->DnResult_);
+}
+
+struct DnTaskHandler {
+   fon9_NON_COPY_NON_MOVE(DnTaskHandler);
+   using MessageType = DnRequest;
+
+   DnTaskHandler(DnThreadPool&) {
+   }
+   void OnMessage(DnRequest& req) {
+      DnAsyncReq::Run(std::move(req));
+   }
+   void OnThreadEnd(const std::string& threadName) {
+      (void)threadName;
+   }
+};
+} // namespace impl
+
 void AsyncDnQuery(DnQueryReqId& id, std::string dn, SocketAddress::port_t defaultPortNo, FnOnSocketAddressList fnOnReady) {
-   return GetDefaultDnWorker().AddWork(id, std::move(dn), defaultPortNo, std::move(fnOnReady));
+   return impl::GetDefaultDnWorker().AddWork(id, std::move(dn), defaultPortNo, std::move(fnOnReady));
 }
 void AsyncDnQuery_CancelAndWait(DnQueryReqId* id) {
-   return GetDefaultDnWorker().CancelAndWait(id);
+   return impl::GetDefaultDnWorker().CancelAndWait(id);
 }
 void AsyncDnQuery_Cancel(DnQueryReqId id) {
-   return GetDefaultDnWorker().Cancel(id);
+   return impl::GetDefaultDnWorker().Cancel(id);
 }
 
 } } // namespaces
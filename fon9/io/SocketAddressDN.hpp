@@ -4,6 +4,7 @@
 #define __fon9_io_SocketAddressDN_hpp__
 #include "fon9/io/SocketAddress.hpp"
 #include "fon9/Utility.hpp"
+#include "fon9/TimeInterval.hpp"
 #include <vector>
 #include <functional>
 
@@ -15,6 +16,9 @@ namespace fon9 { namespace io {
 
 fon9_WARN_DISABLE_PADDING;
 using SocketAddressList = std::vector<SocketAddress>;
+namespace impl {
+struct DnAsyncReq;
+} // namespace impl
 
 /// \ingroup io
 /// 透過 DomainNameParser::Parse() 查找 dn => address 的結果.
@@ -38,7 +42,16 @@ class fon9_API DomainNameParser {
    StrView     DnParser_;
    port_t      LastPortNo_;
    port_t      DefaultPortNo_;
+   friend struct impl::DnAsyncReq;
    void Parse(StrView dnPort, DomainNameParseResult& res);
+   /// 從 dnPort 取出 dn1, dnPort 只留下 port, 兩者尾端都會填入 '\0';
+   /// 若為 "[ipv6]:port" 格式, 則會設定 AddrHints_.ai_family = AF_INET6;
+   /// \retval false dn1 及 port 都是空的, 不用查詢.
+   bool FetchDnPort(StrView& dnPort, StrView& dn1);
+   /// 取得 dn1:dnPort 的查詢結果後, 將 address(或錯誤訊息) 加入 res.
+   void OnResolved(StrView dn1, StrView dnPort, int eno, SocketAddressList& addrList, DomainNameParseResult& res);
+   /// 全部的 dn 解析完畢後: 若沒有指定 DefaultPortNo_, 則使用最後一個 port 填入前面沒有 port 的 address.
+   void OnParseEnd(DomainNameParseResult& res);
 public:
    /// - 預設建構時會設定 AddrHints_.ai_family = AF_INET;
    /// - 若 AddrHints_.ai_family = AF_UNSPEC; 表示 AF_INET 或 AF_INET6 皆可.
@@ -65,6 +78,8 @@ public:
 
    /// 一次取出一個用','分隔的 domain name, 透過 getaddrinfo() 取得 address, 加入 res.AddressList_.
    /// getaddrinfo() 為 blocking mode, 所以這裡可能會花一點時間!
+   /// - 查詢結果(包含失敗)會放入 dn cache, 參考 DnQueryConfig;
+   /// - 若相同的 dn 正在其他 thread 查詢, 則等候該查詢的結果, 不會重複呼叫 getaddrinfo().
    /// \retval false 已經沒有任何 domain name.
    /// \retval true  可能還有 domain name 需要解析.
    bool Parse(DomainNameParseResult& res);
@@ -76,12 +91,44 @@ public:
 };
 fon9_WARN_POP;
 
+/// \ingroup io
+/// DomainNameParser 及 AsyncDnQuery() 的共用設定.
+/// - getaddrinfo() 無法取得 DNS 的 TTL, 所以 cache 的保留時間使用這裡的設定.
+struct DnQueryConfig {
+   /// 查詢成功的結果, 在 cache 保留的時間; 0 = 不使用 cache.
+   TimeInterval   CacheTTL_{TimeInterval_Second(60)};
+   /// 查詢失敗的結果(negative cache), 在 cache 保留的時間; 0 = 失敗時不保留.
+   /// 避免大量斷線重連時, 不停地查詢不存在(或暫時無法解析)的 dn.
+   TimeInterval   NegativeTTL_{TimeInterval_Second(5)};
+   /// AsyncDnQuery() 使用的專用 thread 數量, 僅在第一次 AsyncDnQuery() 之前設定有效.
+   uint32_t       ThreadCount_{4};
+};
+fon9_API void DnQuery_SetConfig(const DnQueryConfig& cfg);
+fon9_API DnQueryConfig DnQuery_GetConfig();
+/// 清除 dn cache 的全部內容(正在查詢中的除外).
+fon9_API void DnQuery_ClearCache();
+
+/// \ingroup io
+/// dn cache 的累計次數, 可用來觀察 cache 及 查詢中合併 的效果.
+struct DnQueryStats {
+   /// 實際呼叫 getaddrinfo() 的次數.
+   uint64_t ResolveCount_{0};
+   /// 直接使用 cache 結果的次數(包含 negative cache 及 等候其他 thread 查詢的結果).
+   uint64_t CacheHitCount_{0};
+   /// 因相同的 dn 正在查詢中, 而等候查詢結果的次數.
+   uint64_t WaitCount_{0};
+};
+fon9_API DnQueryStats DnQuery_GetStats();
+
 using DnQueryReqId = uint64_t;
 using FnOnSocketAddressList = std::function<void(DnQueryReqId id, DomainNameParseResult& res)>;
 
 /// \ingroup io
 /// - dn 可以包含多個 address:port, 使用 ',' 分隔即可.
-/// - 在 fon9::GetDefaultThreadPool() 處理, 處理完畢透過 fnOnReady() 告知結果.
+/// - 在專用的 thread pool(DnQueryConfig::ThreadCount_) 處理, 處理完畢透過 fnOnReady() 告知結果.
+///   - 不使用 fon9::GetDefaultThreadPool(), 避免緩慢的 DNS 影響其他工作.
+///   - 多個要求可同時查詢, 不會因其中一個 dn 緩慢而全部卡住.
+///   - 若相同的 dn 正在查詢中, 則要求放到該 dn 的等候佇列, 不佔用 thread 等候, 由查詢的 thread 提供結果.
 /// - id = 可丟給 AsyncDnQuery_Cancel() 取消.
 /// - 可能在返回前就呼叫了 fnOnReady(); 但在呼叫 fnOnReady() 之前 id 必定已經填妥.
 fon9_API void AsyncDnQuery(DnQueryReqId& id, std::string dn, SocketAddress::port_t defaultPortNo, FnOnSocketAddressList fnOnReady);
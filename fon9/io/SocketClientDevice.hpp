@@ -92,6 +92,9 @@ class RecvBuffer;
 ///      void StartRecv(RecvBufferSize expectSize);
 ///
 ///      GetSendBuffer& GetSendBuffer();
+///
+///      // 送出緩衝已空, 且沒有等候 kernel 完成的資料(例: MSG_ZEROCOPY).
+///      bool IsSendCompleted();
 ///   };
 ///   \endcode
 /// \tparam DeviceBase 可參考 TcpClientBase.hpp 的 class TcpClientBase;
@@ -157,7 +160,7 @@ public:
       bool res;
       this->OpQueue_.InplaceOrWait(AQueueTaskKind::Send, DeviceAsyncOp{[&res](Device& dev) {
          if (ClientImpl* impl = static_cast<SocketClientDeviceT*>(&dev)->ImplSP_.get())
-            res = impl->GetSendBuffer().IsEmpty();
+            res = impl->IsSendCompleted();
          else
             res = true;
       }});
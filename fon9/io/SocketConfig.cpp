@@ -14,6 +14,7 @@ inline static void SetOptionsDefaultAfterZero(SocketOptions& opts) {
 #endif
    opts.SO_RCVBUF_ = -1;
    opts.TCP_NODELAY_ = 1;
+   opts.SO_INCOMING_CPU_ = -1;
 }
 
 void SocketOptions::SetDefaults() {
@@ -55,6 +56,14 @@ ConfigParser::Result SocketOptions::OnTagValue(StrView tag, StrView& value) {
    }
    else if (tag == "KeepAlive")
       this->KeepAliveInterval_ = StrTo(value, int{});
+   else if (tag == "BusyPoll")
+      this->SO_BUSY_POLL_ = StrTo(value, int{});
+   else if (tag == "IncomingCpu")
+      this->SO_INCOMING_CPU_ = StrTo(value, -1);
+   else if (tag == "RxTimestamp")
+      this->SO_TIMESTAMPING_ = (toupper(static_cast<unsigned char>(value.Get1st())) == 'Y');
+   else if (tag == "ZeroCopy")
+      this->SO_ZEROCOPY_ = (toupper(static_cast<unsigned char>(value.Get1st())) == 'Y');
    else
       return ConfigParser::Result::EUnknownTag;
    return ConfigParser::Result::Success;
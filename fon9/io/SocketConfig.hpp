@@ -40,6 +40,27 @@ struct fon9_API SocketOptions {
    /// - >1:  TCP_KEEPIDLE,TCP_KEEPINTVL 的間隔秒數, 此時 TCP_KEEPCNT 一律設為 3.
    int KeepAliveInterval_;
 
+   /// 使用 "BusyPoll=usecs" 設定: 請參閱 SO_BUSY_POLL 的說明(Linux).
+   /// - <=0: 不設定(預設).
+   /// - >0:  在沒有資料時, 由 recv 以 busy polling 的方式等候 NIC 的資料, 最多 usecs 微秒.
+   ///   超過系統設定(net.core.busy_read)的值, 需要 CAP_NET_ADMIN 權限.
+   int SO_BUSY_POLL_;
+   /// 使用 "IncomingCpu=n" 設定: 請參閱 SO_INCOMING_CPU 的說明(Linux).
+   /// - <0: 不設定(預設).
+   /// - Listener: 搭配 ReusePort=Y, 每個 cpu 建立一個 listener, 並將 IncomingCpu 設為該 cpu,
+   ///   則 kernel 會優先將「在該 cpu 收到的連線」交給此 listener; 通常搭配 IoServiceArgs 的 Cpus 設定,
+   ///   讓連線的封包處理, 與負責該連線的 FdrThread 在同一個 cpu.
+   int SO_INCOMING_CPU_;
+   /// 使用 "RxTimestamp=Y" 設定: 啟用 SO_TIMESTAMPING 的 software RX timestamp(Linux).
+   /// 啟用後, 在 Session::OnDevice_Recv() 時, 可透過 RecvBuffer::StaticCast(rxbuf).GetRxTime();
+   /// 取得 kernel 收到封包的時間, 用來計算 wire-to-handler 的延遲.
+   int SO_TIMESTAMPING_;
+   /// 使用 "ZeroCopy=Y" 設定: 啟用 SO_ZEROCOPY(Linux 4.14+).
+   /// 啟用後, FdrSocket 在一次送出的資料量較大時, 使用 send(MSG_ZEROCOPY),
+   /// 送出的 BufferNode 會保留到 kernel 的完成通知之後才釋放(觸發 OnBufferConsumed()).
+   /// 適用於大量資料(數MB)的傳送, 例: 行情快照回補; 小訊息使用 MSG_ZEROCOPY 反而會比較慢.
+   int SO_ZEROCOPY_;
+
    void SetDefaults();
 
    ConfigParser::Result OnTagValue(StrView tag, StrView& value);
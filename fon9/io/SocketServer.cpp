@@ -17,6 +17,7 @@ void SocketServerConfig::SetDefaults() {
    this->ListenConfig_.Options_.SO_REUSEADDR_ = 1;
    this->ListenConfig_.Options_.SO_REUSEPORT_ = 1;
    this->ListenBacklog_ = 5;
+   this->IsListenPerThread_ = false;
    this->ServiceArgs_.ThreadCount_ = GetDefaultServerThreadCount();
    this->ServiceArgs_.Capacity_ = 0;
    this->ServiceArgs_.CpuAffinity_.clear();
@@ -33,6 +34,8 @@ ConfigParser::Result SocketServerConfig::Parser::OnTagValue(StrView tag, StrView
       if ((this->Owner_.ListenBacklog_ = StrTo(value, int{5})) <= 0)
          this->Owner_.ListenBacklog_ = 5;
    }
+   else if (tag == "ListenPerThread")
+      this->Owner_.IsListenPerThread_ = (toupper(static_cast<unsigned char>(value.Get1st())) == 'Y');
    else if (tag == "ClientOptions") { // value = "{AcceptedSocketOptions_|AcceptedClientOptions_}"
       struct ClientParser : public ConfigParser {
          fon9_NON_COPY_NON_MOVE(ClientParser);
@@ -19,6 +19,14 @@ struct fon9_API SocketServerConfig {
    /// - SetDefaults() = 5
    int   ListenBacklog_;
 
+   /// 使用 "ListenPerThread=Y" 設定, 目前僅 FdrTcpServer 支援.
+   /// - 為每個 io service thread 建立一個 listener(SO_REUSEPORT), 由 kernel 分配連入的連線.
+   /// - 連入的連線由「接受連線的 listener」所在的 thread 負責後續的 io, 讓 accept 及之後的 io 都在同一個 thread(cpu).
+   /// - 若 ListenConfig_ 沒有設定 IncomingCpu, 且 thread 有綁定 cpu(Cpus=), 則該 listener 的 SO_INCOMING_CPU 設為該 cpu.
+   /// - 必須 ReusePort=Y(預設).
+   /// - SetDefaults() = false;
+   bool  IsListenPerThread_;
+
    /// \ref IoServiceArgs::OnTagValue(StrView tag, StrView& value)
    /// - ServiceArgs_.ThreadCount_ 提供服務的 threads 數量.
    ///   - SetDefaults() = std::thread::hardware_concurrency() / 2.
@@ -45,6 +53,7 @@ struct fon9_API SocketServerConfig {
       ~Parser();
 
       /// - "ListenBacklog=n"
+      /// - "ListenPerThread=Y"
       /// - "ClientOptions={configs}" 提供: AcceptedSocketOptions_, AcceptedClientOptions_
       /// - 其餘丟給 ListenConfig_.OnTagValue() 及 ServiceArgs_.OnTagValue();
       Result OnTagValue(StrView tag, StrView& value) override;
@@ -6,6 +6,7 @@
 #include "fon9/io/SocketClientConfig.hpp"
 #include "fon9/TestTools.hpp"
 #include <thread>
+#include <atomic>
 
 #ifdef fon9_WINDOWS
 #pragma comment(lib, "Ws2_32.lib")
@@ -42,6 +43,122 @@ int main() {
    } while (!isDone);
    std::cout << "[OK   ] Test done|@delay(ms)=" << ms << std::endl;
 
+   // 相同 dn 的大量查詢: 由 cache 及 查詢中合併, 每個 dn 只需要一次 getaddrinfo().
+   std::cout << "[TEST ] dn query storm";
+   {
+      static const unsigned   kQueryCount = 1000;
+      std::atomic<unsigned>   doneCount{0};
+      std::atomic<unsigned>   errCount{0};
+      std::vector<fon9::io::DnQueryReqId> reqs(kQueryCount);
+      fon9::io::DnQuery_ClearCache();
+      const fon9::io::DnQueryStats statsBeg = fon9::io::DnQuery_GetStats();
+      fon9::StopWatch stopWatch;
+      for (auto& id : reqs) {
+         fon9::io::AsyncDnQuery(id, "localhost:6666,127.0.0.1:http", 0,
+                                [&doneCount, &errCount](fon9::io::DnQueryReqId, fon9::io::DomainNameParseResult& res) {
+            if (!res.ErrMsg_.empty() || res.AddressList_.size() < 2)
+               ++errCount;
+            ++doneCount;
+         });
+      }
+      while (doneCount < kQueryCount)
+         std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      const fon9::io::DnQueryStats stats = fon9::io::DnQuery_GetStats();
+      const uint64_t resolveCount = stats.ResolveCount_ - statsBeg.ResolveCount_;
+      const uint64_t hitCount = stats.CacheHitCount_ - statsBeg.CacheHitCount_;
+      // 2 個 dn: "localhost:6666", "127.0.0.1:http";
+      if (errCount != 0 || resolveCount != 2 || resolveCount + hitCount != kQueryCount * 2) {
+         std::cout << "|errCount=" << errCount << "|resolveCount=" << resolveCount
+                   << "|hitCount=" << hitCount << "\r[ERROR]" << std::endl;
+         abort();
+      }
+      stopWatch.PrintResultNoEOL("\r[OK   ] dn query storm", kQueryCount)
+         << "|waitCount=" << (stats.WaitCount_ - statsBeg.WaitCount_) << std::endl;
+   }
+   // CacheTTL=0: 只有查詢中合併; 等候中的要求不佔用 thread, 由查詢的 thread 提供結果.
+   std::cout << "[TEST ] dn query coalesce(TTL=0)";
+   {
+      const fon9::io::DnQueryConfig cfgBak = fon9::io::DnQuery_GetConfig();
+      fon9::io::DnQueryConfig       cfg = cfgBak;
+      cfg.CacheTTL_ = cfg.NegativeTTL_ = fon9::TimeInterval{};
+      fon9::io::DnQuery_SetConfig(cfg);
+      fon9::io::DnQuery_ClearCache();
+      static const unsigned   kQueryCount = 1000;
+      std::atomic<unsigned>   doneCount{0};
+      std::atomic<unsigned>   errCount{0};
+      std::vector<fon9::io::DnQueryReqId> reqs(kQueryCount);
+      const fon9::io::DnQueryStats statsBeg = fon9::io::DnQuery_GetStats();
+      fon9::StopWatch stopWatch;
+      for (auto& id : reqs) {
+         fon9::io::AsyncDnQuery(id, "localhost:6666,127.0.0.1:http", 0,
+                                [&doneCount, &errCount](fon9::io::DnQueryReqId, fon9::io::DomainNameParseResult& res) {
+            if (!res.ErrMsg_.empty() || res.AddressList_.size() < 2
+                || res.AddressList_.front().GetPort() != 6666 || res.AddressList_.back().GetPort() != 80)
+               ++errCount;
+            ++doneCount;
+         });
+      }
+      while (doneCount < kQueryCount)
+         std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      const fon9::io::DnQueryStats stats = fon9::io::DnQuery_GetStats();
+      const uint64_t resolveCount = stats.ResolveCount_ - statsBeg.ResolveCount_;
+      const uint64_t hitCount = stats.CacheHitCount_ - statsBeg.CacheHitCount_;
+      const uint64_t waitCount = stats.WaitCount_ - statsBeg.WaitCount_;
+      fon9::io::DnQuery_SetConfig(cfgBak);
+      // 每個 dn 不是自己查詢, 就是等候(取得)別人的查詢結果.
+      if (errCount != 0 || resolveCount + hitCount != kQueryCount * 2 || hitCount != waitCount) {
+         std::cout << "|errCount=" << errCount << "|resolveCount=" << resolveCount
+                   << "|hitCount=" << hitCount << "|waitCount=" << waitCount << "\r[ERROR]" << std::endl;
+         abort();
+      }
+      stopWatch.PrintResultNoEOL("\r[OK   ] dn query coalesce(TTL=0)", kQueryCount)
+         << "|resolveCount=" << resolveCount << "|waitCount=" << waitCount << std::endl;
+   }
+   // CacheTTL, NegativeTTL 到期後, 必須重新查詢.
+   std::cout << "[TEST ] dn cache TTL";
+   {
+      const fon9::io::DnQueryConfig cfgBak = fon9::io::DnQuery_GetConfig();
+      fon9::io::DnQueryConfig       cfg = cfgBak;
+      cfg.CacheTTL_ = fon9::TimeInterval_Millisecond(400);
+      cfg.NegativeTTL_ = fon9::TimeInterval_Millisecond(100);
+      fon9::io::DnQuery_SetConfig(cfg);
+      fon9::io::DnQuery_ClearCache();
+      struct DnCheck {
+         const char* Dn_;
+         bool        IsErr_;
+         unsigned    SleepMS_;
+      };
+      // "localhost:bad" 不會送出 DNS 查詢, getaddrinfo() 直接因 port 無效而失敗.
+      static const DnCheck checks[] = {
+         {"127.0.0.1:http", false, 0},
+         {"localhost:bad",  true,  0},
+         {"localhost:bad",  true,  0},   // NegativeTTL 未到期: 使用 cache.
+         {"127.0.0.1:http", false, 200}, // CacheTTL 未到期, NegativeTTL 已到期.
+         {"localhost:bad",  true,  0},   // 重新查詢.
+         {"127.0.0.1:http", false, 300}, // CacheTTL 已到期: 重新查詢.
+      };
+      static const bool kIsResolve[] = {true, true, false, false, true, true};
+      fon9::io::DomainNameParser    parser;
+      fon9::io::DomainNameParseResult res;
+      for (size_t L = 0; L < fon9::numofele(checks); ++L) {
+         const DnCheck& chk = checks[L];
+         if (chk.SleepMS_)
+            std::this_thread::sleep_for(std::chrono::milliseconds{chk.SleepMS_});
+         const uint64_t resolveCount = fon9::io::DnQuery_GetStats().ResolveCount_;
+         res.Clear();
+         parser.Reset(chk.Dn_);
+         parser.ParseAll(res);
+         const bool isResolved = (fon9::io::DnQuery_GetStats().ResolveCount_ != resolveCount);
+         if (res.ErrMsg_.empty() == chk.IsErr_ || isResolved != kIsResolve[L]) {
+            std::cout << "|step=" << L << "|dn=" << chk.Dn_ << "|err=" << res.ErrMsg_
+                      << "|isResolved=" << isResolved << "\r[ERROR]" << std::endl;
+            abort();
+         }
+      }
+      fon9::io::DnQuery_SetConfig(cfgBak);
+      std::cout << "\r[OK   ]" << std::endl;
+   }
+
    //--------------------------------------------------------------------------//
    utinfo.PrintSplitter();
    std::cout << "[TEST ] SocketClientConfig::ParseConfig()";
@@ -61,6 +178,7 @@ int main() {
    };
    fon9::StrView cfgstr{"192.168.1.3:5555|Timeout=99|DN=" cstrDN
       "|TcpNoDelay=N|SNDBUF=1234|RCVBUF=5678|ReuseAddr=Y|ReusePort=Y|Linger=N|KeepAlive=8"
+      "|BusyPoll=50|IncomingCpu=3|RxTimestamp=Y|ZeroCopy=Y"
       "|MyTag=MyValue|Bind=192.168.1.4:29999"
       "|ERR-TEST"};
    if (CliParser{clicfg}.Parse(cfgstr) != fon9::ConfigParser::Result::EUnknownTag
@@ -87,6 +205,10 @@ int main() {
    CHECK_VALUE(clicfg, Options_.Linger_.l_onoff,    1);
    CHECK_VALUE(clicfg, Options_.Linger_.l_linger,   0);
    CHECK_VALUE(clicfg, Options_.KeepAliveInterval_, 8);
+   CHECK_VALUE(clicfg, Options_.SO_BUSY_POLL_,      50);
+   CHECK_VALUE(clicfg, Options_.SO_INCOMING_CPU_,   3);
+   CHECK_VALUE(clicfg, Options_.SO_TIMESTAMPING_,   1);
+   CHECK_VALUE(clicfg, Options_.SO_ZEROCOPY_,       1);
 
    if (clicfg.AddrRemote_.Addr_.sa_family != AF_INET
        || clicfg.AddrRemote_.Addr4_.sin_addr.s_addr != 0x0301a8c0
@@ -125,9 +247,12 @@ __ERROR_cstrErrFieldName:
       }
    };
    cfgstr = "[::1]9999|Remote=[2406:2000:ec:815::3]:8888|ListenBacklog=100"
-      "|Capacity=10240|ThreadCount=99|Wait=Busy|Cpus=1,2,3"
+      "|Capacity=10240|ThreadCount=99|Wait=Busy|Cpus=1,2,3|Engine=uring|ListenPerThread=Y"
+      "|ThreadAlloc=LeastConn|EdgeTrigger=Y"
       "|ClientOptions="
          "{TcpNoDelay=N|SNDBUF=1234|RCVBUF=5678|ReuseAddr=Y|ReusePort=Y|Linger=N|KeepAlive=8"
+         "|BusyPoll=50|IncomingCpu=3|RxTimestamp=Y|ZeroCopy=Y|IoThread=2"
+         "|CoalesceUS=50|CoalesceBytes=16384|CoalesceIov=64"
          "|MyClientTag=MyClientValue}"
       "|MyServerTag=MyServerValue|ERR-TEST";
    if (SerParser{sercfg}.Parse(cfgstr) != fon9::ConfigParser::Result::EUnknownTag
@@ -141,7 +266,15 @@ __ERROR_cstrErrFieldName:
    CHECK_VALUE(sercfg, ServiceArgs_.ThreadCount_, 99);
    CHECK_VALUE(sercfg, ServiceArgs_.HowWait_,     fon9::HowWait::Busy);
    CHECK_VALUE(sercfg, ServiceArgs_.Capacity_,    10240);
+   CHECK_VALUE(sercfg, ServiceArgs_.Engine_,      fon9::io::IoEngine::Uring);
+   CHECK_VALUE(sercfg, ServiceArgs_.ThreadAlloc_, fon9::io::IoThreadAlloc::LeastConn);
+   CHECK_VALUE(sercfg, ServiceArgs_.IsEdgeTriggered_, true);
+   CHECK_VALUE(sercfg, AcceptedClientOptions_.IoThreadIndex_, 2);
+   CHECK_VALUE(sercfg, AcceptedClientOptions_.CoalesceUS_, 50);
+   CHECK_VALUE(sercfg, AcceptedClientOptions_.CoalesceBytes_, 16384);
+   CHECK_VALUE(sercfg, AcceptedClientOptions_.CoalesceIov_, 64);
    CHECK_VALUE(sercfg, ListenBacklog_, 100);
+   CHECK_VALUE(sercfg, IsListenPerThread_, true);
 
    struct in6_addr sin6_addr;
    inet_pton(AF_INET6, "2406:2000:ec:815::3", &sin6_addr);
@@ -12,6 +12,7 @@ namespace fon9 { namespace io {
 /// \ingroup io
 /// - 協助 DeviceAcceptedClientBase 完成:
 ///   - Device member function: `bool IsSendBufferEmpty() const override;`
+///     DeviceAcceptedClientBase 必須提供 `bool IsSendCompleted();`
 /// - 協助完成 `DeviceImpl_DeviceStartSend<>` 所需要的 `struct SendAuxImpl`;
 template <class DeviceAcceptedClientBase>
 class DeviceAcceptedClientWithSend : public DeviceAcceptedClientBase {
@@ -22,7 +23,7 @@ public:
    virtual bool IsSendBufferEmpty() const override {
       bool res;
       this->OpQueue_.InplaceOrWait(AQueueTaskKind::Send, DeviceAsyncOp{[&res](Device& dev) {
-         res = static_cast<DeviceAcceptedClientBase*>(&dev)->GetSendBuffer().IsEmpty();
+         res = static_cast<DeviceAcceptedClientBase*>(&dev)->IsSendCompleted();
       }});
       return res;
    }
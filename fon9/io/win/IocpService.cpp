@@ -2,7 +2,7 @@
 /// \author fonwinz@gmail.com
 #include "fon9/io/win/IocpService.hpp"
 #include "fon9/ThreadTools.hpp"
-#include "fon9/Log.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 
@@ -57,7 +57,7 @@ void IocpService::ThrRun(CompletionPortHandleSP cpHandleSP, ServiceThreadArgs ar
             reinterpret_cast<IocpHandler*>(iocpHandler)->OnIocp_Error(lpOverlapped, eno);
          else {
             // CompletionPort 本身的錯誤??
-            fon9_LOG_FATAL("IocpService.ThrRun"
+            fon9_LOGM_FATAL(LogModule_Io, "IocpService.ThrRun"
                            "|iocpHandler=nullptr"
                            "|overlapped=", ToPtr{lpOverlapped},
                            "|bytesTransfered=", bytesTransfered,
@@ -88,6 +88,9 @@ public:
    SendBuffer& GetSendBuffer() {
       return this->SendBuffer_;
    }
+   bool IsSendCompleted() {
+      return this->SendBuffer_.IsEmpty();
+   }
    void ContinueToSend(DcQueueList& toSend) {
       this->IocpSocketAddRef();
       this->SendAfterAddRef(toSend);
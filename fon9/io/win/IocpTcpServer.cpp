@@ -1,6 +1,7 @@
 ﻿/// \file fon9/io/win/IocpTcpServer.cpp
 /// \author fonwinz@gmail.com
 #include "fon9/io/win/IocpTcpServer.hpp"
+#include "fon9/LogModule.hpp"
 
 namespace fon9 { namespace io {
 
@@ -205,12 +206,12 @@ void IocpTcpListener::OnIocp_Done(OVERLAPPED* lpOverlapped, DWORD bytesTransfere
       }
    }
    if (soRes.IsError() || devAccepted == nullptr)
-      fon9_LOG_ERROR("TcpServer.Accepted"
+      fon9_LOGM_ERROR(LogModule_Io, "TcpServer.Accepted"
                      "|dev=", ToHex{devAccepted},
                      "|soAccepted=", soAccepted,
                      "|err=", soRes, '|', strConnUID);
    else
-      fon9_LOG_INFO("TcpServer.Accepted"
+      fon9_LOGM_INFO(LogModule_Io, "TcpServer.Accepted"
                     "|dev=", ToHex{devAccepted},
                     "|seq=", devAccepted->GetAcceptedClientSeq(),
                     "|soAccepted=", soAccepted, '|', strConnUID);
@@ -223,7 +224,7 @@ void IocpTcpListener::OnIocp_Done(OVERLAPPED* lpOverlapped, DWORD bytesTransfere
 void IocpTcpListener::ResetupAccepter() {
    SocketResult soRes;
    if (!this->SetupAccepter(soRes)) {
-      fon9_LOG_ERROR("IocpTcpListener.ResetupAccepter|err=", soRes);
+      fon9_LOGM_ERROR(LogModule_Io, "IocpTcpListener.ResetupAccepter|err=", soRes);
       this->Server_->CommonTimerRunAfter(TimeInterval_Millisecond(this->Server_->OpImpl_GetOptions().LinkErrorRetryInterval_));
    }
 }
@@ -3,6 +3,7 @@
 #include "fon9/rc/RcClientApi.h"
 #include "fon9/rc/RcClientSession.hpp"
 #include "fon9/DefaultThreadPool.hpp"
+#include "fon9/WorkStealingPool.hpp"
 #include "fon9/LogFile.hpp"
 
 namespace fon9 { namespace rc {
@@ -69,6 +70,7 @@ fon9_Initialize(const char* logFileFmt) {
       RcClientMgr_.reset(new RcClientMgr{ioMgrArgs});
 
       fon9::GetDefaultThreadPool();
+      fon9::GetDefaultWorkPool();
       fon9::GetDefaultTimerThread();
       f9rc_St_ = f9rc_St_Initialized;
    }
@@ -93,6 +95,7 @@ fon9_Finalize() {
 
    RcClientMgr_.reset();
 
+   fon9::WaitWorkPoolQuit(fon9::GetDefaultWorkPool());
    fon9::WaitDefaultThreadPoolQuit(fon9::GetDefaultThreadPool());
    // TODO: fon9::GetDefaultTimerThread(); 如何結束?
    f9rc_St_ = f9rc_St_Finalized;
@@ -0,0 +1,71 @@
+﻿/// \file fon9/seed/LogModuleTree.cpp
+/// \author fonwinz@gmail.com
+#include "fon9/seed/LogModuleTree.hpp"
+#include "fon9/seed/FieldMaker.hpp"
+#include "fon9/seed/PodOp.hpp"
+#include "fon9/LogModule.hpp"
+
+namespace fon9 { namespace seed {
+
+LayoutSP LogModuleTree::MakeLayout() {
+   Fields fields;
+   fields.Add(fon9_MakeField2(LogModule, Level));
+   // LogModule::Name_ 為 StrView, 沒有對應的 Field;
+   // 此處的 key 欄位僅用來描述 layout, GridView、Get 都直接輸出 Name_, 不會透過 key 欄位存取.
+   return new Layout1(FieldSP{new FieldCharVector(Named{"Name"}, 0)},
+                      new Tab{Named{"LogModule"}, std::move(fields), TabFlag::NoSapling_NoSeedCommand_Writable});
+}
+
+class LogModuleTree::PodOp : public PodOpDefault {
+   fon9_NON_COPY_NON_MOVE(PodOp);
+   using base = PodOpDefault;
+   LogModule& Module_;
+public:
+   PodOp(LogModule& module, Tree& sender, const StrView& key)
+      : base{sender, OpResult::no_error, key}
+      , Module_(module) {
+   }
+   void BeginRead(Tab& tab, FnReadOp fnCallback) override {
+      this->BeginRW(tab, std::move(fnCallback), SimpleRawRd{this->Module_});
+   }
+   void BeginWrite(Tab& tab, FnWriteOp fnCallback) override {
+      this->BeginRW(tab, std::move(fnCallback), SimpleRawWr{this->Module_});
+   }
+};
+
+class LogModuleTree::TreeOp : public fon9::seed::TreeOp {
+   fon9_NON_COPY_NON_MOVE(TreeOp);
+   using base = fon9::seed::TreeOp;
+public:
+   TreeOp(LogModuleTree& tree) : base(tree) {
+   }
+   void GridView(const GridViewRequest& req, FnGridViewOp fnCallback) override {
+      TreeOp_GridView_MustLock(*this, GetLogModules(), req, std::move(fnCallback),
+                               [](LogModuleMap::iterator ivalue, Tab* tab, RevBuffer& rbuf) {
+         if (tab)
+            FieldsCellRevPrint(tab->Fields_, SimpleRawRd{*ivalue->second}, rbuf, GridViewResult::kCellSplitter);
+         RevPrint(rbuf, ivalue->first);
+      });
+   }
+   void Get(StrView strKeyText, FnPodOp fnCallback) override {
+      {
+         // 在 LogModule 的解構(移除)之前, 必須先取得 GetLogModules() 的鎖,
+         // 所以在鎖定期間存取 LogModule 是安全的.
+         LogModules::Locker modules{GetLogModules()};
+         auto               ifind = GetIteratorForPod(*modules, strKeyText);
+         if (ifind != modules->end()) {
+            PodOp op{*ifind->second, this->Tree_, strKeyText};
+            fnCallback(op, &op);
+            return;
+         }
+      } // unlock.
+      fnCallback(PodOpResult{this->Tree_, OpResult::not_found_key, strKeyText}, nullptr);
+   }
+};
+
+void LogModuleTree::OnTreeOp(FnTreeOp fnCallback) {
+   TreeOp op{*this};
+   fnCallback(TreeOpResult{this, OpResult::no_error}, &op);
+}
+
+} } // namespaces
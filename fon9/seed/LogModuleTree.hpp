@@ -0,0 +1,37 @@
+﻿/// \file fon9/seed/LogModuleTree.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_seed_LogModuleTree_hpp__
+#define __fon9_seed_LogModuleTree_hpp__
+#include "fon9/seed/MaTree.hpp"
+
+namespace fon9 { namespace seed {
+
+/// \ingroup seed
+/// 列出 fon9/LogModule.hpp 的 GetLogModules(), key = LogModule::Name_;
+/// - 可直接修改 Level 欄位, 調整該 LogModule 的執行階段 log 等級.
+/// - Level 為 LogLevel 的數值: 0=Trace, 1=Debug, 2=Info, 3=Important, 4=Warn, 5=Error, 6=Fatal;
+///   7(LogLevel::Count)=使用全域的 LogLevel_;
+/// - 不支援 Add, Remove: LogModule 由程式建構時自動加入.
+class fon9_API LogModuleTree : public Tree {
+   fon9_NON_COPY_NON_MOVE(LogModuleTree);
+   using base = Tree;
+   static LayoutSP MakeLayout();
+   class PodOp;
+   class TreeOp;
+
+public:
+   LogModuleTree() : base{MakeLayout()} {
+   }
+
+   virtual void OnTreeOp(FnTreeOp fnCallback) override;
+
+   #define fon9_kCSTR_LogModuleTree_DefaultName  "LogModule"
+   /// 在 maTree 上面種一個 LogModuleTree.
+   /// \retval false seedName已存在.
+   static bool Plant(MaTree& maTree, std::string seedName = fon9_kCSTR_LogModuleTree_DefaultName) {
+      return maTree.Add(new NamedSapling(new LogModuleTree, std::move(seedName)), "LogModuleTree.Plant");
+   }
+};
+
+} } // namespaces
+#endif//__fon9_seed_LogModuleTree_hpp__
@@ -0,0 +1,77 @@
+﻿/// \file fon9/seed/MemBlockTree.cpp
+/// \author fonwinz@gmail.com
+#include "fon9/seed/MemBlockTree.hpp"
+#include "fon9/seed/FieldMaker.hpp"
+#include "fon9/seed/PodOp.hpp"
+#include "fon9/buffer/MemBlockImpl.hpp"
+
+namespace fon9 { namespace seed {
+
+LayoutSP MemBlockTree::MakeLayout() {
+   Fields fields;
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, AllocCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, FreeCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, InUseCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, InUseHighWater));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, CenterRefillCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, MallocFallbackCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, TrimCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, ThreadCachedCount));
+   fields.Add(fon9_MakeField2(MemBlockLevelStat, CenterReservedCount));
+   return new Layout1(fon9_MakeField2(MemBlockLevelStat, BlockSize),
+                      new Tab{Named{"MemBlock"}, std::move(fields)});
+}
+
+class MemBlockTree::TreeOp : public fon9::seed::TreeOp {
+   fon9_NON_COPY_NON_MOVE(TreeOp);
+   using base = fon9::seed::TreeOp;
+   MemBlockStats  Stats_;
+   unsigned       Count_;
+public:
+   TreeOp(MemBlockTree& tree) : base(tree), Count_{MemBlockGetStats(Stats_)} {
+   }
+   /// 傳回第一個 BlockSize_ >= key 的位置, BlockSize=0(malloc) 放在最後.
+   unsigned LowerBound(StrView strKeyText) const {
+      if (strKeyText.begin() == kStrKeyText_Begin_)
+         return 0;
+      if (strKeyText.begin() == kStrKeyText_End_)
+         return this->Count_;
+      const MemBlockSize key = StrTo(strKeyText, MemBlockSize{0});
+      if (key == 0)
+         return this->Count_ - 1;
+      unsigned idx = 0;
+      while (idx < this->Count_ - 1 && this->Stats_[idx].BlockSize_ < key)
+         ++idx;
+      return idx;
+   }
+   void GridView(const GridViewRequest& req, FnGridViewOp fnCallback) override {
+      GridViewResult res{this->Tree_, req.Tab_};
+      MakeGridViewArrayRange(this->LowerBound(req.OrigKey_), this->Count_, req, res,
+                             [this](unsigned idx, Tab* tab, RevBuffer& rbuf) {
+         const MemBlockLevelStat& stat = this->Stats_[idx];
+         if (tab)
+            FieldsCellRevPrint(tab->Fields_, SimpleRawRd{stat}, rbuf, GridViewResult::kCellSplitter);
+         RevPrint(rbuf, stat.BlockSize_);
+         return true;
+      });
+      fnCallback(res);
+   }
+   void Get(StrView strKeyText, FnPodOp fnCallback) override {
+      const unsigned idx = this->LowerBound(strKeyText);
+      if (idx < this->Count_
+          && (strKeyText.begin() == kStrKeyText_Begin_
+              || this->Stats_[idx].BlockSize_ == StrTo(strKeyText, MemBlockSize{0}))) {
+         PodOpReadonly<MemBlockLevelStat> op{this->Stats_[idx], this->Tree_, strKeyText};
+         fnCallback(op, &op);
+      }
+      else
+         fnCallback(PodOpResult{this->Tree_, OpResult::not_found_key, strKeyText}, nullptr);
+   }
+};
+
+void MemBlockTree::OnTreeOp(FnTreeOp fnCallback) {
+   TreeOp op{*this};
+   fnCallback(TreeOpResult{this, OpResult::no_error}, &op);
+}
+
+} } // namespaces
@@ -0,0 +1,35 @@
+﻿/// \file fon9/seed/MemBlockTree.hpp
+/// \author fonwinz@gmail.com
+#ifndef __fon9_seed_MemBlockTree_hpp__
+#define __fon9_seed_MemBlockTree_hpp__
+#include "fon9/seed/MaTree.hpp"
+
+namespace fon9 { namespace seed {
+
+/// \ingroup seed
+/// 唯讀的 MemBlock 使用統計, 每個等級一筆, key = BlockSize;
+/// 最後一筆 BlockSize=0 為直接使用 malloc() 的統計.
+/// - 每次查詢時透過 MemBlockGetStats() 取得最新的統計, 所以可從管理介面即時觀察.
+/// - 欄位說明請參考 fon9/buffer/MemBlockImpl.hpp: MemBlockLevelStat.
+class fon9_API MemBlockTree : public Tree {
+   fon9_NON_COPY_NON_MOVE(MemBlockTree);
+   using base = Tree;
+   static LayoutSP MakeLayout();
+   class TreeOp;
+
+public:
+   MemBlockTree() : base{MakeLayout()} {
+   }
+
+   virtual void OnTreeOp(FnTreeOp fnCallback) override;
+
+   #define fon9_kCSTR_MemBlockTree_DefaultName  "MemBlock"
+   /// 在 maTree 上面種一個 MemBlockTree.
+   /// \retval false seedName已存在.
+   static bool Plant(MaTree& maTree, std::string seedName = fon9_kCSTR_MemBlockTree_DefaultName) {
+      return maTree.Add(new NamedSapling(new MemBlockTree, std::move(seedName)), "MemBlockTree.Plant");
+   }
+};
+
+} } // namespaces
+#endif//__fon9_seed_MemBlockTree_hpp__